@@ -0,0 +1,211 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+#include <verbit/streaming/caption_writer.h>
+
+using namespace verbit::streaming;
+
+// count every heap allocation made by the process (see bench_response_parse)
+static std::atomic<size_t> allocations {0};
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+	allocations++;
+	void* p = malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+/**
+ * Class holding a rotating set of captions responses, like those of a live event.
+ */
+class Captions
+{
+public:
+	Captions(int words) : _type("captions"), _text("text"), _punct("punct")
+	{
+		for (int i = 0; i < 1000; i++) {
+			_values.push_back("word" + std::to_string(i));
+		}
+		_values.push_back(".");
+		_items.resize(words);
+		_response.has_response = true;
+		_response.type = string_ref(_type);
+		_response.id = string_ref(_type);
+		_response.is_final = true;
+		_response.alternatives.resize(1);
+		_response.alternatives[0].items.data = _items.data();
+		_response.alternatives[0].items.count = _items.size();
+	}
+
+	// fill the next response, starting at `start` seconds
+	const Response& next(double start)
+	{
+		for (size_t i = 0; i < _items.size(); i++) {
+			bool punct = (i == _items.size() - 1);
+			const std::string& value = punct ? _values.back() : _values[(_next++) % (_values.size() - 1)];
+			_items[i].kind = string_ref(punct ? _punct : _text);
+			_items[i].value = string_ref(value);
+			_items[i].start = start + i * 0.4;
+			_items[i].end = _items[i].start + 0.3;
+		}
+		return _response;
+	}
+
+private:
+	static StringRef string_ref(const std::string& s)
+	{
+		StringRef ref;
+		ref.data = s.data();
+		ref.length = s.length();
+		return ref;
+	}
+
+	std::string _type;
+	std::string _text;
+	std::string _punct;
+	std::vector<std::string> _values;
+	std::vector<Item> _items;
+	size_t _next = 0;
+	Response _response;
+};
+
+// an SRT cue formatted with iostreams, as an ad-hoc formatter might
+void ostream_cue(std::ostream& out, uint64_t index, const Response& response)
+{
+	auto time = [&out](double seconds) {
+		long ms = (long)(seconds * 1000.0 + 0.5);
+		out << std::setfill('0') << std::setw(2) << ms / 3600000 << ':' << std::setw(2) << (ms / 60000) % 60
+			<< ':' << std::setw(2) << (ms / 1000) % 60 << ',' << std::setw(3) << ms % 1000;
+	};
+	const Span<Item>& items = response.alternatives[0].items;
+	out << index << '\n';
+	time(items[0].start);
+	out << " --> ";
+	time(items.back().end);
+	out << '\n';
+	std::string text;
+	for (const Item& item : items) {
+		if (!text.empty() && (item.kind != "punct")) {
+			text += ' ';
+		}
+		text += item.value.str();
+	}
+	out << text << "\n\n";
+}
+
+void report(const char* name, size_t cues, double seconds, size_t allocs, uint64_t bytes, uint64_t stalls)
+{
+	std::cout << std::fixed << std::setprecision(1)
+		<< std::setw(10) << name
+		<< std::setw(14) << (cues / seconds)
+		<< std::setw(10) << ((double)bytes / seconds / (1024 * 1024))
+		<< std::setw(14) << std::setprecision(3) << ((double)allocs / cues)
+		<< std::setw(10) << stalls
+		<< std::endl;
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_caption_writer [ -n cues ] [ -w words ] [ -d directory ]" << std::endl;
+	std::cerr << "  writes cues (default 1000000) of words (default 8) items each to SRT, WebVTT and JSONL" << std::endl;
+	std::cerr << "  files in directory (default /tmp) with CaptionWriter, and to SRT with iostreams, and" << std::endl;
+	std::cerr << "  reports cues/s, MB/s, heap allocations per cue and writer stalls" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int cues = 1000000;
+	int words = 8;
+	std::string dir = "/tmp";
+	int c;
+	while ((c = getopt(argc, argv, "?hn:w:d:")) != -1) {
+		switch (c) {
+		case 'n':
+			cues = atoi(optarg);
+			break;
+		case 'w':
+			words = atoi(optarg);
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if ( (cues <= 0) || (words <= 0) ) {
+		usage();
+		return EX_USAGE;
+	}
+
+	std::cout << std::setw(10) << "" << std::setw(14) << "cues/s" << std::setw(10) << "MB/s"
+		<< std::setw(14) << "allocs/cue" << std::setw(10) << "stalls" << std::endl;
+	struct Run {
+		const char* name;
+		CaptionWriter::Format format;
+		const char* suffix;
+	};
+	const Run runs[] = {
+		{"srt", CaptionWriter::srt, ".srt"},
+		{"webvtt", CaptionWriter::webvtt, ".vtt"},
+		{"jsonl", CaptionWriter::jsonl, ".jsonl"}
+	};
+	std::string base = dir + "/bench_caption_writer." + std::to_string(getpid());
+	for (const Run& run : runs) {
+		Captions captions {words};
+		std::string path = base + run.suffix;
+		CaptionWriter writer {path, run.format};
+		size_t allocs_before = allocations.load();
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < cues; i++) {
+			writer.add(captions.next(i * words * 0.4));
+		}
+		writer.close();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		report(run.name, cues, seconds, allocations.load() - allocs_before, writer.writer().bytes_written(),
+			writer.writer().stalls());
+		unlink(path.c_str());
+	}
+	{
+		Captions captions {words};
+		std::string path = base + ".ostream.srt";
+		std::ofstream out {path};
+		size_t allocs_before = allocations.load();
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < cues; i++) {
+			ostream_cue(out, i + 1, captions.next(i * words * 0.4));
+		}
+		out.close();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::ifstream written {path, std::ios::binary | std::ios::ate};
+		report("ostream", cues, seconds, allocations.load() - allocs_before, (uint64_t)written.tellg(), 0);
+		unlink(path.c_str());
+	}
+	std::cout << cues << " cues of " << words << " items" << std::endl;
+	return EX_OK;
+}
@@ -0,0 +1,126 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/histogram.h>
+#include <verbit/streaming/response_parser.h>
+#include <verbit/streaming/session_capture.h>
+#include <verbit/streaming/transcript_assembler.h>
+
+using namespace verbit::streaming;
+
+void report(const char* name, size_t responses, double seconds, const Histogram& latency)
+{
+	std::cout << std::fixed << std::setprecision(1)
+		<< std::setw(10) << name
+		<< std::setw(14) << (responses / seconds)
+		<< std::setw(10) << (seconds * 1000)
+		<< std::setw(10) << latency.percentile(0.5) / 1000.0
+		<< std::setw(10) << latency.percentile(0.99) / 1000.0
+		<< std::setw(10) << latency.max() / 1000.0
+		<< std::endl;
+}
+
+// handle every captured response, timing each; returns the total seconds
+template<typename Handler>
+double run(const std::vector<std::string>& responses, int passes, Histogram& latency, Handler handle)
+{
+	double seconds = 0.0;
+	for (int pass = 0; pass < passes; pass++) {
+		for (const std::string& response : responses) {
+			auto start = std::chrono::steady_clock::now();
+			handle(response);
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+			seconds += std::chrono::duration<double>(elapsed).count();
+		}
+	}
+	return seconds;
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_capture_replay [ -n passes ] capture" << std::endl;
+	std::cerr << "  replays the responses of a session capture (see SessionRecorder) passes (default 10) times" << std::endl;
+	std::cerr << "  through the client's response paths: the end-of-stream scan, the typed parse, and the" << std::endl;
+	std::cerr << "  typed parse into a TranscriptAssembler; and reports responses/s and per-response" << std::endl;
+	std::cerr << "  latency (microseconds)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int passes = 10;
+	int c;
+	while ((c = getopt(argc, argv, "?hn:")) != -1) {
+		switch (c) {
+		case 'n':
+			passes = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if ( (passes <= 0) || (optind != argc - 1) ) {
+		usage();
+		return EX_USAGE;
+	}
+
+	// the payloads are copied out of the capture, as the client receives them in strings
+	std::vector<std::string> responses;
+	try {
+		SessionCapture capture {argv[optind]};
+		CaptureRecord record;
+		while (capture.next(record)) {
+			if (record.kind == CaptureRecord::response) {
+				responses.push_back(std::string(record.data, record.length));
+			}
+		}
+	} catch (std::exception& e) {
+		std::cerr << "bench_capture_replay: " << e.what() << std::endl;
+		return EX_NOINPUT;
+	}
+	if (responses.empty()) {
+		std::cerr << "bench_capture_replay: no responses in " << argv[optind] << std::endl;
+		return EX_DATAERR;
+	}
+
+	std::cout << std::setw(10) << "" << std::setw(14) << "responses/s" << std::setw(10) << "total ms"
+		<< std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "max us" << std::endl;
+	size_t total = responses.size() * passes;
+	{
+		Histogram latency;
+		Response response;
+		double seconds = run(responses, passes, latency, [&response](const std::string& payload) {
+			ResponseParser::scan(payload, response);
+		});
+		report("scan", total, seconds, latency);
+	}
+	{
+		Histogram latency;
+		ResponseParser parser;
+		double seconds = run(responses, passes, latency, [&parser](const std::string& payload) {
+			parser.parse(payload);
+		});
+		report("parse", total, seconds, latency);
+	}
+	{
+		Histogram latency;
+		ResponseParser parser;
+		TranscriptAssembler transcript;
+		TranscriptAssembler captions {ResponseType::Captions};
+		double seconds = run(responses, passes, latency, [&](const std::string& payload) {
+			const Response& response = parser.parse(payload);
+			transcript.add(response);
+			captions.add(response);
+		});
+		report("assemble", total, seconds, latency);
+	}
+	std::cout << responses.size() << " responses, " << passes << " passes" << std::endl;
+	return EX_OK;
+}
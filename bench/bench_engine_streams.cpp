@@ -0,0 +1,267 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/push_media_source.h>
+#include <verbit/streaming/ws_streaming_client.h>
+
+#define TEST_WS_URL "wss://localhost:9002"
+
+// 100ms of S16LE 16kHz mono silence
+#define SILENCE_CHUNK_MS 100
+#define SILENCE_CHUNK_BYTES ((SILENCE_CHUNK_MS * 2 * 1 * 16000) / 1000)
+// 2s of S16LE 16kHz mono
+#define PUSH_CAPACITY_BYTES 64000
+
+using namespace verbit::streaming;
+
+/**
+ * Media generator producing paced silence until told to stop.
+ */
+class SilenceMediaGenerator : public MediaGenerator
+{
+public:
+	SilenceMediaGenerator() : _stop(false) { }
+
+	bool read_chunk(ChunkBuffer& chunk)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(SILENCE_CHUNK_MS));
+		memset(chunk.prepare(SILENCE_CHUNK_BYTES), 0, SILENCE_CHUNK_BYTES);
+		chunk.commit(SILENCE_CHUNK_BYTES);
+		return true;
+	}
+
+	const std::string get_chunk() { return read_chunk_string(); }
+
+	bool finished() { return _stop; }
+
+	void stop() { _stop = true; }
+
+private:
+	std::atomic<bool> _stop;
+};
+
+/// How the streams are driven.
+enum Mode {
+	mode_blocking,  ///< `run_stream()` on a runner thread per stream, reading a media generator which sleeps
+	mode_async      ///< `async_run_stream()` of a `PushMediaSource` per stream, all fed by one pacing thread
+};
+
+struct Sample {
+	long threads;
+	long rss_kb;
+};
+
+Sample sample_process()
+{
+	Sample sample {0, 0};
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 8, "Threads:") == 0) {
+			sample.threads = std::stol(line.substr(8));
+		} else if (line.compare(0, 6, "VmRSS:") == 0) {
+			sample.rss_kb = std::stol(line.substr(6));
+		}
+	}
+	return sample;
+}
+
+double cpu_seconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+struct Result {
+	Sample base;
+	Sample steady;
+	double cpu;
+	double wall;
+	int failed;
+};
+
+// Let the streams ramp up, then measure steady state for `seconds`.
+void measure(Result& result, int seconds)
+{
+	std::this_thread::sleep_for(std::chrono::seconds(2));
+	double cpu_start = cpu_seconds();
+	std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(std::chrono::seconds(seconds));
+	result.cpu = cpu_seconds() - cpu_start;
+	result.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+	result.steady = sample_process();
+}
+
+Result run_blocking(StreamingEngine& engine, int n, const std::string& access_token, const std::string& ws_url, int seconds)
+{
+	Result result;
+	result.base = sample_process();
+
+	std::vector<std::unique_ptr<WebSocketStreamingClient>> clients;
+	std::vector<std::unique_ptr<SilenceMediaGenerator>> generators;
+	std::vector<std::thread> runners;
+	std::atomic<int> failed(0);
+	for (int i = 0; i < n; i++) {
+		clients.emplace_back(new WebSocketStreamingClient(access_token, engine));
+		generators.emplace_back(new SilenceMediaGenerator());
+		clients.back()->ws_url(ws_url);
+		clients.back()->verify_ssl_cert(false);
+	}
+	for (int i = 0; i < n; i++) {
+		WebSocketStreamingClient* client = clients[i].get();
+		SilenceMediaGenerator* gen = generators[i].get();
+		runners.push_back(std::thread([client, gen, &failed]() {
+			if (!client->run_stream(*gen)) {
+				failed++;
+			}
+		}));
+	}
+
+	measure(result, seconds);
+
+	for (auto& gen : generators) {
+		gen->stop();
+	}
+	for (auto& t : runners) {
+		t.join();
+	}
+	result.failed = failed;
+	return result;
+}
+
+Result run_async(StreamingEngine& engine, int n, const std::string& access_token, const std::string& ws_url, int seconds)
+{
+	Result result;
+	result.base = sample_process();
+
+	// the sources outlive the clients reading them
+	std::vector<std::unique_ptr<PushMediaSource>> sources;
+	std::vector<std::unique_ptr<WebSocketStreamingClient>> clients;
+	std::vector<std::future<StreamResult>> futures;
+	for (int i = 0; i < n; i++) {
+		clients.emplace_back(new WebSocketStreamingClient(access_token, engine));
+		sources.emplace_back(new PushMediaSource(PUSH_CAPACITY_BYTES));
+		clients.back()->ws_url(ws_url);
+		clients.back()->verify_ssl_cert(false);
+	}
+	for (int i = 0; i < n; i++) {
+		futures.push_back(clients[i]->async_run_stream(*sources[i]));
+	}
+
+	// the one producer of every source: push a chunk of silence into each, every chunk interval
+	std::atomic<bool> stop(false);
+	std::thread pacer([&sources, &stop]() {
+		const std::vector<char> silence(SILENCE_CHUNK_BYTES, 0);
+		std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+		while (!stop) {
+			for (auto& source : sources) {
+				source->push(silence.data(), silence.size());
+			}
+			next += std::chrono::milliseconds(SILENCE_CHUNK_MS);
+			std::this_thread::sleep_until(next);
+		}
+		for (auto& source : sources) {
+			source->close();
+		}
+	});
+
+	measure(result, seconds);
+
+	stop = true;
+	pacer.join();
+	result.failed = 0;
+	for (auto& f : futures) {
+		if (!f.get().ok()) {
+			result.failed++;
+		}
+	}
+	return result;
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_engine_streams [ -u URL ] [ -t io_threads ] [ -d seconds ] [ -m blocking|async ] [ streams ... ]" << std::endl;
+	std::cerr << "  runs each number of concurrent streams (default: 1 100 1000) against the test server, in each mode" << std::endl;
+	std::cerr << "  (default: both), and reports threads, RSS and CPU per stream; 1000 streams needs `ulimit -n 4096`" << std::endl;
+	std::cerr << "  blocking: run_stream() on a thread per stream, each reading media which sleeps between chunks" << std::endl;
+	std::cerr << "  async: async_run_stream() of a PushMediaSource per stream, fed by one pacing thread" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	std::string ws_url = TEST_WS_URL;
+	size_t io_threads = WSSC_DEFAULT_ENGINE_THREADS;
+	int seconds = 10;
+	std::vector<Mode> modes {mode_blocking, mode_async};
+	int c;
+	while ((c = getopt(argc, argv, "?hu:t:d:m:")) != -1) {
+		switch (c) {
+		case 'u':
+			ws_url = optarg;
+			break;
+		case 't':
+			io_threads = atoi(optarg);
+			break;
+		case 'd':
+			seconds = atoi(optarg);
+			break;
+		case 'm':
+			if (strcmp(optarg, "blocking") == 0) {
+				modes = {mode_blocking};
+			} else if (strcmp(optarg, "async") == 0) {
+				modes = {mode_async};
+			} else {
+				usage();
+				return EX_USAGE;
+			}
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	std::vector<int> stream_counts;
+	for (int i = optind; i < argc; i++) {
+		stream_counts.push_back(atoi(argv[i]));
+	}
+	if (stream_counts.empty()) {
+		stream_counts = {1, 100, 1000};
+	}
+
+	std::cout << std::setw(10) << "mode" << std::setw(8) << "streams" << std::setw(10) << "threads" << std::setw(14) << "threads/strm"
+		<< std::setw(10) << "RSS MB" << std::setw(14) << "RSS KB/strm" << std::setw(14) << "CPU ms/s/strm"
+		<< std::setw(8) << "failed" << std::endl;
+
+	for (int n : stream_counts) {
+		for (Mode mode : modes) {
+			StreamingEngine engine;
+			engine.start(io_threads);
+			Result r = (mode == mode_async) ? run_async(engine, n, access_token, ws_url, seconds)
+				: run_blocking(engine, n, access_token, ws_url, seconds);
+			engine.stop();
+
+			std::cout << std::fixed << std::setprecision(2)
+				<< std::setw(10) << ((mode == mode_async) ? "async" : "blocking")
+				<< std::setw(8) << n
+				<< std::setw(10) << r.steady.threads
+				<< std::setw(14) << (double)(r.steady.threads - r.base.threads) / n
+				<< std::setw(10) << r.steady.rss_kb / 1024.0
+				<< std::setw(14) << (double)(r.steady.rss_kb - r.base.rss_kb) / n
+				<< std::setw(14) << (r.cpu * 1000.0 / r.wall) / n
+				<< std::setw(8) << r.failed << std::endl;
+		}
+	}
+	return EX_OK;
+}
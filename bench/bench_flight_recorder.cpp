@@ -0,0 +1,84 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <getopt.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/flight_recorder.h>
+
+using namespace verbit::streaming;
+
+__attribute__((noinline)) void record_send(FlightRecorder& recorder, uint32_t bytes)
+{
+	recorder.record(FlightEvent::send, bytes);
+}
+
+// record `events` events on each of `threads` threads, each to its own recorder
+// (as each session has its own) or all to one; returns ns per event
+double run(int threads, int events, bool shared)
+{
+	std::vector<std::unique_ptr<FlightRecorder>> recorders;
+	for (int t = 0; t < (shared ? 1 : threads); t++) {
+		recorders.emplace_back(new FlightRecorder());
+	}
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		FlightRecorder& recorder = *recorders[shared ? 0 : t];
+		workers.emplace_back([events, &recorder]() {
+			for (int i = 0; i < events; i++) {
+				record_send(recorder, 3200 + (i & 0xff));
+			}
+		});
+	}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	return ns / events;
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_flight_recorder [ -n events ] [ -t threads ]" << std::endl;
+	std::cerr << "  records events (default 10000000) on each of 1 and threads (default 4) threads, to a" << std::endl;
+	std::cerr << "  recorder per thread and to one shared recorder, and reports the wall time per event (ns)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int events = 10000000;
+	int threads = 4;
+	int c;
+	while ((c = getopt(argc, argv, "?hn:t:")) != -1) {
+		switch (c) {
+		case 'n':
+			events = atoi(optarg);
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if ( (events <= 0) || (threads <= 0) ) {
+		usage();
+		return EX_USAGE;
+	}
+
+	std::cout << std::setw(10) << "threads" << std::setw(14) << "own ns/event" << std::setw(16) << "shared ns/event" << std::endl;
+	for (int n : {1, threads}) {
+		std::cout << std::fixed << std::setprecision(1)
+			<< std::setw(10) << n
+			<< std::setw(14) << run(n, events, false)
+			<< std::setw(16) << run(n, events, true)
+			<< std::endl;
+	}
+	std::cout << events << " events per thread" << std::endl;
+	return EX_OK;
+}
@@ -0,0 +1,185 @@
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <getopt.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+#include <verbit/streaming/logger.h>
+
+using namespace verbit::streaming;
+
+/**
+ * The previous way of logging, as WebSocket++'s basic access logger does it: a
+ * mutex, a timestamp, and a flushed `std::ofstream` write on the calling thread.
+ */
+class StreamLog
+{
+public:
+	StreamLog(const std::string& path) : _out(path, std::ios::app) { }
+
+	bool enabled() const { return _enabled; }
+
+	void enabled(bool enabled) { _enabled = enabled; }
+
+	void write(const std::string& line)
+	{
+		if (!_enabled) {
+			return;
+		}
+		std::unique_lock<std::mutex> lock(_mutex);
+		char timestamp[32];
+		time_t now = time(nullptr);
+		struct tm tm;
+		localtime_r(&now, &tm);
+		strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm);
+		_out << "[" << timestamp << "] " << "[application] " << line << "\n";
+		_out.flush();
+	}
+
+private:
+	std::ofstream _out;
+	std::mutex _mutex;
+	bool _enabled = true;
+};
+
+// the client's per-message line, built the way it used to be
+__attribute__((noinline)) void stream_line(StreamLog& log, size_t payload_len)
+{
+	std::string debug = std::string("on_message called:")
+		+ " frame_type " + std::string("text-frame:uncompressed:fin")
+		+ " payload_len " + std::to_string(payload_len);
+	log.write(std::string("WebSocket") + ": " + debug);
+}
+
+__attribute__((noinline)) void logger_line(Logger& logger, size_t payload_len)
+{
+	WSSC_LOG(logger, Logger::debug, "WebSocket", "on_message called: frame_type %s payload_len %zu",
+		"text-frame:uncompressed:fin", payload_len);
+}
+
+struct Result {
+	double wall_ns;  // wall time per line
+	double cpu_ns;   // CPU time of the logging threads per line (not counting a writer thread)
+};
+
+double thread_cpu_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// run `lines` calls of `line` on each of `threads` threads
+template<typename Line>
+Result run(int threads, int lines, Line line)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::vector<double> cpu_ns(threads);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([lines, &line, &cpu_ns, t]() {
+			double cpu_start = thread_cpu_ns();
+			for (int i = 0; i < lines; i++) {
+				line(700 + (i & 0xff));
+			}
+			cpu_ns[t] = thread_cpu_ns() - cpu_start;
+		});
+	}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	Result result;
+	result.wall_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lines;
+	result.cpu_ns = 0.0;
+	for (double ns : cpu_ns) {
+		result.cpu_ns += ns;
+	}
+	result.cpu_ns /= (double)lines * threads;
+	return result;
+}
+
+void report(const char* name, const Result& result, uint64_t dropped)
+{
+	std::cout << std::fixed << std::setprecision(1)
+		<< std::setw(14) << name
+		<< std::setw(14) << result.wall_ns
+		<< std::setw(14) << result.cpu_ns
+		<< std::setw(12) << dropped
+		<< std::endl;
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_logger [ -n lines ] [ -t threads ] [ -r records ] [ -d directory ]" << std::endl;
+	std::cerr << "  logs a line like the client's per-message line lines (default 1000000) times on each of" << std::endl;
+	std::cerr << "  threads (default 1) threads, building a string and writing a flushed std::ofstream" << std::endl;
+	std::cerr << "  under a mutex (as through the WebSocket++ access log) and with Logger (with a ring of" << std::endl;
+	std::cerr << "  records lines, default 4096), each with logging disabled and enabled, to a file in" << std::endl;
+	std::cerr << "  directory (default /tmp); and reports the wall time and the logging threads' CPU time per" << std::endl;
+	std::cerr << "  line (ns), and the lines dropped" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int lines = 1000000;
+	int threads = 1;
+	int records = WSSC_DEFAULT_LOG_RECORDS;
+	std::string dir = "/tmp";
+	int c;
+	while ((c = getopt(argc, argv, "?hn:t:r:d:")) != -1) {
+		switch (c) {
+		case 'n':
+			lines = atoi(optarg);
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		case 'r':
+			records = atoi(optarg);
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if ( (lines <= 0) || (threads <= 0) || (records <= 0) ) {
+		usage();
+		return EX_USAGE;
+	}
+
+	std::cout << std::setw(14) << "" << std::setw(14) << "wall ns/line" << std::setw(14) << "cpu ns/line"
+		<< std::setw(12) << "dropped" << std::endl;
+	std::string base = dir + "/bench_logger." + std::to_string(getpid());
+	{
+		std::string path = base + ".stream";
+		StreamLog log {path};
+		log.enabled(false);
+		report("stream off", run(threads, lines, [&log](size_t len) { stream_line(log, len); }), 0);
+		log.enabled(true);
+		report("stream on", run(threads, lines, [&log](size_t len) { stream_line(log, len); }), 0);
+		unlink(path.c_str());
+	}
+	{
+		std::string path = base + ".logger";
+		Logger logger {path, Logger::info, (size_t)records};
+		report("logger off", run(threads, lines, [&logger](size_t len) { logger_line(logger, len); }), 0);
+		logger.level(Logger::debug);
+		Result result = run(threads, lines, [&logger](size_t len) { logger_line(logger, len); });
+		report("logger on", result, logger.dropped());
+		logger.flush();
+		unlink(path.c_str());
+	}
+	std::cout << lines << " lines on " << threads << " threads" << std::endl;
+	return EX_OK;
+}
@@ -0,0 +1,187 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <glob.h>
+#include <sys/resource.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/flac_codec.h>
+#include <verbit/streaming/opus_codec.h>
+
+using namespace verbit::streaming;
+
+double cpu_seconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// Read the S16LE media of a WAV file (or of a headerless file, taken as S16LE 16kHz mono).
+bool read_media(const std::string& path, std::string& media, int& rate, int& channels)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (!file.eof() && file.fail()) {
+		return false;
+	}
+	rate = 16000;
+	channels = 1;
+	if ( (data.size() < 12) || (data.compare(0, 4, "RIFF") != 0) || (data.compare(8, 4, "WAVE") != 0) ) {
+		media = data;
+		return true;
+	}
+	for (size_t pos = 12; pos + 8 <= data.size(); ) {
+		uint32_t size;
+		memcpy(&size, &data[pos + 4], 4);
+		if (data.compare(pos, 4, "fmt ") == 0) {
+			uint16_t format, n_channels, bits;
+			uint32_t sample_rate;
+			memcpy(&format, &data[pos + 8], 2);
+			memcpy(&n_channels, &data[pos + 10], 2);
+			memcpy(&sample_rate, &data[pos + 12], 4);
+			memcpy(&bits, &data[pos + 22], 2);
+			if ( (format != 1) || (bits != 16) ) {
+				return false;
+			}
+			rate = sample_rate;
+			channels = n_channels;
+		} else if (data.compare(pos, 4, "data") == 0) {
+			media = data.substr(pos + 8, size);
+			return true;
+		}
+		pos += 8 + size + (size & 1);
+	}
+	return false;
+}
+
+// Repeat `media` for `seconds` (of whole frames).
+std::string stream_of(const std::string& media, int rate, int channels, int seconds)
+{
+	const size_t bytes = (size_t)rate * channels * 2 * seconds;
+	std::string stream;
+	stream.reserve(bytes + media.size());
+	while (stream.size() < bytes) {
+		stream += media;
+	}
+	stream.resize(bytes);
+	return stream;
+}
+
+struct Codec {
+	std::string name;
+	std::unique_ptr<MediaEncoder> (*create)(int rate, int channels);
+};
+
+const Codec codecs[] = {
+	{ "FLAC 20ms", [](int rate, int channels) {
+		return std::unique_ptr<MediaEncoder>(new FlacMediaEncoder(rate, channels, std::chrono::milliseconds(20))); } },
+	{ "FLAC 100ms", [](int rate, int channels) {
+		return std::unique_ptr<MediaEncoder>(new FlacMediaEncoder(rate, channels)); } },
+#ifdef WITH_OPUS
+	{ "Opus 16k", [](int rate, int channels) {
+		return std::unique_ptr<MediaEncoder>(new OpusMediaEncoder(rate, channels, 16000)); } },
+	{ "Opus 24k", [](int rate, int channels) {
+		return std::unique_ptr<MediaEncoder>(new OpusMediaEncoder(rate, channels)); } },
+#endif
+};
+
+void usage()
+{
+	std::cerr << "Usage: bench_media_encoder [ -s seconds ] [ file.wav ... ]" << std::endl;
+	std::cerr << "  encodes 600 (by default) seconds of each file (test-files/*.wav by default), repeated, in 20ms" << std::endl;
+	std::cerr << "  chunks, with each encoder (Opus only if built WITH_OPUS), and reports the bit rate and bandwidth" << std::endl;
+	std::cerr << "  saved against PCM, the encoder and decoder CPU per stream-hour, and whether FLAC is lossless" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int seconds = 600;
+	int c;
+	while ((c = getopt(argc, argv, "?hs:")) != -1) {
+		switch (c) {
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if (seconds <= 0) {
+		usage();
+		return EX_USAGE;
+	}
+	std::vector<std::string> paths(argv + optind, argv + argc);
+	if (paths.empty()) {
+		glob_t found;
+		if (glob("test-files/*.wav", 0, nullptr, &found) == 0) {
+			paths.assign(found.gl_pathv, found.gl_pathv + found.gl_pathc);
+		}
+		globfree(&found);
+	}
+
+	std::cout << std::setw(24) << "file" << std::setw(12) << "encoder" << std::setw(10) << "kbit/s"
+		<< std::setw(10) << "saved" << std::setw(20) << "CPU s/stream-hour" << std::setw(14) << "streams/core"
+		<< std::setw(18) << "decode CPU s/hour" << std::setw(10) << "lossless" << std::endl;
+	std::cout << std::fixed;
+	for (const std::string& path : paths) {
+		std::string media;
+		int rate;
+		int channels;
+		if (!read_media(path, media, rate, channels) || media.empty()) {
+			std::cerr << path << ": not S16LE media" << std::endl;
+			return EX_DATAERR;
+		}
+		std::string stream = stream_of(media, rate, channels, seconds);
+		const size_t frame_bytes = channels * 2;
+		const size_t chunk = (size_t)rate / 50 * frame_bytes;
+		const double pcm_kbps = rate * frame_bytes * 8 / 1000.0;
+		std::string name = path.substr(path.find_last_of('/') + 1);
+		for (const Codec& codec : codecs) {
+			std::unique_ptr<MediaEncoder> encoder;
+			try {
+				encoder = codec.create(rate, channels);
+			} catch (std::exception& e) {
+				std::cout << std::setw(24) << name << std::setw(12) << codec.name << "  " << e.what() << std::endl;
+				continue;
+			}
+			std::string encoded;
+			encoded.reserve(stream.size());
+			double cpu_start = cpu_seconds();
+			for (size_t pos = 0; pos < stream.size(); pos += chunk) {
+				encoder->encode(&stream[pos], std::min(chunk, stream.size() - pos) / frame_bytes, encoded);
+			}
+			encoder->flush(encoded);
+			double cpu = cpu_seconds() - cpu_start;
+
+			std::unique_ptr<MediaDecoder> decoder = MediaDecoder::create(encoder->format(), rate, channels);
+			std::string decoded;
+			decoded.reserve(stream.size());
+			cpu_start = cpu_seconds();
+			for (size_t pos = 0; pos < encoded.size(); pos += 4096) {
+				decoder->decode(&encoded[pos], std::min((size_t)4096, encoded.size() - pos), decoded);
+			}
+			double decode_cpu = cpu_seconds() - cpu_start;
+
+			double kbps = encoded.size() * 8 / 1000.0 / seconds;
+			std::string lossless = (encoder->format() != "FLAC") ? "-" : (decoded == stream) ? "yes" : "NO";
+			std::cout << std::setw(24) << name << std::setw(12) << codec.name
+				<< std::setw(10) << std::setprecision(1) << kbps
+				<< std::setw(9) << std::setprecision(1) << 100.0 * (1 - kbps / pcm_kbps) << "%"
+				<< std::setw(20) << std::setprecision(2) << cpu * 3600 / seconds
+				<< std::setw(14) << std::setprecision(0) << seconds / cpu
+				<< std::setw(18) << std::setprecision(2) << decode_cpu * 3600 / seconds
+				<< std::setw(10) << lossless << std::endl;
+		}
+	}
+	return EX_OK;
+}
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+#include <getopt.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/metrics_registry.h>
+
+using namespace verbit::streaming;
+
+// what the client records for each media chunk sent: the send call timed, and two counters
+__attribute__((noinline)) void record_send(SessionMetrics& metrics, size_t bytes)
+{
+	auto start = std::chrono::steady_clock::now();
+	metrics.send_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start).count());
+	metrics.frames_sent.add();
+	metrics.bytes_sent.add(bytes);
+}
+
+// what the client records for each response received without parsing or handlers
+__attribute__((noinline)) void record_response(SessionMetrics& metrics)
+{
+	metrics.responses[SessionMetrics::response_captions].add();
+}
+
+template<typename F>
+double ns_per_op(int ops, F op)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ops; i++) {
+		op(i);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ops;
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_metrics [ -n ops ] [ -s sessions ]" << std::endl;
+	std::cerr << "  records metrics ops (default 10000000) times, and takes snapshots and Prometheus" << std::endl;
+	std::cerr << "  exports of a registry of sessions (default 1000) sessions" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int ops = 10000000;
+	int sessions = 1000;
+	int c;
+	while ((c = getopt(argc, argv, "?hn:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			ops = atoi(optarg);
+			break;
+		case 's':
+			sessions = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if ( (ops <= 0) || (sessions <= 0) ) {
+		usage();
+		return EX_USAGE;
+	}
+
+	std::unique_ptr<SessionMetrics> metrics(new SessionMetrics());
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << std::setw(28) << "steady_clock::now()" << std::setw(12)
+		<< ns_per_op(ops, [](int) { std::chrono::steady_clock::now(); }) << " ns" << std::endl;
+	std::cout << std::setw(28) << "record send" << std::setw(12)
+		<< ns_per_op(ops, [&metrics](int i) { record_send(*metrics, 3200 + (i & 0xff)); }) << " ns" << std::endl;
+	std::cout << std::setw(28) << "record response" << std::setw(12)
+		<< ns_per_op(ops, [&metrics](int) { record_response(*metrics); }) << " ns" << std::endl;
+
+	std::vector<std::unique_ptr<SessionMetrics>> session_metrics;
+	MetricsRegistry registry;
+	for (int s = 0; s < sessions; s++) {
+		session_metrics.emplace_back(new SessionMetrics());
+		SessionMetrics* session = session_metrics.back().get();
+		for (int i = 0; i < 1000; i++) {
+			record_send(*session, 3200);
+		}
+		registry.add([session]{ return *session; });
+	}
+	int snapshots = std::max(1, 100000 / sessions);
+	size_t text_length = 0;
+	std::cout << std::setw(28) << "registry snapshot" << std::setw(12)
+		<< ns_per_op(snapshots, [&registry](int) { registry.snapshot(); }) / 1000 << " us" << std::endl;
+	std::cout << std::setw(28) << "registry prometheus()" << std::setw(12)
+		<< ns_per_op(snapshots, [&registry, &text_length](int) { text_length = registry.prometheus().length(); }) / 1000
+		<< " us" << std::endl;
+	std::cout << sessions << " sessions, " << text_length << " bytes of Prometheus text" << std::endl;
+	return EX_OK;
+}
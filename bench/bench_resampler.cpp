@@ -0,0 +1,116 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/resampler.h>
+
+using namespace verbit::streaming;
+
+double cpu_seconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// `seconds` of a 1kHz sine at half full scale
+std::vector<int16_t> tone(int rate, int seconds)
+{
+	std::vector<int16_t> samples((size_t)rate * seconds);
+	for (size_t i = 0; i < samples.size(); i++) {
+		samples[i] = (int16_t)lrint(16384 * std::sin(2 * M_PI * 1000.0 * i / rate));
+	}
+	return samples;
+}
+
+// resample in 20ms chunks (as capture delivers them), and return the output
+std::vector<int16_t> resample(Resampler& resampler, const std::vector<int16_t>& in, int rate)
+{
+	const size_t chunk = rate / 50;
+	std::vector<int16_t> out;
+	out.reserve(resampler.max_output(in.size()) + resampler.max_output(resampler.latency()));
+	std::vector<int16_t> buffer(resampler.max_output(std::max(chunk, (size_t)resampler.latency())));
+	for (size_t done = 0; done < in.size(); done += chunk) {
+		size_t written = resampler.process(&in[done], std::min(chunk, in.size() - done), buffer.data());
+		out.insert(out.end(), buffer.begin(), buffer.begin() + written);
+	}
+	size_t written = resampler.flush(buffer.data());
+	out.insert(out.end(), buffer.begin(), buffer.begin() + written);
+	return out;
+}
+
+// the signal-to-noise ratio of the output against the ideal 1kHz sine, in dB (away from the ends)
+double snr(const std::vector<int16_t>& out, int rate)
+{
+	double signal = 0.0;
+	double noise = 0.0;
+	for (size_t i = rate / 10; i + rate / 10 < out.size(); i++) {
+		double expected = 16384 * std::sin(2 * M_PI * 1000.0 * i / rate);
+		signal += expected * expected;
+		noise += (out[i] - expected) * (out[i] - expected);
+	}
+	return 10 * std::log10(signal / noise);
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_resampler [ -s seconds ] [ -o rate ]" << std::endl;
+	std::cerr << "  resamples 60 (by default) seconds of a 1kHz tone from 48000, 44100, 32000, 22050 and 8000Hz" << std::endl;
+	std::cerr << "  to 16000Hz (by default) mono, with each supported ISA, and reports CPU per stream-hour and SNR" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int seconds = 60;
+	int out_rate = 16000;
+	int c;
+	while ((c = getopt(argc, argv, "?hs:o:")) != -1) {
+		switch (c) {
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'o':
+			out_rate = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if ( (seconds <= 0) || (out_rate <= 0) ) {
+		usage();
+		return EX_USAGE;
+	}
+
+	const int rates[] = {48000, 44100, 32000, 22050, 8000};
+	const SampleConverter::Isa isas[] = { SampleConverter::isa_scalar, SampleConverter::isa_sse2, SampleConverter::isa_avx2 };
+	std::cout << std::setw(8) << "in Hz" << std::setw(8) << "phases" << std::setw(8) << "taps" << std::setw(10) << "latency"
+		<< std::setw(8) << "ISA" << std::setw(20) << "CPU s/stream-hour" << std::setw(16) << "streams/core"
+		<< std::setw(10) << "SNR dB" << std::endl;
+	std::cout << std::fixed;
+	for (int rate : rates) {
+		std::vector<int16_t> in = tone(rate, seconds);
+		for (SampleConverter::Isa isa : isas) {
+			if (!SampleConverter::supported(isa)) {
+				continue;
+			}
+			Resampler resampler {rate, out_rate, 1, WSSC_RESAMPLER_TAPS, isa};
+			double cpu_start = cpu_seconds();
+			std::vector<int16_t> out = resample(resampler, in, rate);
+			double cpu = cpu_seconds() - cpu_start;
+			std::cout << std::setw(8) << rate << std::setw(8) << resampler.phases() << std::setw(8) << resampler.taps()
+				<< std::setw(8) << std::setprecision(1) << resampler.latency() * 1000.0 / rate << "ms"
+				<< std::setw(8) << SampleConverter::isa_name(isa)
+				<< std::setw(20) << std::setprecision(3) << cpu * 3600 / seconds
+				<< std::setw(16) << std::setprecision(0) << seconds / cpu
+				<< std::setw(10) << std::setprecision(1) << snr(out, out_rate) << std::endl;
+		}
+	}
+	return EX_OK;
+}
@@ -0,0 +1,206 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <sysexits.h>
+
+#include <nlohmann/json.hpp>
+
+#include <verbit/streaming/response_parser.h>
+#include <verbit/streaming/response_type.h>
+
+using namespace verbit::streaming;
+
+// count every heap allocation made by the process; the replacements are kept
+// out of line, so the compiler does not pair inlined malloc()/free() calls with
+// new/delete expressions
+static std::atomic<size_t> allocations {0};
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+	allocations++;
+	void* p = malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+// build a response like those the test server sends, with `words` items
+std::string response_json(const char* type, bool is_final, int words, int seq)
+{
+	static const char* speaker = "c6eb6f2b-f85b-478f-af8a-a21b00000001";
+	std::string transcript;
+	std::string items;
+	double t = seq * 0.5;
+	for (int i = 0; i < words; i++) {
+		bool punct = (i == words - 1);
+		std::string word = punct ? "." : ("word" + std::to_string(i));
+		transcript += word + " ";
+		if (!items.empty()) {
+			items += ",";
+		}
+		char times[64];
+		snprintf(times, sizeof(times), "\"start\":%.3f,\"end\":%.3f}", t, t + 0.007);
+		items += std::string("{\"kind\":\"") + (punct ? "punct" : "text") + "\","
+			+ "\"value\":\"" + word + "\",\"speaker_id\":\"" + speaker + "\"," + times;
+		t += 0.020;
+	}
+	return std::string("{\"response\":{") +
+		"\"id\":\"7b1f0d5e-2f7a-4c52-9d55-3a1e7f6f" + std::to_string(1000 + seq % 1000) + "\"," +
+		"\"type\":\"" + type + "\",\"service_type\":\"transcription\",\"language_code\":\"en-US\"," +
+		"\"is_final\":" + (is_final ? "true" : "false") + ",\"is_end_of_stream\":false," +
+		"\"speakers\":[" +
+		"{\"id\":\"c6eb6f2b-f85b-478f-af8a-a21b00000001\",\"label\":\"First Host\"}," +
+		"{\"id\":\"c6eb6f2b-f85b-478f-af8a-a21b00000002\",\"label\":\"Second Host\"}," +
+		"{\"id\":\"c6eb6f2b-f85b-478f-af8a-a21b00000003\",\"label\":\"Speaker 3\"}]," +
+		"\"alternatives\":[{\"transcript\":\"" + transcript + "\",\"items\":[" + items + "]}]}}";
+}
+
+// what the client did per message before typed responses: DOM parse, EOS check,
+// and a handler reading each item's value and times
+double dom_message(const std::string& payload, ResponseType& response_types)
+{
+	nlohmann::json message = nlohmann::json::parse(payload);
+	double sum = 0.0;
+	auto it = message.find("response");
+	if (it != message.end()) {
+		response_types.record_eos(message["response"]);
+		for (const nlohmann::json& item : message["response"]["alternatives"][0]["items"]) {
+			sum += item["value"].get<std::string>().length() + item["end"].get<double>() - item["start"].get<double>();
+		}
+	}
+	return sum;
+}
+
+// the same, with a typed response
+double typed_message(const std::string& payload, ResponseType& response_types, ResponseParser& parser)
+{
+	const Response& response = parser.parse(payload);
+	double sum = 0.0;
+	if (response.has_response) {
+		response_types.record_eos(response);
+		for (const Item& item : response.alternatives[0].items) {
+			sum += item.value.length + item.end - item.start;
+		}
+	}
+	return sum;
+}
+
+// what a raw (relaying) handler costs the client: the end-of-stream scan only
+double raw_message(const std::string& payload, ResponseType& response_types)
+{
+	response_types.scan_eos(payload);
+	return (double)payload.length();
+}
+
+void report(const char* name, size_t messages, double seconds, size_t allocs, size_t bytes)
+{
+	std::cout << std::fixed << std::setprecision(1)
+		<< std::setw(20) << name
+		<< std::setw(14) << (messages / seconds)
+		<< std::setw(12) << ((double)bytes * messages / seconds / (1024 * 1024))
+		<< std::setw(14) << ((double)allocs / messages)
+		<< std::endl;
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_response_parse [ -n messages ] [ -w words ]" << std::endl;
+	std::cerr << "  parses messages (default 200000) captions and transcript responses of words (default 12)" << std::endl;
+	std::cerr << "  items each, with the JSON DOM, with ResponseParser, and with only the end-of-stream scan" << std::endl;
+	std::cerr << "  of a raw handler, and reports messages/s, MB/s" << std::endl;
+	std::cerr << "  and heap allocations per message" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int messages = 200000;
+	int words = 12;
+	int c;
+	while ((c = getopt(argc, argv, "?hn:w:")) != -1) {
+		switch (c) {
+		case 'n':
+			messages = atoi(optarg);
+			break;
+		case 'w':
+			words = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if ( (messages <= 0) || (words <= 0) ) {
+		usage();
+		return EX_USAGE;
+	}
+
+	// a rotating set of payloads, so timings are not for one cached message
+	struct Kind {
+		const char* name;
+		const char* type;
+		bool is_final;
+	};
+	const Kind kinds[] = {{"captions", "captions", true}, {"transcript", "transcript", false}};
+
+	std::cout << std::setw(20) << "" << std::setw(14) << "msg/s" << std::setw(12) << "MB/s"
+		<< std::setw(14) << "allocs/msg" << std::endl;
+	double sink = 0.0;
+	for (const Kind& kind : kinds) {
+		std::vector<std::string> payloads;
+		size_t payload_bytes = 0;
+		for (int i = 0; i < 64; i++) {
+			payloads.push_back(response_json(kind.type, kind.is_final, words, i));
+			payload_bytes += payloads.back().length();
+		}
+		payload_bytes /= payloads.size();
+
+		for (int path = 0; path < 3; path++) {
+			ResponseType response_types {ResponseType::Transcript | ResponseType::Captions};
+			ResponseParser parser;
+			auto message = [&](const std::string& payload) -> double {
+				switch (path) {
+				case 0: return dom_message(payload, response_types);
+				case 1: return typed_message(payload, response_types, parser);
+				default: return raw_message(payload, response_types);
+				}
+			};
+			// warm up (grows the parser memory to fit)
+			for (const std::string& payload : payloads) {
+				sink += message(payload);
+			}
+
+			size_t allocs_before = allocations.load();
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < messages; i++) {
+				const std::string& payload = payloads[i % payloads.size()];
+				sink += message(payload);
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			size_t allocs = allocations.load() - allocs_before;
+
+			static const char* path_names[] = {" DOM", " typed", " raw scan"};
+			std::string name = std::string(kind.name) + path_names[path];
+			report(name.c_str(), messages, seconds, allocs, payload_bytes);
+		}
+	}
+	std::cout << words << " items/message (checksum " << std::setprecision(0) << sink << ")" << std::endl;
+	return EX_OK;
+}
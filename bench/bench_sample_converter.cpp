@@ -0,0 +1,103 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/sample_converter.h>
+
+using namespace verbit::streaming;
+
+void usage()
+{
+	std::cerr << "Usage: bench_sample_converter [ -s seconds ] [ -r rate ]" << std::endl;
+	std::cerr << "  converts 60 (by default) seconds of 48000Hz (by default) audio, from F32LE, S24LE and S32LE," << std::endl;
+	std::cerr << "  stereo to mono, with and without dither, with each supported ISA" << std::endl;
+}
+
+// the input samples converted per second, in millions
+double msamples_per_second(SampleConverter& converter, const std::vector<uint8_t>& in, size_t frames,
+	std::vector<int16_t>& out)
+{
+	// (in chunks of 100ms, as a capture callback might deliver them)
+	const size_t chunk_frames = frames / 600;
+	const size_t chunk_bytes = chunk_frames * converter.in_frame_bytes();
+	auto start = std::chrono::steady_clock::now();
+	for (size_t done = 0; done + chunk_frames <= frames; done += chunk_frames) {
+		converter.convert(in.data() + done / chunk_frames * chunk_bytes, chunk_frames,
+			out.data() + done * converter.out_channels());
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return frames * converter.in_channels() / seconds / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+	int seconds = 60;
+	int rate = 48000;
+	int c;
+	while ((c = getopt(argc, argv, "?hs:r:")) != -1) {
+		switch (c) {
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if ( (seconds <= 0) || (rate <= 0) ) {
+		usage();
+		return EX_USAGE;
+	}
+
+	const int channels = 2;
+	const size_t frames = (size_t)seconds * rate;
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> sample(-1.0f, 1.0f);
+	std::vector<uint8_t> f32(frames * channels * 4);
+	for (size_t i = 0; i < frames * channels; i++) {
+		float v = sample(random);
+		memcpy(&f32[4 * i], &v, 4);
+	}
+	std::vector<uint8_t> ints(frames * channels * 4);
+	for (uint8_t& byte : ints) {
+		byte = (uint8_t)random();
+	}
+	std::vector<int16_t> out(frames);
+
+	const SampleConverter::Isa isas[] = { SampleConverter::isa_scalar, SampleConverter::isa_sse2, SampleConverter::isa_avx2 };
+	const SampleConverter::Format formats[] = { SampleConverter::f32le, SampleConverter::s24le, SampleConverter::s32le };
+	std::cout << seconds << "s of " << rate << "Hz stereo to mono, Msamples/s (realtime streams per core)" << std::endl;
+	std::cout << std::setw(8) << "ISA";
+	for (SampleConverter::Format format : formats) {
+		for (bool dither : {false, true}) {
+			std::cout << std::setw(20) << (std::string(SampleConverter::format_name(format)) + (dither ? "+dither" : ""));
+		}
+	}
+	std::cout << std::endl << std::fixed;
+	for (SampleConverter::Isa isa : isas) {
+		if (!SampleConverter::supported(isa)) {
+			continue;
+		}
+		std::cout << std::setw(8) << SampleConverter::isa_name(isa);
+		for (SampleConverter::Format format : formats) {
+			for (bool dither : {false, true}) {
+				SampleConverter converter {format, channels, 1, dither, isa};
+				double msps = msamples_per_second(converter, (format == SampleConverter::f32le) ? f32 : ints, frames, out);
+				std::cout << std::setw(11) << std::setprecision(1) << msps
+					<< " (" << std::setw(5) << std::setprecision(0) << msps * 1e6 / (rate * channels) << ")";
+			}
+		}
+		std::cout << std::endl;
+	}
+	return EX_OK;
+}
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/ws_streaming_client.h>
+
+#define TEST_WS_URL "wss://localhost:9002"
+
+// 100ms of S16LE 16kHz mono silence
+#define SILENCE_CHUNK_BYTES 3200
+
+using namespace verbit::streaming;
+
+/**
+ * Media generator producing a fixed number of unpaced silence chunks.
+ */
+class ShortSilenceMediaGenerator : public MediaGenerator
+{
+public:
+	ShortSilenceMediaGenerator(int chunks) : _remaining(chunks) { }
+
+	bool read_chunk(ChunkBuffer& chunk)
+	{
+		if (_remaining > 0) {
+			memset(chunk.prepare(SILENCE_CHUNK_BYTES), 0, SILENCE_CHUNK_BYTES);
+			chunk.commit(SILENCE_CHUNK_BYTES);
+			_remaining--;
+		}
+		return true;
+	}
+
+	const std::string get_chunk() { return read_chunk_string(); }
+
+	bool finished() { return (_remaining == 0); }
+
+private:
+	int _remaining;
+};
+
+double ms_between(StreamTimes::time_point from, StreamTimes::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+double percentile(std::vector<double> samples, double p)
+{
+	if (samples.empty()) {
+		return 0.0;
+	}
+	std::sort(samples.begin(), samples.end());
+	size_t i = (size_t)(p * (samples.size() - 1) + 0.5);
+	return samples[i];
+}
+
+void report(const char* name, const std::vector<double>& samples)
+{
+	std::cout << std::fixed << std::setprecision(2)
+		<< std::setw(22) << name
+		<< std::setw(10) << percentile(samples, 0.50)
+		<< std::setw(10) << percentile(samples, 0.99)
+		<< std::setw(10) << (samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end()))
+		<< std::endl;
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_session_latency [ -u URL ] [ -n sessions ] [ -c chunks ] [ -s ]" << std::endl;
+	std::cerr << "  runs sessions (default 100) one after another against the test server, each sending" << std::endl;
+	std::cerr << "  chunks (default 5) of 100ms silence, and reports p50/p99/max phase latencies;" << std::endl;
+	std::cerr << "  -s runs each session on a standalone client instead of a shared StreamingEngine" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	std::string ws_url = TEST_WS_URL;
+	int sessions = 100;
+	int chunks = 5;
+	bool standalone = false;
+	int c;
+	while ((c = getopt(argc, argv, "?hu:n:c:s")) != -1) {
+		switch (c) {
+		case 'u':
+			ws_url = optarg;
+			break;
+		case 'n':
+			sessions = atoi(optarg);
+			break;
+		case 'c':
+			chunks = atoi(optarg);
+			break;
+		case 's':
+			standalone = true;
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+
+	StreamingEngine engine;
+	if (!standalone) {
+		engine.start(1);
+	}
+
+	std::vector<double> connect_to_open;
+	std::vector<double> open_to_first_send;
+	std::vector<double> eos_to_return;
+	int failed = 0;
+	for (int i = 0; i < sessions; i++) {
+		std::unique_ptr<WebSocketStreamingClient> client;
+		if (standalone) {
+			client.reset(new WebSocketStreamingClient(access_token));
+		} else {
+			client.reset(new WebSocketStreamingClient(access_token, engine));
+		}
+		client->ws_url(ws_url);
+		client->verify_ssl_cert(false);
+		ShortSilenceMediaGenerator media_generator {chunks};
+
+		bool ok = client->run_stream(media_generator);
+		StreamTimes::time_point returned = std::chrono::steady_clock::now();
+		StreamTimes times = client->stream_times();
+		if (!ok || (times.eos == StreamTimes::time_point())) {
+			failed++;
+			continue;
+		}
+		connect_to_open.push_back(ms_between(times.connect, times.open));
+		open_to_first_send.push_back(ms_between(times.open, times.first_send));
+		eos_to_return.push_back(ms_between(times.eos, returned));
+	}
+
+	std::cout << std::setw(22) << "ms" << std::setw(10) << "p50" << std::setw(10) << "p99"
+		<< std::setw(10) << "max" << std::endl;
+	report("connect-to-open", connect_to_open);
+	report("open-to-first-send", open_to_first_send);
+	report("EOS-to-return", eos_to_return);
+	std::cout << sessions << " sessions, " << failed << " failed" << std::endl;
+
+	if (!standalone) {
+		engine.stop();
+	}
+	return (failed == 0) ? EX_OK : EX_SOFTWARE;
+}
@@ -0,0 +1,223 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/histogram.h>
+#include <verbit/streaming/transcript_assembler.h>
+
+using namespace verbit::streaming;
+
+// 150 words per minute, 12 words per utterance
+#define WORD_SECONDS 0.4
+#define UTTERANCE_WORDS 12
+
+/**
+ * Class generating the transcript responses of a synthetic session: a partial
+ * response after each word of an utterance, then a final one.
+ */
+class Session
+{
+public:
+	Session(double hours) : _words((size_t)(hours * 3600 / WORD_SECONDS)), _type("transcript"),
+		_kind_text("text"), _kind_punct("punct"), _speaker("c6eb6f2b-f85b-478f-af8a-a21b00000001")
+	{
+		_response.has_response = true;
+		_response.type = string_ref(_type);
+		_response.alternatives.resize(1);
+	}
+
+	// fill the next response; returns `false` at the end of the session
+	bool next()
+	{
+		if ( (_word >= _words) && (_in_utterance == 0) ) {
+			return false;
+		}
+		if (_in_utterance == 0) {
+			_id = "7b1f0d5e-2f7a-4c52-9d55-" + std::to_string(100000000000 + _utterance++);
+			_values.clear();
+			_items.clear();
+			_transcript.clear();
+		}
+		bool is_final = (_in_utterance == UTTERANCE_WORDS) || (_word >= _words);
+		if (is_final) {
+			_values.push_back(".");
+			_in_utterance = 0;
+		} else {
+			_values.push_back("word" + std::to_string(_word % 1000));
+			_in_utterance++;
+			_word++;
+		}
+		_transcript += _values.back() + " ";
+
+		// the values may have moved, so refer to them again
+		_items.resize(_values.size());
+		double start = (_word - _values.size() + (is_final ? 1 : 0)) * WORD_SECONDS;
+		for (size_t i = 0; i < _values.size(); i++) {
+			bool punct = is_final && (i == _values.size() - 1);
+			_items[i].kind = string_ref(punct ? _kind_punct : _kind_text);
+			_items[i].value = string_ref(_values[i]);
+			_items[i].speaker_id = string_ref(_speaker);
+			_items[i].start = start + i * WORD_SECONDS;
+			_items[i].end = _items[i].start + WORD_SECONDS * 0.8;
+		}
+		_response.id = string_ref(_id);
+		_response.is_final = is_final;
+		_response.alternatives[0].transcript = string_ref(_transcript);
+		_response.alternatives[0].items.data = _items.data();
+		_response.alternatives[0].items.count = _items.size();
+		return true;
+	}
+
+	const Response& response() const { return _response; }
+
+	double seconds() const { return _words * WORD_SECONDS; }
+
+private:
+	static StringRef string_ref(const std::string& s)
+	{
+		StringRef ref;
+		ref.data = s.data();
+		ref.length = s.length();
+		return ref;
+	}
+
+	size_t _words;
+	size_t _word = 0;
+	size_t _utterance = 0;
+	int _in_utterance = 0;
+	std::string _type;
+	std::string _kind_text;
+	std::string _kind_punct;
+	std::string _speaker;
+	std::string _id;
+	std::string _transcript;
+	std::vector<std::string> _values;
+	std::vector<Item> _items;
+	Response _response;
+};
+
+/**
+ * The naive running transcript: the final text, re-concatenated with the open
+ * utterance on every response.
+ */
+class NaiveTranscript
+{
+public:
+	void add(const Response& response)
+	{
+		const StringRef& transcript = response.alternatives[0].transcript;
+		if (response.is_final) {
+			_finals.append(transcript.data, transcript.length);
+			_text = _finals;
+		} else {
+			_text = _finals + transcript.str();
+		}
+	}
+
+	size_t length() const { return _text.length(); }
+
+private:
+	std::string _finals;
+	std::string _text;
+};
+
+void report(const char* name, size_t responses, double seconds, const Histogram& latency)
+{
+	std::cout << std::fixed << std::setprecision(1)
+		<< std::setw(12) << name
+		<< std::setw(14) << (responses / seconds)
+		<< std::setw(10) << (seconds * 1000)
+		<< std::setw(10) << latency.percentile(0.5) / 1000.0
+		<< std::setw(10) << latency.percentile(0.99) / 1000.0
+		<< std::setw(10) << latency.max() / 1000.0
+		<< std::endl;
+}
+
+// add every response of a session, timing each; returns the total seconds
+template<typename Transcript>
+double run(double hours, Transcript& transcript, Histogram& latency, size_t& responses)
+{
+	Session session {hours};
+	responses = 0;
+	double seconds = 0.0;
+	while (session.next()) {
+		auto start = std::chrono::steady_clock::now();
+		transcript.add(session.response());
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		seconds += std::chrono::duration<double>(elapsed).count();
+		responses++;
+	}
+	return seconds;
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_transcript_assembler [ -H hours ] [ -q queries ]" << std::endl;
+	std::cerr << "  assembles the transcript responses of a synthetic session of hours (default 8) of speech," << std::endl;
+	std::cerr << "  a partial response per word and a final one per utterance, by re-concatenating the" << std::endl;
+	std::cerr << "  text on each response and with TranscriptAssembler, and reports responses/s and" << std::endl;
+	std::cerr << "  per-response latency (microseconds); then times snapshots and queries (default 10000)" << std::endl;
+	std::cerr << "  of the items in one minute" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	double hours = 8.0;
+	int queries = 10000;
+	int c;
+	while ((c = getopt(argc, argv, "?hH:q:")) != -1) {
+		switch (c) {
+		case 'H':
+			hours = atof(optarg);
+			break;
+		case 'q':
+			queries = atoi(optarg);
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if ( (hours <= 0.0) || (queries <= 0) ) {
+		usage();
+		return EX_USAGE;
+	}
+
+	std::cout << std::setw(12) << "" << std::setw(14) << "responses/s" << std::setw(10) << "total ms"
+		<< std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "max us" << std::endl;
+	size_t responses = 0;
+	{
+		NaiveTranscript naive;
+		Histogram latency;
+		double seconds = run(hours, naive, latency, responses);
+		report("naive", responses, seconds, latency);
+	}
+	TranscriptAssembler assembler;
+	{
+		Histogram latency;
+		double seconds = run(hours, assembler, latency, responses);
+		report("assembler", responses, seconds, latency);
+	}
+
+	// snapshots and one-minute time range queries, spread over the session
+	Session session {hours};
+	size_t items = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < queries; i++) {
+		TranscriptSnapshot snapshot = assembler.snapshot();
+		double from = (session.seconds() - 60.0) * i / queries;
+		items += snapshot.items(from, from + 60.0).size();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << std::setprecision(2) << "snapshot + 1 minute query: " << (seconds * 1e6 / queries) << "us ("
+		<< (items / queries) << " items)" << std::endl;
+	std::cout << std::setprecision(1) << hours << " hours, " << responses << " responses, "
+		<< assembler.size() << " utterances, " << assembler.item_count() << " items" << std::endl;
+	return EX_OK;
+}
@@ -0,0 +1,165 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <glob.h>
+#include <sys/resource.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/voice_gate.h>
+
+using namespace verbit::streaming;
+
+double cpu_seconds()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// Read the S16LE media of a WAV file (or of a headerless file, taken as S16LE 16kHz mono).
+bool read_media(const std::string& path, std::string& media, int& rate, int& channels)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (!file.eof() && file.fail()) {
+		return false;
+	}
+	rate = 16000;
+	channels = 1;
+	if ( (data.size() < 12) || (data.compare(0, 4, "RIFF") != 0) || (data.compare(8, 4, "WAVE") != 0) ) {
+		media = data;
+		return true;
+	}
+	for (size_t pos = 12; pos + 8 <= data.size(); ) {
+		uint32_t size;
+		memcpy(&size, &data[pos + 4], 4);
+		if (data.compare(pos, 4, "fmt ") == 0) {
+			uint16_t format, n_channels, bits;
+			uint32_t sample_rate;
+			memcpy(&format, &data[pos + 8], 2);
+			memcpy(&n_channels, &data[pos + 10], 2);
+			memcpy(&sample_rate, &data[pos + 12], 4);
+			memcpy(&bits, &data[pos + 22], 2);
+			if ( (format != 1) || (bits != 16) ) {
+				return false;
+			}
+			rate = sample_rate;
+			channels = n_channels;
+		} else if (data.compare(pos, 4, "data") == 0) {
+			media = data.substr(pos + 8, size);
+			return true;
+		}
+		pos += 8 + size + (size & 1);
+	}
+	return false;
+}
+
+// Repeat `media` for `seconds`, with `gap` seconds of quiet noise (about -70dBFS) between repeats.
+std::string stream_of(const std::string& media, int rate, int channels, double gap, int seconds)
+{
+	const size_t bytes = (size_t)rate * channels * 2 * seconds;
+	std::string quiet((size_t)(rate * gap) * channels * 2, '\0');
+	uint32_t state = 1;
+	for (size_t i = 0; i < quiet.size(); i += 2) {
+		state = state * 1664525 + 1013904223;
+		int16_t sample = (int16_t)((int)((state >> 16) % 21) - 10);
+		memcpy(&quiet[i], &sample, 2);
+	}
+	std::string stream;
+	stream.reserve(bytes + media.size() + quiet.size());
+	while (stream.size() < bytes) {
+		stream += media;
+		stream += quiet;
+	}
+	stream.resize(bytes);
+	return stream;
+}
+
+void usage()
+{
+	std::cerr << "Usage: bench_voice_gate [ -s seconds ] [ -g gap ] [ file.wav ... ]" << std::endl;
+	std::cerr << "  gates 600 (by default) seconds of each file (test-files/*.wav by default), repeated with 2 (by default)" << std::endl;
+	std::cerr << "  seconds of quiet noise between repeats, in 20ms chunks, with each supported ISA, and reports CPU" << std::endl;
+	std::cerr << "  per stream-hour, time per analysis window and the media not sent" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int seconds = 600;
+	double gap = 2.0;
+	int c;
+	while ((c = getopt(argc, argv, "?hs:g:")) != -1) {
+		switch (c) {
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'g':
+			gap = atof(optarg);
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if ( (seconds <= 0) || (gap < 0) ) {
+		usage();
+		return EX_USAGE;
+	}
+	std::vector<std::string> paths(argv + optind, argv + argc);
+	if (paths.empty()) {
+		glob_t found;
+		if (glob("test-files/*.wav", 0, nullptr, &found) == 0) {
+			paths.assign(found.gl_pathv, found.gl_pathv + found.gl_pathc);
+		}
+		globfree(&found);
+	}
+
+	const SampleConverter::Isa isas[] = { SampleConverter::isa_scalar, SampleConverter::isa_sse2, SampleConverter::isa_avx2 };
+	std::cout << std::setw(24) << "file" << std::setw(8) << "ISA" << std::setw(20) << "CPU s/stream-hour"
+		<< std::setw(14) << "streams/core" << std::setw(12) << "ns/window" << std::setw(10) << "saved"
+		<< std::setw(10) << "segments" << std::endl;
+	std::cout << std::fixed;
+	for (const std::string& path : paths) {
+		std::string media;
+		int rate;
+		int channels;
+		if (!read_media(path, media, rate, channels) || media.empty()) {
+			std::cerr << path << ": not S16LE media" << std::endl;
+			return EX_DATAERR;
+		}
+		std::string stream = stream_of(media, rate, channels, gap, seconds);
+		const size_t chunk = (size_t)rate / 50 * channels * 2;
+		std::string name = path.substr(path.find_last_of('/') + 1);
+		for (SampleConverter::Isa isa : isas) {
+			if (!SampleConverter::supported(isa)) {
+				continue;
+			}
+			VoiceGateConfig config;
+			config.mode = VoiceGateConfig::gate_drop;
+			VoiceGate gate {config, rate, channels, isa};
+			std::string payload;
+			payload.reserve(chunk);
+			double cpu_start = cpu_seconds();
+			for (size_t pos = 0; pos < stream.size(); pos += chunk) {
+				payload.assign(stream, pos, chunk);
+				gate.process(payload);
+			}
+			double cpu = cpu_seconds() - cpu_start;
+			GateStats stats = gate.stats();
+			double windows = (double)seconds * 1000 / config.window.count();
+			std::cout << std::setw(24) << name << std::setw(8) << SampleConverter::isa_name(isa)
+				<< std::setw(20) << std::setprecision(3) << cpu * 3600 / seconds
+				<< std::setw(14) << std::setprecision(0) << seconds / cpu
+				<< std::setw(12) << std::setprecision(1) << cpu * 1e9 / windows
+				<< std::setw(9) << std::setprecision(1) << 100.0 * stats.bytes_gated / stats.bytes_in << "%"
+				<< std::setw(10) << stats.speech_segments << std::endl;
+		}
+	}
+	return EX_OK;
+}
@@ -3,8 +3,6 @@
 #include <stdlib.h>
 #include <sysexits.h>
 
-#include <nlohmann/json.hpp>
-
 #include <verbit/streaming/ws_streaming_client.h>
 
 #include "wav_media_generator.h"
@@ -57,11 +55,11 @@ bool config_from_options(int argc, char** argv, WebSocketStreamingClient &client
 	return true;
 }
 
-void on_response(WebSocketStreamingClient* client, nlohmann::json* response)
+void on_response(WebSocketStreamingClient* client, const Response& response)
 {
-	auto alternatives = (*response)["response"]["alternatives"];
-	std::string transcript = alternatives[0]["transcript"].get<std::string>();
-	std::cout << transcript << std::endl;
+	if (!response.alternatives.empty()) {
+		std::cout << response.alternatives[0].transcript << std::endl;
+	}
 }
 
 int main(int argc, char** argv)
@@ -79,7 +77,7 @@ int main(int argc, char** argv)
 
 	// set handler for client to deliver responses from service
 	// (see documentation for how to set a class method as a handler)
-	client.set_response_handler(&on_response);
+	client.set_typed_response_handler(&on_response);
 
 	// construct media generator
 	WAVMediaGenerator media_gen {wavfile};
@@ -35,16 +35,16 @@ WAVMediaGenerator::~WAVMediaGenerator()
 	_file.close();
 }
 
-const std::string WAVMediaGenerator::get_chunk()
+bool WAVMediaGenerator::read_chunk(ChunkBuffer& chunk)
 {
 	if (_file.eof()) {
-		return std::string();
+		return true;
 	}
 
-	// read next chunk (binary) - might be less than what we asked for
-	char buf[CHUNK_BYTES];
-	_file.read(buf, CHUNK_BYTES);
+	// read next chunk (binary) straight into the buffer - might be less than what we asked for
+	_file.read(chunk.prepare(CHUNK_BYTES), CHUNK_BYTES);
 	std::streamsize count = _file.gcount();
+	chunk.commit(count);
 #if defined(VERBOSE_DEBUG)
 	std::cout << "read " << count << " bytes" << std::endl;
 #endif
@@ -52,6 +52,5 @@ const std::string WAVMediaGenerator::get_chunk()
 	// simulate realtime playback-rate by sleeping
 	std::this_thread::sleep_for(std::chrono::milliseconds(CHUNK_DURATION_MS));
 
-	// return chunk as `string`
-	return std::string(buf, count);
+	return true;
 }
@@ -23,11 +23,14 @@ public:
 
 	~WAVMediaGenerator();
 
-	/// Return the next chunk of media bytes from the WAV file.
+	/// Read the next chunk of media bytes from the WAV file, directly into `chunk`.
 	///
-	/// The returned `string` is binary data, up to `CHUNK_BYTES` in length.
-	/// When the end of the WAV file is reached, returns an empty `string`.
-	const std::string get_chunk();
+	/// Reads up to `CHUNK_BYTES`.
+	/// When the end of the WAV file is reached, leaves `chunk` empty.
+	bool read_chunk(verbit::streaming::ChunkBuffer& chunk);
+
+	/// Return the next chunk of media bytes from the WAV file, with `read_chunk()`.
+	const std::string get_chunk() { return read_chunk_string(); }
 
 	/// Returns `true` when the end of the WAV file is reached.
 	///
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "async_file_writer.h"
+
+namespace verbit {
+namespace streaming {
+
+AsyncFileWriter::AsyncFileWriter(const std::string& path, size_t buffer_size, int buffers)
+	: _path(path), _buffer_size(buffer_size ? buffer_size : 1)
+{
+	if (buffers < 2) {
+		throw std::runtime_error("file writer needs at least two buffers");
+	}
+	_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (_fd < 0) {
+		throw std::runtime_error(std::string("can't open ") + path + ": " + strerror(errno));
+	}
+	for (int i = 0; i < buffers; i++) {
+		_buffers.emplace_back(new char[_buffer_size]);
+		_free.push_back(_buffers.back().get());
+	}
+	_current = _free.back();
+	_free.pop_back();
+	_full.reserve(buffers);
+	_thread = std::thread(&AsyncFileWriter::work, this);
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+	try {
+		close();
+	} catch (...) {
+	}
+}
+
+void AsyncFileWriter::append(const char* data, size_t len)
+{
+	while (len > 0) {
+		if (_used == _buffer_size) {
+			hand_off(false);
+		}
+		size_t n = std::min(len, _buffer_size - _used);
+		memcpy(_current + _used, data, n);
+		_used += n;
+		data += n;
+		len -= n;
+	}
+}
+
+void AsyncFileWriter::flush()
+{
+	hand_off(true);
+}
+
+void AsyncFileWriter::close()
+{
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (_closed) {
+			return;
+		}
+	}
+	std::string error;
+	try {
+		hand_off(true);
+	} catch (const std::runtime_error& e) {
+		error = e.what();
+	}
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_closed = true;
+		_stopping = true;
+		_cv.notify_all();
+	}
+	_used = _buffer_size;  // so the next append hands off, and throws
+	_thread.join();
+	if ( (::close(_fd) != 0) && error.empty() ) {
+		error = std::string("can't close ") + _path + ": " + strerror(errno);
+	}
+	if (!error.empty()) {
+		throw std::runtime_error(error);
+	}
+}
+
+uint64_t AsyncFileWriter::bytes_written()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _bytes_written;
+}
+
+uint64_t AsyncFileWriter::stalls()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _stalls;
+}
+
+// Hand the current buffer (if not empty) to the writer thread, and take a free one;
+// with `wait_written`, also wait until everything handed off has been written.
+void AsyncFileWriter::hand_off(bool wait_written)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (_closed) {
+		throw std::runtime_error(_path + " is closed");
+	}
+	check_error();
+	if (_used > 0) {
+		if (_free.empty()) {
+			_stalls++;
+			_cv.wait(lock, [this]{ return !_free.empty() || !_error.empty(); });
+			check_error();
+		}
+		_full.push_back(Full {_current, _used});
+		_current = _free.back();
+		_free.pop_back();
+		_used = 0;
+		_cv.notify_all();
+	}
+	if (wait_written) {
+		_cv.wait(lock, [this]{ return (_full.empty() && !_writing) || !_error.empty(); });
+		check_error();
+	}
+}
+
+// must be called with the mutex held
+void AsyncFileWriter::check_error()
+{
+	if (!_error.empty()) {
+		throw std::runtime_error(_error);
+	}
+}
+
+void AsyncFileWriter::work()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_cv.wait(lock, [this]{ return _stopping || !_full.empty(); });
+		if (_full.empty()) {
+			return;
+		}
+		Full full = _full.front();
+		_full.erase(_full.begin());
+		_writing = true;
+		lock.unlock();
+
+		std::string error;
+		const char* p = full.data;
+		size_t left = full.len;
+		while (left > 0) {
+			ssize_t n = ::write(_fd, p, left);
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				error = std::string("can't write ") + _path + ": " + strerror(errno);
+				break;
+			}
+			p += n;
+			left -= n;
+		}
+
+		lock.lock();
+		_writing = false;
+		_bytes_written += full.len - left;
+		if (_error.empty()) {
+			_error = error;
+		}
+		_free.push_back(full.data);
+		_cv.notify_all();
+	}
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define WSSC_DEFAULT_WRITER_BUFFER_SIZE (64 * 1024)
+#define WSSC_DEFAULT_WRITER_BUFFERS 4
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class writing a file through a fixed set of buffers, on a thread of its own.
+ *
+ * Appended text is copied into the current buffer; a full buffer is handed to
+ * the writer thread, and appending carries on in a free one. So appending
+ * only waits for the disk when every buffer is full (counted as a stall), and
+ * memory stays constant however much is written.
+ *
+ * A failed write is reported by a later `append()` (once it fills a buffer),
+ * `flush()` or `close()`, which throws a `std::runtime_error`.
+ *
+ * **NOTE** The append, flush and close methods must be called from one thread
+ * at a time.
+ */
+class AsyncFileWriter
+{
+public:
+	/// Construct a new file writer, creating (or truncating) the file.
+	///
+	/// \param path the file path
+	/// \param buffer_size the size of each buffer, in bytes
+	/// \param buffers the number of buffers (at least 2)
+	/// \throws std::runtime_error if the file can't be opened
+	AsyncFileWriter(const std::string& path, size_t buffer_size = WSSC_DEFAULT_WRITER_BUFFER_SIZE,
+		int buffers = WSSC_DEFAULT_WRITER_BUFFERS);
+
+	/// Destroy the writer, writing out any buffered text and closing the file
+	/// (errors are ignored; call `close()` first to see them).
+	~AsyncFileWriter();
+
+	/// Append text.
+	///
+	/// \param data the text
+	/// \param len the text length, in bytes
+	/// \throws std::runtime_error if an earlier write failed (found once the current buffer
+	///         is full), or the writer is closed
+	void append(const char* data, size_t len);
+
+	/// Append one character.
+	void append(char c)
+	{
+		if (_used == _buffer_size) {
+			hand_off(false);
+		}
+		_current[_used++] = c;
+	}
+
+	/// Write out all appended text, and wait until it has been written to the file.
+	///
+	/// \throws std::runtime_error if a write failed
+	void flush();
+
+	/// Write out all appended text, and close the file.
+	///
+	/// \throws std::runtime_error if a write failed
+	void close();
+
+	/// Return the file path.
+	const std::string& path() const { return _path; }
+
+	/// Return the number of bytes written to the file so far.
+	uint64_t bytes_written();
+
+	/// Return the number of times appending waited for a free buffer.
+	uint64_t stalls();
+
+private:
+	AsyncFileWriter(const AsyncFileWriter&) = delete;
+	AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+	void hand_off(bool wait_written);
+	void work();
+	void check_error();
+
+	std::string _path;
+	int _fd;
+	size_t _buffer_size;
+	std::vector<std::unique_ptr<char[]>> _buffers;
+
+	// the buffer being appended to, only touched by the appending thread
+	char* _current = nullptr;
+	size_t _used = 0;
+
+	struct Full {
+		char* data;
+		size_t len;
+	};
+
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	std::vector<char*> _free;
+	std::vector<Full> _full;    // in order, oldest first
+	bool _writing = false;
+	bool _stopping = false;
+	bool _closed = false;
+	std::string _error;
+	uint64_t _bytes_written = 0;
+	uint64_t _stalls = 0;
+	std::thread _thread;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "caption_writer.h"
+
+namespace verbit {
+namespace streaming {
+
+namespace {
+
+// Write `n` in decimal, with at least `width` digits, to `out`; returns the length.
+size_t _format_number(uint64_t n, int width, char* out)
+{
+	char digits[20];
+	int len = 0;
+	do {
+		digits[len++] = '0' + (n % 10);
+		n /= 10;
+	} while (n > 0);
+	size_t i = 0;
+	for (; width > len; width--) {
+		out[i++] = '0';
+	}
+	while (len > 0) {
+		out[i++] = digits[--len];
+	}
+	return i;
+}
+
+uint64_t _milliseconds(double seconds)
+{
+	return (seconds > 0.0) ? (uint64_t)std::llround(seconds * 1000.0) : 0;
+}
+
+bool _is_type(const StringRef& type, int types)
+{
+	if (types == ResponseType::Captions) {
+		return (type == "captions") || (type == "Captions");
+	}
+	return (type == "transcript") || (type == "Transcript");
+}
+
+} // anonymous namespace
+
+CaptionWriter::CaptionWriter(const std::string& path, Format format, int type, size_t buffer_size)
+	: _out(path, buffer_size), _format(format), _type(type)
+{
+	if ( (type != ResponseType::Captions) && (type != ResponseType::Transcript) ) {
+		throw std::runtime_error("caption writer needs a single response type");
+	}
+	if (format == webvtt) {
+		_out.append("WEBVTT\n\n", 8);
+	}
+}
+
+bool CaptionWriter::add(const Response& response)
+{
+	if ( !response.has_response || !(response.is_final || response.is_end_of_stream)
+		|| !_is_type(response.type, _type) || response.alternatives.empty() ) {
+		return false;
+	}
+	const Span<Item>& items = response.alternatives[0].items;
+	if (items.empty()) {
+		return false;
+	}
+	double start = items[0].start;
+	double end = std::max(start, items.back().end);
+	_cues++;
+
+	switch (_format) {
+	case srt:
+	case webvtt: {
+		char sep = (_format == srt) ? ',' : '.';
+		append_number(_cues);
+		_out.append('\n');
+		append_time(start, sep);
+		_out.append(" --> ", 5);
+		append_time(end, sep);
+		_out.append('\n');
+		append_text(items);
+		_out.append("\n\n", 2);
+		break;
+	}
+	case jsonl:
+		_out.append("{\"index\":", 9);
+		append_number(_cues);
+		_out.append(",\"id\":\"", 7);
+		append_escaped(response.id);
+		_out.append("\",\"start\":", 10);
+		append_seconds(start);
+		_out.append(",\"end\":", 7);
+		append_seconds(end);
+		_out.append(",\"text\":\"", 9);
+		append_text(items);
+		_out.append("\"}\n", 3);
+		break;
+	}
+	return true;
+}
+
+size_t CaptionWriter::format_time(double seconds, char sep, char* out)
+{
+	uint64_t ms = _milliseconds(seconds);
+	size_t len = _format_number(ms / 3600000, 2, out);
+	out[len++] = ':';
+	len += _format_number((ms / 60000) % 60, 2, out + len);
+	out[len++] = ':';
+	len += _format_number((ms / 1000) % 60, 2, out + len);
+	out[len++] = sep;
+	len += _format_number(ms % 1000, 3, out + len);
+	return len;
+}
+
+void CaptionWriter::append_time(double seconds, char sep)
+{
+	char text[32];
+	_out.append(text, format_time(seconds, sep, text));
+}
+
+// seconds with millisecond precision, for JSON
+void CaptionWriter::append_seconds(double seconds)
+{
+	uint64_t ms = _milliseconds(seconds);
+	char text[32];
+	size_t len = _format_number(ms / 1000, 1, text);
+	text[len++] = '.';
+	len += _format_number(ms % 1000, 3, text + len);
+	_out.append(text, len);
+}
+
+void CaptionWriter::append_number(uint64_t n)
+{
+	char text[20];
+	_out.append(text, _format_number(n, 1, text));
+}
+
+// a string escaped for the format: JSON string, WebVTT cue text, or (SRT) as is
+void CaptionWriter::append_escaped(const StringRef& s)
+{
+	static const char* hex = "0123456789abcdef";
+	const char* p = s.data;
+	const char* end = s.data + s.length;
+	for (; p < end; p++) {
+		char c = *p;
+		if (_format == jsonl) {
+			if ( (c == '"') || (c == '\\') ) {
+				_out.append('\\');
+				_out.append(c);
+			} else if ((unsigned char)c < 0x20) {
+				char escape[6] = {'\\', 'u', '0', '0', hex[(c >> 4) & 0x0f], hex[c & 0x0f]};
+				_out.append(escape, sizeof(escape));
+			} else {
+				_out.append(c);
+			}
+		} else if (_format == webvtt) {
+			switch (c) {
+			case '&': _out.append("&amp;", 5); break;
+			case '<': _out.append("&lt;", 4); break;
+			case '>': _out.append("&gt;", 4); break;
+			default: _out.append(c); break;
+			}
+		} else {
+			_out.append(c);
+		}
+	}
+}
+
+// item values, separated by spaces except before punctuation
+void CaptionWriter::append_text(const Span<Item>& items)
+{
+	bool first = true;
+	for (const Item& item : items) {
+		if (item.value.empty()) {
+			continue;
+		}
+		if ( !first && (item.kind != "punct") ) {
+			_out.append(' ');
+		}
+		append_escaped(item.value);
+		first = false;
+	}
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <verbit/streaming/async_file_writer.h>
+#include <verbit/streaming/response.h>
+#include <verbit/streaming/response_type.h>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class writing caption cues to a file, incrementally, as responses arrive.
+ *
+ * Each final response (of the Captions type, by default) with items becomes
+ * one cue, timed from the start of its first item to the end of its last,
+ * and appended to the file in one of these formats:
+ *
+ * - `srt`: SubRip, numbered cues with `HH:MM:SS,mmm` times
+ * - `webvtt`: WebVTT, with a `WEBVTT` header and `HH:MM:SS.mmm` times
+ * - `jsonl`: one JSON object per line, with `index`, `id`, `start`, `end` (seconds) and `text`
+ *
+ * The cue text is the item values, separated by spaces (except before
+ * punctuation). Cues are formatted straight into the buffers of an
+ * `AsyncFileWriter`, without iostreams or heap allocation, so memory stays
+ * constant however long the session.
+ *
+ * ```
+ * CaptionWriter captions {"event.srt", CaptionWriter::srt};
+ * client.set_typed_response_handler([&captions](WebSocketStreamingClient*, const Response& response) {
+ *     captions.add(response);
+ * });
+ * ...
+ * captions.close();
+ * ```
+ *
+ * **NOTE** Responses must be added from one thread at a time (as the client
+ * delivers them), and in order.
+ */
+class CaptionWriter
+{
+public:
+	/// The caption file formats.
+	enum Format {
+		srt,     ///< SubRip
+		webvtt,  ///< WebVTT
+		jsonl    ///< JSON Lines
+	};
+
+	/// Construct a new caption writer, creating (or truncating) the file.
+	///
+	/// \param path the file path
+	/// \param format the file format
+	/// \param type the response type to write, `ResponseType::Captions` or `ResponseType::Transcript`
+	/// \param buffer_size the size of each file writer buffer, in bytes
+	/// \throws std::runtime_error if the file can't be opened
+	CaptionWriter(const std::string& path, Format format, int type = ResponseType::Captions,
+		size_t buffer_size = WSSC_DEFAULT_WRITER_BUFFER_SIZE);
+
+	/// Add a response, appending a cue if it is a final response of the writer's type with items.
+	///
+	/// \param response the response
+	/// \return `true` if a cue was appended
+	/// \throws std::runtime_error if writing the file failed
+	bool add(const Response& response);
+
+	/// Write out all cues so far, and wait until they have been written to the file.
+	void flush() { _out.flush(); }
+
+	/// Write out all cues, and close the file.
+	void close() { _out.close(); }
+
+	/// Return the file format.
+	Format format() const { return _format; }
+
+	/// Return the number of cues appended.
+	uint64_t cues() const { return _cues; }
+
+	/// Return the file writer.
+	AsyncFileWriter& writer() { return _out; }
+
+	/// Format a time as `HH:MM:SS<sep>mmm` (with more hour digits if needed), rounded to the millisecond.
+	///
+	/// \param seconds the time, in seconds (negative times are taken as 0)
+	/// \param sep the separator before the milliseconds, `,` for SRT or `.` for WebVTT
+	/// \param out where to write the text, with room for at least 24 characters
+	/// \return the length of the text
+	static size_t format_time(double seconds, char sep, char* out);
+
+private:
+	CaptionWriter(const CaptionWriter&) = delete;
+	CaptionWriter& operator=(const CaptionWriter&) = delete;
+
+	void append_time(double seconds, char sep);
+	void append_seconds(double seconds);
+	void append_number(uint64_t n);
+	void append_escaped(const StringRef& s);
+	void append_text(const Span<Item>& items);
+
+	AsyncFileWriter _out;
+	Format _format;
+	int _type;
+	uint64_t _cues = 0;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class for a buffer lent to a media generator, to fill with the next chunk of media.
+ *
+ * The storage behind the buffer is the payload of the outgoing WebSocket message,
+ * so media written here is not copied again before it is framed for sending.
+ *
+ * A `std::string` can only be lengthened by initializing the new bytes, so the buffer
+ * grows its storage straight to the capacity reserved for the message, and only trims
+ * it to the committed bytes when it is destroyed: each byte is initialized at most once,
+ * however many times it is prepared. Read the storage only after that (or through `data()`).
+ *
+ * ```
+ * size_t n = read_samples(chunk.prepare(max_bytes), max_bytes);
+ * chunk.commit(n);
+ * ```
+ */
+class ChunkBuffer
+{
+public:
+	/// Construct an empty buffer over the given storage, whose contents are discarded
+	/// (but whose length is reused, without initializing it again).
+	explicit ChunkBuffer(std::string& storage) : _storage(storage), _size(0) { }
+
+	/// Trim the storage to the committed bytes.
+	~ChunkBuffer() { _storage.resize(_size); }
+
+	/// Return a pointer to `len` writable bytes following the committed bytes.
+	/// Follow with `commit()`, before calling any other method.
+	char* prepare(size_t len)
+	{
+		if (_storage.size() < _size + len) {
+			// (within the capacity reserved for the message: no allocation in the common case)
+			_storage.resize(std::max(_size + len, _storage.capacity()));
+		}
+		return &_storage[_size];
+	}
+
+	/// Commit `len` bytes (at most those last prepared) as written.
+	void commit(size_t len) { _size += len; }
+
+	/// Append a copy of `len` bytes.
+	void append(const void* data, size_t len)
+	{
+		memcpy(prepare(len), data, len);
+		commit(len);
+	}
+
+	/// Return the storage holding just the committed bytes, for code appending to a
+	/// `std::string` (such as a `MediaEncoder`) to write to directly, without a copy.
+	/// Follow with `commit_string()`, before calling any other method.
+	std::string& string()
+	{
+		// (shortening a string keeps its capacity)
+		_storage.resize(_size);
+		return _storage;
+	}
+
+	/// Commit all the bytes appended to the storage returned by `string()`.
+	void commit_string() { _size = _storage.size(); }
+
+	/// Return the committed bytes.
+	const char* data() const { return _storage.data(); }
+
+	/// Return the number of committed bytes.
+	size_t size() const { return _size; }
+
+	/// Discard all committed bytes.
+	void clear() { _size = 0; }
+
+private:
+	ChunkBuffer(const ChunkBuffer&) = delete;
+	ChunkBuffer& operator=(const ChunkBuffer&) = delete;
+
+	std::string& _storage;
+	size_t _size;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct holding per-session send congestion metrics.
+ *
+ * The session is congested from when its send queue rises above the high
+ * watermark until it drains to the low watermark.
+ */
+struct CongestionStats {
+	/// The number of times the session became congested.
+	uint64_t congestion_events = 0;
+
+	/// The total time spent congested.
+	std::chrono::milliseconds time_congested {0};
+
+	/// The number of media bytes dropped due to congestion.
+	uint64_t bytes_dropped = 0;
+
+	/// The number of media bytes held back while congested and sent coalesced.
+	uint64_t bytes_coalesced = 0;
+
+	/// The largest send queue size seen, in bytes.
+	size_t max_buffered = 0;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,254 @@
+#include <stdexcept>
+
+#include "dispatch_pool.h"
+
+namespace verbit {
+namespace streaming {
+
+DispatchPool::DispatchPool(int workers)
+{
+	if (workers < 1) {
+		throw std::runtime_error("dispatch pool needs at least one worker");
+	}
+	for (int i = 0; i < workers; i++) {
+		_threads.push_back(std::thread(&DispatchPool::work, this));
+	}
+}
+
+DispatchPool::~DispatchPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_stopping = true;
+		_ready_cv.notify_all();
+	}
+	for (std::thread& thread : _threads) {
+		thread.join();
+	}
+}
+
+void DispatchPool::schedule(std::shared_ptr<DispatchQueue> queue)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_ready.push_back(std::move(queue));
+	_ready_cv.notify_one();
+}
+
+void DispatchPool::work()
+{
+	while (true) {
+		std::shared_ptr<DispatchQueue> queue;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_ready_cv.wait(lock, [this]{ return _stopping || !_ready.empty(); });
+			if (_ready.empty()) {
+				return;
+			}
+			queue = std::move(_ready.front());
+			_ready.pop_front();
+		}
+		// a queue with more to deliver goes to the back, behind other sessions
+		if (queue->run(WSSC_DISPATCH_BATCH)) {
+			schedule(std::move(queue));
+		}
+	}
+}
+
+DispatchQueue::DispatchQueue(DispatchPool& pool, consumer deliver, size_t capacity, OverflowPolicy policy,
+	std::chrono::milliseconds block_timeout)
+	: _pool(pool), _deliver(deliver), _policy(policy), _block_timeout(block_timeout), _capacity(capacity ? capacity : 1)
+{
+}
+
+bool DispatchQueue::push(std::string&& payload, bool keep)
+{
+	return queue(payload, nullptr, 0, keep);
+}
+
+bool DispatchQueue::push_latest(std::string&& payload, const char* key, size_t key_len)
+{
+	return queue(payload, key, key_len, false);
+}
+
+// Queue a response; `key` is its supersede key, or `nullptr`.
+bool DispatchQueue::queue(std::string& payload, const char* key, size_t key_len, bool keep)
+{
+	bool accepted = true;
+	bool schedule = false;
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (_closed || _finishing) {
+			return false;
+		}
+		if (key) {
+			// the newest queued response with the same key is replaced (the key
+			// is compared before the payload swap, as it may refer into it)
+			for (std::deque<Entry>::reverse_iterator it = _entries.rbegin(); it != _entries.rend(); ++it) {
+				if ( it->supersedable && (it->key.compare(0, std::string::npos, key, key_len) == 0) ) {
+					it->payload.swap(payload);
+					it->queued = std::chrono::steady_clock::now();
+					_coalesced++;
+					return true;
+				}
+			}
+			if (_entries.size() >= _capacity) {
+				_dropped++;
+				return false;
+			}
+		}
+		if ( (_entries.size() >= _capacity) && (_policy == block) ) {
+			// a bounded wait, after which a full queue drops the oldest after all
+			_blocked++;
+			_cv.wait_for(lock, _block_timeout, [this]{ return _closed || (_entries.size() < _capacity); });
+			if (_closed) {
+				return false;
+			}
+		}
+		if (_entries.size() >= _capacity) {
+			if ( (_policy != drop_newest) && drop_oldest_entry() ) {
+				accepted = false;
+			} else if (!keep) {
+				_dropped++;
+				return false;
+			}
+			// otherwise a response to keep is queued beyond the capacity
+		}
+		_entries.push_back(Entry());
+		Entry& entry = _entries.back();
+		entry.supersedable = (key != nullptr);
+		if (key) {
+			entry.key.assign(key, key_len);
+		}
+		entry.keep = keep;
+		entry.payload.swap(payload);
+		entry.queued = std::chrono::steady_clock::now();
+		_queue_depth.record(_entries.size());
+		if (!_scheduled) {
+			_scheduled = true;
+			schedule = true;
+		}
+	}
+	if (schedule) {
+		_pool.schedule(shared_from_this());
+	}
+	return accepted;
+}
+
+// Drop the oldest queued response which is not to be kept; returns `false` if there is none.
+bool DispatchQueue::drop_oldest_entry()
+{
+	for (std::deque<Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+		if (!it->keep) {
+			_entries.erase(it);
+			_dropped++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void DispatchQueue::finish(std::function<void()> fn)
+{
+	bool closed = false;
+	bool schedule = false;
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (_closed) {
+			closed = true;
+		} else {
+			_finishing = true;
+			_finish = fn;
+			if (!_scheduled) {
+				_scheduled = true;
+				schedule = true;
+			}
+		}
+	}
+	if (closed) {
+		fn();
+	} else if (schedule) {
+		_pool.schedule(shared_from_this());
+	}
+}
+
+void DispatchQueue::close()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_closed = true;
+	_finish = nullptr;
+	_entries.clear();
+	_cv.notify_all();
+	_cv.wait(lock, [this]{ return !_running; });
+}
+
+size_t DispatchQueue::depth()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _entries.size();
+}
+
+DispatchStats DispatchQueue::stats()
+{
+	DispatchStats stats;
+	stats.delivered = _delivered.load();
+	stats.dropped = _dropped.load();
+	stats.blocked = _blocked.load();
+	stats.coalesced = _coalesced.load();
+	stats.queue_depth = _queue_depth;
+	stats.queue_wait = _queue_wait;
+	stats.handler_latency = _handler_latency;
+	return stats;
+}
+
+// Deliver up to `batch` responses; returns `true` if the queue should be scheduled again.
+bool DispatchQueue::run(size_t batch)
+{
+	std::string payload;
+	std::chrono::steady_clock::time_point queued;
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (size_t n = 0; n < batch; n++) {
+		if (_closed || _entries.empty()) {
+			break;
+		}
+		payload.swap(_entries.front().payload);
+		queued = _entries.front().queued;
+		_entries.pop_front();
+		_running = true;
+		_cv.notify_all();
+		lock.unlock();
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		_queue_wait.record(std::chrono::duration_cast<std::chrono::microseconds>(start - queued).count());
+		try {
+			_deliver(payload);
+		} catch (...) {
+			// a failing handler must not take the worker down (nor stop the session's other responses)
+		}
+		_handler_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start).count());
+		payload.clear();
+		_delivered++;
+
+		lock.lock();
+		_running = false;
+		_cv.notify_all();
+	}
+
+	if (!_closed && !_entries.empty()) {
+		return true;
+	}
+	_scheduled = false;
+	if (_closed || !_finish) {
+		return false;
+	}
+	// everything queued before `finish()` has been delivered; the finish function
+	// may destroy the session (and close this queue), so the queue is left idle first
+	std::function<void()> fn = std::move(_finish);
+	_finish = nullptr;
+	lock.unlock();
+	fn();
+	return false;
+}
+
+} // namespace
+} // namespace
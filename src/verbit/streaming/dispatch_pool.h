@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <verbit/streaming/dispatch_stats.h>
+
+#define WSSC_DEFAULT_DISPATCH_CAPACITY 256
+#define WSSC_DEFAULT_DISPATCH_BLOCK_MS 50
+#define WSSC_DISPATCH_BATCH 16
+
+namespace verbit {
+namespace streaming {
+
+class DispatchQueue;
+
+/**
+ * Class running response handlers on a pool of worker threads, off the I/O threads.
+ *
+ * Each session queues its responses on its own `DispatchQueue`. A queue with
+ * responses is scheduled on the pool, and a worker delivers up to
+ * `WSSC_DISPATCH_BATCH` of them before moving on to the next scheduled queue;
+ * a queue is only ever run by one worker at a time, so each session's responses
+ * are delivered in order.
+ *
+ * ```
+ * DispatchPool pool {4};
+ * client.dispatch_pool(&pool);          // before running the stream
+ * ```
+ *
+ * **NOTE** The pool must outlive the clients (and queues) using it.
+ */
+class DispatchPool
+{
+public:
+	/// Construct a new dispatch pool, starting its worker threads.
+	///
+	/// \param workers the number of worker threads
+	DispatchPool(int workers = 1);
+
+	/// Destroy the pool, after its workers have run every scheduled queue.
+	~DispatchPool();
+
+	/// Return the number of worker threads.
+	int workers() const { return (int)_threads.size(); }
+
+private:
+	friend class DispatchQueue;
+
+	DispatchPool(const DispatchPool&) = delete;
+	DispatchPool& operator=(const DispatchPool&) = delete;
+
+	void schedule(std::shared_ptr<DispatchQueue> queue);
+	void work();
+
+	std::mutex _mutex;
+	std::condition_variable _ready_cv;
+	std::deque<std::shared_ptr<DispatchQueue>> _ready;
+	bool _stopping = false;
+	std::vector<std::thread> _threads;
+};
+
+/**
+ * Class queueing one session's responses for delivery by a `DispatchPool`.
+ *
+ * The queue is bounded. When it is full, `push()` follows its overflow policy;
+ * dropped responses are counted in `stats()`. A response pushed to be kept (such
+ * as a final or end-of-stream response) is never dropped: the oldest response which
+ * may be dropped makes room for it, or if there is none, it is queued beyond the
+ * capacity.
+ *
+ * A response queued with `push_latest()` is superseded by the next one queued
+ * with the same key, if it has not been delivered by then: only the newest is
+ * delivered, in the place of the first. This is a latest-value mailbox per key,
+ * so a slow handler only sees the newest of a run of updates.
+ *
+ * A queue must be created with `std::make_shared`.
+ */
+class DispatchQueue : public std::enable_shared_from_this<DispatchQueue>
+{
+public:
+	/// What `push()` does when the queue is full.
+	enum OverflowPolicy {
+		drop_oldest,  ///< discard the oldest queued response (not one to keep) to make room (default)
+		drop_newest,  ///< discard the pushed response (unless it is to be kept)
+		block         ///< wait (up to the block timeout) for a worker to make room, then as `drop_oldest`
+	};
+
+	/// The function delivering a response; it may move the response text out.
+	typedef std::function<void(std::string&)> consumer;
+
+	/// Construct a new dispatch queue.
+	///
+	/// \param pool the pool which runs the queue
+	/// \param deliver the function delivering each response, on a worker thread
+	/// \param capacity the maximum number of queued responses
+	/// \param policy what to do on overflow
+	/// \param block_timeout with the `block` policy, how long to wait for room
+	DispatchQueue(DispatchPool& pool, consumer deliver, size_t capacity = WSSC_DEFAULT_DISPATCH_CAPACITY,
+		OverflowPolicy policy = drop_oldest,
+		std::chrono::milliseconds block_timeout = std::chrono::milliseconds(WSSC_DEFAULT_DISPATCH_BLOCK_MS));
+
+	/// Queue a response for delivery.
+	///
+	/// \param payload the response text, which is moved from
+	/// \param keep never drop this response, even if the queue is full
+	/// \return `false` if the response (or, to make room, an older one) was dropped,
+	///         or the queue is closed
+	bool push(std::string&& payload, bool keep = false);
+
+	/// Queue a response for delivery, superseding any queued response pushed with the same key.
+	/// The newest response takes the place of the one it supersedes, which is counted in `stats()`
+	/// as coalesced. If the queue is full, and there is no response to supersede, the response is
+	/// dropped (and counted as dropped) whatever the overflow policy, as a response with the same
+	/// key is expected to follow.
+	///
+	/// \param payload the response text, which is moved from
+	/// \param key the supersede key, which may refer into `payload`
+	/// \param key_len the length of the supersede key
+	/// \return `false` if the response was dropped, or the queue is closed
+	bool push_latest(std::string&& payload, const char* key, size_t key_len);
+
+	/// Run `fn` on a worker once every response queued so far has been delivered.
+	/// Nothing may be pushed afterwards. If the queue is closed, `fn` is run at once.
+	void finish(std::function<void()> fn);
+
+	/// Discard queued responses, and wait for any delivery in progress to return;
+	/// after this, the queue never calls `deliver` (nor a `finish()` function) again.
+	/// Must not be called from `deliver`.
+	void close();
+
+	/// Return the number of queued responses.
+	size_t depth();
+
+	/// Return the queue capacity.
+	size_t capacity() const { return _capacity; }
+
+	/// Return the overflow policy.
+	OverflowPolicy policy() const { return _policy; }
+
+	/// Return a snapshot of the dispatch metrics.
+	DispatchStats stats();
+
+private:
+	friend class DispatchPool;
+
+	DispatchQueue(const DispatchQueue&) = delete;
+	DispatchQueue& operator=(const DispatchQueue&) = delete;
+
+	bool run(size_t batch);
+	bool queue(std::string& payload, const char* key, size_t key_len, bool keep);
+	bool drop_oldest_entry();
+
+	struct Entry {
+		std::string payload;
+		std::string key;
+		bool supersedable = false;
+		bool keep = false;
+		std::chrono::steady_clock::time_point queued;
+	};
+
+	DispatchPool& _pool;
+	consumer _deliver;
+	OverflowPolicy _policy;
+	std::chrono::milliseconds _block_timeout;
+
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	size_t _capacity;
+	std::deque<Entry> _entries;
+	bool _scheduled = false;
+	bool _running = false;
+	bool _closed = false;
+	bool _finishing = false;
+	std::function<void()> _finish;
+
+	std::atomic<uint64_t> _delivered {0};
+	std::atomic<uint64_t> _dropped {0};
+	std::atomic<uint64_t> _blocked {0};
+	std::atomic<uint64_t> _coalesced {0};
+	Histogram _queue_depth;
+	Histogram _queue_wait;
+	Histogram _handler_latency;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+#include <verbit/streaming/histogram.h>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct holding per-session response dispatch metrics.
+ */
+struct DispatchStats {
+	/// The number of responses delivered to the handler(s).
+	uint64_t delivered = 0;
+
+	/// The number of responses dropped because the queue was full.
+	uint64_t dropped = 0;
+
+	/// The number of times a response waited for room because the queue was full.
+	uint64_t blocked = 0;
+
+	/// The number of responses superseded by a newer one before delivery (see `DispatchQueue::push_latest()`).
+	uint64_t coalesced = 0;
+
+	/// The queue depth just after each response was queued.
+	Histogram queue_depth;
+
+	/// The time each response waited in the queue, from queueing until its delivery began, in microseconds.
+	Histogram queue_wait;
+
+	/// The time the handler(s) took for each response, in microseconds.
+	Histogram handler_latency;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,785 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "flac_codec.h"
+
+namespace verbit {
+namespace streaming {
+
+namespace {
+
+const int BITS_PER_SAMPLE = 16;
+const int MAX_FIXED_ORDER = 4;
+const int MAX_RICE_PARAMETER = 14;  // (15 escapes, with 4-bit parameters)
+
+// subframe types
+const uint32_t SUBFRAME_CONSTANT = 0;
+const uint32_t SUBFRAME_VERBATIM = 1;
+const uint32_t SUBFRAME_FIXED = 8;
+const uint32_t SUBFRAME_LPC = 32;
+
+// stereo channel assignments (below them, independent channels)
+const uint32_t LEFT_SIDE = 8;
+const uint32_t SIDE_RIGHT = 9;
+const uint32_t MID_SIDE = 10;
+
+struct CrcTables {
+	uint8_t crc8[256];
+	uint16_t crc16[256];
+
+	CrcTables()
+	{
+		for (int i = 0; i < 256; i++) {
+			uint8_t c8 = (uint8_t)i;
+			uint16_t c16 = (uint16_t)(i << 8);
+			for (int bit = 0; bit < 8; bit++) {
+				c8 = (uint8_t)((c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1);
+				c16 = (uint16_t)((c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1);
+			}
+			crc8[i] = c8;
+			crc16[i] = c16;
+		}
+	}
+};
+
+const CrcTables& crc_tables()
+{
+	static const CrcTables tables;
+	return tables;
+}
+
+// CRC-8 (x^8 + x^2 + x + 1) of frame headers
+uint8_t crc8(const char* data, size_t size)
+{
+	const CrcTables& tables = crc_tables();
+	uint8_t crc = 0;
+	for (size_t i = 0; i < size; i++) {
+		crc = tables.crc8[crc ^ (uint8_t)data[i]];
+	}
+	return crc;
+}
+
+// CRC-16 (x^16 + x^15 + x^2 + 1) of frames
+uint16_t crc16(const char* data, size_t size)
+{
+	const CrcTables& tables = crc_tables();
+	uint16_t crc = 0;
+	for (size_t i = 0; i < size; i++) {
+		crc = (uint16_t)((crc << 8) ^ tables.crc16[(crc >> 8) ^ (uint8_t)data[i]]);
+	}
+	return crc;
+}
+
+inline uint32_t mask(int bits)
+{
+	return (bits >= 32) ? 0xffffffffu : ((1u << bits) - 1);
+}
+
+// Writes bits, most significant first, appending whole bytes to a string.
+class BitWriter
+{
+public:
+	explicit BitWriter(std::string& out) : _out(out) { }
+
+	// `bits` up to 32
+	void put(uint32_t value, int bits)
+	{
+		_acc = (_acc << bits) | (value & mask(bits));
+		_bits += bits;
+		while (_bits >= 8) {
+			_bits -= 8;
+			_out.push_back((char)(_acc >> _bits));
+		}
+	}
+
+	void put_signed(int32_t value, int bits) { put((uint32_t)value, bits); }
+
+	void put_rice(int32_t residual, int parameter)
+	{
+		uint32_t folded = ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+		uint32_t quotient = folded >> parameter;
+		uint32_t low = ((1u << parameter) | folded) & mask(parameter + 1);
+		if (quotient + parameter + 1 <= 32) {
+			put(low, quotient + parameter + 1);
+			return;
+		}
+		for (; quotient >= 32; quotient -= 32) {
+			put(0, 32);
+		}
+		put(0, quotient);
+		put(low, parameter + 1);
+	}
+
+	void align()
+	{
+		if (_bits > 0) {
+			put(0, 8 - _bits);
+		}
+	}
+
+private:
+	std::string& _out;
+	uint64_t _acc = 0;
+	int _bits = 0;
+};
+
+// Reads bits, most significant first; reading past the end gives zeros, and sets `short_read()`.
+class BitReader
+{
+public:
+	BitReader(const char* data, size_t size) : _data(reinterpret_cast<const uint8_t*>(data)), _end(size * 8) { }
+
+	// `bits` up to 32
+	uint32_t get(int bits)
+	{
+		if (_pos + bits > _end) {
+			_short = true;
+			_pos = _end;
+			return 0;
+		}
+		size_t byte = _pos >> 3;
+		int need = (int)(_pos & 7) + bits;
+		uint64_t word = 0;
+		for (int i = 0; i < (need + 7) / 8; i++) {
+			word = (word << 8) | _data[byte + i];
+		}
+		_pos += bits;
+		return (uint32_t)(word >> (((need + 7) & ~7) - need)) & mask(bits);
+	}
+
+	int32_t get_signed(int bits)
+	{
+		if (bits == 0) {
+			return 0;
+		}
+		uint32_t value = get(bits);
+		if ( (bits < 32) && (value >> (bits - 1)) ) {
+			value |= ~mask(bits);
+		}
+		return (int32_t)value;
+	}
+
+	// the number of zeros before the next one
+	uint32_t get_unary()
+	{
+		uint32_t zeros = 0;
+		while (_pos < _end) {
+			uint8_t rest = (uint8_t)(_data[_pos >> 3] << (_pos & 7));
+			if (rest == 0) {
+				zeros += 8 - (_pos & 7);
+				_pos = (_pos | 7) + 1;
+				continue;
+			}
+			while (!(rest & 0x80)) {
+				rest <<= 1;
+				zeros++;
+				_pos++;
+			}
+			_pos++;
+			return zeros;
+		}
+		_short = true;
+		return 0;
+	}
+
+	int32_t get_rice(int parameter)
+	{
+		uint32_t quotient = get_unary();
+		uint32_t folded = (quotient << parameter) | get(parameter);
+		return (int32_t)(folded >> 1) ^ -(int32_t)(folded & 1);
+	}
+
+	void align() { _pos = std::min(_end, (_pos + 7) & ~(size_t)7); }
+
+	bool short_read() const { return _short; }
+
+	size_t byte_pos() const { return _pos >> 3; }
+
+private:
+	const uint8_t* _data;
+	size_t _pos = 0;
+	size_t _end;
+	bool _short = false;
+};
+
+// the frame header code for a sample rate (12 to 14: given after the header)
+int rate_code(int sample_rate)
+{
+	static const int rates[] = {0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+	for (int code = 1; code < 12; code++) {
+		if (rates[code] == sample_rate) {
+			return code;
+		}
+	}
+	if ( (sample_rate % 1000 == 0) && (sample_rate / 1000 <= 255) ) {
+		return 12;
+	}
+	if (sample_rate <= 65535) {
+		return 13;
+	}
+	if ( (sample_rate % 10 == 0) && (sample_rate / 10 <= 65535) ) {
+		return 14;
+	}
+	return 0;  // (from STREAMINFO)
+}
+
+// the residual of a fixed predictor of `order`, for samples `[order, n)`
+void fixed_residual(const int32_t* x, size_t n, int order, int32_t* residual)
+{
+	for (size_t i = order; i < n; i++) {
+		int32_t r;
+		switch (order) {
+		case 0: r = x[i]; break;
+		case 1: r = x[i] - x[i - 1]; break;
+		case 2: r = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+		case 3: r = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+		default: r = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+		}
+		residual[i - order] = r;
+	}
+}
+
+// the fixed predictor order with the smallest residual, and the residual's absolute sum
+int best_fixed_order(const int32_t* x, size_t n, uint64_t& sum)
+{
+	uint64_t sums[MAX_FIXED_ORDER + 1] = {0, 0, 0, 0, 0};
+	for (size_t i = MAX_FIXED_ORDER; i < n; i++) {
+		int32_t e0 = x[i];
+		int32_t e1 = e0 - x[i - 1];
+		int32_t e2 = e1 - (x[i - 1] - x[i - 2]);
+		int32_t e3 = e2 - (x[i - 1] - 2 * x[i - 2] + x[i - 3]);
+		int32_t e4 = e3 - (x[i - 1] - 3 * x[i - 2] + 3 * x[i - 3] - x[i - 4]);
+		sums[0] += std::abs(e0);
+		sums[1] += std::abs(e1);
+		sums[2] += std::abs(e2);
+		sums[3] += std::abs(e3);
+		sums[4] += std::abs(e4);
+	}
+	int order = 0;
+	for (int o = 1; o <= MAX_FIXED_ORDER; o++) {
+		if (sums[o] < sums[order]) {
+			order = o;
+		}
+	}
+	sum = sums[order];
+	return order;
+}
+
+// the Rice parameter for a partition of `count` residuals folding to `sum`, and its estimated bits
+int rice_parameter(uint64_t count, uint64_t sum, uint64_t& bits)
+{
+	int best = 0;
+	bits = UINT64_MAX;
+	for (int parameter = 0; parameter <= MAX_RICE_PARAMETER; parameter++) {
+		uint64_t estimate = count * (parameter + 1) + (sum >> parameter);
+		if (estimate < bits) {
+			bits = estimate;
+			best = parameter;
+		}
+	}
+	return best;
+}
+
+// Write a subframe of `n` samples of `bps` bits, in whichever coding is smallest.
+void write_subframe(BitWriter& bits, const int32_t* x, size_t n, int bps, std::vector<int32_t>& residual,
+	std::vector<uint64_t>& partition_sums)
+{
+	bool constant = true;
+	for (size_t i = 1; constant && (i < n); i++) {
+		constant = (x[i] == x[0]);
+	}
+	if (constant) {
+		bits.put(SUBFRAME_CONSTANT << 1, 8);
+		bits.put_signed(x[0], bps);
+		return;
+	}
+
+	const uint64_t verbatim_bits = (uint64_t)n * bps;
+	uint64_t sum = 0;
+	int order = (n > 2 * MAX_FIXED_ORDER) ? best_fixed_order(x, n, sum) : -1;
+	int partition_order = 0;
+	uint64_t best_bits = UINT64_MAX;
+	if (order >= 0) {
+		fixed_residual(x, n, order, residual.data());
+		// the folded sums of the finest partitions, merged for the coarser ones
+		int max_order = 0;
+		while ( (max_order < WSSC_FLAC_MAX_PARTITION_ORDER) && (n % (2u << max_order) == 0)
+			&& ((n >> (max_order + 1)) > (size_t)order) ) {
+			max_order++;
+		}
+		size_t partitions = (size_t)1 << max_order;
+		size_t size = n >> max_order;
+		for (size_t p = 0, i = 0; p < partitions; p++) {
+			uint64_t partition_sum = 0;
+			for (size_t end = (p + 1) * size - order; i < end; i++) {
+				partition_sum += ((uint32_t)residual[i] << 1) ^ (uint32_t)(residual[i] >> 31);
+			}
+			partition_sums[p] = partition_sum;
+		}
+		for (int po = max_order; po >= 0; po--) {
+			size_t count = (size_t)1 << po;
+			uint64_t total = (uint64_t)order * bps + 6;
+			for (size_t p = 0; p < count; p++) {
+				uint64_t partition_bits;
+				rice_parameter((n >> po) - ((p == 0) ? order : 0), partition_sums[p], partition_bits);
+				total += 4 + partition_bits;
+			}
+			if (total < best_bits) {
+				best_bits = total;
+				partition_order = po;
+			}
+			for (size_t p = 0; p < count / 2; p++) {
+				partition_sums[p] = partition_sums[2 * p] + partition_sums[2 * p + 1];
+			}
+		}
+		// (the sums are for the coarsest partitions now: merge again for the chosen ones)
+		for (size_t p = 0, i = 0, count = (size_t)1 << partition_order; p < count; p++) {
+			uint64_t partition_sum = 0;
+			for (size_t end = (p + 1) * (n >> partition_order) - order; i < end; i++) {
+				partition_sum += ((uint32_t)residual[i] << 1) ^ (uint32_t)(residual[i] >> 31);
+			}
+			partition_sums[p] = partition_sum;
+		}
+	}
+
+	if (best_bits >= verbatim_bits) {
+		bits.put(SUBFRAME_VERBATIM << 1, 8);
+		for (size_t i = 0; i < n; i++) {
+			bits.put_signed(x[i], bps);
+		}
+		return;
+	}
+	bits.put((SUBFRAME_FIXED + order) << 1, 8);
+	for (int i = 0; i < order; i++) {
+		bits.put_signed(x[i], bps);
+	}
+	bits.put(0, 2);  // 4-bit Rice parameters
+	bits.put(partition_order, 4);
+	const int32_t* r = residual.data();
+	for (size_t p = 0, count = (size_t)1 << partition_order; p < count; p++) {
+		size_t samples = (n >> partition_order) - ((p == 0) ? order : 0);
+		uint64_t partition_bits;
+		int parameter = rice_parameter(samples, partition_sums[p], partition_bits);
+		bits.put(parameter, 4);
+		for (size_t i = 0; i < samples; i++) {
+			bits.put_rice(*r++, parameter);
+		}
+	}
+}
+
+} // anonymous namespace
+
+FlacMediaEncoder::FlacMediaEncoder(int sample_rate, int channels, std::chrono::milliseconds block) :
+	MediaEncoder(sample_rate, channels)
+{
+	if ( (sample_rate <= 0) || (sample_rate >= (1 << 20)) || (channels < 1) || (channels > 8) ) {
+		throw std::runtime_error("FLAC sample rate or channels out of range");
+	}
+	_block_frames = (size_t)((uint64_t)sample_rate * block.count() / 1000);
+	if ( (_block_frames < 16) || (_block_frames > 65535) ) {
+		throw std::runtime_error("FLAC block must be 16 to 65535 frames");
+	}
+	_samples.resize(_block_frames * channels);
+	_side.resize(_block_frames);
+	_mid.resize(_block_frames);
+	_residual.resize(_block_frames);
+	_partition_sums.resize((size_t)1 << WSSC_FLAC_MAX_PARTITION_ORDER);
+}
+
+void FlacMediaEncoder::encode(const void* in, size_t frames, std::string& out)
+{
+	if (!_header_written) {
+		write_header(out);
+	}
+	const uint8_t* bytes = static_cast<const uint8_t*>(in);
+	const size_t channels = _channels;
+	while (frames > 0) {
+		size_t n = std::min(frames, _block_frames - _fill);
+		for (size_t c = 0; c < channels; c++) {
+			int32_t* x = &_samples[c * _block_frames + _fill];
+			for (size_t i = 0; i < n; i++) {
+				int16_t sample;
+				memcpy(&sample, bytes + 2 * (i * channels + c), 2);
+				x[i] = sample;
+			}
+		}
+		bytes += n * channels * 2;
+		frames -= n;
+		_fill += n;
+		if (_fill == _block_frames) {
+			write_frame(out);
+			_fill = 0;
+		}
+	}
+}
+
+void FlacMediaEncoder::flush(std::string& out)
+{
+	if (!_header_written) {
+		write_header(out);
+	}
+	if (_fill > 0) {
+		write_frame(out);
+		_fill = 0;
+	}
+}
+
+// Write the stream marker, and STREAMINFO (as the only metadata block).
+void FlacMediaEncoder::write_header(std::string& out)
+{
+	out.append("fLaC");
+	BitWriter bits(out);
+	bits.put(0x80, 8);       // last metadata block, STREAMINFO
+	bits.put(34, 24);
+	bits.put(_block_frames, 16);
+	bits.put(_block_frames, 16);
+	bits.put(0, 24);         // frame sizes unknown
+	bits.put(0, 24);
+	bits.put(_sample_rate, 20);
+	bits.put(_channels - 1, 3);
+	bits.put(BITS_PER_SAMPLE - 1, 5);
+	bits.put(0, 4);          // total samples unknown
+	bits.put(0, 32);
+	out.append(16, '\0');    // no MD5 signature
+	_header_written = true;
+}
+
+void FlacMediaEncoder::write_frame(std::string& out)
+{
+	const size_t n = _fill;
+	const size_t start = out.size();
+	const int32_t* left = _samples.data();
+	const int32_t* right = left + _block_frames;
+
+	// pick the stereo decorrelation with the smallest residuals
+	uint32_t assignment = _channels - 1;
+	if (_channels == 2) {
+		for (size_t i = 0; i < n; i++) {
+			_side[i] = left[i] - right[i];
+			_mid[i] = (left[i] + right[i]) >> 1;
+		}
+		uint64_t l, r, s, m;
+		best_fixed_order(left, n, l);
+		best_fixed_order(right, n, r);
+		best_fixed_order(_side.data(), n, s);
+		best_fixed_order(_mid.data(), n, m);
+		uint64_t best = l + r;
+		if (l + s < best) {
+			best = l + s;
+			assignment = LEFT_SIDE;
+		}
+		if (s + r < best) {
+			best = s + r;
+			assignment = SIDE_RIGHT;
+		}
+		if (m + s < best) {
+			assignment = MID_SIDE;
+		}
+	}
+
+	BitWriter bits(out);
+	bits.put(0xfff8, 16);    // sync, fixed block size
+	int rate = rate_code(_sample_rate);
+	bits.put(7, 4);          // block size - 1 in 16 bits, below
+	bits.put(rate, 4);
+	bits.put(assignment, 4);
+	bits.put(4, 3);          // 16 bits per sample
+	bits.put(0, 1);
+	// the frame number, UTF-8 coded
+	uint64_t number = _frame_number++;
+	if (number < 0x80) {
+		bits.put((uint32_t)number, 8);
+	} else {
+		int bytes = 2;
+		while ( (bytes < 7) && (number >> (5 * bytes + 1)) ) {
+			bytes++;
+		}
+		bits.put(((0xff00u >> bytes) & 0xff) | (uint32_t)(number >> (6 * (bytes - 1))), 8);
+		for (int i = bytes - 2; i >= 0; i--) {
+			bits.put(0x80 | (uint32_t)((number >> (6 * i)) & 0x3f), 8);
+		}
+	}
+	bits.put(n - 1, 16);
+	if (rate == 12) {
+		bits.put(_sample_rate / 1000, 8);
+	} else if (rate == 13) {
+		bits.put(_sample_rate, 16);
+	} else if (rate == 14) {
+		bits.put(_sample_rate / 10, 16);
+	}
+	bits.put(crc8(&out[start], out.size() - start), 8);
+
+	switch (assignment) {
+	case LEFT_SIDE:
+		write_subframe(bits, left, n, BITS_PER_SAMPLE, _residual, _partition_sums);
+		write_subframe(bits, _side.data(), n, BITS_PER_SAMPLE + 1, _residual, _partition_sums);
+		break;
+	case SIDE_RIGHT:
+		write_subframe(bits, _side.data(), n, BITS_PER_SAMPLE + 1, _residual, _partition_sums);
+		write_subframe(bits, right, n, BITS_PER_SAMPLE, _residual, _partition_sums);
+		break;
+	case MID_SIDE:
+		write_subframe(bits, _mid.data(), n, BITS_PER_SAMPLE, _residual, _partition_sums);
+		write_subframe(bits, _side.data(), n, BITS_PER_SAMPLE + 1, _residual, _partition_sums);
+		break;
+	default:
+		for (int c = 0; c < _channels; c++) {
+			write_subframe(bits, &_samples[c * _block_frames], n, BITS_PER_SAMPLE, _residual, _partition_sums);
+		}
+		break;
+	}
+	bits.align();
+	bits.put(crc16(&out[start], out.size() - start), 16);
+}
+
+void FlacMediaDecoder::decode(const char* data, size_t size, std::string& out)
+{
+	_buffer.append(data, size);
+	while (_metadata_done ? read_frame(out) : read_metadata()) {
+	}
+	_buffer.erase(0, _pos);
+	_pos = 0;
+}
+
+// Read the stream marker and metadata blocks, if all there; returns `false` if not.
+bool FlacMediaDecoder::read_metadata()
+{
+	if (_buffer.size() < _pos + 4) {
+		return false;
+	}
+	if (_buffer.compare(_pos, 4, "fLaC") != 0) {
+		throw std::runtime_error("not a FLAC stream");
+	}
+	size_t pos = _pos + 4;
+	for (bool last = false; !last; ) {
+		if (_buffer.size() < pos + 4) {
+			return false;
+		}
+		BitReader header(&_buffer[pos], 4);
+		last = header.get(1);
+		uint32_t type = header.get(7);
+		uint32_t length = header.get(24);
+		if (_buffer.size() < pos + 4 + length) {
+			return false;
+		}
+		if (type == 0) {
+			BitReader info(&_buffer[pos + 4], length);
+			info.get(32);        // block sizes
+			info.get(32);        // frame sizes
+			info.get(16);
+			_sample_rate = info.get(20);
+			_channels = info.get(3) + 1;
+			int bps = info.get(5) + 1;
+			if (info.short_read() || (bps != BITS_PER_SAMPLE)) {
+				throw std::runtime_error("only 16-bit FLAC streams are supported");
+			}
+		}
+		pos += 4 + length;
+	}
+	if (_channels == 0) {
+		throw std::runtime_error("FLAC stream without STREAMINFO");
+	}
+	_pos = pos;
+	_metadata_done = true;
+	return true;
+}
+
+// Read a frame, if all there, appending its samples; returns `false` if not.
+bool FlacMediaDecoder::read_frame(std::string& out)
+{
+	const char* frame = _buffer.data() + _pos;
+	BitReader bits(frame, _buffer.size() - _pos);
+	if (bits.get(15) != (0xfff8 >> 1)) {
+		if (bits.short_read()) {
+			return false;
+		}
+		throw std::runtime_error("FLAC frame sync lost");
+	}
+	bits.get(1);             // blocking strategy
+	uint32_t size_code = bits.get(4);
+	uint32_t rate = bits.get(4);
+	uint32_t assignment = bits.get(4);
+	uint32_t sample_size = bits.get(3);
+	bits.get(1);
+	uint32_t first = bits.get(8);
+	for (uint32_t lead = first; (lead & 0xc0) == 0xc0; lead <<= 1) {
+		bits.get(8);         // (the frame or sample number is not needed)
+	}
+	if (bits.short_read()) {
+		return false;
+	}
+	size_t n;
+	if (size_code == 1) {
+		n = 192;
+	} else if ( (size_code >= 2) && (size_code <= 5) ) {
+		n = (size_t)576 << (size_code - 2);
+	} else if (size_code == 6) {
+		n = bits.get(8) + 1;
+	} else if (size_code == 7) {
+		n = bits.get(16) + 1;
+	} else if (size_code >= 8) {
+		n = (size_t)256 << (size_code - 8);
+	} else {
+		throw std::runtime_error("invalid FLAC block size");
+	}
+	if (rate == 12) {
+		bits.get(8);
+	} else if ( (rate == 13) || (rate == 14) ) {
+		bits.get(16);
+	}
+	size_t header_size = bits.byte_pos();
+	uint32_t header_crc = bits.get(8);
+	if (bits.short_read()) {
+		return false;
+	}
+	if (header_crc != crc8(frame, header_size)) {
+		throw std::runtime_error("FLAC frame header CRC mismatch");
+	}
+	if ( ((sample_size != 0) && (sample_size != 4)) || (assignment > MID_SIDE) ) {
+		throw std::runtime_error("unsupported FLAC frame");
+	}
+	int channels = (assignment >= LEFT_SIDE) ? 2 : assignment + 1;
+	if (channels != _channels) {
+		throw std::runtime_error("FLAC frame channels differ from STREAMINFO");
+	}
+
+	_samples.resize(n * channels);
+	for (int c = 0; c < channels; c++) {
+		int32_t* x = &_samples[c * n];
+		bool side = ( (assignment == LEFT_SIDE) && (c == 1) ) || ( (assignment == SIDE_RIGHT) && (c == 0) ) ||
+			( (assignment == MID_SIDE) && (c == 1) );
+		int bps = BITS_PER_SAMPLE + (side ? 1 : 0);
+		if (bits.get(1) != 0) {
+			throw std::runtime_error("invalid FLAC subframe");
+		}
+		uint32_t type = bits.get(6);
+		int wasted = 0;
+		if (bits.get(1)) {
+			wasted = bits.get_unary() + 1;
+			bps -= wasted;
+		}
+		if (type == SUBFRAME_CONSTANT) {
+			std::fill(x, x + n, bits.get_signed(bps));
+		} else if (type == SUBFRAME_VERBATIM) {
+			for (size_t i = 0; i < n; i++) {
+				x[i] = bits.get_signed(bps);
+			}
+		} else if ( ((type >= SUBFRAME_FIXED) && (type <= SUBFRAME_FIXED + MAX_FIXED_ORDER)) || (type >= SUBFRAME_LPC) ) {
+			size_t order = (type >= SUBFRAME_LPC) ? type - SUBFRAME_LPC + 1 : type - SUBFRAME_FIXED;
+			if (order > n) {
+				throw std::runtime_error("invalid FLAC predictor order");
+			}
+			for (size_t i = 0; i < order; i++) {
+				x[i] = bits.get_signed(bps);
+			}
+			int precision = 0;
+			int shift = 0;
+			int32_t coefs[32];
+			if (type >= SUBFRAME_LPC) {
+				precision = bits.get(4) + 1;
+				shift = bits.get_signed(5);
+				if ( (precision == 16) || (shift < 0) ) {
+					throw std::runtime_error("invalid FLAC LPC subframe");
+				}
+				for (size_t i = 0; i < order; i++) {
+					coefs[i] = bits.get_signed(precision);
+				}
+			}
+			// the residual, into `x` (the prediction is added below)
+			uint32_t method = bits.get(2);
+			uint32_t partition_order = bits.get(4);
+			if ( (method > 1) || (n % ((size_t)1 << partition_order) != 0) || ((n >> partition_order) < order) ) {
+				throw std::runtime_error("invalid FLAC residual");
+			}
+			const int parameter_bits = (method == 0) ? 4 : 5;
+			const uint32_t escape = (method == 0) ? 15 : 31;
+			size_t i = order;
+			for (size_t p = 0; (p < ((size_t)1 << partition_order)) && !bits.short_read(); p++) {
+				size_t end = (p + 1) * (n >> partition_order);
+				uint32_t parameter = bits.get(parameter_bits);
+				if (parameter == escape) {
+					int raw = bits.get(5);
+					for (; i < end; i++) {
+						x[i] = bits.get_signed(raw);
+					}
+				} else {
+					for (; (i < end) && !bits.short_read(); i++) {
+						x[i] = bits.get_rice(parameter);
+					}
+				}
+			}
+			if (bits.short_read()) {
+				return false;
+			}
+			if (type >= SUBFRAME_LPC) {
+				for (size_t i = order; i < n; i++) {
+					int64_t sum = 0;
+					for (size_t j = 0; j < order; j++) {
+						sum += (int64_t)coefs[j] * x[i - 1 - j];
+					}
+					x[i] += (int32_t)(sum >> shift);
+				}
+			} else {
+				for (size_t i = order; i < n; i++) {
+					switch (order) {
+					case 1: x[i] += x[i - 1]; break;
+					case 2: x[i] += 2 * x[i - 1] - x[i - 2]; break;
+					case 3: x[i] += 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3]; break;
+					case 4: x[i] += 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4]; break;
+					}
+				}
+			}
+		} else {
+			throw std::runtime_error("invalid FLAC subframe type");
+		}
+		if (bits.short_read()) {
+			return false;
+		}
+		if (wasted > 0) {
+			for (size_t i = 0; i < n; i++) {
+				x[i] = (int32_t)((uint32_t)x[i] << wasted);
+			}
+		}
+	}
+	bits.align();
+	size_t frame_size = bits.byte_pos();
+	uint32_t frame_crc = bits.get(16);
+	if (bits.short_read()) {
+		return false;
+	}
+	if (frame_crc != crc16(frame, frame_size)) {
+		throw std::runtime_error("FLAC frame CRC mismatch");
+	}
+
+	// undo the stereo decorrelation, and interleave
+	int32_t* a = _samples.data();
+	int32_t* b = a + n;
+	for (size_t i = 0; i < n; i++) {
+		if (assignment == LEFT_SIDE) {
+			b[i] = a[i] - b[i];
+		} else if (assignment == SIDE_RIGHT) {
+			a[i] += b[i];
+		} else if (assignment == MID_SIDE) {
+			int32_t mid = (int32_t)((uint32_t)a[i] << 1) | (b[i] & 1);
+			a[i] = (mid + b[i]) >> 1;
+			b[i] = (mid - b[i]) >> 1;
+		}
+	}
+	size_t offset = out.size();
+	out.resize(offset + n * channels * 2);
+	char* pcm = &out[offset];
+	for (size_t i = 0; i < n; i++) {
+		for (int c = 0; c < channels; c++) {
+			int16_t sample = (int16_t)_samples[c * n + i];
+			memcpy(pcm, &sample, 2);
+			pcm += 2;
+		}
+	}
+	_pos += frame_size + 2;
+	return true;
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,181 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "flight_recorder.h"
+
+namespace verbit {
+namespace streaming {
+
+namespace {
+
+struct DumpHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	int32_t error_code;
+	uint32_t count;
+	uint64_t wall_time_us;
+	uint64_t time_ns;
+};
+
+struct DumpEvent {
+	uint64_t time_ns;
+	uint32_t value;
+	uint16_t kind;
+	uint16_t arg;
+};
+
+static_assert(sizeof(DumpHeader) == 32, "flight dump header must be 32 bytes");
+static_assert(sizeof(DumpEvent) == 16, "flight dump event must be 16 bytes");
+
+uint64_t _now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // anonymous namespace
+
+const char* FlightEvent::kind_name(Kind kind)
+{
+	switch (kind) {
+	case state: return "state";
+	case connect: return "connect";
+	case open: return "open";
+	case send: return "send";
+	case send_error: return "send_error";
+	case buffered: return "buffered";
+	case eos: return "eos";
+	case response: return "response";
+	case ping: return "ping";
+	case close: return "close";
+	case fail: return "fail";
+	case keepalive_timeout: return "keepalive_timeout";
+	case media_eof: return "media_eof";
+	case reconnect: return "reconnect";
+	case finish: return "finish";
+	default: return "unknown";
+	}
+}
+
+FlightRecorder::FlightRecorder(size_t events) :
+	_start_ticks(ticks()),
+	_start_ns(_now_ns()),
+	_next(0)
+{
+	size_t capacity = 2;
+	while (capacity < events) {
+		capacity <<= 1;
+	}
+	_mask = capacity - 1;
+	_slots.reset(new Slot[capacity]);
+	for (size_t i = 0; i < capacity; i++) {
+		_slots[i].time.store(0, std::memory_order_relaxed);
+		_slots[i].data.store(0, std::memory_order_relaxed);
+	}
+}
+
+// Convert a time stamp to monotonic nanoseconds, scaling TSC ticks by their rate since construction.
+uint64_t FlightRecorder::to_ns(uint64_t ticks, uint64_t now_ticks, uint64_t now_ns) const
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (now_ticks <= _start_ticks) {
+		return _start_ns;
+	}
+	long double ns_per_tick = (long double)(now_ns - _start_ns) / (now_ticks - _start_ticks);
+	return _start_ns + (int64_t)((long double)(int64_t)(ticks - _start_ticks) * ns_per_tick);
+#else
+	return ticks;
+#endif
+}
+
+std::vector<FlightEvent> FlightRecorder::events() const
+{
+	uint64_t now_ticks = ticks();
+	uint64_t now_ns = _now_ns();
+	uint64_t next = _next.load(std::memory_order_acquire);
+	uint64_t first = (next > capacity()) ? next - capacity() : 0;
+	std::vector<FlightEvent> events;
+	events.reserve(next - first);
+	for (uint64_t i = first; i < next; i++) {
+		const Slot& slot = _slots[i & _mask];
+		uint64_t data = slot.data.load(std::memory_order_relaxed);
+		FlightEvent event;
+		event.kind = (FlightEvent::Kind)((data >> 32) & 0xffff);
+		if (event.kind == 0) {
+			continue;  // claimed, but not yet written
+		}
+		event.time_ns = to_ns(slot.time.load(std::memory_order_relaxed), now_ticks, now_ns);
+		event.value = (uint32_t)data;
+		event.arg = (uint16_t)(data >> 48);
+		events.push_back(event);
+	}
+	return events;
+}
+
+void FlightRecorder::dump(const std::string& path, int error_code) const
+{
+	std::vector<FlightEvent> recorded = events();
+	DumpHeader header;
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.reserved = 0;
+	header.error_code = error_code;
+	header.count = recorded.size();
+	header.wall_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	header.time_ns = _now_ns();
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		throw std::runtime_error(std::string("can't open ") + path + ": " + strerror(errno));
+	}
+	out.write((const char*)&header, sizeof(header));
+	for (const FlightEvent& event : recorded) {
+		DumpEvent dumped;
+		dumped.time_ns = event.time_ns;
+		dumped.value = event.value;
+		dumped.kind = event.kind;
+		dumped.arg = event.arg;
+		out.write((const char*)&dumped, sizeof(dumped));
+	}
+	out.close();
+	if (!out) {
+		throw std::runtime_error(std::string("can't write ") + path);
+	}
+}
+
+void FlightRecorder::load(const std::string& path, std::vector<FlightEvent>& events, int& error_code,
+	uint64_t& wall_time_us, uint64_t& time_ns)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		throw std::runtime_error(std::string("can't open ") + path + ": " + strerror(errno));
+	}
+	DumpHeader header;
+	if ( !in.read((char*)&header, sizeof(header)) || (header.magic != MAGIC) || (header.version != VERSION) ) {
+		throw std::runtime_error(path + " is not a flight recorder dump (or not this version)");
+	}
+	error_code = header.error_code;
+	wall_time_us = header.wall_time_us;
+	time_ns = header.time_ns;
+	events.clear();
+	events.reserve(header.count);
+	for (uint32_t i = 0; i < header.count; i++) {
+		DumpEvent dumped;
+		if (!in.read((char*)&dumped, sizeof(dumped))) {
+			throw std::runtime_error(path + ": truncated at event " + std::to_string(i));
+		}
+		FlightEvent event;
+		event.time_ns = dumped.time_ns;
+		event.kind = (FlightEvent::Kind)dumped.kind;
+		event.arg = dumped.arg;
+		event.value = dumped.value;
+		events.push_back(event);
+	}
+}
+
+} // namespace
+} // namespace
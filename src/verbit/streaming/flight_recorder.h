@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define WSSC_DEFAULT_FLIGHT_EVENTS 1024
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct describing one event of a flight record.
+ */
+struct FlightEvent {
+	/// What happened.
+	enum Kind {
+		state = 1,              ///< service state transition: `arg` the new state, `value` the old one
+		connect = 2,            ///< connect attempt started: `value` the attempt number
+		open = 3,               ///< WebSocket opened
+		send = 4,               ///< media sent: `value` bytes
+		send_error = 5,         ///< media send failed: `value` the error code
+		buffered = 6,           ///< send queue sampled: `value` bytes (`get_buffered_amount()`)
+		eos = 7,                ///< end-of-stream event sent
+		response = 8,           ///< response received: `value` bytes, `arg` `response_final` and/or `response_eos`
+		ping = 9,               ///< ping received
+		close = 10,             ///< WebSocket closed: `value` the local close code, `arg` the remote one
+		fail = 11,              ///< connect failed: `value` the local close code
+		keepalive_timeout = 12, ///< no ping received within the keepalive timeout
+		media_eof = 13,         ///< media ended before it was finished
+		reconnect = 14,         ///< reconnect started: `value` the reconnect number
+		finish = 15             ///< session finished: `value` the error code
+	};
+
+	/// `response` event flags.
+	static const uint16_t response_final = 1;
+	static const uint16_t response_eos = 2;
+
+	/// When it happened, in nanoseconds by the monotonic clock.
+	uint64_t time_ns = 0;
+
+	/// What happened.
+	Kind kind = state;
+
+	/// Kind-specific argument.
+	uint16_t arg = 0;
+
+	/// Kind-specific value.
+	uint32_t value = 0;
+
+	/// Return the name of an event kind, _e.g._ `"send"`.
+	static const char* kind_name(Kind kind);
+};
+
+/**
+ * Class keeping the last events of a session in a fixed-size ring, always on,
+ * to find out afterwards why a session failed.
+ *
+ * Recording an event is a few nanoseconds: an atomic increment, a time stamp
+ * (the TSC, on x86) and two relaxed stores; nothing is formatted. A dump is a
+ * small binary file, decoded to text or Chrome trace JSON by `flight_decode`.
+ *
+ * ```
+ * client.flight_dump_dir("/var/tmp");  // dump automatically when a session fails
+ * if (!client.run_stream(media)) {
+ *     client.flight_recorder().dump("failed.vbfr");  // or on request
+ * }
+ * ```
+ *
+ * Events may be recorded from any number of threads. A dump taken while
+ * events are being recorded may hold a torn event.
+ */
+class FlightRecorder
+{
+public:
+	/// The dump file magic number.
+	static const uint32_t MAGIC = 0x52464256;  // "VBFR"
+
+	/// The dump format version.
+	static const uint16_t VERSION = 1;
+
+	/// Construct a new flight recorder.
+	///
+	/// \param events the ring capacity, in events (rounded up to a power of two)
+	FlightRecorder(size_t events = WSSC_DEFAULT_FLIGHT_EVENTS);
+
+	/// Record an event.
+	///
+	/// \param kind what happened
+	/// \param value kind-specific value (see `FlightEvent::Kind`)
+	/// \param arg kind-specific argument
+	void record(FlightEvent::Kind kind, uint32_t value = 0, uint16_t arg = 0)
+	{
+		Slot& slot = _slots[_next.fetch_add(1, std::memory_order_relaxed) & _mask];
+		slot.time.store(ticks(), std::memory_order_relaxed);
+		slot.data.store(value | ((uint64_t)kind << 32) | ((uint64_t)arg << 48), std::memory_order_relaxed);
+	}
+
+	/// Return the ring capacity, in events.
+	size_t capacity() const { return _mask + 1; }
+
+	/// Return the number of events recorded (including those since overwritten).
+	uint64_t recorded() const { return _next.load(std::memory_order_relaxed); }
+
+	/// Return the events in the ring, oldest first, with their times in nanoseconds.
+	std::vector<FlightEvent> events() const;
+
+	/// Write the events in the ring to a dump file.
+	///
+	/// \param path the dump file path
+	/// \param error_code the session error code, if any
+	/// \throws std::runtime_error if the file can't be written
+	void dump(const std::string& path, int error_code = 0) const;
+
+	/// Read a dump file.
+	///
+	/// \param path the dump file path
+	/// \param events filled with the events, oldest first
+	/// \param error_code set to the session error code
+	/// \param wall_time_us set to when the dump was written, in microseconds since the Unix epoch
+	/// \param time_ns set to when the dump was written, by the clock of the event times
+	/// \throws std::runtime_error if the file can't be read, or is not a dump
+	static void load(const std::string& path, std::vector<FlightEvent>& events, int& error_code,
+		uint64_t& wall_time_us, uint64_t& time_ns);
+
+	/// Return the current time stamp: TSC ticks on x86, otherwise monotonic nanoseconds.
+	static uint64_t ticks()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+private:
+	FlightRecorder(const FlightRecorder&) = delete;
+	FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+	struct Slot {
+		std::atomic<uint64_t> time;
+		std::atomic<uint64_t> data;  // value, kind << 32, arg << 48
+	};
+
+	uint64_t to_ns(uint64_t ticks, uint64_t now_ticks, uint64_t now_ns) const;
+
+	std::unique_ptr<Slot[]> _slots;
+	size_t _mask;
+	uint64_t _start_ticks;
+	uint64_t _start_ns;
+	std::atomic<uint64_t> _next;
+};
+
+} // namespace
+} // namespace
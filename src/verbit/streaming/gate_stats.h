@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct holding per-session metrics for the voice gate.
+ */
+struct GateStats {
+	/// Media bytes read from the media generator.
+	uint64_t bytes_in = 0;
+
+	/// Media bytes passed on for sending (including pre-roll and keep-alive frames).
+	uint64_t bytes_sent = 0;
+
+	/// Media bytes of silence withheld, and never sent.
+	uint64_t bytes_gated = 0;
+
+	/// Keep-alive frames (of digital silence) sent while the gate was closed.
+	uint64_t keepalive_frames = 0;
+
+	/// The number of times the gate opened on speech.
+	uint64_t speech_segments = 0;
+
+	/// The media time withheld (`bytes_gated` as a duration).
+	std::chrono::milliseconds time_gated {0};
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,104 @@
+#include <cmath>
+
+#include "histogram.h"
+
+namespace verbit {
+namespace streaming {
+
+Histogram& Histogram::operator=(const Histogram& other)
+{
+	for (int i = 0; i < BUCKETS; i++) {
+		_buckets[i].store(other._buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	_count.store(other._count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	_sum.store(other._sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	_max.store(other._max.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	return *this;
+}
+
+void Histogram::record(uint64_t value)
+{
+	_buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_sum.fetch_add(value, std::memory_order_relaxed);
+	uint64_t current = _max.load(std::memory_order_relaxed);
+	while ( (value > current) && !_max.compare_exchange_weak(current, value, std::memory_order_relaxed) ) {
+	}
+}
+
+void Histogram::merge(const Histogram& other)
+{
+	for (int i = 0; i < BUCKETS; i++) {
+		uint64_t n = other._buckets[i].load(std::memory_order_relaxed);
+		if (n) {
+			_buckets[i].fetch_add(n, std::memory_order_relaxed);
+		}
+	}
+	_count.fetch_add(other._count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	_sum.fetch_add(other._sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	uint64_t value = other._max.load(std::memory_order_relaxed);
+	uint64_t current = _max.load(std::memory_order_relaxed);
+	while ( (value > current) && !_max.compare_exchange_weak(current, value, std::memory_order_relaxed) ) {
+	}
+}
+
+void Histogram::reset()
+{
+	for (int i = 0; i < BUCKETS; i++) {
+		_buckets[i].store(0, std::memory_order_relaxed);
+	}
+	_count.store(0, std::memory_order_relaxed);
+	_sum.store(0, std::memory_order_relaxed);
+	_max.store(0, std::memory_order_relaxed);
+}
+
+double Histogram::mean() const
+{
+	uint64_t count = _count.load(std::memory_order_relaxed);
+	return count ? ((double)_sum.load(std::memory_order_relaxed) / count) : 0.0;
+}
+
+uint64_t Histogram::percentile(double p) const
+{
+	uint64_t count = _count.load(std::memory_order_relaxed);
+	if (count == 0) {
+		return 0;
+	}
+	uint64_t rank = (uint64_t)std::ceil(p * count);
+	if (rank < 1) {
+		rank = 1;
+	}
+	uint64_t max = _max.load(std::memory_order_relaxed);
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKETS; i++) {
+		seen += _buckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank) {
+			uint64_t value = bucket_max(i);
+			return (value < max) ? value : max;
+		}
+	}
+	return max;
+}
+
+int Histogram::bucket(uint64_t value)
+{
+	if (value < 16) {
+		return (int)value;
+	}
+	int msb = 63 - __builtin_clzll(value);
+	return 16 + (msb - 4) * 8 + (int)((value >> (msb - 3)) & 7);
+}
+
+uint64_t Histogram::bucket_max(int bucket)
+{
+	if (bucket < 16) {
+		return (uint64_t)bucket;
+	}
+	int msb = 4 + (bucket - 16) / 8;
+	uint64_t sub = (uint64_t)((bucket - 16) % 8);
+	// wraps to the largest uint64_t for the last bucket
+	return ((8 + sub + 1) << (msb - 3)) - 1;
+}
+
+} // namespace
+} // namespace
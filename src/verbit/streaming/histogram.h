@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class counting recorded values into log-linear buckets, for percentiles.
+ *
+ * Values below 16 are counted exactly; above that, each power of two is split
+ * into 8 buckets, so a percentile is within 12.5% of the true value. Recording
+ * is lock-free and wait-free (apart from updating the maximum), and may be
+ * done from any thread.
+ *
+ * Copying a histogram takes a snapshot of it. A snapshot taken while values are
+ * being recorded may be slightly inconsistent (_e.g._ `count()` may not equal
+ * the sum of the bucket counts).
+ */
+class Histogram
+{
+public:
+	/// The number of buckets.
+	static const int BUCKETS = 16 + 60 * 8;
+
+	/// Construct a new, empty histogram.
+	Histogram() { reset(); }
+
+	/// Construct a snapshot of another histogram.
+	Histogram(const Histogram& other) { *this = other; }
+
+	/// Replace this histogram with a snapshot of another histogram.
+	Histogram& operator=(const Histogram& other);
+
+	/// Record a value.
+	void record(uint64_t value);
+
+	/// Add the values recorded by another histogram to this one.
+	void merge(const Histogram& other);
+
+	/// Forget all recorded values. Not safe while values are being recorded.
+	void reset();
+
+	/// Return the number of values recorded.
+	uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+
+	/// Return the sum of the values recorded.
+	uint64_t sum() const { return _sum.load(std::memory_order_relaxed); }
+
+	/// Return the largest value recorded, or 0 if none.
+	uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+
+	/// Return the mean of the values recorded, or 0 if none.
+	double mean() const;
+
+	/// Return the value at or below which fraction `p` (0 to 1) of the recorded values are.
+	/// This is the upper bound of the bucket holding that value, but no more than `max()`.
+	uint64_t percentile(double p) const;
+
+	/// Return the bucket a value is counted in.
+	static int bucket(uint64_t value);
+
+	/// Return the largest value counted in a bucket.
+	static uint64_t bucket_max(int bucket);
+
+private:
+	std::atomic<uint64_t> _buckets[BUCKETS];
+	std::atomic<uint64_t> _count;
+	std::atomic<uint64_t> _sum;
+	std::atomic<uint64_t> _max;
+};
+
+} // namespace
+} // namespace
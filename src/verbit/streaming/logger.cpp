@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+namespace verbit {
+namespace streaming {
+
+namespace {
+
+const std::chrono::milliseconds DRAIN_INTERVAL {10};
+const size_t WRITE_BUFFER_SIZE = 64 * 1024;
+
+// room for the time and level prefix, the text and the newline
+const size_t MAX_LINE = 64 + WSSC_LOG_RECORD_TEXT;
+
+} // anonymous namespace
+
+Logger::Logger(const std::string& path, Level level, size_t records) :
+	_level(level),
+	_head(0),
+	_dropped(0),
+	_write_errors(0),
+	_written(0)
+{
+	size_t capacity = 2;
+	while (capacity < records) {
+		capacity <<= 1;
+	}
+	_mask = capacity - 1;
+	_slots.reset(new Slot[capacity]);
+	for (size_t i = 0; i < capacity; i++) {
+		_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (_fd < 0) {
+		throw std::runtime_error(std::string("can't open ") + path + ": " + strerror(errno));
+	}
+	_thread = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger()
+{
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_wake_cv.notify_one();
+	_thread.join();
+	::close(_fd);
+}
+
+bool Logger::log(Level level, const char* tag, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	bool logged = vlog(level, tag, format, args);
+	va_end(args);
+	return logged;
+}
+
+// Claim a slot (or drop the line if the ring is full), format the line into it, and publish it.
+bool Logger::vlog(Level level, const char* tag, const char* format, va_list args)
+{
+	if (!enabled(level)) {
+		return false;
+	}
+	size_t pos = _head.load(std::memory_order_relaxed);
+	Slot* slot;
+	for (;;) {
+		slot = &_slots[pos & _mask];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+		if (diff == 0) {
+			if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		} else {
+			pos = _head.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	slot->level = level;
+	size_t len = 0;
+	if (tag && *tag) {
+		len = std::min(strlen(tag), (size_t)WSSC_LOG_RECORD_TEXT - 3);
+		memcpy(slot->text, tag, len);
+		slot->text[len++] = ':';
+		slot->text[len++] = ' ';
+	}
+	int n = vsnprintf(slot->text + len, WSSC_LOG_RECORD_TEXT - len, format, args);
+	if (n > 0) {
+		len += std::min((size_t)n, WSSC_LOG_RECORD_TEXT - len - 1);
+	}
+	slot->length = len;
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+void Logger::flush()
+{
+	size_t target = _head.load(std::memory_order_acquire);
+	std::unique_lock<std::mutex> lock(_mutex);
+	_wake_cv.notify_one();
+	_written_cv.wait(lock, [this, target]{ return _written.load(std::memory_order_acquire) >= target; });
+}
+
+const char* Logger::level_name(Level level)
+{
+	switch (level) {
+	case debug: return "debug";
+	case info: return "info";
+	case warn: return "warn";
+	case error: return "error";
+	default: return "off";
+	}
+}
+
+// The writer thread: drain the ring every DRAIN_INTERVAL (or when flushed), until stopped and empty.
+void Logger::run()
+{
+	std::unique_ptr<char[]> buffer(new char[WRITE_BUFFER_SIZE]);
+	bool stopping = false;
+	for (;;) {
+		size_t lines = 0;
+		size_t len = drain(buffer.get(), WRITE_BUFFER_SIZE, lines);
+		if (lines > 0) {
+			write_out(buffer.get(), len);
+			_written.fetch_add(lines, std::memory_order_release);
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+			}
+			_written_cv.notify_all();
+			continue;
+		}
+		if (stopping) {
+			break;
+		}
+		std::unique_lock<std::mutex> lock(_mutex);
+		stopping = _stopping;
+		if (!stopping) {
+			_wake_cv.wait_for(lock, DRAIN_INTERVAL);
+		}
+	}
+}
+
+// Format the lines published in the ring into `buffer`, while there is room for a whole line;
+// returns the length, and the number of lines in `lines`.
+size_t Logger::drain(char* buffer, size_t size, size_t& lines)
+{
+	static const char* level_tags[] = {"] [debug] ", "] [info] ", "] [warn] ", "] [error] ", "] [off] "};
+	time_t second = 0;
+	char second_text[32] = {0};
+	size_t second_len = 0;
+
+	size_t len = 0;
+	while (size - len >= MAX_LINE) {
+		Slot& slot = _slots[_tail & _mask];
+		if (slot.sequence.load(std::memory_order_acquire) != _tail + 1) {
+			break;
+		}
+
+		// [YYYY-MM-DD HH:MM:SS.uuuuuu] [level] text
+		time_t now = (time_t)(slot.time_us / 1000000);
+		if ( (second_len == 0) || (now != second) ) {
+			struct tm tm;
+			localtime_r(&now, &tm);
+			second_len = strftime(second_text, sizeof(second_text), "[%Y-%m-%d %H:%M:%S.", &tm);
+			second = now;
+		}
+		memcpy(buffer + len, second_text, second_len);
+		len += second_len;
+		len += snprintf(buffer + len, size - len, "%06u", (unsigned)(slot.time_us % 1000000));
+		const char* level_tag = level_tags[std::min((int)slot.level, (int)off)];
+		size_t level_len = strlen(level_tag);
+		memcpy(buffer + len, level_tag, level_len);
+		len += level_len;
+		memcpy(buffer + len, slot.text, slot.length);
+		len += slot.length;
+		buffer[len++] = '\n';
+
+		slot.sequence.store(_tail + _mask + 1, std::memory_order_release);
+		_tail++;
+		lines++;
+	}
+	return len;
+}
+
+void Logger::write_out(const char* data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = ::write(_fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			_write_errors.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define WSSC_DEFAULT_LOG_RECORDS 4096
+#define WSSC_LOG_RECORD_TEXT 240
+
+/// Log a line with `logger` (a `Logger&`) if `level` is enabled, formatted printf-style;
+/// the arguments are only evaluated, and the line only formatted, if it is.
+///
+/// ```
+/// WSSC_LOG(logger, Logger::debug, "media", "sent %zu bytes", chunk.length());
+/// ```
+#define WSSC_LOG(logger, level, tag, ...) \
+	do { \
+		if ((logger).enabled(level)) { \
+			(logger).log((level), (tag), __VA_ARGS__); \
+		} \
+	} while (0)
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class logging leveled lines to a file, without ever waiting for the disk.
+ *
+ * A line whose level is below the logger's level costs one relaxed atomic load
+ * (with `WSSC_LOG()`, its arguments are not even evaluated). An enabled line is
+ * formatted (printf-style, truncated to `WSSC_LOG_RECORD_TEXT` bytes) straight
+ * into a slot of a fixed-capacity lock-free ring, without heap allocation; a
+ * thread of the logger's own drains the ring (every 10ms), adds the time and
+ * level, and writes the lines to the file. When the ring is full, lines are
+ * dropped (and counted) rather than wait.
+ *
+ * ```
+ * Logger logger {"/var/log/verbit/client.log", Logger::info};
+ * client.logger(&logger);
+ * ```
+ *
+ * Lines may be logged from any number of threads.
+ */
+class Logger
+{
+public:
+	/// The log levels, from the most verbose.
+	enum Level {
+		debug,   ///< details of every message, _e.g._ each response received
+		info,    ///< session events
+		warn,    ///< unexpected conditions the session recovers from
+		error,   ///< failures
+		off      ///< as the logger level: log nothing
+	};
+
+	/// Construct a new logger, appending to a file (created if needed).
+	///
+	/// \param path the file path
+	/// \param level the least level to log
+	/// \param records the ring capacity, in lines (rounded up to a power of two)
+	/// \throws std::runtime_error if the file can't be opened
+	Logger(const std::string& path, Level level = info, size_t records = WSSC_DEFAULT_LOG_RECORDS);
+
+	/// Write out the lines logged so far, and close the file.
+	~Logger();
+
+	/// Return the least level logged.
+	Level level() const { return (Level)_level.load(std::memory_order_relaxed); }
+
+	/// Set the least level logged.
+	void level(Level level) { _level.store(level, std::memory_order_relaxed); }
+
+	/// Return `true` if lines of a level are logged.
+	bool enabled(Level level) const { return (int)level >= _level.load(std::memory_order_relaxed); }
+
+	/// Log a line, formatted printf-style, if its level is enabled.
+	///
+	/// \param level the line level
+	/// \param tag what the line is about, or `nullptr`
+	/// \param format the printf-style format, followed by its arguments
+	/// \return `false` if the line was dropped (or its level is not enabled)
+	bool log(Level level, const char* tag, const char* format, ...) __attribute__((format(printf, 4, 5)));
+
+	/// Log a line, formatted printf-style from a `va_list`, if its level is enabled.
+	bool vlog(Level level, const char* tag, const char* format, va_list args);
+
+	/// Wait until the lines logged so far have been written to the file.
+	void flush();
+
+	/// Return the number of lines logged (not counting those dropped).
+	uint64_t logged() const { return _head.load(std::memory_order_relaxed); }
+
+	/// Return the number of lines dropped because the ring was full.
+	uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+	/// Return the number of failed file writes (their lines are lost).
+	uint64_t write_errors() const { return _write_errors.load(std::memory_order_relaxed); }
+
+	/// Return the name of a level, _e.g._ `"info"`.
+	static const char* level_name(Level level);
+
+private:
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+
+	struct Slot {
+		std::atomic<size_t> sequence;
+		uint64_t time_us;
+		Level level;
+		uint32_t length;
+		char text[WSSC_LOG_RECORD_TEXT];
+	};
+
+	void run();
+	size_t drain(char* buffer, size_t size, size_t& lines);
+	void write_out(const char* data, size_t len);
+
+	std::atomic<int> _level;
+	std::unique_ptr<Slot[]> _slots;
+	size_t _mask;
+	int _fd;
+
+	alignas(64) std::atomic<size_t> _head;     // claimed by the producers
+	alignas(64) size_t _tail = 0;              // drained by the writer thread
+	alignas(64) std::atomic<uint64_t> _dropped;
+	std::atomic<uint64_t> _write_errors;
+	std::atomic<size_t> _written;              // lines written (or lost to an error)
+
+	std::mutex _mutex;
+	std::condition_variable _wake_cv;
+	std::condition_variable _written_cv;
+	bool _stopping = false;
+	std::thread _thread;
+};
+
+} // namespace
+} // namespace
@@ -1,4 +1,7 @@
+#pragma once
+
 #include <iostream>
+#include <string>
 
 namespace verbit {
 namespace streaming {
@@ -13,6 +16,9 @@ struct MediaConfig {
 	int num_channels = 1;          ///< number of channels
 
 	std::string url_params();
+
+	/// Is the media uncompressed PCM (as opposed to encoded, _e.g._ "FLAC" or "OPUS")?
+	bool is_pcm() const { return (format != "FLAC") && (format != "OPUS"); }
 };
 
 } // namespace
@@ -0,0 +1,67 @@
+#include <algorithm>
+
+#include "media_encoder.h"
+#include "flac_codec.h"
+#include "opus_codec.h"
+
+namespace verbit {
+namespace streaming {
+
+std::unique_ptr<MediaDecoder> MediaDecoder::create(const std::string& format, int sample_rate, int channels)
+{
+	if (format == "FLAC") {
+		return std::unique_ptr<MediaDecoder>(new FlacMediaDecoder());
+	}
+#ifdef WITH_OPUS
+	if (format == "OPUS") {
+		return std::unique_ptr<MediaDecoder>(new OpusMediaDecoder(sample_rate, channels));
+	}
+#endif
+	return nullptr;
+}
+
+bool EncodingMediaGenerator::read_chunk(ChunkBuffer& chunk)
+{
+	ChunkBuffer input(_input);
+	bool ok = _source.read_chunk(input);
+	const size_t frame_bytes = _encoder.channels() * sizeof(int16_t);
+	const char* data = input.data();
+	size_t size = input.size();
+	// encode straight into the message payload
+	std::string& encoded = chunk.string();
+
+	// complete a partial frame left from the last chunk
+	if (!_partial.empty()) {
+		size_t head = std::min(frame_bytes - _partial.size(), size);
+		_partial.append(data, head);
+		data += head;
+		size -= head;
+		if (_partial.size() == frame_bytes) {
+			_encoder.encode(_partial.data(), 1, encoded);
+			_partial.clear();
+		}
+	}
+	size_t frames = size / frame_bytes;
+	_encoder.encode(data, frames, encoded);
+	_partial.append(data + frames * frame_bytes, size - frames * frame_bytes);
+	if (ok && _source.finished() && !_flushed) {
+		_encoder.flush(encoded);
+		_partial.clear();
+		_flushed = true;
+	}
+	chunk.commit_string();
+	return ok;
+}
+
+MediaConfig EncodingMediaGenerator::media_config() const
+{
+	MediaConfig config;
+	config.format = _encoder.format();
+	config.sample_rate = _encoder.sample_rate();
+	config.sample_width = 2;
+	config.num_channels = _encoder.channels();
+	return config;
+}
+
+} // namespace
+} // namespace
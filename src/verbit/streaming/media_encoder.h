@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <verbit/streaming/media_config.h>
+#include <verbit/streaming/media_generator.h>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Abstract class for encoders compressing S16LE media into a stream of another format.
+ *
+ * The stream starts with whatever headers the format has, written with the first
+ * output; `flush()` ends it. See `FlacMediaEncoder` and `OpusMediaEncoder`.
+ *
+ * An encoder is not thread-safe.
+ */
+class MediaEncoder
+{
+public:
+	virtual ~MediaEncoder() { }
+
+	/// Encode S16LE frames, which the encoder may hold back until it has a whole block of them.
+	///
+	/// \param in `frames` S16LE frames (need not be aligned)
+	/// \param frames the number of frames
+	/// \param out the encoded stream so far is appended to this
+	virtual void encode(const void* in, size_t frames, std::string& out) = 0;
+
+	/// Encode the frames held back, and end the stream, at the end of the media.
+	///
+	/// \param out the rest of the encoded stream is appended to this
+	virtual void flush(std::string& out) = 0;
+
+	/// Return the format of the stream, for `MediaConfig::format` (_e.g._ "FLAC").
+	virtual std::string format() const = 0;
+
+	/// Return the sample rate, in Hz.
+	int sample_rate() const { return _sample_rate; }
+
+	/// Return the number of channels.
+	int channels() const { return _channels; }
+
+protected:
+	MediaEncoder(int sample_rate, int channels) : _sample_rate(sample_rate), _channels(channels) { }
+
+	int _sample_rate;
+	int _channels;
+
+private:
+	MediaEncoder(const MediaEncoder&) = delete;
+	MediaEncoder& operator=(const MediaEncoder&) = delete;
+};
+
+/**
+ * Abstract class for decoders of a stream written by a `MediaEncoder`, back to S16LE media.
+ *
+ * Decoders take the stream in pieces of any size, as they arrive. Use
+ * `MediaDecoder::create()` to get a decoder for a `MediaConfig::format`.
+ *
+ * A decoder is not thread-safe.
+ */
+class MediaDecoder
+{
+public:
+	virtual ~MediaDecoder() { }
+
+	/// Decode the next piece of the stream.
+	///
+	/// \param data the next bytes of the stream
+	/// \param size the number of bytes
+	/// \param out the S16LE media of the whole blocks (frames, packets) decoded so far is appended to this
+	/// \throws std::runtime_error if the stream is corrupt or not supported
+	virtual void decode(const char* data, size_t size, std::string& out) = 0;
+
+	/// Return a new decoder for a format.
+	///
+	/// \param format the format of the stream (`MediaConfig::format`)
+	/// \param sample_rate the sample rate, in Hz
+	/// \param channels the number of channels
+	/// \return the decoder, or null if the format is not encoded (_e.g._ "S16LE"), or not supported
+	static std::unique_ptr<MediaDecoder> create(const std::string& format, int sample_rate, int channels);
+};
+
+/**
+ * Class for a media generator encoding the S16LE media of another, with a `MediaEncoder`.
+ *
+ * Chain it in front of any media generator delivering S16LE media, and stream with
+ * its `media_config()` (which has the encoder's format):
+ *
+ * ```
+ * FlacMediaEncoder flac {16000};
+ * EncodingMediaGenerator media {capture, flac};
+ * client.async_run_stream(media, media.media_config(), response_types);
+ * ```
+ *
+ * Chunks read from the source need not hold whole frames. When the source finishes,
+ * the encoder is flushed, before this finishes too.
+ */
+class EncodingMediaGenerator : public MediaGenerator
+{
+public:
+	/// Construct a new encoding media generator.
+	///
+	/// \param source the media generator to encode the media of; must outlive this
+	/// \param encoder the encoder, for the source's sample rate and channels; must outlive this
+	EncodingMediaGenerator(MediaGenerator& source, MediaEncoder& encoder) : _source(source), _encoder(encoder) { }
+
+	/// Read the next chunk of the source, and encode it into `chunk`
+	/// (which may stay empty while the encoder fills a block).
+	///
+	/// \return `false` if the source ended unexpectedly
+	bool read_chunk(ChunkBuffer& chunk);
+
+	/// Return the next chunk encoded, with `read_chunk()`.
+	const std::string get_chunk() { return read_chunk_string(); }
+
+	/// Has the source finished, and the encoder been flushed?
+	bool finished() { return _flushed && _source.finished(); }
+
+	/// Return the source's event descriptor.
+	int event_fd() { return _source.event_fd(); }
+
+	/// Return the media configuration of the encoded media.
+	MediaConfig media_config() const;
+
+	/// Return the encoder.
+	MediaEncoder& encoder() { return _encoder; }
+
+private:
+	EncodingMediaGenerator(const EncodingMediaGenerator&) = delete;
+	EncodingMediaGenerator& operator=(const EncodingMediaGenerator&) = delete;
+
+	MediaGenerator& _source;
+	MediaEncoder& _encoder;
+	std::string _input;
+	std::string _partial;
+	bool _flushed = false;
+};
+
+} // namespace
+} // namespace
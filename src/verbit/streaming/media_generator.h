@@ -2,6 +2,8 @@
 
 #include <string>
 
+#include <verbit/streaming/chunk_buffer.h>
+
 namespace verbit {
 namespace streaming {
 
@@ -11,6 +13,8 @@ namespace streaming {
 class MediaGenerator
 {
 public:
+	/// Returned by `get_chunk()` if the media source ended unexpectedly.
+	/// (`read_chunk()` reports this out-of-band, by returning `false`.)
 	static constexpr const char* END_OF_FILE = "end of file";
 
 	virtual ~MediaGenerator() {}
@@ -24,15 +28,67 @@ public:
 	/// To avoid high CPU load, it is expected to either:
 	/// 1. Block until more media bytes are available.
 	/// 2. Wait a short while (_e.g._ 100ms) before returning empty.
+	///
+	/// The client reads media with `read_chunk()` instead, whose default implementation
+	/// calls this. A media generator implementing `read_chunk()` can implement this
+	/// with `read_chunk_string()`.
 	virtual const std::string get_chunk() = 0;
 
+	/// Read the next chunk of media bytes into a buffer lent by the caller.
+	///
+	/// The buffer's storage is the outgoing WebSocket message, so a media generator that
+	/// writes its media directly into `chunk` (see `ChunkBuffer::prepare()`) avoids copying it.
+	/// If there are no media bytes waiting, leaves `chunk` empty. The same blocking rules
+	/// apply as for `get_chunk()`.
+	///
+	/// The default implementation calls `get_chunk()` and copies the result.
+	///
+	/// \return `false` if the media source ended unexpectedly (see `END_OF_FILE`)
+	virtual bool read_chunk(ChunkBuffer& chunk);
+
 	/// Has all media now been sent?
 	///
 	/// **NOTE** When this method returns `true`, the caller will
 	/// send the end-of-stream event. This will close out the
 	/// Verbit order, after which no more media may be sent.
 	virtual bool finished() = 0;
+
+	/// Return a file descriptor that is readable while media may be available, or -1.
+	///
+	/// If a media generator returns a valid descriptor, the client waits on it from its
+	/// I/O threads instead of calling `read_chunk()` in a loop on a media thread. In that case
+	/// `read_chunk()` must never block, and the descriptor must also become readable when
+	/// `finished()` becomes `true`. The default is -1 (pull from a media thread).
+	virtual int event_fd() { return -1; }
+
+protected:
+	/// Return the next chunk from `read_chunk()` as `get_chunk()` would, _i.e._ `END_OF_FILE`
+	/// if the media source ended unexpectedly. For a media generator implementing `read_chunk()`:
+	/// `const std::string get_chunk() { return read_chunk_string(); }`
+	const std::string read_chunk_string();
 };
 
+inline const std::string MediaGenerator::read_chunk_string()
+{
+	std::string storage;
+	{
+		ChunkBuffer chunk(storage);
+		if (!read_chunk(chunk)) {
+			return END_OF_FILE;
+		}
+	}
+	return storage;
+}
+
+inline bool MediaGenerator::read_chunk(ChunkBuffer& chunk)
+{
+	const std::string data = get_chunk();
+	if (data == END_OF_FILE) {
+		return false;
+	}
+	chunk.append(data.data(), data.length());
+	return true;
+}
+
 } // namespace
 } // namespace
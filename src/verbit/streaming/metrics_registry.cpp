@@ -0,0 +1,366 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metrics_registry.h"
+
+namespace verbit {
+namespace streaming {
+
+namespace {
+
+const char* PREFIX = "verbit_streaming_";
+const size_t MAX_REQUEST = 8192;
+const int SOCKET_TIMEOUT_SECONDS = 1;
+
+void _header(std::string& out, const char* name, const char* type, const char* help)
+{
+	out.append("# HELP ").append(PREFIX).append(name).append(" ").append(help).append("\n");
+	out.append("# TYPE ").append(PREFIX).append(name).append(" ").append(type).append("\n");
+}
+
+void _sample(std::string& out, const char* name, const char* suffix, const char* labels, double value)
+{
+	char text[64];
+	snprintf(text, sizeof(text), " %.9g\n", value);
+	out.append(PREFIX).append(name).append(suffix);
+	if (labels) {
+		out.append("{").append(labels).append("}");
+	}
+	out.append(text);
+}
+
+void _counter(std::string& out, const char* name, const char* help, uint64_t value)
+{
+	_header(out, name, "counter", help);
+	_sample(out, name, "", nullptr, (double)value);
+}
+
+// a histogram as a summary: p50, p90, p95, p99 and max (quantile 1), scaled (_e.g._ microseconds to seconds)
+void _summary(std::string& out, const char* name, const char* help, const Histogram& histogram, double scale)
+{
+	static const char* quantiles[] = {"0.5", "0.9", "0.95", "0.99", "1"};
+	_header(out, name, "summary", help);
+	for (const char* quantile : quantiles) {
+		std::string labels = std::string("quantile=\"") + quantile + "\"";
+		_sample(out, name, "", labels.c_str(), histogram.percentile(atof(quantile)) * scale);
+	}
+	_sample(out, name, "_sum", nullptr, histogram.sum() * scale);
+	_sample(out, name, "_count", nullptr, (double)histogram.count());
+}
+
+// write all of `data`, returning `false` on error (or timeout)
+bool _write_all(int fd, const char* data, size_t len)
+{
+	while (len > 0) {
+		ssize_t n = ::write(fd, data, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+MetricsRegistry::MetricsRegistry() :
+	_export_errors(0)
+{
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+	if (_thread.joinable()) {
+		{
+			std::unique_lock<std::mutex> lock(_export_mutex);
+			_stopping = true;
+		}
+		wake();
+		_thread.join();
+	}
+	if (_listen_fd >= 0) {
+		::close(_listen_fd);
+		::unlink(_socket_path.c_str());
+	}
+	if (_wake_fd >= 0) {
+		::close(_wake_fd);
+	}
+}
+
+uint64_t MetricsRegistry::add(Source source)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	uint64_t id = _next_id++;
+	_sources[id] = source;
+	return id;
+}
+
+void MetricsRegistry::remove(uint64_t id)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	std::map<uint64_t, Source>::iterator it = _sources.find(id);
+	if (it == _sources.end()) {
+		return;
+	}
+	_removed.merge(it->second());
+	_sources.erase(it);
+}
+
+SessionMetrics MetricsRegistry::snapshot()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	SessionMetrics total = _removed;
+	for (auto& source : _sources) {
+		total.merge(source.second());
+	}
+	return total;
+}
+
+size_t MetricsRegistry::sessions()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _sources.size();
+}
+
+uint64_t MetricsRegistry::sessions_total()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _next_id;
+}
+
+std::string MetricsRegistry::prometheus()
+{
+	size_t active;
+	uint64_t total;
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		active = _sources.size();
+		total = _next_id;
+	}
+	SessionMetrics metrics = snapshot();
+
+	std::string out;
+	out.reserve(4096);
+	_header(out, "sessions", "gauge", "Sessions currently running.");
+	_sample(out, "sessions", "", nullptr, (double)active);
+	_counter(out, "sessions_total", "Sessions started.", total);
+	_counter(out, "media_bytes_sent_total", "Media bytes sent.", metrics.bytes_sent.value());
+	_counter(out, "media_frames_sent_total", "Media messages sent.", metrics.frames_sent.value());
+	_counter(out, "media_send_errors_total", "Media sends which failed.", metrics.send_errors.value());
+	_counter(out, "media_bytes_gated_total", "Media bytes of silence not sent.", metrics.bytes_gated.value());
+	_summary(out, "media_send_seconds", "Time taken by each media send call.", metrics.send_latency, 1e-6);
+	_summary(out, "send_buffered_bytes", "Send queue size, sampled before each media read.", metrics.buffered_amount, 1);
+	_header(out, "responses_total", "counter", "Responses received, by type.");
+	for (int kind = 0; kind < SessionMetrics::response_kinds; kind++) {
+		std::string labels = std::string("type=\"") + SessionMetrics::response_kind_name((SessionMetrics::ResponseKind)kind) + "\"";
+		_sample(out, "responses_total", "", labels.c_str(), (double)metrics.responses[kind].value());
+	}
+	_summary(out, "response_parse_seconds", "Time taken to parse each response.", metrics.parse_time, 1e-6);
+	_summary(out, "response_handler_seconds", "Time taken by the response handlers for each response.", metrics.handler_time, 1e-6);
+	_summary(out, "response_latency_seconds", "Time from sending the audio up to the end of each response, until it arrived.",
+		metrics.emission_latency, 1e-6);
+	_counter(out, "pings_total", "Pings received.", metrics.pings.value());
+	_counter(out, "connect_attempts_total", "WebSocket connect attempts.", metrics.connect_attempts.value());
+	_counter(out, "reconnects_total", "Reconnects after an unexpected close.", metrics.reconnects.value());
+	_header(out, "state_seconds_total", "counter", "Time spent in each session state.");
+	for (int state = ServiceState::state_opening; state < SessionMetrics::STATES; state++) {
+		std::string labels = std::string("state=\"") + ServiceState::name(state) + "\"";
+		_sample(out, "state_seconds_total", "", labels.c_str(), metrics.time_in_state[state].count() * 1e-6);
+	}
+	return out;
+}
+
+void MetricsRegistry::write_prometheus(const std::string& path)
+{
+	std::string text = prometheus();
+	std::string temp_path = path + ".tmp";
+	std::ofstream out(temp_path, std::ios::trunc);
+	if (!out) {
+		throw std::runtime_error(std::string("can't open ") + temp_path + ": " + strerror(errno));
+	}
+	out.write(text.data(), text.length());
+	out.close();
+	if (!out) {
+		::unlink(temp_path.c_str());
+		throw std::runtime_error(std::string("can't write ") + temp_path);
+	}
+	if (::rename(temp_path.c_str(), path.c_str()) != 0) {
+		int err = errno;
+		::unlink(temp_path.c_str());
+		throw std::runtime_error(std::string("can't rename ") + temp_path + ": " + strerror(err));
+	}
+}
+
+void MetricsRegistry::export_file(const std::string& path, std::chrono::milliseconds interval)
+{
+	{
+		std::unique_lock<std::mutex> lock(_export_mutex);
+		_file_path = path;
+		_interval = std::max(interval, std::chrono::milliseconds(1));
+		start_thread();
+	}
+	wake();
+}
+
+void MetricsRegistry::listen(const std::string& path)
+{
+	{
+		std::unique_lock<std::mutex> lock(_export_mutex);
+		if (_listen_fd >= 0) {
+			throw std::runtime_error("already listening on " + _socket_path);
+		}
+	}
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (path.length() >= sizeof(addr.sun_path)) {
+		throw std::runtime_error("socket path too long: " + path);
+	}
+	memcpy(addr.sun_path, path.data(), path.length());
+
+	int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		throw std::runtime_error(std::string("can't create socket: ") + strerror(errno));
+	}
+	::unlink(path.c_str());
+	if ( (::bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) || (::listen(fd, 16) != 0) ) {
+		int err = errno;
+		::close(fd);
+		throw std::runtime_error(std::string("can't listen on ") + path + ": " + strerror(err));
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_export_mutex);
+		_listen_fd = fd;
+		_socket_path = path;
+		start_thread();
+	}
+	wake();
+}
+
+// Start the export thread, if not yet started; called with `_export_mutex` held.
+void MetricsRegistry::start_thread()
+{
+	if (_thread.joinable()) {
+		return;
+	}
+	_wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_wake_fd < 0) {
+		throw std::runtime_error(std::string("can't create eventfd: ") + strerror(errno));
+	}
+	_thread = std::thread(&MetricsRegistry::run, this);
+}
+
+void MetricsRegistry::wake()
+{
+	uint64_t one = 1;
+	if (::write(_wake_fd, &one, sizeof(one)) < 0) {
+		// already readable (the counter can't overflow in practice)
+	}
+}
+
+// The export thread: write the file every interval, and serve connections to the socket,
+// until stopped. Nothing here touches the sessions except through `prometheus()`.
+void MetricsRegistry::run()
+{
+	std::chrono::steady_clock::time_point next_write;
+	for (;;) {
+		std::string file_path;
+		std::chrono::milliseconds interval;
+		int listen_fd;
+		{
+			std::unique_lock<std::mutex> lock(_export_mutex);
+			if (_stopping) {
+				break;
+			}
+			file_path = _file_path;
+			interval = _interval;
+			listen_fd = _listen_fd;
+		}
+
+		int timeout = -1;
+		if (!file_path.empty()) {
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (now >= next_write) {
+				try {
+					write_prometheus(file_path);
+				} catch (const std::runtime_error&) {
+					_export_errors.fetch_add(1, std::memory_order_relaxed);
+				}
+				next_write = now + interval;
+			}
+			timeout = std::chrono::duration_cast<std::chrono::milliseconds>(next_write - now).count() + 1;
+		}
+
+		struct pollfd fds[2];
+		fds[0].fd = _wake_fd;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		fds[1].fd = listen_fd;
+		fds[1].events = POLLIN;
+		fds[1].revents = 0;
+		if (::poll(fds, (listen_fd >= 0) ? 2 : 1, timeout) <= 0) {
+			continue;
+		}
+		if (fds[0].revents & POLLIN) {
+			uint64_t value;
+			if (::read(_wake_fd, &value, sizeof(value)) < 0) {
+				// reset by an earlier read
+			}
+			continue;  // the settings may have changed
+		}
+		if (fds[1].revents & POLLIN) {
+			int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+			if (fd >= 0) {
+				serve(fd);
+				::close(fd);
+			}
+		}
+	}
+}
+
+// Serve one connection: read the request (up to its blank line), whatever it is, and
+// answer with the metrics. A client which sends nothing gets them after the timeout.
+void MetricsRegistry::serve(int fd)
+{
+	struct timeval timeout = {SOCKET_TIMEOUT_SECONDS, 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	std::string request;
+	char buffer[1024];
+	while ( (request.length() < MAX_REQUEST) && (request.find("\r\n\r\n") == std::string::npos) ) {
+		ssize_t n = ::read(fd, buffer, sizeof(buffer));
+		if ( (n < 0) && (errno == EINTR) ) {
+			continue;
+		}
+		if (n <= 0) {
+			break;
+		}
+		request.append(buffer, n);
+	}
+
+	std::string body = prometheus();
+	std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+		+ std::to_string(body.length()) + "\r\nConnection: close\r\n\r\n" + body;
+	if (!_write_all(fd, response.data(), response.length())) {
+		_export_errors.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <verbit/streaming/session_metrics.h>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class collecting the metrics of the sessions in a process, for process-wide
+ * totals and Prometheus export.
+ *
+ * Clients given a registry (`WebSocketStreamingClient::metrics_registry()`) add
+ * themselves when their stream starts, and fold their final metrics into the
+ * totals when destroyed. Sessions update their own metrics; the registry only
+ * reads them when a snapshot is taken, so it costs the sessions nothing.
+ *
+ * ```
+ * MetricsRegistry registry;
+ * registry.export_file("/var/lib/node_exporter/verbit.prom", std::chrono::seconds(15));
+ * registry.listen("/run/verbit/metrics.sock");  // curl --unix-socket /run/verbit/metrics.sock http://localhost/metrics
+ * client.metrics_registry(&registry);
+ * ```
+ *
+ * The registry must outlive its clients.
+ */
+class MetricsRegistry
+{
+public:
+	/// A function returning a snapshot of a session's metrics.
+	typedef std::function<SessionMetrics()> Source;
+
+	/// Construct a new, empty registry.
+	MetricsRegistry();
+
+	/// Stop exporting.
+	~MetricsRegistry();
+
+	/// Add a session.
+	///
+	/// \param source returns a snapshot of the session's metrics; called from any thread, until removed
+	/// \return the session's id in the registry
+	uint64_t add(Source source);
+
+	/// Remove a session, adding its final metrics to the totals.
+	///
+	/// \param id the session's id, from `add()`
+	void remove(uint64_t id);
+
+	/// Return the totals of all sessions, current and removed.
+	SessionMetrics snapshot();
+
+	/// Return the number of sessions currently added.
+	size_t sessions();
+
+	/// Return the number of sessions added so far.
+	uint64_t sessions_total();
+
+	/// Return the totals in the Prometheus text exposition format.
+	std::string prometheus();
+
+	/// Write the totals in the Prometheus text format to a file, replacing it atomically
+	/// (by writing a temporary file alongside and renaming it).
+	///
+	/// \param path the file path
+	/// \throws std::runtime_error if the file can't be written
+	void write_prometheus(const std::string& path);
+
+	/// Write the totals to a file periodically, with `write_prometheus()`, on a thread of the
+	/// registry's own (_e.g._ for the node exporter's textfile collector). Write failures are
+	/// counted in `export_errors()`.
+	///
+	/// \param path the file path
+	/// \param interval how often to write the file
+	void export_file(const std::string& path, std::chrono::milliseconds interval);
+
+	/// Serve the totals in the Prometheus text format on a Unix socket, on a thread of the
+	/// registry's own. Each connection gets one HTTP/1.0 response (whatever it asked for),
+	/// and is closed. A socket file already at `path` is replaced, and removed when the
+	/// registry is destroyed.
+	///
+	/// \param path the socket path
+	/// \throws std::runtime_error if the socket can't be created, or the registry is already listening
+	void listen(const std::string& path);
+
+	/// Return the number of failed exports (file writes, or connections not served).
+	uint64_t export_errors() { return _export_errors.load(std::memory_order_relaxed); }
+
+private:
+	MetricsRegistry(const MetricsRegistry&) = delete;
+	MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+	void start_thread();
+	void wake();
+	void run();
+	void serve(int fd);
+
+	std::mutex _mutex;
+	std::map<uint64_t, Source> _sources;
+	SessionMetrics _removed;
+	uint64_t _next_id = 0;
+
+	std::mutex _export_mutex;
+	std::string _file_path;
+	std::chrono::milliseconds _interval {0};
+	std::string _socket_path;
+	int _listen_fd = -1;
+	int _wake_fd = -1;
+	bool _stopping = false;
+	std::thread _thread;
+	std::atomic<uint64_t> _export_errors;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "ogg_stream.h"
+
+namespace verbit {
+namespace streaming {
+
+namespace {
+
+const size_t HEADER_SIZE = 27;
+const uint8_t CONTINUED = 0x01;
+const uint8_t BOS = 0x02;
+const uint8_t EOS = 0x04;
+const uint64_t NO_GRANULE = ~(uint64_t)0;
+
+// the Ogg CRC-32 (polynomial 0x04c11db7, not reflected, initially 0)
+uint32_t ogg_crc(const char* data, size_t size)
+{
+	static uint32_t table[256];
+	static bool ready = false;
+	if (!ready) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t crc = i << 24;
+			for (int bit = 0; bit < 8; bit++) {
+				crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04c11db7u : crc << 1;
+			}
+			table[i] = crc;
+		}
+		ready = true;
+	}
+	uint32_t crc = 0;
+	for (size_t i = 0; i < size; i++) {
+		crc = (crc << 8) ^ table[(crc >> 24) ^ (uint8_t)data[i]];
+	}
+	return crc;
+}
+
+void put_le(std::string& out, uint64_t value, int bytes)
+{
+	for (int i = 0; i < bytes; i++) {
+		out.push_back((char)(value >> (8 * i)));
+	}
+}
+
+uint64_t get_le(const char* data, int bytes)
+{
+	uint64_t value = 0;
+	for (int i = bytes - 1; i >= 0; i--) {
+		value = (value << 8) | (uint8_t)data[i];
+	}
+	return value;
+}
+
+} // anonymous namespace
+
+void OggPageWriter::packet(const void* data, size_t size, uint64_t granule)
+{
+	_data.append(static_cast<const char*>(data), size);
+	// a packet is 255-byte lacing values, ended by one below 255 (0 if need be)
+	for (size_t left = size; ; left -= 255) {
+		_lacing.push_back((uint8_t)std::min(left, (size_t)255));
+		_granules.push_back((left < 255) ? granule : NO_GRANULE);
+		if (left < 255) {
+			break;
+		}
+	}
+}
+
+void OggPageWriter::flush(std::string& out, bool eos)
+{
+	if (_lacing.empty() && !eos) {
+		return;
+	}
+	size_t done = 0;
+	size_t data_done = 0;
+	bool continued = false;
+	do {
+		size_t segments = std::min(_lacing.size() - done, (size_t)255);
+		size_t data_size = 0;
+		uint64_t granule = NO_GRANULE;
+		for (size_t i = done; i < done + segments; i++) {
+			data_size += _lacing[i];
+			if (_granules[i] != NO_GRANULE) {
+				granule = _granules[i];
+			}
+		}
+		bool last = (done + segments == _lacing.size());
+		size_t start = out.size();
+		page(out, segments, granule, continued, eos && last);
+		out.append(_lacing.data() + done, _lacing.data() + done + segments);
+		out.append(_data, data_done, data_size);
+		uint32_t crc = ogg_crc(&out[start], out.size() - start);
+		for (int i = 0; i < 4; i++) {
+			out[start + 22 + i] = (char)(crc >> (8 * i));
+		}
+		continued = (segments > 0) && (_lacing[done + segments - 1] == 255);
+		done += segments;
+		data_done += data_size;
+	} while (done < _lacing.size());
+	_data.clear();
+	_lacing.clear();
+	_granules.clear();
+}
+
+// Write a page header, with a zero CRC (set once the page is written).
+void OggPageWriter::page(std::string& out, size_t segments, uint64_t granule, bool continued, bool eos)
+{
+	out.append("OggS", 4);
+	out.push_back(0);  // version
+	out.push_back((char)((continued ? CONTINUED : 0) | ((_sequence == 0) ? BOS : 0) | (eos ? EOS : 0)));
+	put_le(out, granule, 8);
+	put_le(out, _serial, 4);
+	put_le(out, _sequence++, 4);
+	put_le(out, 0, 4);
+	out.push_back((char)segments);
+}
+
+void OggPacketReader::append(const char* data, size_t size)
+{
+	_buffer.append(data, size);
+	size_t pos = 0;
+	while (_buffer.size() >= pos + 4) {
+		const char* header = &_buffer[pos];
+		if (memcmp(header, "OggS", 4) != 0) {
+			throw std::runtime_error("Ogg page sync lost");
+		}
+		if (_buffer.size() < pos + HEADER_SIZE) {
+			break;
+		}
+		size_t segments = (uint8_t)header[26];
+		if (_buffer.size() < pos + HEADER_SIZE + segments) {
+			break;
+		}
+		size_t data_size = 0;
+		for (size_t i = 0; i < segments; i++) {
+			data_size += (uint8_t)header[HEADER_SIZE + i];
+		}
+		size_t page_size = HEADER_SIZE + segments + data_size;
+		if (_buffer.size() < pos + page_size) {
+			break;
+		}
+		uint32_t crc = (uint32_t)get_le(header + 22, 4);
+		memset(&_buffer[pos + 22], 0, 4);
+		if (ogg_crc(&_buffer[pos], page_size) != crc) {
+			throw std::runtime_error("Ogg page CRC mismatch");
+		}
+
+		uint8_t flags = (uint8_t)header[5];
+		uint64_t granule = get_le(header + 6, 8);
+		if (!(flags & CONTINUED)) {
+			_partial.clear();
+		}
+		const char* body = header + HEADER_SIZE + segments;
+		size_t last_packet = _packets.size();
+		for (size_t i = 0; i < segments; i++) {
+			uint8_t lacing = (uint8_t)header[HEADER_SIZE + i];
+			_partial.append(body, lacing);
+			body += lacing;
+			if (lacing < 255) {
+				last_packet = _packets.size();
+				_packets.push_back(Packet {_partial, granule, false});
+				_partial.clear();
+			}
+		}
+		if (flags & EOS) {
+			_eos = true;
+			if (last_packet < _packets.size()) {
+				_packets[last_packet].eos = true;
+			}
+		}
+		pos += page_size;
+	}
+	_buffer.erase(0, pos);
+}
+
+bool OggPacketReader::next(std::string& packet, uint64_t& granule, bool& eos)
+{
+	if (_packets.empty()) {
+		return false;
+	}
+	packet.swap(_packets.front().data);
+	granule = _packets.front().granule;
+	eos = _packets.front().eos;
+	_packets.pop_front();
+	return true;
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class framing packets into Ogg pages (RFC 3533), for one logical stream.
+ *
+ * Packets are queued with `packet()`, and written out as pages by `flush()`: one
+ * page (or more, for over 255 lacing values) for all the packets queued, so the
+ * caller picks the trade-off between page overhead and latency.
+ */
+class OggPageWriter
+{
+public:
+	/// Construct a new page writer.
+	///
+	/// \param serial the stream's serial number
+	explicit OggPageWriter(uint32_t serial) : _serial(serial) { }
+
+	/// Queue a packet for the next page.
+	///
+	/// \param data the packet
+	/// \param size the packet's size
+	/// \param granule the granule position at the end of the packet
+	void packet(const void* data, size_t size, uint64_t granule);
+
+	/// Write the packets queued as pages (the first page of the stream is marked as such);
+	/// nothing is written if no packets are queued, unless it is the end of the stream.
+	///
+	/// \param out the pages are appended to this
+	/// \param eos mark the (last) page as the end of the stream, even if no packets are queued
+	void flush(std::string& out, bool eos = false);
+
+private:
+	void page(std::string& out, size_t segments, uint64_t granule, bool continued, bool eos);
+
+	uint32_t _serial;
+	uint32_t _sequence = 0;
+	std::string _data;             // the packets queued
+	std::vector<uint8_t> _lacing;
+	std::vector<uint64_t> _granules;  // per lacing value: of the packet it ends, or ~0
+};
+
+/**
+ * Class reading the packets of an Ogg stream, from pieces of any size.
+ *
+ * Pages are checked against their CRC. Only one logical stream is expected.
+ */
+class OggPacketReader
+{
+public:
+	/// Add the next piece of the stream.
+	///
+	/// \throws std::runtime_error if a page is corrupt
+	void append(const char* data, size_t size);
+
+	/// Take the next whole packet, if any.
+	///
+	/// \param packet set to the packet
+	/// \param granule set to the granule position of the page the packet ends on
+	/// \param eos set to whether it is the last packet of the stream
+	/// \return `false` if there is no whole packet yet
+	bool next(std::string& packet, uint64_t& granule, bool& eos);
+
+	/// Has the end of the stream been read (even on a page without packets)?
+	bool eos() const { return _eos; }
+
+private:
+	struct Packet {
+		std::string data;
+		uint64_t granule;
+		bool eos;
+	};
+
+	std::string _buffer;
+	std::string _partial;
+	std::deque<Packet> _packets;
+	bool _eos = false;
+};
+
+} // namespace
+} // namespace
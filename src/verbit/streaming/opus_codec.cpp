@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef WITH_OPUS
+#include <opus/opus.h>
+#endif
+
+#include "opus_codec.h"
+
+namespace verbit {
+namespace streaming {
+
+#ifdef WITH_OPUS
+
+namespace {
+
+const int MAX_PACKET = 1275 * 3 + 7;   // the largest packet of up to 60ms
+const int MAX_FRAME = 5760;            // 120ms at 48kHz, the longest packet decoded
+
+int granule_scale(int sample_rate)
+{
+	switch (sample_rate) {
+	case 8000: case 12000: case 16000: case 24000: case 48000:
+		return 48000 / sample_rate;
+	default:
+		throw std::runtime_error("Opus does not support a sample rate of " + std::to_string(sample_rate));
+	}
+}
+
+void check_channels(int channels)
+{
+	if ( (channels < 1) || (channels > 2) ) {
+		throw std::runtime_error("Opus supports 1 or 2 channels, not " + std::to_string(channels));
+	}
+}
+
+void put_le(std::string& out, uint32_t value, int bytes)
+{
+	for (int i = 0; i < bytes; i++) {
+		out.push_back((char)(value >> (8 * i)));
+	}
+}
+
+} // anonymous namespace
+
+OpusMediaEncoder::OpusMediaEncoder(int sample_rate, int channels, int bitrate, std::chrono::milliseconds frame) :
+	MediaEncoder(sample_rate, channels),
+	_encoder(nullptr),
+	_ogg(0x56424954u),  // "VBIT"
+	_granule_scale(granule_scale(sample_rate))
+{
+	check_channels(channels);
+	long ms = (long)frame.count();
+	if ( (ms != 10) && (ms != 20) && (ms != 40) && (ms != 60) ) {
+		throw std::runtime_error("Opus frame duration must be 10, 20, 40 or 60ms");
+	}
+	_frame_size = (size_t)(sample_rate / 1000 * ms);
+	int error = OPUS_OK;
+	_encoder = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &error);
+	if (error != OPUS_OK) {
+		throw std::runtime_error(std::string("failed to create Opus encoder: ") + opus_strerror(error));
+	}
+	opus_encoder_ctl(_encoder, OPUS_SET_BITRATE(bitrate));
+	opus_encoder_ctl(_encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+	opus_int32 lookahead = 0;
+	opus_encoder_ctl(_encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+	_pre_skip = lookahead * _granule_scale;
+	_pcm.resize(_frame_size * channels);
+	_packet.resize(MAX_PACKET);
+}
+
+OpusMediaEncoder::~OpusMediaEncoder()
+{
+	opus_encoder_destroy(_encoder);
+}
+
+// Write the identification (RFC 7845 section 5.1) and comment headers, each on its own page.
+void OpusMediaEncoder::write_headers(std::string& out)
+{
+	std::string head("OpusHead", 8);
+	head.push_back(1);  // version
+	head.push_back((char)_channels);
+	put_le(head, (uint32_t)_pre_skip, 2);
+	put_le(head, (uint32_t)_sample_rate, 4);
+	put_le(head, 0, 2);  // output gain
+	head.push_back(0);   // channel mapping family
+	_ogg.packet(head.data(), head.size(), 0);
+	_ogg.flush(out);
+
+	const char* vendor = opus_get_version_string();
+	std::string tags("OpusTags", 8);
+	put_le(tags, (uint32_t)strlen(vendor), 4);
+	tags.append(vendor);
+	put_le(tags, 0, 4);  // no user comments
+	_ogg.packet(tags.data(), tags.size(), 0);
+	_ogg.flush(out);
+	_headers_written = true;
+}
+
+void OpusMediaEncoder::encode_frame(const int16_t* pcm, uint64_t end)
+{
+	opus_int32 size = opus_encode(_encoder, pcm, (int)_frame_size, _packet.data(), (opus_int32)_packet.size());
+	if (size < 0) {
+		throw std::runtime_error(std::string("Opus encoding failed: ") + opus_strerror(size));
+	}
+	_granule += _frame_size * _granule_scale;
+	_ogg.packet(_packet.data(), (size_t)size, std::min(_granule, end));
+}
+
+void OpusMediaEncoder::encode(const void* in, size_t frames, std::string& out)
+{
+	if (!_headers_written) {
+		write_headers(out);
+	}
+	const int16_t* pcm = static_cast<const int16_t*>(in);
+	_frames_in += frames;
+	while (frames > 0) {
+		size_t take = std::min(frames, _frame_size - _fill);
+		memcpy(&_pcm[_fill * _channels], pcm, take * _channels * sizeof(int16_t));
+		_fill += take;
+		pcm += take * _channels;
+		frames -= take;
+		if (_fill == _frame_size) {
+			encode_frame(_pcm.data(), ~(uint64_t)0);
+			_fill = 0;
+		}
+	}
+	_ogg.flush(out);
+}
+
+void OpusMediaEncoder::flush(std::string& out)
+{
+	if (!_headers_written) {
+		write_headers(out);
+	}
+	// pad with silence until the frames held back by the encoder's delay are out too;
+	// the end granule position trims the padding (RFC 7845 section 4.4)
+	uint64_t end = _pre_skip + _frames_in * _granule_scale;
+	while ( (_fill > 0) || (_granule < end) ) {
+		std::fill(_pcm.begin() + _fill * _channels, _pcm.end(), 0);
+		encode_frame(_pcm.data(), end);
+		_fill = 0;
+	}
+	_ogg.flush(out, true);
+}
+
+OpusMediaDecoder::OpusMediaDecoder(int sample_rate, int channels) :
+	_decoder(nullptr),
+	_sample_rate(sample_rate),
+	_channels(channels),
+	_granule_scale(granule_scale(sample_rate))
+{
+	check_channels(channels);
+	int error = OPUS_OK;
+	_decoder = opus_decoder_create(sample_rate, channels, &error);
+	if (error != OPUS_OK) {
+		throw std::runtime_error(std::string("failed to create Opus decoder: ") + opus_strerror(error));
+	}
+	_pcm.resize((size_t)MAX_FRAME / _granule_scale * channels);
+}
+
+OpusMediaDecoder::~OpusMediaDecoder()
+{
+	opus_decoder_destroy(_decoder);
+}
+
+void OpusMediaDecoder::decode(const char* data, size_t size, std::string& out)
+{
+	_ogg.append(data, size);
+	std::string packet;
+	uint64_t granule;
+	bool eos;
+	while (_ogg.next(packet, granule, eos)) {
+		if (_packets++ == 0) {
+			if ( (packet.size() < 19) || (memcmp(packet.data(), "OpusHead", 8) != 0) ) {
+				throw std::runtime_error("Opus stream has no OpusHead header");
+			}
+			uint32_t pre_skip = (uint8_t)packet[10] | ((uint8_t)packet[11] << 8);
+			_skip = pre_skip / _granule_scale;
+			_granule = 0;
+			continue;
+		}
+		if (_packets == 2) {
+			continue;  // OpusTags
+		}
+		int frames = opus_decode(_decoder, (const unsigned char*)packet.data(), (opus_int32)packet.size(),
+			_pcm.data(), (int)(_pcm.size() / _channels), 0);
+		if (frames < 0) {
+			throw std::runtime_error(std::string("Opus decoding failed: ") + opus_strerror(frames));
+		}
+		uint64_t first = _granule;
+		_granule += (uint64_t)frames * _granule_scale;
+		uint64_t keep = frames;
+		if (eos && (granule < _granule)) {
+			// end trimming
+			uint64_t trim = (_granule - std::max(granule, first)) / _granule_scale;
+			keep -= std::min(keep, trim);
+		}
+		uint64_t skip = std::min(_skip, keep);
+		_skip -= skip;
+		out.append((const char*)&_pcm[skip * _channels], (keep - skip) * _channels * sizeof(int16_t));
+	}
+}
+
+#else // WITH_OPUS
+
+// without libopus, the classes are there, but can't be constructed
+
+namespace {
+
+const char* NOT_BUILT = "Opus is not supported: not built with WITH_OPUS";
+
+} // anonymous namespace
+
+OpusMediaEncoder::OpusMediaEncoder(int sample_rate, int channels, int bitrate, std::chrono::milliseconds frame) :
+	MediaEncoder(sample_rate, channels),
+	_encoder(nullptr),
+	_ogg(0)
+{
+	throw std::runtime_error(NOT_BUILT);
+}
+
+OpusMediaEncoder::~OpusMediaEncoder()
+{
+}
+
+void OpusMediaEncoder::encode(const void* in, size_t frames, std::string& out)
+{
+}
+
+void OpusMediaEncoder::flush(std::string& out)
+{
+}
+
+OpusMediaDecoder::OpusMediaDecoder(int sample_rate, int channels) :
+	_decoder(nullptr),
+	_sample_rate(sample_rate),
+	_channels(channels),
+	_granule_scale(1)
+{
+	throw std::runtime_error(NOT_BUILT);
+}
+
+OpusMediaDecoder::~OpusMediaDecoder()
+{
+}
+
+void OpusMediaDecoder::decode(const char* data, size_t size, std::string& out)
+{
+}
+
+#endif // WITH_OPUS
+
+} // namespace
+} // namespace
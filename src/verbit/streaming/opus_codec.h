@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <verbit/streaming/media_encoder.h>
+#include <verbit/streaming/ogg_stream.h>
+
+#define WSSC_OPUS_BITRATE 24000
+#define WSSC_OPUS_FRAME_MS 20
+
+struct OpusEncoder;
+struct OpusDecoder;
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class encoding S16LE media as an Ogg Opus stream (RFC 7845), with libopus.
+ *
+ * Only works when built with `WITH_OPUS` (linking `-lopus`); otherwise the
+ * constructor throws, so the API does not depend on how the library was built.
+ * The encoder is set up for speech (`OPUS_APPLICATION_VOIP`), at a constant frame
+ * duration; at the default 24 kbit/s, 16kHz mono speech takes under a tenth of the
+ * bandwidth of PCM.
+ *
+ * Each call of `encode()` writes the packets of the frames it completes as one Ogg
+ * page, so the stream is not held back beyond a frame; `flush()` pads the last frame
+ * and ends the stream with the granule position trimming the padding.
+ */
+class OpusMediaEncoder : public MediaEncoder
+{
+public:
+	/// Construct a new Opus encoder.
+	///
+	/// \param sample_rate the sample rate, in Hz: 8000, 12000, 16000, 24000 or 48000
+	/// \param channels the number of (interleaved) channels, 1 or 2
+	/// \param bitrate the bit rate, in bit/s
+	/// \param frame the duration of a frame: 10, 20, 40 or 60ms
+	/// \throws std::runtime_error if a parameter is invalid, or not built with `WITH_OPUS`
+	OpusMediaEncoder(int sample_rate, int channels = 1, int bitrate = WSSC_OPUS_BITRATE,
+		std::chrono::milliseconds frame = std::chrono::milliseconds(WSSC_OPUS_FRAME_MS));
+
+	~OpusMediaEncoder();
+
+	void encode(const void* in, size_t frames, std::string& out);
+
+	void flush(std::string& out);
+
+	std::string format() const { return "OPUS"; }
+
+private:
+	void write_headers(std::string& out);
+	void encode_frame(const int16_t* pcm, uint64_t end);
+
+	OpusEncoder* _encoder;
+	OggPageWriter _ogg;
+	size_t _frame_size;        // in frames of the sample rate
+	int _granule_scale;        // 48kHz granule units per frame of the sample rate
+	int _pre_skip;             // in 48kHz units
+	uint64_t _granule = 0;     // in 48kHz units, encoded so far (including the pre-skip)
+	uint64_t _frames_in = 0;
+	bool _headers_written = false;
+	std::vector<int16_t> _pcm;
+	size_t _fill = 0;
+	std::vector<unsigned char> _packet;
+};
+
+/**
+ * Class decoding an Ogg Opus stream to S16LE media, with libopus.
+ *
+ * The decoder's pre-skip and the end trimming of the last page are applied, so an
+ * `OpusMediaEncoder` stream decodes to as many frames as were encoded. Like the
+ * encoder, only works when built with `WITH_OPUS`.
+ */
+class OpusMediaDecoder : public MediaDecoder
+{
+public:
+	/// Construct a new Opus decoder.
+	///
+	/// \param sample_rate the sample rate to decode to, in Hz (as for `OpusMediaEncoder`)
+	/// \param channels the number of channels to decode to, 1 or 2
+	/// \throws std::runtime_error if a parameter is invalid, or not built with `WITH_OPUS`
+	OpusMediaDecoder(int sample_rate, int channels);
+
+	~OpusMediaDecoder();
+
+	void decode(const char* data, size_t size, std::string& out);
+
+private:
+	OpusDecoder* _decoder;
+	OggPacketReader _ogg;
+	int _sample_rate;
+	int _channels;
+	int _granule_scale;
+	size_t _packets = 0;
+	uint64_t _skip = 0;        // frames still to skip, of the pre-skip
+	uint64_t _granule = 0;     // in 48kHz units, decoded so far (including the pre-skip)
+	std::vector<int16_t> _pcm;
+};
+
+} // namespace
+} // namespace
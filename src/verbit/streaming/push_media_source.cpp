@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+
+#include "push_media_source.h"
+
+namespace verbit {
+namespace streaming {
+
+PushMediaSource::PushMediaSource(size_t capacity_bytes, OverflowPolicy policy, size_t frame_bytes, size_t max_chunk_bytes) :
+	_policy(policy),
+	_frame_bytes(frame_bytes),
+	_head(0),
+	_tail(0),
+	_reading(0),
+	_signaled(false),
+	_closed(false),
+	_overflow_count(0),
+	_dropped_bytes(0),
+	_space_waiting(false)
+{
+	if (frame_bytes == 0) {
+		throw std::runtime_error("push media source frame size must be positive");
+	}
+	if (capacity_bytes < frame_bytes) {
+		throw std::runtime_error("push media source capacity must hold at least one frame");
+	}
+	size_t capacity = 1;
+	while (capacity < capacity_bytes) {
+		capacity <<= 1;
+	}
+	_usable = capacity - (capacity % frame_bytes);
+	// drop_oldest: slack for the producer to write into while the consumer copies media it dropped
+	_ring_bytes = (policy == drop_oldest) ? capacity * 2 : capacity;
+	_mask = _ring_bytes - 1;
+	_max_chunk_bytes = std::max(frame_bytes, max_chunk_bytes - (max_chunk_bytes % frame_bytes));
+	_ring.reset(new uint8_t[_ring_bytes]);
+
+	_event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_event_fd < 0) {
+		throw std::runtime_error(std::string("can't create eventfd: ") + strerror(errno));
+	}
+}
+
+PushMediaSource::~PushMediaSource()
+{
+	::close(_event_fd);
+}
+
+void* PushMediaSource::operator new(size_t size)
+{
+	void* ptr;
+	if (::posix_memalign(&ptr, alignof(PushMediaSource), size) != 0) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void PushMediaSource::operator delete(void* ptr)
+{
+	::free(ptr);
+}
+
+size_t PushMediaSource::push(const void* data, size_t len)
+{
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+	len -= len % _frame_bytes;
+	if (len == 0 || _closed.load(std::memory_order_relaxed)) {
+		return 0;
+	}
+	size_t head = _head.load(std::memory_order_relaxed);
+
+	if (_policy == block) {
+		size_t accepted = 0;
+		while (len > 0) {
+			size_t space = _usable - (head - _tail.load(std::memory_order_acquire));
+			if (space == 0) {
+				// wait for read_chunk() to make room: it only takes the lock to notify
+				// once it sees `_space_waiting`, and either it sees the flag or we see
+				// its new tail when we look again (both are sequentially consistent)
+				std::unique_lock<std::mutex> lock(_space_mutex);
+				_space_waiting.store(true, std::memory_order_seq_cst);
+				_space_available.wait(lock, [this, head]() {
+					return _tail.load(std::memory_order_seq_cst) != head - _usable;
+				});
+				_space_waiting.store(false, std::memory_order_relaxed);
+				continue;
+			}
+			size_t n = std::min(len, space);
+			copy_in(head, src, n);
+			head += n;
+			_head.store(head, std::memory_order_release);
+			signal();
+			src += n;
+			len -= n;
+			accepted += n;
+		}
+		return accepted;
+	}
+
+	// media larger than the whole ring can never fit: keep its newest or oldest frames
+	size_t dropped = 0;
+	if (len > _usable) {
+		dropped = len - _usable;
+		if (_policy == drop_oldest) {
+			src += dropped;
+		}
+		len = _usable;
+	}
+
+	size_t tail = _tail.load(std::memory_order_acquire);
+	size_t space = _usable - (head - tail);
+	if (len > space) {
+		if (_policy == drop_newest) {
+			dropped += len - space;
+			len = space;
+		} else {
+			// drop_oldest: advance the consumer's position past just enough whole frames;
+			// a failed exchange means the consumer made room meanwhile, so look again
+			size_t need = len - space;
+			while (!_tail.compare_exchange_weak(tail, tail + need,
+				std::memory_order_seq_cst, std::memory_order_acquire)) {
+				space = _usable - (head - tail);
+				if (len <= space) {
+					need = 0;
+					break;
+				}
+				need = len - space;
+			}
+			dropped += need;
+		}
+	}
+	if (dropped > 0) {
+		count_overflow(dropped);
+	}
+	if (len == 0) {
+		return 0;
+	}
+
+	if (_policy == drop_oldest) {
+		wait_reader(head + len);
+	}
+	copy_in(head, src, len);
+	_head.store(head + len, std::memory_order_release);
+	signal();
+	return len;
+}
+
+void PushMediaSource::close()
+{
+	_closed.store(true, std::memory_order_release);
+	signal();
+}
+
+bool PushMediaSource::read_chunk(ChunkBuffer& chunk)
+{
+	size_t tail = _tail.load(std::memory_order_acquire);
+	for (;;) {
+		size_t head = _head.load(std::memory_order_acquire);
+		size_t n = std::min(head - tail, _max_chunk_bytes);
+		if (n == 0) {
+			// empty: reset the eventfd, then look once more, since a push() between
+			// our first look and the reset would have found the eventfd still set
+			clear_signal();
+			head = _head.load(std::memory_order_acquire);
+			tail = _tail.load(std::memory_order_acquire);
+			if (head == tail) {
+				if (_closed.load(std::memory_order_acquire)) {
+					// a closed source stays readable, so the client wakes to see it finished
+					signal();
+				}
+				return true;
+			}
+			continue;
+		}
+
+		if (_policy == drop_oldest) {
+			// tell the producer where we copy from, so it doesn't overwrite it, then make sure
+			// it hadn't dropped that media already (both are sequentially consistent: either
+			// it sees us reading, or we see its new tail)
+			_reading.store(tail + 1, std::memory_order_seq_cst);
+			size_t current = _tail.load(std::memory_order_seq_cst);
+			if (current != tail) {
+				_reading.store(0, std::memory_order_release);
+				tail = current;
+				continue;
+			}
+		}
+
+		copy_out(tail, reinterpret_cast<uint8_t*>(chunk.prepare(n)), n);
+		if (_policy == drop_oldest) {
+			_reading.store(0, std::memory_order_release);
+		}
+
+		// if the producer dropped the oldest media while we were copying it, it is counted as
+		// dropped, not read: the exchange fails, and we start over from the new position
+		if (_tail.compare_exchange_strong(tail, tail + n, std::memory_order_seq_cst, std::memory_order_acquire)) {
+			chunk.commit(n);
+			if (_policy == block) {
+				notify_space();
+			}
+			return true;
+		}
+	}
+}
+
+bool PushMediaSource::finished()
+{
+	return _closed.load(std::memory_order_acquire) &&
+		(_head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire));
+}
+
+size_t PushMediaSource::size()
+{
+	size_t tail = _tail.load(std::memory_order_acquire);
+	return _head.load(std::memory_order_acquire) - tail;
+}
+
+void PushMediaSource::copy_in(size_t pos, const uint8_t* src, size_t len)
+{
+	size_t offset = pos & _mask;
+	size_t first = std::min(len, _mask + 1 - offset);
+	memcpy(&_ring[offset], src, first);
+	memcpy(&_ring[0], src + first, len - first);
+}
+
+void PushMediaSource::copy_out(size_t pos, uint8_t* dst, size_t len)
+{
+	size_t offset = pos & _mask;
+	size_t first = std::min(len, _mask + 1 - offset);
+	memcpy(dst, &_ring[offset], first);
+	memcpy(dst + first, &_ring[0], len - first);
+}
+
+// Wait until the consumer is not copying media the producer would overwrite by writing up
+// to `end`: only when the producer has filled the ring's slack during a single copy.
+void PushMediaSource::wait_reader(size_t end)
+{
+	size_t reading = _reading.load(std::memory_order_seq_cst);
+	while ( (reading != 0) && (end > reading - 1 + _ring_bytes) ) {
+		std::this_thread::yield();
+		reading = _reading.load(std::memory_order_seq_cst);
+	}
+}
+
+// Wake a producer blocked on a full ring, if there is one. The lock makes sure it is
+// already waiting, not between looking at the tail and starting to wait.
+void PushMediaSource::notify_space()
+{
+	if (_space_waiting.load(std::memory_order_seq_cst)) {
+		{
+			std::unique_lock<std::mutex> lock(_space_mutex);
+		}
+		_space_available.notify_one();
+	}
+}
+
+// Make the eventfd readable, unless it already is: one syscall per burst, not per push.
+void PushMediaSource::signal()
+{
+	if (!_signaled.exchange(true, std::memory_order_acq_rel)) {
+		uint64_t one = 1;
+		ssize_t rc = ::write(_event_fd, &one, sizeof(one));
+		(void)rc;  // can only fail if the counter would overflow, which can't happen here
+	}
+}
+
+// Reset the eventfd before the flag: a signal() in between then finds the flag still set
+// and skips its write, but (via the exchange) its media is visible to the caller's next look.
+void PushMediaSource::clear_signal()
+{
+	if (_signaled.load(std::memory_order_acquire)) {
+		uint64_t value;
+		ssize_t rc = ::read(_event_fd, &value, sizeof(value));
+		(void)rc;  // EAGAIN is fine: nothing to clear
+		_signaled.exchange(false, std::memory_order_acq_rel);
+	}
+}
+
+void PushMediaSource::count_overflow(size_t bytes)
+{
+	_overflow_count.fetch_add(1, std::memory_order_relaxed);
+	_dropped_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <verbit/streaming/media_generator.h>
+
+#define WSSC_PUSH_MAX_CHUNK_BYTES 3200
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class implementing a push-based media source for live capture.
+ *
+ * Media is written by a single producer (_e.g._ an audio capture callback)
+ * with `push()`, into a fixed-capacity lock-free single-producer/single-consumer
+ * ring of PCM frames, and is read by the streaming client. `push()` does not
+ * allocate, and (except with the `block` overflow policy) does not wait. With
+ * `drop_oldest`, the ring has a second capacity's worth of slack, so media dropped
+ * while the client is copying it out is never overwritten under it; only if the
+ * producer fills the slack during one such copy does `push()` yield until it ends.
+ *
+ * The client does not poll a push source: it waits on `event_fd()` (an
+ * eventfd) on its I/O threads, and reads only when media is available.
+ *
+ * ```
+ * PushMediaSource source {64000};                  // 2s of S16LE 16kHz mono
+ * client.async_run_stream(source);
+ * ...
+ * source.push(samples, n_samples * 2);             // from the capture callback
+ * ...
+ * source.close();                                  // end of media
+ * ```
+ */
+class PushMediaSource : public MediaGenerator
+{
+public:
+	/// What `push()` does when there is not enough room in the ring.
+	enum OverflowPolicy {
+		drop_oldest,  ///< discard the oldest buffered media to make room (default)
+		drop_newest,  ///< discard the part of the pushed media that does not fit
+		block         ///< wait until the client has made room (not wait-free!)
+	};
+
+	/// Construct a new push media source.
+	///
+	/// \param capacity_bytes the ring capacity, rounded up to a power of two
+	/// \param policy what to do on overflow
+	/// \param frame_bytes the size of one PCM frame (sample width times channels); media is
+	///        only ever pushed, dropped and read in whole frames
+	/// \param max_chunk_bytes the maximum size of one chunk read by `read_chunk()`
+	PushMediaSource(size_t capacity_bytes, OverflowPolicy policy = drop_oldest, size_t frame_bytes = 2,
+		size_t max_chunk_bytes = WSSC_PUSH_MAX_CHUNK_BYTES);
+
+	~PushMediaSource();
+
+	/// Allocate a source on the heap, aligned for its cache-line separated positions
+	/// (which `new` only does itself from C++17).
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+
+	/// Push media into the ring. Call from the producer thread only.
+	///
+	/// \param data the PCM frames
+	/// \param len the number of bytes; a trailing partial frame is ignored
+	/// \return the number of bytes accepted (less than `len` if any were dropped)
+	size_t push(const void* data, size_t len);
+
+	/// Mark the end of media. Call from the producer thread only.
+	/// Media already pushed is still sent, after which the client sends end-of-stream.
+	void close();
+
+	/// Read the next chunk of buffered media into `chunk`, leaving it empty if there is none.
+	/// Never blocks.
+	///
+	/// \return always `true`: a push source ends with `close()`, not unexpectedly
+	bool read_chunk(ChunkBuffer& chunk);
+
+	/// Return the next chunk of buffered media, with `read_chunk()`. Never blocks.
+	const std::string get_chunk() { return read_chunk_string(); }
+
+	/// Has the source been closed, and all buffered media read?
+	bool finished();
+
+	/// Return the eventfd that is readable while media may be available (or the source is closed).
+	int event_fd() { return _event_fd; }
+
+	/// Return the usable capacity of the ring, in bytes.
+	size_t capacity() { return _usable; }
+
+	/// Return the number of bytes currently buffered.
+	size_t size();
+
+	/// Return the number of `push()` calls that dropped media.
+	uint64_t overflow_count() { return _overflow_count.load(std::memory_order_relaxed); }
+
+	/// Return the total number of bytes dropped.
+	uint64_t dropped_bytes() { return _dropped_bytes.load(std::memory_order_relaxed); }
+
+private:
+	PushMediaSource(const PushMediaSource&) = delete;
+	PushMediaSource& operator=(const PushMediaSource&) = delete;
+
+	OverflowPolicy _policy;
+	size_t _frame_bytes;
+	size_t _max_chunk_bytes;
+	size_t _mask;
+	size_t _ring_bytes;
+	size_t _usable;
+	std::unique_ptr<uint8_t[]> _ring;
+	int _event_fd;
+
+	// producer and consumer positions are free-running byte counts, on separate cache lines
+	alignas(64) std::atomic<size_t> _head;  // written by the producer
+	alignas(64) std::atomic<size_t> _tail;  // advanced by the consumer, and by the producer to drop oldest
+	std::atomic<size_t> _reading;           // 1 + the position the consumer is copying from, or 0 (drop_oldest)
+	alignas(64) std::atomic<bool> _signaled;
+	std::atomic<bool> _closed;
+	std::atomic<uint64_t> _overflow_count;
+	std::atomic<uint64_t> _dropped_bytes;
+
+	// block: the producer waits for the consumer to make room
+	std::atomic<bool> _space_waiting;
+	std::mutex _space_mutex;
+	std::condition_variable _space_available;
+
+	void copy_in(size_t pos, const uint8_t* src, size_t len);
+	void copy_out(size_t pos, uint8_t* dst, size_t len);
+	void wait_reader(size_t end);
+	void notify_space();
+	void signal();
+	void clear_signal();
+	void count_overflow(size_t bytes);
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct holding per-session metrics for mid-stream reconnects.
+ */
+struct ReconnectStats {
+	/// The number of times the WebSocket was reopened after an unexpected close.
+	uint64_t reconnects = 0;
+
+	/// The total time without an open WebSocket, from each unexpected close until reopened.
+	std::chrono::milliseconds total_gap {0};
+
+	/// The longest time without an open WebSocket.
+	std::chrono::milliseconds max_gap {0};
+
+	/// The number of media bytes sent again after reconnecting.
+	uint64_t bytes_replayed = 0;
+
+	/// The number of unacknowledged media bytes no longer held for replay, and so lost.
+	uint64_t bytes_lost = 0;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "replay_ring.h"
+
+namespace verbit {
+namespace streaming {
+
+ReplayRing::ReplayRing(size_t capacity_bytes, size_t frame_bytes) :
+	_end(0),
+	_size(0)
+{
+	if (frame_bytes == 0) {
+		throw std::runtime_error("replay ring frame size must be positive");
+	}
+	_capacity = capacity_bytes - (capacity_bytes % frame_bytes);
+	if (_capacity == 0) {
+		throw std::runtime_error("replay ring capacity must hold at least one frame");
+	}
+	_ring.reset(new uint8_t[_capacity]);
+}
+
+void ReplayRing::append(const void* data, size_t len)
+{
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+	if (len > _capacity) {
+		// only the newest media can be held
+		src += len - _capacity;
+		_end += len - _capacity;
+		len = _capacity;
+	}
+	size_t pos = _end % _capacity;
+	size_t first = std::min(len, _capacity - pos);
+	memcpy(&_ring[pos], src, first);
+	memcpy(&_ring[0], src + first, len - first);
+	_end += len;
+	_size = std::min(_size + len, _capacity);
+}
+
+size_t ReplayRing::copy(uint64_t offset, void* dst, size_t len) const
+{
+	if ((offset < begin_offset()) || (offset >= _end)) {
+		return 0;
+	}
+	len = std::min(len, (size_t)(_end - offset));
+	size_t pos = offset % _capacity;
+	size_t first = std::min(len, _capacity - pos);
+	uint8_t* out = static_cast<uint8_t*>(dst);
+	memcpy(out, &_ring[pos], first);
+	memcpy(out + first, &_ring[0], len - first);
+	return len;
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class holding the most recent media of a stream, for replay after a reconnect.
+ *
+ * The ring is allocated once, at construction. Appending media overwrites the
+ * oldest media once the ring is full. Media is addressed by its offset in the
+ * whole stream, so a replay can start from the last media acknowledged by the
+ * service, if it is still held.
+ *
+ * **NOTE** A replay ring is not thread-safe: the streaming client only uses it
+ * from its media path.
+ */
+class ReplayRing
+{
+public:
+	/// Construct a new replay ring.
+	///
+	/// \param capacity_bytes the ring capacity, rounded down to whole frames
+	/// \param frame_bytes the size of one PCM frame (sample width times channels)
+	ReplayRing(size_t capacity_bytes, size_t frame_bytes = 2);
+
+	/// Append media, overwriting the oldest media if the ring is full.
+	void append(const void* data, size_t len);
+
+	/// Copy held media, starting at stream offset `offset`, into `dst`.
+	///
+	/// \return the number of bytes copied: at most `len`, and 0 if `offset` is not held
+	size_t copy(uint64_t offset, void* dst, size_t len) const;
+
+	/// Return the stream offset of the oldest media held.
+	uint64_t begin_offset() const { return _end - _size; }
+
+	/// Return the stream offset just past the newest media held (the total media appended).
+	uint64_t end_offset() const { return _end; }
+
+	/// Return the number of bytes held.
+	size_t size() const { return _size; }
+
+	/// Return the ring capacity, in bytes.
+	size_t capacity() const { return _capacity; }
+
+private:
+	ReplayRing(const ReplayRing&) = delete;
+	ReplayRing& operator=(const ReplayRing&) = delete;
+
+	size_t _capacity;
+	std::unique_ptr<uint8_t[]> _ring;
+	uint64_t _end;
+	size_t _size;
+};
+
+} // namespace
+} // namespace
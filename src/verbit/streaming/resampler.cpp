@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define WSSC_RESAMPLER_X86 1
+#endif
+
+#include "resampler.h"
+
+namespace verbit {
+namespace streaming {
+
+namespace {
+
+// Kaiser window shape, for about 80dB of stopband attenuation
+const double KAISER_BETA = 7.86;
+const double KAISER_ATTENUATION = 80.0;
+
+// dot products of `n` floats (a multiple of 8)
+
+float dot_scalar(const float* a, const float* b, size_t n)
+{
+	float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	for (size_t i = 0; i < n; i += 4) {
+		for (int j = 0; j < 4; j++) {
+			sum[j] += a[i + j] * b[i + j];
+		}
+	}
+	return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+#ifdef WSSC_RESAMPLER_X86
+
+// (four accumulators, to overlap the adds' latency)
+
+float dot_sse2(const float* a, const float* b, size_t n)
+{
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	__m128 sum2 = _mm_setzero_ps();
+	__m128 sum3 = _mm_setzero_ps();
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+		sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+		sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+	}
+	if (i < n) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+	__m128 sum = _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma"))) float dot_avx2(const float* a, const float* b, size_t n)
+{
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+	__m256 sum2 = _mm256_setzero_ps();
+	__m256 sum3 = _mm256_setzero_ps();
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+		sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+		sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), sum2);
+		sum3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), sum3);
+	}
+	for (; i < n; i += 8) {
+		sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+	}
+	__m256 sum8 = _mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3));
+	__m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum8), _mm256_extractf128_ps(sum8, 1));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+#endif // WSSC_RESAMPLER_X86
+
+// the zeroth-order modified Bessel function of the first kind, for the Kaiser window
+double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 50; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-12) {
+			break;
+		}
+	}
+	return sum;
+}
+
+int gcd(int a, int b)
+{
+	while (b != 0) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+inline int16_t to_s16(float v)
+{
+	v = (v < 32767.0f) ? v : 32767.0f;
+	v = (v > -32768.0f) ? v : -32768.0f;
+#ifdef WSSC_RESAMPLER_X86
+	// (`lrintf()` is a library call, unless errno is off)
+	return (int16_t)_mm_cvtss_si32(_mm_set_ss(v));
+#else
+	return (int16_t)lrintf(v);
+#endif
+}
+
+} // anonymous namespace
+
+Resampler::Resampler(int in_rate, int out_rate, int channels, int taps, SampleConverter::Isa isa) :
+	_in_rate(in_rate), _out_rate(out_rate), _channels(channels), _isa(isa)
+{
+	if ( (in_rate <= 0) || (out_rate <= 0) ) {
+		throw std::runtime_error("resampler rates must be positive");
+	}
+	if (channels < 1) {
+		throw std::runtime_error("resampler channels must be positive");
+	}
+	if (taps < 8) {
+		throw std::runtime_error("resampler filter must have at least 8 taps");
+	}
+	if (!SampleConverter::supported(isa)) {
+		throw std::runtime_error(std::string("resampler ISA not supported: ") + SampleConverter::isa_name(isa));
+	}
+	int divisor = gcd(in_rate, out_rate);
+	_up = out_rate / divisor;
+	_down = in_rate / divisor;
+	if (_up > WSSC_RESAMPLER_MAX_PHASES) {
+		throw std::runtime_error("resampler ratio " + std::to_string(out_rate) + "/" + std::to_string(in_rate)
+			+ " needs too many phases");
+	}
+	if (_down > 64 * _up) {
+		throw std::runtime_error("resampler can't downsample by more than 64");
+	}
+	_dot = dot_scalar;
+#ifdef WSSC_RESAMPLER_X86
+	if (isa == SampleConverter::isa_avx2) {
+		_dot = dot_avx2;
+	} else if (isa == SampleConverter::isa_sse2) {
+		_dot = dot_sse2;
+	}
+#endif
+
+	if (_up == _down) {
+		// the same rate: copied straight through
+		_taps = 0;
+		_stride = 0;
+		return;
+	}
+
+	// the filter spans `taps` samples at the lower rate, rounded up to whole vectors
+	// (and at least one input sample per output, so each output moves its window less than its length)
+	double ratio = std::min(1.0, (double)_up / _down);
+	_taps = (int)std::ceil(taps / ratio);
+	_taps = std::max(_taps, 2 * (_down + _up - 1) / _up);
+	_taps = (_taps + 7) / 8 * 8;
+
+	// cut off so the transition band ends at the lower Nyquist frequency (in cycles per input sample)
+	double transition = (KAISER_ATTENUATION - 7.95) / (14.36 * _taps);
+	double cutoff = 0.5 * ratio - transition / 2;
+	double half = _taps / 2.0;
+	_coefs.resize((size_t)_up * _taps);
+	for (int phase = 0; phase < _up; phase++) {
+		// output at input time i + phase / L, from the inputs i - taps/2 + 1 ... i + taps/2
+		float* coefs = &_coefs[(size_t)phase * _taps];
+		double sum = 0.0;
+		for (int m = 0; m < _taps; m++) {
+			double t = (double)phase / _up + half - 1 - m;
+			double x = 2 * cutoff * t;
+			double sinc = (x == 0.0) ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+			double w = t / half;
+			double window = (std::fabs(w) >= 1.0) ? 0.0 : bessel_i0(KAISER_BETA * std::sqrt(1 - w * w)) / bessel_i0(KAISER_BETA);
+			coefs[m] = (float)(2 * cutoff * sinc * window);
+			sum += coefs[m];
+		}
+		// (unity gain at DC, whatever the phase)
+		for (int m = 0; m < _taps; m++) {
+			coefs[m] = (float)(coefs[m] / sum);
+		}
+	}
+	_stride = _taps + WSSC_RESAMPLER_BLOCK_FRAMES;
+	_history.resize(_stride * channels);
+	reset();
+}
+
+void Resampler::reset()
+{
+	// the history starts with silence before the first sample, so output 0 is centred on input 0
+	std::fill(_history.begin(), _history.end(), 0.0f);
+	_fill = (_taps > 0) ? _taps / 2 - 1 : 0;
+	_pos = 0;
+	_phase = 0;
+	_in_frames = 0;
+	_out_frames = 0;
+}
+
+size_t Resampler::process(const void* in, size_t frames, int16_t* out)
+{
+	if (_taps == 0) {
+		memcpy(out, in, frames * _channels * sizeof(int16_t));
+		return frames;
+	}
+	_in_frames += frames;
+	return run(static_cast<const uint8_t*>(in), frames, out, std::numeric_limits<size_t>::max());
+}
+
+size_t Resampler::flush(int16_t* out)
+{
+	size_t written = 0;
+	if (_taps > 0) {
+		// feed silence until the last input has been through the middle of the filter,
+		// up to the output for the input's whole duration
+		uint64_t total = (_in_frames * _up + _down - 1) / _down;
+		written = run(nullptr, latency(), out, (size_t)(total - std::min(total, _out_frames)));
+	}
+	reset();
+	return written;
+}
+
+size_t Resampler::run(const uint8_t* in, size_t frames, int16_t* out, size_t limit)
+{
+	const size_t frame_bytes = _channels * sizeof(int16_t);
+	const size_t step = _down / _up;
+	const int step_phase = _down % _up;
+	size_t written = 0;
+	while ( (frames > 0) && (written < limit) ) {
+		size_t n = std::min(frames, (size_t)WSSC_RESAMPLER_BLOCK_FRAMES);
+		for (int c = 0; c < _channels; c++) {
+			float* history = &_history[c * _stride + _fill];
+			if (in == nullptr) {
+				std::fill(history, history + n, 0.0f);
+				continue;
+			}
+			const uint8_t* samples = in + c * sizeof(int16_t);
+			for (size_t i = 0; i < n; i++) {
+				int16_t sample;
+				memcpy(&sample, samples + i * frame_bytes, sizeof(int16_t));
+				history[i] = sample;
+			}
+		}
+		_fill += n;
+
+		while ( (_pos + _taps <= _fill) && (written < limit) ) {
+			const float* coefs = &_coefs[(size_t)_phase * _taps];
+			for (int c = 0; c < _channels; c++) {
+				*out++ = to_s16(_dot(coefs, &_history[c * _stride + _pos], _taps));
+			}
+			written++;
+			// (advance by M/L input samples, without dividing)
+			_pos += step;
+			_phase += step_phase;
+			if (_phase >= _up) {
+				_phase -= _up;
+				_pos++;
+			}
+		}
+
+		// keep the history from the next output's window on
+		size_t keep = _fill - std::min(_pos, _fill);
+		if (_pos > 0) {
+			for (int c = 0; c < _channels; c++) {
+				float* history = &_history[c * _stride];
+				memmove(history, history + _pos, keep * sizeof(float));
+			}
+		}
+		_fill = keep;
+		_pos = 0;
+		if (in != nullptr) {
+			in += n * frame_bytes;
+		}
+		frames -= n;
+	}
+	_out_frames += written;
+	return written;
+}
+
+ResamplingMediaGenerator::ResamplingMediaGenerator(MediaGenerator& source, int in_rate, int out_rate, int channels) :
+	_source(source), _resampler(in_rate, out_rate, channels)
+{
+}
+
+bool ResamplingMediaGenerator::read_chunk(ChunkBuffer& chunk)
+{
+	ChunkBuffer input(_input);
+	bool ok = _source.read_chunk(input);
+	const size_t frame_bytes = _resampler.channels() * sizeof(int16_t);
+	const char* data = input.data();
+	size_t size = input.size();
+
+	// complete a partial frame left from the last chunk
+	if (!_partial.empty()) {
+		size_t head = std::min(frame_bytes - _partial.size(), size);
+		_partial.append(data, head);
+		data += head;
+		size -= head;
+	}
+	size_t frames = size / frame_bytes;
+	bool whole = (_partial.size() == frame_bytes);
+	size_t max_frames = (whole ? _resampler.max_output(1) : 0) + _resampler.max_output(frames);
+	if (ok && _source.finished()) {
+		max_frames += _resampler.max_output(_resampler.latency());
+	}
+	int16_t* out = reinterpret_cast<int16_t*>(chunk.prepare(max_frames * frame_bytes));
+	size_t written = 0;
+	if (whole) {
+		written += _resampler.process(_partial.data(), 1, out);
+		_partial.clear();
+	}
+	written += _resampler.process(data, frames, out + written * _resampler.channels());
+	_partial.append(data + frames * frame_bytes, size - frames * frame_bytes);
+	if (ok && _source.finished() && !_flushed) {
+		written += _resampler.flush(out + written * _resampler.channels());
+		_partial.clear();
+		_flushed = true;
+	}
+	chunk.commit(written * frame_bytes);
+	return ok;
+}
+
+MediaConfig ResamplingMediaGenerator::media_config() const
+{
+	MediaConfig config;
+	config.format = "S16LE";
+	config.sample_rate = _resampler.out_rate();
+	config.sample_width = 2;
+	config.num_channels = _resampler.channels();
+	return config;
+}
+
+} // namespace
+} // namespace
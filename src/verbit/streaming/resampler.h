@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <verbit/streaming/media_config.h>
+#include <verbit/streaming/media_generator.h>
+#include <verbit/streaming/sample_converter.h>
+
+#define WSSC_RESAMPLER_TAPS 48
+#define WSSC_RESAMPLER_MAX_PHASES 1024
+#define WSSC_RESAMPLER_BLOCK_FRAMES 256
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class resampling S16LE PCM between any two sample rates, as a stream.
+ *
+ * The rates' ratio, reduced to `L/M`, picks `L` phases of a polyphase
+ * windowed-sinc (Kaiser, about 80dB stopband) lowpass filter, cut off below the
+ * lower of the two Nyquist frequencies. Each output sample is a dot product of
+ * one phase with the input around it, done by SSE2 or AVX2 kernels picked at run
+ * time, or by scalar code.
+ *
+ * Input may be given in chunks of any size: the filter history and phase carry
+ * over, so the output does not depend on how the input was split. All buffers are
+ * allocated on construction, so `process()` never allocates. Output is aligned
+ * with the input in time (output sample `n` is the input at `n / out_rate`
+ * seconds), and lags it by a constant `latency()` input frames; `flush()` pushes
+ * out the rest at the end of the media.
+ *
+ * ```
+ * Resampler resampler {48000, 16000};
+ * std::vector<int16_t> out(resampler.max_output(n_frames));
+ * out.resize(resampler.process(samples, n_frames, out.data()));
+ * ```
+ *
+ * A resampler is not thread-safe.
+ */
+class Resampler
+{
+public:
+	/// Construct a new resampler.
+	///
+	/// \param in_rate the input sample rate, in Hz
+	/// \param out_rate the output sample rate, in Hz
+	/// \param channels the number of (interleaved) channels
+	/// \param taps the filter length, in samples at the lower of the two rates: longer
+	///        filters have a sharper cutoff, at proportionally more CPU
+	/// \param isa the kernels to use (by default, the best the CPU supports)
+	/// \throws std::runtime_error if a parameter is invalid, the reduced ratio has more than
+	///         `WSSC_RESAMPLER_MAX_PHASES` phases or downsamples by more than 64, or the CPU
+	///         does not support `isa`
+	Resampler(int in_rate, int out_rate, int channels = 1, int taps = WSSC_RESAMPLER_TAPS,
+		SampleConverter::Isa isa = SampleConverter::best_isa());
+
+	/// Resample input frames.
+	///
+	/// \param in `frames` S16LE input frames (need not be aligned)
+	/// \param frames the number of frames
+	/// \param out room for `max_output(frames)` output frames
+	/// \return the number of frames written to `out`
+	size_t process(const void* in, size_t frames, int16_t* out);
+
+	/// Resample the input still held back by the filter, at the end of the media,
+	/// and reset for new media.
+	///
+	/// \param out room for `max_output(latency())` output frames
+	/// \return the number of frames written to `out`: the output totals the input's duration
+	size_t flush(int16_t* out);
+
+	/// Forget all input, for new media.
+	void reset();
+
+	/// Return the most output frames `process()` writes for a number of input frames.
+	size_t max_output(size_t frames) const { return (frames + 1) * _up / _down + 1; }
+
+	/// Return the number of input frames by which output lags input.
+	int latency() const { return _taps / 2; }
+
+	/// Return the input sample rate, in Hz.
+	int in_rate() const { return _in_rate; }
+
+	/// Return the output sample rate, in Hz.
+	int out_rate() const { return _out_rate; }
+
+	/// Return the number of channels.
+	int channels() const { return _channels; }
+
+	/// Return the number of filter phases (the reduced ratio's numerator).
+	int phases() const { return _up; }
+
+	/// Return the number of filter taps per phase, at the input rate.
+	int taps() const { return _taps; }
+
+	/// Return the kernels used.
+	SampleConverter::Isa isa() const { return _isa; }
+
+private:
+	size_t run(const uint8_t* in, size_t frames, int16_t* out, size_t limit);
+
+	int _in_rate;
+	int _out_rate;
+	int _channels;
+	int _up;    // L: output samples per `_down` input samples
+	int _down;  // M
+	int _taps;
+	SampleConverter::Isa _isa;
+	float (*_dot)(const float* a, const float* b, size_t n);
+	std::vector<float> _coefs;    // `_up` phases of `_taps` coefficients
+	std::vector<float> _history;  // per channel, `_stride` samples
+	size_t _stride;
+	size_t _fill = 0;   // samples in each channel's history
+	size_t _pos = 0;    // where the next output's window starts in the history
+	int _phase = 0;     // the next output's phase
+	uint64_t _in_frames = 0;
+	uint64_t _out_frames = 0;
+};
+
+/**
+ * Class for a media generator resampling the S16LE media of another, with a `Resampler`.
+ *
+ * Chain it in front of any media generator delivering S16LE (_e.g._ a
+ * `ConvertingMediaGenerator`), and stream with its `media_config()`:
+ *
+ * ```
+ * ConvertingMediaGenerator mono {capture, SampleConverter::f32le, 2};
+ * ResamplingMediaGenerator media {mono, 48000, 16000};
+ * client.async_run_stream(media, media.media_config(), response_types);
+ * ```
+ *
+ * Chunks read from the source need not hold whole frames. When the source finishes,
+ * the input held back by the filter is flushed, before this finishes too.
+ */
+class ResamplingMediaGenerator : public MediaGenerator
+{
+public:
+	/// Construct a new resampling media generator.
+	///
+	/// \param source the media generator to resample the media of; must outlive this
+	/// \param in_rate the source's sample rate, in Hz
+	/// \param out_rate the sample rate to send, in Hz
+	/// \param channels the source's number of channels
+	/// \throws std::runtime_error if the rates or channels are invalid
+	ResamplingMediaGenerator(MediaGenerator& source, int in_rate, int out_rate, int channels = 1);
+
+	/// Read the next chunk of the source, and resample it into `chunk`.
+	///
+	/// \return `false` if the source ended unexpectedly
+	bool read_chunk(ChunkBuffer& chunk);
+
+	/// Return the next chunk resampled, with `read_chunk()`.
+	const std::string get_chunk() { return read_chunk_string(); }
+
+	/// Has the source finished, and the resampler been flushed?
+	bool finished() { return _flushed && _source.finished(); }
+
+	/// Return the source's event descriptor.
+	int event_fd() { return _source.event_fd(); }
+
+	/// Return the media configuration of the resampled media.
+	MediaConfig media_config() const;
+
+	/// Return the resampler.
+	Resampler& resampler() { return _resampler; }
+
+private:
+	ResamplingMediaGenerator(const ResamplingMediaGenerator&) = delete;
+	ResamplingMediaGenerator& operator=(const ResamplingMediaGenerator&) = delete;
+
+	MediaGenerator& _source;
+	Resampler _resampler;
+	std::string _input;
+	std::string _partial;
+	bool _flushed = false;
+};
+
+} // namespace
+} // namespace
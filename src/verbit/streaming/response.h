@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct referring to a string held by a `ResponseParser`, without owning it.
+ *
+ * A string reference is only valid until the parser parses its next message.
+ * Use `str()` to keep a copy.
+ */
+struct StringRef {
+	/// The string bytes (not NUL-terminated).
+	const char* data = "";
+
+	/// The string length, in bytes.
+	size_t length = 0;
+
+	/// Return a copy of the string.
+	std::string str() const { return std::string(data, length); }
+
+	/// Is the string empty (or absent from the response)?
+	bool empty() const { return (length == 0); }
+
+	/// Does the string equal the NUL-terminated string `s`?
+	bool operator==(const char* s) const { return (strlen(s) == length) && (memcmp(data, s, length) == 0); }
+
+	/// Does the string differ from the NUL-terminated string `s`?
+	bool operator!=(const char* s) const { return !(*this == s); }
+};
+
+/**
+ * Struct referring to a run of elements held by a `ResponseParser`, without owning them.
+ *
+ * Like a `StringRef`, a span is only valid until the parser parses its next message.
+ */
+template<typename T>
+struct Span {
+	/// The first element.
+	const T* data = nullptr;
+
+	/// The number of elements.
+	size_t count = 0;
+
+	const T* begin() const { return data; }
+	const T* end() const { return data + count; }
+	size_t size() const { return count; }
+	bool empty() const { return (count == 0); }
+	const T& operator[](size_t i) const { return data[i]; }
+	const T& back() const { return data[count - 1]; }
+};
+
+/**
+ * Struct describing one item (word or punctuation) of a response alternative.
+ */
+struct Item {
+	/// The item kind, _e.g._ `text` or `punct`.
+	StringRef kind;
+
+	/// The item text.
+	StringRef value;
+
+	/// The speaker of the item, matching a `Speaker::id`.
+	/// A numeric speaker ID is held in its decimal form.
+	StringRef speaker_id;
+
+	/// The item start time, in seconds from the start of the media.
+	double start = 0.0;
+
+	/// The item end time, in seconds from the start of the media.
+	double end = 0.0;
+};
+
+/**
+ * Struct describing one speaker of a response.
+ */
+struct Speaker {
+	/// The speaker ID (a numeric speaker ID is held in its decimal form).
+	StringRef id;
+
+	/// The speaker label, which may be empty.
+	StringRef label;
+};
+
+/**
+ * Struct describing one alternative of a response.
+ */
+struct Alternative {
+	/// The alternative transcript text.
+	StringRef transcript;
+
+	/// The alternative items, in order.
+	Span<Item> items;
+};
+
+/**
+ * Struct describing one response from the Verbit Transcribe Streaming service.
+ *
+ * A response is filled by a `ResponseParser`, and its strings and items refer
+ * to memory owned by the parser, which is reused for the next message. Copy
+ * out anything which must outlive the response handler call.
+ *
+ * Elements missing from the message are left empty (or zero, or `false`).
+ */
+struct Response {
+	/// Did the message contain a `response` object?
+	bool has_response = false;
+
+	/// The response ID.
+	StringRef id;
+
+	/// The response type, _e.g._ `captions` or `transcript`.
+	StringRef type;
+
+	/// The service type, _e.g._ `transcription` or `translation`.
+	StringRef service_type;
+
+	/// The response language code, _e.g._ `en-US`.
+	StringRef language_code;
+
+	/// Is this response final (will not be revised)?
+	bool is_final = false;
+
+	/// Is this the last response of its type?
+	bool is_end_of_stream = false;
+
+	/// The speakers referred to by the response items.
+	std::vector<Speaker> speakers;
+
+	/// The response alternatives, most likely first.
+	std::vector<Alternative> alternatives;
+};
+
+inline std::ostream& operator<<(std::ostream& ost, const StringRef& s)
+{
+	return ost.write(s.data, s.length);
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,477 @@
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+#include "response_parser.h"
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * SAX event handler filling the response of a `ResponseParser`.
+ *
+ * The handler tracks where it is in the message with a small stack of
+ * contexts. Containers which are not part of the response model are skipped
+ * by counting their nesting depth.
+ */
+class ResponseParser::Sax
+{
+public:
+	typedef nlohmann::json json;
+
+	Sax(ResponseParser& parser) : _parser(parser), _depth(0), _skip(0), _field(field_other)
+	{
+		_stack[0] = ctx_root;
+	}
+
+	const std::string& error() const { return _error; }
+
+	bool null() { return true; }
+
+	bool boolean(bool val)
+	{
+		if ( (_skip == 0) && (top() == ctx_response) ) {
+			if (_field == field_is_final) {
+				_parser._response.is_final = val;
+			} else if (_field == field_is_end_of_stream) {
+				_parser._response.is_end_of_stream = val;
+			}
+		}
+		return true;
+	}
+
+	bool number_integer(json::number_integer_t val)
+	{
+		char text[32];
+		int len = snprintf(text, sizeof(text), "%lld", (long long)val);
+		number((double)val, text, len);
+		return true;
+	}
+
+	bool number_unsigned(json::number_unsigned_t val)
+	{
+		char text[32];
+		int len = snprintf(text, sizeof(text), "%llu", (unsigned long long)val);
+		number((double)val, text, len);
+		return true;
+	}
+
+	bool number_float(json::number_float_t val, const json::string_t&)
+	{
+		number(val, nullptr, 0);
+		return true;
+	}
+
+	bool string(json::string_t& val)
+	{
+		if (_skip == 0) {
+			StringRef* ref = string_field();
+			if (ref) {
+				*ref = _parser.store(val.data(), val.size());
+			}
+		}
+		return true;
+	}
+
+	// binary values (nlohmann/json 3.8 and later) only come from binary formats
+	template<typename Binary>
+	bool binary(Binary&) { return true; }
+
+	bool start_object(size_t)
+	{
+		Context context = ctx_skip;
+		if (_skip == 0) {
+			Response& response = _parser._response;
+			switch (top()) {
+			case ctx_root:
+				context = ctx_message;
+				break;
+			case ctx_message:
+				if (_field == field_response) {
+					response.has_response = true;
+					context = ctx_response;
+				}
+				break;
+			case ctx_speakers:
+				response.speakers.push_back(Speaker());
+				context = ctx_speaker;
+				break;
+			case ctx_alternatives:
+				response.alternatives.push_back(Alternative());
+				_parser._first_items.push_back(_parser._items.size());
+				context = ctx_alternative;
+				break;
+			case ctx_items:
+				_parser._items.push_back(Item());
+				context = ctx_item;
+				break;
+			default:
+				break;
+			}
+		}
+		push(context);
+		return true;
+	}
+
+	bool key(json::string_t& key)
+	{
+		if (_skip == 0) {
+			_field = field_for(top(), key);
+		}
+		return true;
+	}
+
+	bool end_object()
+	{
+		pop();
+		return true;
+	}
+
+	bool start_array(size_t)
+	{
+		Context context = ctx_skip;
+		if (_skip == 0) {
+			if (top() == ctx_response) {
+				if (_field == field_speakers) {
+					context = ctx_speakers;
+				} else if (_field == field_alternatives) {
+					context = ctx_alternatives;
+				}
+			} else if ( (top() == ctx_alternative) && (_field == field_items) ) {
+				context = ctx_items;
+			}
+		}
+		push(context);
+		return true;
+	}
+
+	bool end_array()
+	{
+		pop();
+		return true;
+	}
+
+	bool parse_error(size_t, const std::string&, const json::exception& ex)
+	{
+		_error = ex.what();
+		return false;
+	}
+
+private:
+	enum Context {
+		ctx_root,
+		ctx_message,
+		ctx_response,
+		ctx_speakers,
+		ctx_speaker,
+		ctx_alternatives,
+		ctx_alternative,
+		ctx_items,
+		ctx_item,
+		ctx_skip
+	};
+
+	enum Field {
+		field_other,
+		field_response,
+		field_id,
+		field_type,
+		field_service_type,
+		field_language_code,
+		field_is_final,
+		field_is_end_of_stream,
+		field_speakers,
+		field_alternatives,
+		field_label,
+		field_transcript,
+		field_items,
+		field_kind,
+		field_value,
+		field_speaker_id,
+		field_start,
+		field_end
+	};
+
+	// deep enough for message.response.alternatives[].items[]
+	static const int MAX_DEPTH = 8;
+
+	Context top() const { return _stack[_depth]; }
+
+	void push(Context context)
+	{
+		if ( (_skip > 0) || (context == ctx_skip) || (_depth + 1 >= MAX_DEPTH) ) {
+			_skip++;
+		} else {
+			_stack[++_depth] = context;
+		}
+	}
+
+	void pop()
+	{
+		if (_skip > 0) {
+			_skip--;
+		} else if (_depth > 0) {
+			_depth--;
+		}
+		_field = field_other;
+	}
+
+	static Field field_for(Context context, const std::string& key)
+	{
+		switch (context) {
+		case ctx_message:
+			if (key == "response") return field_response;
+			break;
+		case ctx_response:
+			if (key == "id") return field_id;
+			if (key == "type") return field_type;
+			if (key == "service_type") return field_service_type;
+			if (key == "language_code") return field_language_code;
+			if (key == "is_final") return field_is_final;
+			if (key == "is_end_of_stream") return field_is_end_of_stream;
+			if (key == "speakers") return field_speakers;
+			if (key == "alternatives") return field_alternatives;
+			break;
+		case ctx_speaker:
+			if (key == "id") return field_id;
+			if (key == "label") return field_label;
+			break;
+		case ctx_alternative:
+			if (key == "transcript") return field_transcript;
+			if (key == "items") return field_items;
+			break;
+		case ctx_item:
+			if (key == "kind") return field_kind;
+			if (key == "value") return field_value;
+			if (key == "speaker_id") return field_speaker_id;
+			if (key == "start") return field_start;
+			if (key == "end") return field_end;
+			break;
+		default:
+			break;
+		}
+		return field_other;
+	}
+
+	// the string element the current value fills, if any
+	StringRef* string_field()
+	{
+		Response& response = _parser._response;
+		switch (top()) {
+		case ctx_response:
+			switch (_field) {
+			case field_id: return &response.id;
+			case field_type: return &response.type;
+			case field_service_type: return &response.service_type;
+			case field_language_code: return &response.language_code;
+			default: return nullptr;
+			}
+		case ctx_speaker:
+			switch (_field) {
+			case field_id: return &response.speakers.back().id;
+			case field_label: return &response.speakers.back().label;
+			default: return nullptr;
+			}
+		case ctx_alternative:
+			return (_field == field_transcript) ? &response.alternatives.back().transcript : nullptr;
+		case ctx_item:
+			switch (_field) {
+			case field_kind: return &_parser._items.back().kind;
+			case field_value: return &_parser._items.back().value;
+			case field_speaker_id: return &_parser._items.back().speaker_id;
+			default: return nullptr;
+			}
+		default:
+			return nullptr;
+		}
+	}
+
+	// item times may be integers or floats; speaker IDs may be integers
+	void number(double val, const char* text, int text_len)
+	{
+		if (_skip > 0) {
+			return;
+		}
+		if (top() == ctx_item) {
+			if (_field == field_start) {
+				_parser._items.back().start = val;
+				return;
+			} else if (_field == field_end) {
+				_parser._items.back().end = val;
+				return;
+			}
+		}
+		if ( text && (text_len > 0) && ((top() == ctx_item) || (top() == ctx_speaker)) ) {
+			StringRef* ref = string_field();
+			if (ref) {
+				*ref = _parser.store(text, text_len);
+			}
+		}
+	}
+
+	ResponseParser& _parser;
+	Context _stack[MAX_DEPTH];
+	int _depth;
+	int _skip;
+	Field _field;
+	std::string _error;
+};
+
+namespace {
+
+const char* _skip_space(const char* p, const char* end)
+{
+	while ( (p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r')) ) {
+		p++;
+	}
+	return p;
+}
+
+// Return the closing quote of the string whose opening quote is at `p`, or `end`.
+const char* _string_end(const char* p, const char* end)
+{
+	for (p++; p < end; p++) {
+		if (*p == '\\') {
+			p++;
+		} else if (*p == '"') {
+			return p;
+		}
+	}
+	return end;
+}
+
+bool _equals(const char* p, const char* e, const char* s)
+{
+	size_t len = strlen(s);
+	return ((size_t)(e - p) == len) && (memcmp(p, s, len) == 0);
+}
+
+} // anonymous namespace
+
+void ResponseParser::scan(const std::string& message, Response& response)
+{
+	response = Response();
+
+	static const int FOUND_ALL = 0x0f;
+	int found = 0;
+	int depth = 0;
+	bool response_next = false;
+	const char* p = message.data();
+	const char* end = p + message.length();
+	while (p < end) {
+		switch (*p) {
+		case '"': {
+			const char* s = p + 1;
+			const char* e = _string_end(p, end);
+			p = _skip_space(e + 1, end);
+			if ( (p >= end) || (*p != ':') ) {
+				continue;  // a string value
+			}
+			const char* value = _skip_space(p + 1, end);
+			if (depth == 1) {
+				response_next = _equals(s, e, "response");
+			} else if ( (depth == 2) && response.has_response ) {
+				if ( _equals(s, e, "id") || _equals(s, e, "type") ) {
+					if ( (value < end) && (*value == '"') ) {
+						StringRef& ref = (s[0] == 'i') ? response.id : response.type;
+						ref.data = value + 1;
+						ref.length = _string_end(value, end) - ref.data;
+					}
+					found |= (s[0] == 'i') ? 0x01 : 0x02;
+				} else if ( _equals(s, e, "is_final") || _equals(s, e, "is_end_of_stream") ) {
+					bool flag = ( (end - value >= 4) && (memcmp(value, "true", 4) == 0) );
+					if (e - s == 8) {
+						response.is_final = flag;
+						found |= 0x04;
+					} else {
+						response.is_end_of_stream = flag;
+						found |= 0x08;
+					}
+				}
+				if (found == FOUND_ALL) {
+					return;
+				}
+			}
+			p = value;
+			continue;
+		}
+		case '{':
+		case '[':
+			depth++;
+			if ( (depth == 2) && response_next && (*p == '{') ) {
+				response.has_response = true;
+			}
+			response_next = false;
+			break;
+		case '}':
+		case ']':
+			if ( (depth == 2) && response.has_response ) {
+				return;  // end of the response object
+			}
+			depth--;
+			break;
+		default:
+			break;
+		}
+		p++;
+	}
+}
+
+const Response& ResponseParser::parse(const std::string& payload)
+{
+	reset(payload.length());
+
+	Sax sax(*this);
+	if (!nlohmann::json::sax_parse(payload, &sax)) {
+		throw std::runtime_error(std::string("invalid response message: ") + sax.error());
+	}
+
+	// items are only contiguous once all have been added
+	size_t count = _response.alternatives.size();
+	for (size_t i = 0; i < count; i++) {
+		size_t first = _first_items[i];
+		size_t last = (i + 1 < count) ? _first_items[i + 1] : _items.size();
+		_response.alternatives[i].items.data = _items.data() + first;
+		_response.alternatives[i].items.count = last - first;
+	}
+	return _response;
+}
+
+void ResponseParser::reset(size_t payload_len)
+{
+	// clear (rather than replace) the vectors and arena, to keep their capacity
+	_response.has_response = false;
+	_response.id = StringRef();
+	_response.type = StringRef();
+	_response.service_type = StringRef();
+	_response.language_code = StringRef();
+	_response.is_final = false;
+	_response.is_end_of_stream = false;
+	_response.speakers.clear();
+	_response.alternatives.clear();
+	_items.clear();
+	_first_items.clear();
+	_arena.clear();
+	// an unescaped JSON string, or a reformatted integer, is never longer
+	// than its JSON text, so the whole message bounds the arena
+	if (_arena.capacity() < payload_len) {
+		_arena.reserve(payload_len);
+	}
+}
+
+StringRef ResponseParser::store(const char* data, size_t len)
+{
+	if (_arena.size() + len > _arena.capacity()) {
+		throw std::runtime_error("response parser arena overflow");
+	}
+	StringRef ref;
+	ref.data = _arena.data() + _arena.size();
+	ref.length = len;
+	_arena.append(data, len);
+	return ref;
+}
+
+} // namespace
+} // namespace
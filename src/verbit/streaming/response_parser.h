@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <verbit/streaming/response.h>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class parsing response messages from the Verbit Transcribe Streaming service
+ * into a typed `Response`.
+ *
+ * The parser makes a single SAX pass over each message, keeping only the
+ * elements described by `Response`, and never builds a JSON DOM. Strings and
+ * items are held in memory owned by the parser, which is reused from one
+ * message to the next; once it has grown to fit the largest message seen, a
+ * parse allocates little or nothing.
+ *
+ * **NOTE** A response parser is not thread-safe: the streaming client keeps
+ * one per session, and only uses it from its I/O thread.
+ */
+class ResponseParser
+{
+public:
+	/// Construct a new response parser.
+	ResponseParser() { }
+
+	/// Parse a response message.
+	/// The returned response (and everything it refers to) is valid until
+	/// the next call to `parse()`.
+	///
+	/// \param payload the JSON text of the message
+	/// \return the parsed response
+	/// \throws std::runtime_error if the message is not valid JSON
+	const Response& parse(const std::string& payload);
+
+	/// Return the most recently parsed response.
+	const Response& response() const { return _response; }
+
+	/// Fill only the top-level fields of a response (`has_response`, `id`, `type`, `is_final`
+	/// and `is_end_of_stream`), by a targeted scan of the message text rather than a parse.
+	///
+	/// The scan skips over strings and tracks nesting, so it only finds the keys of the
+	/// `response` object itself, and stops as soon as it has found them all. It does not
+	/// validate the message. The strings refer to `message` itself, and are not unescaped.
+	/// Other elements of `response` are left empty.
+	///
+	/// \param message the JSON text of the message
+	/// \param response the response to fill
+	static void scan(const std::string& message, Response& response);
+
+private:
+	class Sax;
+
+	ResponseParser(const ResponseParser&) = delete;
+	ResponseParser& operator=(const ResponseParser&) = delete;
+
+	void reset(size_t payload_len);
+	StringRef store(const char* data, size_t len);
+
+	Response _response;
+
+	// all strings of the current message; reserved to the message length
+	// before parsing, so a string never moves once stored
+	std::string _arena;
+
+	// items of all alternatives, and the index of each alternative's first item
+	std::vector<Item> _items;
+	std::vector<size_t> _first_items;
+};
+
+} // namespace
+} // namespace
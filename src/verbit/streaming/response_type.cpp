@@ -1,3 +1,7 @@
+#include <cstring>
+
+#include <verbit/streaming/response_parser.h>
+
 #include "response_type.h"
 
 namespace
@@ -26,6 +30,18 @@ static int _string_to_response_types(std::string const types)
 	}
 }
 
+// Return the response type of an end-of-stream response's `type`, or 0 if it is not one
+// (the service may add types; they must not take down the session on the I/O thread).
+static int _eos_type(const char* type, size_t length)
+{
+	if ( (length == 8) && ((strncmp(type, "captions", 8) == 0) || (strncmp(type, "Captions", 8) == 0)) ) {
+		return ResponseType::Captions;
+	} else if ( (length == 10) && ((strncmp(type, "transcript", 10) == 0) || (strncmp(type, "Transcript", 10) == 0)) ) {
+		return ResponseType::Transcript;
+	}
+	return 0;
+}
+
 ResponseType::ResponseType(std::string const types)
 	: _types(_string_to_response_types(types)), _eos_types(0)
 {
@@ -66,10 +82,9 @@ void ResponseType::record_eos(nlohmann::json &response)
 	it = response.find("type");
 	if (is_eos && (it != response.end())) {
 		nlohmann::json value = *it;
-		if (!value.is_null()) {
-			std::string type = value.get<std::string>();
-			type[0] = toupper(type[0]);
-			_eos_types |= _string_to_response_types(type);
+		if (value.is_string()) {
+			const std::string& type = value.get_ref<const std::string&>();
+			_eos_types |= _eos_type(type.data(), type.length());
 #if defined(DEBUG)
 			ResponseType _seen_types {_eos_types};
 			std::cout << "have seen EOS response types: " << _seen_types.to_string() << std::endl;
@@ -78,6 +93,25 @@ void ResponseType::record_eos(nlohmann::json &response)
 	}
 }
 
+void ResponseType::record_eos(const Response& response)
+{
+	if (!response.is_end_of_stream) {
+		return;
+	}
+	_eos_types |= _eos_type(response.type.data, response.type.length);
+#if defined(DEBUG)
+	ResponseType _seen_types {_eos_types};
+	std::cout << "have seen EOS response types: " << _seen_types.to_string() << std::endl;
+#endif
+}
+
+void ResponseType::scan_eos(const std::string& message)
+{
+	Response response;
+	ResponseParser::scan(message, response);
+	record_eos(response);
+}
+
 std::ostream& operator<<(std::ostream& ost, const ResponseType& rt)
 {
 	ost << "ResponseType(" << rt.to_string() << ")";
@@ -2,6 +2,8 @@
 
 #include <nlohmann/json.hpp>
 
+#include <verbit/streaming/response.h>
+
 namespace verbit {
 namespace streaming {
 
@@ -52,6 +54,19 @@ public:
 	/// \param response the response to check for end-of-stream
 	void record_eos(nlohmann::json &response);
 
+	/// Record whether end-of-stream has been received for the given typed response.
+	///
+	/// \param response the response to check for end-of-stream
+	void record_eos(const Response& response);
+
+	/// Record whether end-of-stream has been received for the given message, without parsing it.
+	/// This makes a targeted scan of the JSON text for the `is_end_of_stream` and
+	/// (only if that is `true`) `type` keys, taking the first of each; so it relies on
+	/// the service schema, where only the `response` object has such keys.
+	///
+	/// \param message the JSON text of the message
+	void scan_eos(const std::string& message);
+
 	std::string url_params();
 
 private:
@@ -0,0 +1,565 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define WSSC_CONVERTER_X86 1
+#endif
+
+#include "sample_converter.h"
+
+namespace verbit {
+namespace streaming {
+
+struct SampleConverter::Kernels {
+	// decode `n` samples to floats in the 16-bit range, indexed by `Format`
+	void (*decode[3])(const uint8_t* in, size_t n, float* out);
+	// average interleaved stereo frames to mono
+	void (*downmix_stereo)(const float* in, size_t frames, float* out);
+	// generate `groups` groups of TPDF noise samples, one from each generator
+	void (*noise)(uint32_t* state, size_t groups, float* out);
+	// add `n` noise samples
+	void (*add)(float* samples, const float* noise, size_t n);
+	// clip and round `n` samples to 16 bits
+	void (*quantize)(const float* in, size_t n, int16_t* out);
+};
+
+namespace {
+
+// Every kernel does the operations of the scalar reference, in the same order, with
+// the same single-precision rounding, so they are all bit-exact with it.
+
+const float F32_SCALE = 32768.0f;
+const float S32_SCALE = 1.0f / 65536.0f;
+const float S16_MAX = 32767.0f;
+const float S16_MIN = -32768.0f;
+const float NOISE_SCALE = 1.0f / 16777216.0f;
+const int NOISE_LANES = 8;
+
+// scalar reference
+
+void decode_f32_scalar(const uint8_t* in, size_t n, float* out)
+{
+	for (size_t i = 0; i < n; i++) {
+		float v;
+		memcpy(&v, in + 4 * i, 4);
+		out[i] = v * F32_SCALE;
+	}
+}
+
+void decode_s24_scalar(const uint8_t* in, size_t n, float* out)
+{
+	for (size_t i = 0; i < n; i++) {
+		// (the sample in the high 3 bytes: an S32 sample, exact as a float)
+		const uint8_t* p = in + 3 * i;
+		uint32_t v = ((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24);
+		out[i] = (float)(int32_t)v * S32_SCALE;
+	}
+}
+
+void decode_s32_scalar(const uint8_t* in, size_t n, float* out)
+{
+	for (size_t i = 0; i < n; i++) {
+		int32_t v;
+		memcpy(&v, in + 4 * i, 4);
+		out[i] = (float)v * S32_SCALE;
+	}
+}
+
+void downmix_stereo_scalar(const float* in, size_t frames, float* out)
+{
+	for (size_t i = 0; i < frames; i++) {
+		out[i] = (in[2 * i] + in[2 * i + 1]) * 0.5f;
+	}
+}
+
+inline uint32_t xorshift(uint32_t x)
+{
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+void noise_scalar(uint32_t* state, size_t groups, float* out)
+{
+	// TPDF: the difference of two uniform values in [0, 1), from consecutive states
+	for (size_t g = 0; g < groups; g++) {
+		for (int lane = 0; lane < NOISE_LANES; lane++) {
+			uint32_t a = xorshift(state[lane]);
+			uint32_t b = xorshift(a);
+			state[lane] = b;
+			*out++ = (float)(int32_t)(a >> 8) * NOISE_SCALE - (float)(int32_t)(b >> 8) * NOISE_SCALE;
+		}
+	}
+}
+
+void add_scalar(float* samples, const float* noise, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		samples[i] += noise[i];
+	}
+}
+
+inline int16_t quantize_sample(float v)
+{
+	// (as `minps` and `maxps` do, including for NaN)
+	v = (v < S16_MAX) ? v : S16_MAX;
+	v = (v > S16_MIN) ? v : S16_MIN;
+	return (int16_t)lrintf(v);
+}
+
+void quantize_scalar(const float* in, size_t n, int16_t* out)
+{
+	for (size_t i = 0; i < n; i++) {
+		out[i] = quantize_sample(in[i]);
+	}
+}
+
+#ifdef WSSC_CONVERTER_X86
+
+// SSE2 (always available on x86-64)
+
+void decode_f32_sse2(const uint8_t* in, size_t n, float* out)
+{
+	const __m128 scale = _mm_set1_ps(F32_SCALE);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps((const float*)(in + 4 * i)), scale));
+	}
+	decode_f32_scalar(in + 4 * i, n - i, out + i);
+}
+
+void decode_s32_sse2(const uint8_t* in, size_t n, float* out)
+{
+	const __m128 scale = _mm_set1_ps(S32_SCALE);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + 4 * i));
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+	}
+	decode_s32_scalar(in + 4 * i, n - i, out + i);
+}
+
+void downmix_stereo_sse2(const float* in, size_t frames, float* out)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		__m128 a = _mm_loadu_ps(in + 2 * i);
+		__m128 b = _mm_loadu_ps(in + 2 * i + 4);
+		__m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+	}
+	downmix_stereo_scalar(in + 2 * i, frames - i, out + i);
+}
+
+inline __m128i xorshift_sse2(__m128i x)
+{
+	x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+	x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+	return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+void noise_sse2(uint32_t* state, size_t groups, float* out)
+{
+	const __m128 scale = _mm_set1_ps(NOISE_SCALE);
+	for (int half = 0; half < NOISE_LANES; half += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(state + half));
+		for (size_t g = 0; g < groups; g++) {
+			__m128i a = xorshift_sse2(x);
+			x = xorshift_sse2(a);
+			__m128 noise = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(a, 8)), scale),
+				_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)), scale));
+			_mm_storeu_ps(out + g * NOISE_LANES + half, noise);
+		}
+		_mm_storeu_si128((__m128i*)(state + half), x);
+	}
+}
+
+void add_sse2(float* samples, const float* noise, size_t n)
+{
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps(samples + i, _mm_add_ps(_mm_loadu_ps(samples + i), _mm_loadu_ps(noise + i)));
+	}
+	add_scalar(samples + i, noise + i, n - i);
+}
+
+inline __m128i quantize_sse2(__m128 v)
+{
+	v = _mm_min_ps(v, _mm_set1_ps(S16_MAX));
+	v = _mm_max_ps(v, _mm_set1_ps(S16_MIN));
+	return _mm_cvtps_epi32(v);
+}
+
+void quantize_sse2(const float* in, size_t n, int16_t* out)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m128i a = quantize_sse2(_mm_loadu_ps(in + i));
+		__m128i b = quantize_sse2(_mm_loadu_ps(in + i + 4));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(a, b));
+	}
+	quantize_scalar(in + i, n - i, out + i);
+}
+
+// AVX2 (compiled for AVX2 whatever the build flags, and only called if the CPU has it)
+
+#define WSSC_AVX2 __attribute__((target("avx2")))
+
+WSSC_AVX2 void decode_f32_avx2(const uint8_t* in, size_t n, float* out)
+{
+	const __m256 scale = _mm256_set1_ps(F32_SCALE);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps((const float*)(in + 4 * i)), scale));
+	}
+	decode_f32_scalar(in + 4 * i, n - i, out + i);
+}
+
+WSSC_AVX2 void decode_s24_avx2(const uint8_t* in, size_t n, float* out)
+{
+	// move each 3-byte sample into the high 3 bytes of a 32-bit lane
+	const __m256i shuffle = _mm256_setr_epi8(
+		-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+		-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+	const __m256 scale = _mm256_set1_ps(S32_SCALE);
+	size_t i = 0;
+	// (8 samples are 24 bytes, but the second 16-byte load reads 28: stop while 30 are left)
+	for (; i + 10 <= n; i += 8) {
+		const uint8_t* p = in + 3 * i;
+		__m256i v = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+			_mm_loadu_si128((const __m128i*)(p + 12)), 1);
+		v = _mm256_shuffle_epi8(v, shuffle);
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+	}
+	decode_s24_scalar(in + 3 * i, n - i, out + i);
+}
+
+WSSC_AVX2 void decode_s32_avx2(const uint8_t* in, size_t n, float* out)
+{
+	const __m256 scale = _mm256_set1_ps(S32_SCALE);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(in + 4 * i));
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+	}
+	decode_s32_scalar(in + 4 * i, n - i, out + i);
+}
+
+WSSC_AVX2 void downmix_stereo_avx2(const float* in, size_t frames, float* out)
+{
+	const __m256 half = _mm256_set1_ps(0.5f);
+	size_t i = 0;
+	for (; i + 8 <= frames; i += 8) {
+		__m256 a = _mm256_loadu_ps(in + 2 * i);
+		__m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+		// (shuffles work within 128-bit lanes: frames come out as 0 1 4 5 2 3 6 7)
+		__m256 left = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		__m256 right = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+		__m256 mono = _mm256_mul_ps(_mm256_add_ps(left, right), half);
+		mono = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(mono), _MM_SHUFFLE(3, 1, 2, 0)));
+		_mm256_storeu_ps(out + i, mono);
+	}
+	downmix_stereo_scalar(in + 2 * i, frames - i, out + i);
+}
+
+WSSC_AVX2 inline __m256i xorshift_avx2(__m256i x)
+{
+	x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+	x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+	return _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+}
+
+WSSC_AVX2 void noise_avx2(uint32_t* state, size_t groups, float* out)
+{
+	const __m256 scale = _mm256_set1_ps(NOISE_SCALE);
+	__m256i x = _mm256_loadu_si256((const __m256i*)state);
+	for (size_t g = 0; g < groups; g++) {
+		__m256i a = xorshift_avx2(x);
+		x = xorshift_avx2(a);
+		__m256 noise = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(a, 8)), scale),
+			_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(x, 8)), scale));
+		_mm256_storeu_ps(out + g * NOISE_LANES, noise);
+	}
+	_mm256_storeu_si256((__m256i*)state, x);
+}
+
+WSSC_AVX2 void add_avx2(float* samples, const float* noise, size_t n)
+{
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(samples + i, _mm256_add_ps(_mm256_loadu_ps(samples + i), _mm256_loadu_ps(noise + i)));
+	}
+	add_scalar(samples + i, noise + i, n - i);
+}
+
+WSSC_AVX2 inline __m256i quantize_avx2(__m256 v)
+{
+	v = _mm256_min_ps(v, _mm256_set1_ps(S16_MAX));
+	v = _mm256_max_ps(v, _mm256_set1_ps(S16_MIN));
+	return _mm256_cvtps_epi32(v);
+}
+
+WSSC_AVX2 void quantize_avx2(const float* in, size_t n, int16_t* out)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m256i a = quantize_avx2(_mm256_loadu_ps(in + i));
+		__m256i b = quantize_avx2(_mm256_loadu_ps(in + i + 8));
+		// (packing works within 128-bit lanes: samples come out as 0-3 8-11 4-7 12-15)
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i*)(out + i), packed);
+	}
+	quantize_scalar(in + i, n - i, out + i);
+}
+
+#endif // WSSC_CONVERTER_X86
+
+} // anonymous namespace
+
+const SampleConverter::Kernels* SampleConverter::kernels(Isa isa)
+{
+	static const Kernels scalar_kernels = {
+		{decode_f32_scalar, decode_s24_scalar, decode_s32_scalar},
+		downmix_stereo_scalar, noise_scalar, add_scalar, quantize_scalar
+	};
+#ifdef WSSC_CONVERTER_X86
+	// (SSE2 has no byte shuffle, for S24)
+	static const Kernels sse2_kernels = {
+		{decode_f32_sse2, decode_s24_scalar, decode_s32_sse2},
+		downmix_stereo_sse2, noise_sse2, add_sse2, quantize_sse2
+	};
+	static const Kernels avx2_kernels = {
+		{decode_f32_avx2, decode_s24_avx2, decode_s32_avx2},
+		downmix_stereo_avx2, noise_avx2, add_avx2, quantize_avx2
+	};
+	switch (isa) {
+	case isa_sse2:
+		return &sse2_kernels;
+	case isa_avx2:
+		return &avx2_kernels;
+	default:
+		break;
+	}
+#endif
+	return &scalar_kernels;
+}
+
+SampleConverter::SampleConverter(Format format, int in_channels, int out_channels, bool dither, Isa isa) :
+	_format(format), _in_channels(in_channels), _out_channels(out_channels), _dither(dither), _isa(isa)
+{
+	if (in_channels < 1) {
+		throw std::runtime_error("sample converter input channels must be positive");
+	}
+	if ( (out_channels != 1) && (out_channels != 2) ) {
+		throw std::runtime_error("sample converter output must be mono or stereo");
+	}
+	if (!supported(isa)) {
+		throw std::runtime_error(std::string("sample converter ISA not supported: ") + isa_name(isa));
+	}
+	_kernels = kernels(isa);
+	_decoded.resize(WSSC_CONVERTER_BLOCK_FRAMES * in_channels);
+	if (in_channels != out_channels) {
+		_mixed.resize(WSSC_CONVERTER_BLOCK_FRAMES * out_channels);
+	}
+	if (dither) {
+		_noise.resize(WSSC_CONVERTER_BLOCK_FRAMES * out_channels + NOISE_LANES);
+	}
+	seed(1);
+}
+
+void SampleConverter::convert(const void* in, size_t frames, int16_t* out)
+{
+	const uint8_t* input = static_cast<const uint8_t*>(in);
+	const size_t in_bytes = in_frame_bytes();
+	while (frames > 0) {
+		size_t n = std::min(frames, (size_t)WSSC_CONVERTER_BLOCK_FRAMES);
+		_kernels->decode[_format](input, n * _in_channels, _decoded.data());
+		float* mixed = mix(n);
+		size_t samples = n * _out_channels;
+		if (_dither) {
+			add_dither(mixed, samples);
+		}
+		_kernels->quantize(mixed, samples, out);
+		input += n * in_bytes;
+		out += samples;
+		frames -= n;
+	}
+}
+
+float* SampleConverter::mix(size_t frames)
+{
+	if (_in_channels == _out_channels) {
+		return _decoded.data();
+	}
+	const float* in = _decoded.data();
+	float* out = _mixed.data();
+	if (_out_channels == 2) {
+		// mono to both channels, or the first two channels of more
+		for (size_t i = 0; i < frames; i++, in += _in_channels) {
+			out[2 * i] = in[0];
+			out[2 * i + 1] = in[(_in_channels == 1) ? 0 : 1];
+		}
+	} else if (_in_channels == 2) {
+		_kernels->downmix_stereo(in, frames, out);
+	} else {
+		// (the same for every ISA)
+		const float scale = 1.0f / _in_channels;
+		for (size_t i = 0; i < frames; i++, in += _in_channels) {
+			float sum = in[0];
+			for (int c = 1; c < _in_channels; c++) {
+				sum += in[c];
+			}
+			out[i] = sum * scale;
+		}
+	}
+	return out;
+}
+
+void SampleConverter::add_dither(float* samples, size_t n)
+{
+	if (_noise_end - _noise_pos < n) {
+		// keep the noise left over, and generate whole groups after it
+		size_t left = _noise_end - _noise_pos;
+		memmove(_noise.data(), _noise.data() + _noise_pos, left * sizeof(float));
+		size_t groups = (n - left + NOISE_LANES - 1) / NOISE_LANES;
+		_kernels->noise(_rng, groups, _noise.data() + left);
+		_noise_pos = 0;
+		_noise_end = left + groups * NOISE_LANES;
+	}
+	_kernels->add(samples, _noise.data() + _noise_pos, n);
+	_noise_pos += n;
+}
+
+void SampleConverter::seed(uint32_t seed)
+{
+	// a different nonzero state for each generator, mixed from the seed
+	for (int lane = 0; lane < NOISE_LANES; lane++) {
+		uint32_t x = seed + 0x9e3779b9u * (lane + 1);
+		x = (x ^ (x >> 16)) * 0x85ebca6bu;
+		x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+		x ^= x >> 16;
+		_rng[lane] = (x != 0) ? x : 1;
+	}
+	_noise_pos = 0;
+	_noise_end = 0;
+}
+
+SampleConverter::Isa SampleConverter::best_isa()
+{
+	if (supported(isa_avx2)) {
+		return isa_avx2;
+	}
+	if (supported(isa_sse2)) {
+		return isa_sse2;
+	}
+	return isa_scalar;
+}
+
+bool SampleConverter::supported(Isa isa)
+{
+	switch (isa) {
+	case isa_scalar:
+		return true;
+#ifdef WSSC_CONVERTER_X86
+	case isa_sse2:
+		return true;
+	case isa_avx2:
+		// the resampler's AVX2 kernel also uses FMA, which a few AVX2 CPUs lack
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* SampleConverter::isa_name(Isa isa)
+{
+	switch (isa) {
+	case isa_scalar:
+		return "scalar";
+	case isa_sse2:
+		return "sse2";
+	case isa_avx2:
+		return "avx2";
+	}
+	return "unknown";
+}
+
+const char* SampleConverter::format_name(Format format)
+{
+	switch (format) {
+	case f32le:
+		return "F32LE";
+	case s24le:
+		return "S24LE";
+	case s32le:
+		return "S32LE";
+	}
+	return "unknown";
+}
+
+size_t SampleConverter::sample_width(Format format)
+{
+	return (format == s24le) ? 3 : 4;
+}
+
+ConvertingMediaGenerator::ConvertingMediaGenerator(MediaGenerator& source, SampleConverter::Format format,
+	int in_channels, int out_channels, bool dither) :
+	_source(source), _converter(format, in_channels, out_channels, dither)
+{
+}
+
+bool ConvertingMediaGenerator::read_chunk(ChunkBuffer& chunk)
+{
+	ChunkBuffer input(_input);
+	bool ok = _source.read_chunk(input);
+	const size_t in_bytes = _converter.in_frame_bytes();
+	const size_t out_bytes = _converter.out_frame_bytes();
+	const char* data = input.data();
+	size_t size = input.size();
+
+	// complete a partial frame left from the last chunk
+	size_t head = 0;
+	if (!_partial.empty()) {
+		head = std::min(in_bytes - _partial.size(), size);
+		_partial.append(data, head);
+		data += head;
+		size -= head;
+	}
+	size_t frames = size / in_bytes;
+	bool whole = (_partial.size() == in_bytes);
+	size_t out_frames = frames + (whole ? 1 : 0);
+	if (out_frames > 0) {
+		int16_t* out = reinterpret_cast<int16_t*>(chunk.prepare(out_frames * out_bytes));
+		if (whole) {
+			_converter.convert(_partial.data(), 1, out);
+			out += _converter.out_channels();
+			_partial.clear();
+		}
+		_converter.convert(data, frames, out);
+		chunk.commit(out_frames * out_bytes);
+	}
+	_partial.append(data + frames * in_bytes, size - frames * in_bytes);
+	return ok;
+}
+
+MediaConfig ConvertingMediaGenerator::media_config(int sample_rate) const
+{
+	MediaConfig config;
+	config.format = "S16LE";
+	config.sample_rate = sample_rate;
+	config.sample_width = 2;
+	config.num_channels = _converter.out_channels();
+	return config;
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <verbit/streaming/media_config.h>
+#include <verbit/streaming/media_generator.h>
+
+#define WSSC_CONVERTER_BLOCK_FRAMES 256
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class converting interleaved PCM samples to S16LE, downmixing to mono or stereo.
+ *
+ * Input is float32, S24LE (packed, 3 bytes per sample) or S32LE, with any number of
+ * channels. Samples are scaled to the 16-bit range, mixed, optionally dithered, and
+ * rounded to nearest (ties to even), clipping at full scale. Mixing to mono averages
+ * all channels; mixing to stereo duplicates a mono input, or keeps the first two
+ * channels (front left and right) of more.
+ *
+ * The work is done in blocks of `WSSC_CONVERTER_BLOCK_FRAMES` frames, by SSE2 or AVX2
+ * kernels picked at run time (`best_isa()`), or by scalar code. All kernels do the same
+ * single-precision operations in the same order, so their output is bit-exact with the
+ * scalar reference. TPDF dither (triangular noise of up to ±1 LSB) comes from eight
+ * interleaved xorshift generators, stepped together by the same kernels, so dithered
+ * output is bit-exact too, and reproducible given a `seed()`.
+ *
+ * ```
+ * SampleConverter converter {SampleConverter::f32le, 2};  // float32 stereo to S16LE mono
+ * converter.convert(samples, n_frames, out);              // n_frames int16_t samples out
+ * ```
+ *
+ * A converter is not thread-safe.
+ */
+class SampleConverter
+{
+public:
+	/// Input sample formats (all little-endian, interleaved).
+	enum Format {
+		f32le,  ///< 32-bit float, full scale at ±1.0
+		s24le,  ///< signed 24-bit integer, packed in 3 bytes
+		s32le   ///< signed 32-bit integer
+	};
+
+	/// Instruction sets of the conversion kernels.
+	enum Isa {
+		isa_scalar,  ///< portable scalar code (the reference)
+		isa_sse2,    ///< SSE2 (x86-64)
+		isa_avx2     ///< AVX2 with FMA (x86-64, if the CPU supports both)
+	};
+
+	/// Construct a new converter.
+	///
+	/// \param format the input sample format
+	/// \param in_channels the number of input channels
+	/// \param out_channels the number of output channels: 1 (mono) or 2 (stereo)
+	/// \param dither whether to add TPDF dither before rounding
+	/// \param isa the kernels to use (by default, the best the CPU supports)
+	/// \throws std::runtime_error if a channel count is invalid, or the CPU does not support `isa`
+	SampleConverter(Format format, int in_channels, int out_channels = 1, bool dither = false,
+		Isa isa = best_isa());
+
+	/// Convert samples.
+	///
+	/// \param in `frames` input frames
+	/// \param frames the number of frames
+	/// \param out room for `frames` output frames (`frames * out_channels()` samples)
+	void convert(const void* in, size_t frames, int16_t* out);
+
+	/// Reseed the dither noise generator, to reproduce dithered output.
+	///
+	/// \param seed any value
+	void seed(uint32_t seed);
+
+	/// Return the input sample format.
+	Format format() const { return _format; }
+
+	/// Return the number of input channels.
+	int in_channels() const { return _in_channels; }
+
+	/// Return the number of output channels.
+	int out_channels() const { return _out_channels; }
+
+	/// Return whether dither is added.
+	bool dither() const { return _dither; }
+
+	/// Return the kernels used.
+	Isa isa() const { return _isa; }
+
+	/// Return the size of an input frame, in bytes.
+	size_t in_frame_bytes() const { return sample_width(_format) * _in_channels; }
+
+	/// Return the size of an output frame, in bytes.
+	size_t out_frame_bytes() const { return sizeof(int16_t) * _out_channels; }
+
+	/// Return the best kernels the CPU supports.
+	static Isa best_isa();
+
+	/// Return whether the CPU supports kernels.
+	static bool supported(Isa isa);
+
+	/// Return the name of kernels, _e.g._ `"avx2"`.
+	static const char* isa_name(Isa isa);
+
+	/// Return the name of a sample format, _e.g._ `"S24LE"`.
+	static const char* format_name(Format format);
+
+	/// Return the size of a sample of a format, in bytes.
+	static size_t sample_width(Format format);
+
+private:
+	struct Kernels;
+	static const Kernels* kernels(Isa isa);
+
+	float* mix(size_t frames);
+	void add_dither(float* samples, size_t n);
+
+	Format _format;
+	int _in_channels;
+	int _out_channels;
+	bool _dither;
+	Isa _isa;
+	const Kernels* _kernels;
+	uint32_t _rng[8];  // (a state for each noise generator)
+	std::vector<float> _decoded;
+	std::vector<float> _mixed;
+	std::vector<float> _noise;
+	size_t _noise_pos = 0;
+	size_t _noise_end = 0;
+};
+
+/**
+ * Class for a media generator converting the media of another to S16LE mono or stereo,
+ * with a `SampleConverter`.
+ *
+ * Chain it in front of any media generator delivering float32, S24LE or S32LE, and
+ * stream with its `media_config()`:
+ *
+ * ```
+ * PushMediaSource capture {384000, PushMediaSource::drop_oldest, 8};  // float32 stereo, 48kHz
+ * ConvertingMediaGenerator media {capture, SampleConverter::f32le, 2};
+ * client.run_stream(media, media.media_config(48000), response_types);
+ * ```
+ *
+ * Chunks read from the source need not hold whole frames: a partial frame is kept
+ * until the rest of it is read. Each chunk is converted straight into the chunk buffer
+ * lent by the client.
+ */
+class ConvertingMediaGenerator : public MediaGenerator
+{
+public:
+	/// Construct a new converting media generator.
+	///
+	/// \param source the media generator to convert the media of; must outlive this
+	/// \param format the source's sample format
+	/// \param in_channels the source's number of channels
+	/// \param out_channels the number of channels to send: 1 (mono) or 2 (stereo)
+	/// \param dither whether to add TPDF dither
+	/// \throws std::runtime_error if a channel count is invalid
+	ConvertingMediaGenerator(MediaGenerator& source, SampleConverter::Format format, int in_channels,
+		int out_channels = 1, bool dither = false);
+
+	/// Read the next chunk of the source, and convert it into `chunk`.
+	///
+	/// \return `false` if the source ended unexpectedly
+	bool read_chunk(ChunkBuffer& chunk);
+
+	/// Return the next chunk converted, with `read_chunk()`.
+	const std::string get_chunk() { return read_chunk_string(); }
+
+	/// Has the source finished? (A trailing partial frame is dropped.)
+	bool finished() { return _source.finished(); }
+
+	/// Return the source's event descriptor.
+	int event_fd() { return _source.event_fd(); }
+
+	/// Return the media configuration of the converted media.
+	///
+	/// \param sample_rate the source's sample rate, in Hz
+	MediaConfig media_config(int sample_rate) const;
+
+	/// Return the converter.
+	SampleConverter& converter() { return _converter; }
+
+private:
+	ConvertingMediaGenerator(const ConvertingMediaGenerator&) = delete;
+	ConvertingMediaGenerator& operator=(const ConvertingMediaGenerator&) = delete;
+
+	MediaGenerator& _source;
+	SampleConverter _converter;
+	std::string _input;
+	std::string _partial;
+};
+
+} // namespace
+} // namespace
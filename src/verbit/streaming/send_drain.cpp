@@ -0,0 +1,59 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "send_drain.h"
+
+namespace verbit {
+namespace streaming {
+
+SendDrain::SendDrain()
+{
+	_event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_event_fd < 0) {
+		throw std::runtime_error(std::string("can't create eventfd: ") + strerror(errno));
+	}
+}
+
+SendDrain::~SendDrain()
+{
+	::close(_event_fd);
+}
+
+void SendDrain::notify()
+{
+	_count.fetch_add(1);
+	// the increment and this load are both sequentially consistent,
+	// so either we see the waiter, or the waiter sees the new count
+	if (_waiters.load() > 0) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_cv.notify_all();
+	}
+	// likewise, either we see the flag, or the armed caller's check sees the release
+	if (_armed.load() && _armed.exchange(false)) {
+		uint64_t one = 1;
+		ssize_t rc = ::write(_event_fd, &one, sizeof(one));
+		(void)rc;  // can only fail if the counter would overflow, which can't happen here
+	}
+}
+
+void SendDrain::wait(uint64_t seen)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_waiters.fetch_add(1);
+	_cv.wait(lock, [this, seen]{ return _count.load() != seen; });
+	_waiters.fetch_sub(1);
+}
+
+void SendDrain::clear()
+{
+	uint64_t value;
+	ssize_t rc = ::read(_event_fd, &value, sizeof(value));
+	(void)rc;  // EAGAIN is fine: nothing to clear
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class signalling that a session's WebSocket send queue may have drained.
+ *
+ * WebSocket++ has no callback for its send queue draining, but it releases each
+ * frame it sends once the frame has been written to the socket, and only then
+ * takes the frames queued behind it; so each release is a point at which
+ * `get_buffered_amount()` may have dropped. Each session has a signal of its own,
+ * which its outgoing media messages notify as they are released (they are
+ * allocated with a deleter doing so); incoming and control frames, and other
+ * sessions' messages, never wake it.
+ *
+ * A media thread blocked by a congested send queue waits on it with `wait()`,
+ * then checks its queue again. Without a media thread, the I/O thread `arm()`s
+ * the signal instead, and waits for its `event_fd()` to become readable.
+ */
+class SendDrain
+{
+public:
+	/// Construct a new send drain signal.
+	///
+	/// \throws std::runtime_error if its eventfd can't be created
+	SendDrain();
+
+	/// Destruct the send drain signal.
+	~SendDrain();
+
+	/// Return the number of notifications so far, to pass to `wait()`.
+	///
+	/// Read it before checking the condition to wait for, so that a notification
+	/// in between is not missed.
+	uint64_t count() const { return _count.load(); }
+
+	/// Notify all waiters, and make `event_fd()` readable if armed.
+	void notify();
+
+	/// Wait until there has been a notification since `seen` was read by `count()`.
+	void wait(uint64_t seen);
+
+	/// Make `event_fd()` readable on the next notification.
+	///
+	/// Arm it before checking the condition to wait for, so that a notification
+	/// in between is not missed.
+	void arm() { _armed.store(true); }
+
+	/// Make `event_fd()` unreadable again, once a wait on it has completed.
+	void clear();
+
+	/// Return a descriptor which becomes readable on the first notification after `arm()`.
+	int event_fd() const { return _event_fd; }
+
+private:
+	SendDrain(const SendDrain&) = delete;
+	SendDrain& operator=(const SendDrain&) = delete;
+
+	std::atomic<uint64_t> _count {0};
+	std::atomic<int> _waiters {0};
+	std::atomic<bool> _armed {false};
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	int _event_fd;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,75 @@
+#include <stdexcept>
+
+#include "send_timeline.h"
+
+namespace verbit {
+namespace streaming {
+
+SendTimeline::SendTimeline(size_t chunks)
+{
+	if (chunks == 0) {
+		throw std::runtime_error("send timeline capacity must be positive");
+	}
+	_sends.resize(chunks);
+}
+
+void SendTimeline::sent(uint64_t end_offset, std::chrono::steady_clock::time_point time)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	if ( (_count > 0) && (end_offset <= at(_count - 1).end_offset) ) {
+		return;
+	}
+	if (_count < _sends.size()) {
+		_count++;
+	} else {
+		_first = (_first + 1) % _sends.size();
+	}
+	Send& send = _sends[(_first + _count - 1) % _sends.size()];
+	send.end_offset = end_offset;
+	send.time = time;
+}
+
+bool SendTimeline::sent_time(uint64_t offset, std::chrono::steady_clock::time_point& time) const
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (_count == 0) {
+		return false;
+	}
+	if (offset > at(_count - 1).end_offset) {
+		time = at(_count - 1).time;
+		return true;
+	}
+	// the first send ending at or after `offset`
+	size_t low = 0;
+	size_t high = _count - 1;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (at(mid).end_offset < offset) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	if ( (low == 0) && (_count == _sends.size()) && (offset <= at(0).end_offset) ) {
+		// it may have been sent by an earlier send, no longer kept
+		return false;
+	}
+	time = at(low).time;
+	return true;
+}
+
+uint64_t SendTimeline::end_offset() const
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return (_count > 0) ? at(_count - 1).end_offset : 0;
+}
+
+void SendTimeline::clear()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_first = 0;
+	_count = 0;
+}
+
+} // namespace
+} // namespace
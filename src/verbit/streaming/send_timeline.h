@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#define WSSC_DEFAULT_SEND_TIMELINE_CHUNKS 1024
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class mapping media byte offsets to the times they were sent, to measure
+ * how long after sending its audio each response arrives.
+ *
+ * Each media send adds the offset just past its last byte, with the time of
+ * the send; offsets only grow, so media sent again (after reconnecting) keeps
+ * the time it was first sent. A fixed-capacity ring keeps the most recent
+ * chunks, and lookups are binary searches. May be used from any thread.
+ */
+class SendTimeline
+{
+public:
+	/// Construct a new, empty timeline.
+	///
+	/// \param chunks the number of most recent sends kept
+	SendTimeline(size_t chunks = WSSC_DEFAULT_SEND_TIMELINE_CHUNKS);
+
+	/// Record a send; ignored unless it extends the timeline.
+	///
+	/// \param end_offset the media offset just past the last byte sent
+	/// \param time when it was sent
+	void sent(uint64_t end_offset, std::chrono::steady_clock::time_point time);
+
+	/// Find when the media up to an offset was sent: the time of the send which
+	/// included the byte just before `offset` (or of the last send, if `offset` is
+	/// past the end of the timeline).
+	///
+	/// \param offset the media offset
+	/// \param time set to the send time, if found
+	/// \return `false` if nothing was sent yet, or that send is no longer kept
+	bool sent_time(uint64_t offset, std::chrono::steady_clock::time_point& time) const;
+
+	/// Return the media offset just past the last byte sent, or 0 if none.
+	uint64_t end_offset() const;
+
+	/// Forget all sends.
+	void clear();
+
+private:
+	struct Send {
+		uint64_t end_offset;
+		std::chrono::steady_clock::time_point time;
+	};
+
+	const Send& at(size_t index) const { return _sends[(_first + index) % _sends.size()]; }
+
+	mutable std::mutex _mutex;
+	std::vector<Send> _sends;
+	size_t _first = 0;
+	size_t _count = 0;
+};
+
+} // namespace
+} // namespace
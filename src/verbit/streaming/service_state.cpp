@@ -1,13 +1,47 @@
+#include <cerrno>
+#include <climits>
+#include <ctime>
 #include <stdexcept>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "service_state.h"
 
 namespace verbit {
 namespace streaming {
 
+static_assert(sizeof(std::atomic<int>) == sizeof(int), "futex needs a plain int atomic");
+
+static int futex_wait(std::atomic<int>* addr, int expected, const struct timespec* timeout)
+{
+	return syscall(SYS_futex, reinterpret_cast<int*>(addr), FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+}
+
+static void futex_wake_all(std::atomic<int>* addr)
+{
+	syscall(SYS_futex, reinterpret_cast<int*>(addr), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+ServiceState::ServiceState() :
+	_state(state_initial),
+	_waiters(0)
+{
+	for (int i = 0; i < num_states; i++) {
+		_entered[i].store(0, std::memory_order_relaxed);
+		_time_in[i].store(0, std::memory_order_relaxed);
+	}
+	_entered[state_initial].store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
 const char* const ServiceState::c_str()
 {
-	switch (_state) {
+	return name(get());
+}
+
+const char* ServiceState::name(int state)
+{
+	switch (state) {
 	case state_initial:
 		return "initial";
 	case state_opening:
@@ -27,59 +61,125 @@ const char* const ServiceState::c_str()
 
 void ServiceState::change(int state)
 {
-	std::unique_lock<std::mutex> mlock(_state_mutex);
-	_state = state;
-	_state_changed.notify_one();
+	int from = _state.exchange(state);
+	transitioned(from, state);
 }
 
-void ServiceState::change_if(int state, int expected_state, bool throw_ex)
+bool ServiceState::change_if(int state, int expected_state, bool throw_ex)
 {
-	std::unique_lock<std::mutex> mlock(_state_mutex);
-	if ((_state != expected_state) && throw_ex) {
-		std::string error = std::string("change_if failed changing state=") + std::to_string(_state)
+	int current = expected_state;
+	if (_state.compare_exchange_strong(current, state)) {
+		transitioned(expected_state, state);
+		return true;
+	}
+	if (throw_ex) {
+		std::string error = std::string("change_if failed changing state=") + std::to_string(current)
 			+ " (expected state=" + std::to_string(expected_state)
 			+ ") to state=" + std::to_string(state);
 		throw std::runtime_error(error);
 	}
-	if (_state == expected_state) {
-		_state = state;
-		_state_changed.notify_one();
-	}
+	return false;
 }
 
 void ServiceState::change_unless(int state, int not_state, bool throw_ex)
 {
-	std::unique_lock<std::mutex> mlock(_state_mutex);
-	if ((_state == not_state) && throw_ex) {
-		std::string error = std::string("change_unless failed changing state=") + std::to_string(_state)
+	int current = get();
+	while (current != not_state) {
+		if (_state.compare_exchange_weak(current, state)) {
+			transitioned(current, state);
+			return;
+		}
+	}
+	if (throw_ex) {
+		std::string error = std::string("change_unless failed changing state=") + std::to_string(current)
 			+ " (not expected) to state=" + std::to_string(state);
 		throw std::runtime_error(error);
 	}
-	if (_state != not_state) {
-		_state = state;
-		_state_changed.notify_one();
-	}
 }
 
 void ServiceState::wait_for(int state, std::chrono::milliseconds timeout)
 {
-	std::unique_lock<std::mutex> mlock(_state_mutex);
-	std::chrono::milliseconds remainingInterval = timeout;
-	std::chrono::system_clock::time_point startTime = std::chrono::system_clock::now();
-	while (state != _state)
-	{
-		auto result = _state_changed.wait_for(mlock, remainingInterval);
-		if (result == std::cv_status::timeout) {
-			break;
-		}
-		else if (state != _state) {
-			// The thread may also be unblocked spuriously, without timeout or notify_one().
-			// In this case, just continue
-			std::chrono::system_clock::time_point currentTime = std::chrono::system_clock::now();
-			auto elapsed = currentTime - startTime;
-			remainingInterval -= std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+	wait(state, true, &timeout);
+}
+
+int ServiceState::wait_while(int state)
+{
+	return wait(state, false, nullptr);
+}
+
+int ServiceState::wait_while(int state, std::chrono::milliseconds timeout)
+{
+	return wait(state, false, &timeout);
+}
+
+std::chrono::steady_clock::duration ServiceState::time_in(int state) const
+{
+	if ((state < 0) || (state >= num_states)) {
+		return std::chrono::steady_clock::duration::zero();
+	}
+	std::chrono::steady_clock::duration total(_time_in[state].load(std::memory_order_relaxed));
+	if (get() == state) {
+		total += std::chrono::steady_clock::now() - entered(state);
+	}
+	return total;
+}
+
+std::chrono::steady_clock::time_point ServiceState::entered(int state) const
+{
+	if ((state < 0) || (state >= num_states)) {
+		return std::chrono::steady_clock::time_point();
+	}
+	return std::chrono::steady_clock::time_point(
+		std::chrono::steady_clock::duration(_entered[state].load(std::memory_order_relaxed)));
+}
+
+// Record the time of a transition (which has already happened), and wake all waiters.
+void ServiceState::transitioned(int from, int to)
+{
+	std::chrono::steady_clock::rep now = std::chrono::steady_clock::now().time_since_epoch().count();
+	if ((from >= 0) && (from < num_states) && (from != to)) {
+		_time_in[from].fetch_add(now - _entered[from].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	if ((to >= 0) && (to < num_states) && (from != to)) {
+		_entered[to].store(now, std::memory_order_relaxed);
+	}
+	if (_recorder) {
+		_recorder->record(FlightEvent::state, from, to);
+	}
+	// the exchange that changed the state and this load are both sequentially consistent,
+	// so either we see the waiter, or the waiter sees the new state before sleeping
+	if (_waiters.load() > 0) {
+		futex_wake_all(&_state);
+	}
+}
+
+// Wait until the state equals (or, if `until_equal` is false, differs from) `state`,
+// or until `timeout` if given. Returns the current state.
+int ServiceState::wait(int state, bool until_equal, const std::chrono::milliseconds* timeout)
+{
+	std::chrono::steady_clock::time_point deadline;
+	if (timeout) {
+		deadline = std::chrono::steady_clock::now() + *timeout;
+	}
+	_waiters.fetch_add(1);
+	int current = _state.load();
+	while ((current == state) != until_equal) {
+		struct timespec ts;
+		if (timeout) {
+			std::chrono::steady_clock::duration remaining = deadline - std::chrono::steady_clock::now();
+			if (remaining <= std::chrono::steady_clock::duration::zero()) {
+				break;
+			}
+			std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining);
+			ts.tv_sec = ns.count() / 1000000000;
+			ts.tv_nsec = ns.count() % 1000000000;
 		}
+		// sleeps only if the state is still `current`; wakes on any transition (or spuriously)
+		futex_wait(&_state, current, timeout ? &ts : nullptr);
+		current = _state.load();
 	}
+	_waiters.fetch_sub(1);
+	return current;
 }
 
 } // namespace
@@ -1,17 +1,27 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
 #include <string>
-#include <mutex>
-#include <condition_variable>
+
+#include <verbit/streaming/flight_recorder.h>
 
 namespace verbit {
 namespace streaming {
 
 /**
  * Class to track the state of the Verbit Transcribe Streaming service.
+ *
+ * The state is a single atomic integer: reading it never blocks, and
+ * transitions are compare-and-exchange operations. Waiters block on the
+ * state itself (with a futex), and every transition wakes all of them.
+ * The time of each transition is recorded, so the time spent in each
+ * state is available as instrumentation.
  */
 class ServiceState {
 public:
 	/// Construct a new service state.
-	ServiceState() : _state(state_initial) { }
+	ServiceState();
 
 	static const int state_initial = 0;  ///< initial state
 	static const int state_opening = 1;  ///< WebSocket is being opened
@@ -21,13 +31,16 @@ public:
 	static const int state_fail = 5;     ///< final state: session failed; end-of-stream event **not** sent
 
 	/// Return the current service state.
-	constexpr int get() { return _state; }
+	int get() const { return _state.load(std::memory_order_acquire); }
 
 	/// Return the current service state as a C string.
 	const char* const c_str();
 
+	/// Return the name of a state, _e.g._ `"open"` for `state_open`.
+	static const char* name(int state);
+
 	/// Is the current service state a final state?
-	constexpr bool is_final() { return (_state == state_closing) || (_state == state_done) || (_state == state_fail); }
+	bool is_final() const { int state = get(); return (state == state_closing) || (state == state_done) || (state == state_fail); }
 
 	/// Change state unconditionally.
 	///
@@ -39,7 +52,8 @@ public:
 	/// \param state the state to change to
 	/// \param expected_state the expected current state
 	/// \param throw_ex if true, throw exception if not currently in expected state; otherwise fail silently
-	void change_if(int state, int expected_state, bool throw_ex);
+	/// \return true if the state was changed
+	bool change_if(int state, int expected_state, bool throw_ex);
 
 	/// Change state **unless** currently in not-expected state.
 	///
@@ -54,10 +68,39 @@ public:
 	/// \param timeout how long to wait before returning anyway
 	void wait_for(int state, std::chrono::milliseconds timeout);
 
+	/// Wait until the state is no longer `state`.
+	///
+	/// \param state the state to wait to leave
+	/// \return the new state
+	int wait_while(int state);
+
+	/// Wait until the state is no longer `state`, or return on timeout.
+	///
+	/// \param state the state to wait to leave
+	/// \param timeout how long to wait before returning anyway
+	/// \return the current state
+	int wait_while(int state, std::chrono::milliseconds timeout);
+
+	/// Return the total time spent in `state` so far, including the current stay in it.
+	std::chrono::steady_clock::duration time_in(int state) const;
+
+	/// Return when `state` was last entered, or a zero time point if never.
+	std::chrono::steady_clock::time_point entered(int state) const;
+
+	/// Set a flight recorder to record each transition in (set before any transition).
+	void flight_recorder(FlightRecorder* recorder) { _recorder = recorder; }
+
 private:
-	int _state;
-	std::mutex _state_mutex;
-	std::condition_variable _state_changed;
+	static const int num_states = state_fail + 1;
+
+	std::atomic<int> _state;
+	std::atomic<int> _waiters;
+	std::atomic<std::chrono::steady_clock::rep> _entered[num_states];
+	std::atomic<std::chrono::steady_clock::rep> _time_in[num_states];
+	FlightRecorder* _recorder = nullptr;
+
+	void transitioned(int from, int to);
+	int wait(int state, bool until_equal, const std::chrono::milliseconds* timeout);
 };
 
 } // namespace
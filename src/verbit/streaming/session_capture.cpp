@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "session_capture.h"
+
+namespace verbit {
+namespace streaming {
+
+namespace {
+
+struct FileHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint64_t start_time_us;
+};
+
+struct RecordHeader {
+	uint32_t length;
+	uint8_t kind;
+	uint8_t reserved[3];
+	uint64_t time_us;
+};
+
+static_assert(sizeof(FileHeader) == 16, "capture file header must be 16 bytes");
+static_assert(sizeof(RecordHeader) == 16, "capture record header must be 16 bytes");
+
+const size_t ALIGN = 8;
+
+size_t _padding(size_t len)
+{
+	return (ALIGN - (len % ALIGN)) % ALIGN;
+}
+
+} // anonymous namespace
+
+SessionRecorder::SessionRecorder(const std::string& path)
+	: _out(path), _start(std::chrono::steady_clock::now())
+{
+	FileHeader header;
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.reserved = 0;
+	header.start_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	_out.append((const char*)&header, sizeof(header));
+}
+
+void SessionRecorder::record(CaptureRecord::Kind kind, const char* data, size_t len)
+{
+	static const char zeros[ALIGN] = {0};
+	if (len > UINT32_MAX) {
+		throw std::runtime_error("message too long to record");
+	}
+	RecordHeader header;
+	header.length = (uint32_t)len;
+	header.kind = (uint8_t)kind;
+	memset(header.reserved, 0, sizeof(header.reserved));
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	header.time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - _start).count();
+	_out.append((const char*)&header, sizeof(header));
+	_out.append(data, len);
+	_out.append(zeros, _padding(len));
+	_records++;
+}
+
+void SessionRecorder::close()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_out.close();
+}
+
+uint64_t SessionRecorder::records()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _records;
+}
+
+SessionCapture::SessionCapture(const std::string& path)
+	: _path(path)
+{
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::runtime_error(std::string("can't open ") + path + ": " + strerror(errno));
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		int err = errno;
+		::close(fd);
+		throw std::runtime_error(std::string("can't stat ") + path + ": " + strerror(err));
+	}
+	if ((size_t)st.st_size < sizeof(FileHeader)) {
+		::close(fd);
+		throw std::runtime_error(path + " is not a session capture");
+	}
+	void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	int err = errno;
+	::close(fd);
+	if (data == MAP_FAILED) {
+		throw std::runtime_error(std::string("can't map ") + path + ": " + strerror(err));
+	}
+	_data = (const char*)data;
+	_size = st.st_size;
+
+	FileHeader header;
+	memcpy(&header, _data, sizeof(header));
+	if ( (header.magic != SessionRecorder::MAGIC) || (header.version != SessionRecorder::VERSION) ) {
+		munmap((void*)_data, _size);
+		throw std::runtime_error(path + " is not a session capture (or not this version)");
+	}
+	_start_time_us = header.start_time_us;
+	_pos = sizeof(header);
+}
+
+SessionCapture::~SessionCapture()
+{
+	munmap((void*)_data, _size);
+}
+
+bool SessionCapture::next(CaptureRecord& record)
+{
+	if (_pos == _size) {
+		return false;
+	}
+	RecordHeader header;
+	if (_size - _pos < sizeof(header)) {
+		throw std::runtime_error(_path + ": truncated record header at " + std::to_string(_pos));
+	}
+	memcpy(&header, _data + _pos, sizeof(header));
+	size_t payload = _pos + sizeof(header);
+	if ( (header.kind < CaptureRecord::media) || (header.kind > CaptureRecord::response) ) {
+		throw std::runtime_error(_path + ": bad record kind at " + std::to_string(_pos));
+	}
+	if (_size - payload < header.length) {
+		throw std::runtime_error(_path + ": truncated record at " + std::to_string(_pos));
+	}
+	record.kind = (CaptureRecord::Kind)header.kind;
+	record.time_us = header.time_us;
+	record.data = _data + payload;
+	record.length = header.length;
+	_pos = std::min(_size, payload + header.length + _padding(header.length));
+	return true;
+}
+
+void SessionCapture::rewind()
+{
+	_pos = sizeof(FileHeader);
+}
+
+} // namespace
+} // namespace
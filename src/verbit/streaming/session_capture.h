@@ -0,0 +1,154 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <verbit/streaming/async_file_writer.h>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct describing one record of a session capture file.
+ */
+struct CaptureRecord {
+	/// What a record holds.
+	enum Kind {
+		media = 1,     ///< a media (binary) message sent by the client
+		event = 2,     ///< a text message sent by the client, _e.g._ the EOS event
+		response = 3   ///< a response (text) message received by the client
+	};
+
+	/// What the record holds.
+	Kind kind = media;
+
+	/// When the message was sent or received, in microseconds from the start of the capture
+	/// (by the monotonic clock).
+	uint64_t time_us = 0;
+
+	/// The message payload (in the capture memory; not NUL-terminated).
+	const char* data = nullptr;
+
+	/// The payload length, in bytes.
+	size_t length = 0;
+};
+
+/**
+ * Class recording a session to a capture file: the messages the client sends
+ * and receives, with monotonic timestamps.
+ *
+ * The capture format is compact, and laid out to be read in place from a
+ * memory map (see `SessionCapture`): a 16-byte header (magic `VBSC`, version,
+ * and the wall clock start time), then for each message a 16-byte record
+ * header (payload length, kind and time) and the payload, padded to 8 bytes.
+ * Numbers are in the host (little-endian) byte order.
+ *
+ * ```
+ * SessionRecorder recorder {"session.vbsc"};
+ * client.session_recorder(&recorder);   // before running the stream
+ * client.run_stream(media);
+ * recorder.close();
+ * ```
+ *
+ * Records are written through an `AsyncFileWriter`, so recording does not
+ * wait for the disk. A recorder may be used from several threads.
+ */
+class SessionRecorder
+{
+public:
+	/// The capture file magic number.
+	static const uint32_t MAGIC = 0x43534256;  // "VBSC"
+
+	/// The capture format version.
+	static const uint16_t VERSION = 1;
+
+	/// Construct a new session recorder, creating (or truncating) the capture file.
+	///
+	/// \param path the capture file path
+	/// \throws std::runtime_error if the file can't be opened
+	SessionRecorder(const std::string& path);
+
+	/// Record a message.
+	///
+	/// \param kind what the message is
+	/// \param data the message payload
+	/// \param len the payload length, in bytes
+	/// \throws std::runtime_error if writing the file failed
+	void record(CaptureRecord::Kind kind, const char* data, size_t len);
+
+	/// Write out all records, and close the capture file.
+	///
+	/// \throws std::runtime_error if writing the file failed
+	void close();
+
+	/// Return the number of messages recorded.
+	uint64_t records();
+
+private:
+	SessionRecorder(const SessionRecorder&) = delete;
+	SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+	std::mutex _mutex;
+	AsyncFileWriter _out;
+	std::chrono::steady_clock::time_point _start;
+	uint64_t _records = 0;
+};
+
+/**
+ * Class reading a session capture file, in place, from a memory map.
+ *
+ * ```
+ * SessionCapture capture {"session.vbsc"};
+ * CaptureRecord record;
+ * while (capture.next(record)) {
+ *     if (record.kind == CaptureRecord::response) {
+ *         ...
+ *     }
+ * }
+ * ```
+ *
+ * Record payloads stay valid as long as the capture.
+ */
+class SessionCapture
+{
+public:
+	/// Open and map a capture file, and check its header.
+	///
+	/// \param path the capture file path
+	/// \throws std::runtime_error if the file can't be mapped, or is not a capture
+	SessionCapture(const std::string& path);
+
+	/// Unmap the capture file.
+	~SessionCapture();
+
+	/// Read the next record.
+	///
+	/// \param record the record to fill
+	/// \return `false` at the end of the capture
+	/// \throws std::runtime_error if the record is truncated, or malformed
+	bool next(CaptureRecord& record);
+
+	/// Go back to the first record.
+	void rewind();
+
+	/// Return the wall clock time the capture started, in microseconds since the Unix epoch.
+	uint64_t start_time_us() const { return _start_time_us; }
+
+	/// Return the capture size, in bytes.
+	size_t size() const { return _size; }
+
+private:
+	SessionCapture(const SessionCapture&) = delete;
+	SessionCapture& operator=(const SessionCapture&) = delete;
+
+	std::string _path;
+	const char* _data = nullptr;
+	size_t _size = 0;
+	size_t _pos = 0;
+	uint64_t _start_time_us = 0;
+};
+
+} // namespace
+} // namespace
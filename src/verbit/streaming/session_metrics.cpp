@@ -0,0 +1,49 @@
+#include "session_metrics.h"
+
+namespace verbit {
+namespace streaming {
+
+void SessionMetrics::merge(const SessionMetrics& other)
+{
+	bytes_sent.add(other.bytes_sent.value());
+	frames_sent.add(other.frames_sent.value());
+	send_errors.add(other.send_errors.value());
+	bytes_gated.add(other.bytes_gated.value());
+	send_latency.merge(other.send_latency);
+	buffered_amount.merge(other.buffered_amount);
+	for (int i = 0; i < response_kinds; i++) {
+		responses[i].add(other.responses[i].value());
+	}
+	parse_time.merge(other.parse_time);
+	handler_time.merge(other.handler_time);
+	emission_latency.merge(other.emission_latency);
+	pings.add(other.pings.value());
+	connect_attempts.add(other.connect_attempts.value());
+	reconnects.add(other.reconnects.value());
+	for (int i = 0; i < STATES; i++) {
+		time_in_state[i] += other.time_in_state[i];
+	}
+}
+
+SessionMetrics::ResponseKind SessionMetrics::response_kind(const StringRef& type)
+{
+	if (type == "captions") {
+		return response_captions;
+	}
+	if (type == "transcript") {
+		return response_transcript;
+	}
+	return response_other;
+}
+
+const char* SessionMetrics::response_kind_name(ResponseKind kind)
+{
+	switch (kind) {
+	case response_captions: return "captions";
+	case response_transcript: return "transcript";
+	default: return "other";
+	}
+}
+
+} // namespace
+} // namespace
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <verbit/streaming/histogram.h>
+#include <verbit/streaming/response.h>
+#include <verbit/streaming/service_state.h>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Class counting events, lock-free, from any thread.
+ *
+ * Copying a counter takes a snapshot of it.
+ */
+class Counter
+{
+public:
+	/// Construct a new counter at 0.
+	Counter() : _value(0) { }
+
+	/// Construct a snapshot of another counter.
+	Counter(const Counter& other) : _value(other.value()) { }
+
+	/// Replace this counter with a snapshot of another counter.
+	Counter& operator=(const Counter& other) { _value.store(other.value(), std::memory_order_relaxed); return *this; }
+
+	/// Add to the count.
+	void add(uint64_t n = 1) { _value.fetch_add(n, std::memory_order_relaxed); }
+
+	/// Return the count.
+	uint64_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> _value;
+};
+
+/**
+ * Struct holding the metrics of a session (or, from `MetricsRegistry::snapshot()`,
+ * the totals of all sessions in a process).
+ *
+ * The client updates the counters and histograms as it goes, with relaxed atomic
+ * operations, and `WebSocketStreamingClient::metrics()` returns a snapshot.
+ */
+struct SessionMetrics {
+	/// Response types counted separately in `responses`.
+	enum ResponseKind {
+		response_captions,    ///< `captions` responses
+		response_transcript,  ///< `transcript` responses
+		response_other,       ///< responses of any other type, or with no `response`
+		response_kinds
+	};
+
+	/// The number of `ServiceState` states, for `time_in_state`.
+	static const int STATES = ServiceState::state_fail + 1;
+
+	/// Media bytes sent (including media sent again after reconnecting).
+	Counter bytes_sent;
+
+	/// Media messages (WebSocket frames) sent.
+	Counter frames_sent;
+
+	/// Media sends which failed.
+	Counter send_errors;
+
+	/// Media bytes of silence not sent, by the voice gate.
+	Counter bytes_gated;
+
+	/// The time each media send call took, in microseconds.
+	Histogram send_latency;
+
+	/// The send queue size (`get_buffered_amount()`), in bytes, sampled before each media read.
+	Histogram buffered_amount;
+
+	/// Responses received, by `ResponseKind`.
+	Counter responses[response_kinds];
+
+	/// The time each response took to parse into a typed response, in microseconds
+	/// (responses are only parsed for a typed handler, or in resilient mode).
+	Histogram parse_time;
+
+	/// The time the response handler(s) took for each response, in microseconds
+	/// (including the JSON parse for a `set_response_handler()` handler).
+	Histogram handler_time;
+
+	/// The emission latency of each response: from when the audio up to the end of its last
+	/// item was sent, until the response arrived, in microseconds (only responses parsed on
+	/// the I/O thread; see `WebSocketStreamingClient::track_latency()`).
+	Histogram emission_latency;
+
+	/// Pings received.
+	Counter pings;
+
+	/// WebSocket connect attempts, including retries and reconnects.
+	Counter connect_attempts;
+
+	/// Reconnects begun after an unexpected close, in resilient mode.
+	Counter reconnects;
+
+	/// The time spent in each `ServiceState` state (filled in by snapshots).
+	std::chrono::microseconds time_in_state[STATES] {};
+
+	/// Add the metrics of another session to these.
+	void merge(const SessionMetrics& other);
+
+	/// Return the response kind of a response type, _e.g._ `response_captions` for `"captions"`.
+	static ResponseKind response_kind(const StringRef& type);
+
+	/// Return the name of a response kind, _e.g._ `"captions"`.
+	static const char* response_kind_name(ResponseKind kind);
+};
+
+} // namespace
+} // namespace
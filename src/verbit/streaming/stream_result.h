@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct holding the outcome of a finished streaming session.
+ */
+struct StreamResult {
+	/// The numeric error code; see `WebSocketStreamingClient::error_code()`.
+	int error_code = 0;
+
+	/// The service-level error message; see `WebSocketStreamingClient::service_error()`.
+	std::string service_error;
+
+	/// Did the session finish without error?
+	bool ok() const { return (error_code == 0); }
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct holding the times at which one WebSocket connect attempt reached each phase.
+ *
+ * WebSocket++ reports no event between DNS resolution and TCP connect, so
+ * `tcp_connected - start` covers both.
+ */
+struct ConnectAttempt {
+	typedef std::chrono::steady_clock::time_point time_point;
+
+	/// When the attempt was queued (DNS resolution starts).
+	time_point start;
+
+	/// When the TCP connection was established.
+	time_point tcp_connected;
+
+	/// When the TLS handshake completed (HTTP upgrade starts).
+	time_point tls_done;
+
+	/// When the attempt opened the WebSocket, or failed.
+	time_point end;
+
+	/// Did the attempt open the WebSocket?
+	bool ok = false;
+};
+
+/**
+ * Struct holding the times at which a streaming session reached each phase.
+ *
+ * A phase the session did not reach has a default-constructed (zero) time point.
+ */
+struct StreamTimes {
+	typedef std::chrono::steady_clock::time_point time_point;
+
+	/// When the first WebSocket connect was queued.
+	time_point connect;
+
+	/// When the WebSocket opened.
+	time_point open;
+
+	/// When the first media chunk was sent.
+	time_point first_send;
+
+	/// When the end-of-stream event was (first) sent.
+	time_point eos;
+
+	/// When the session finished (closed or failed).
+	time_point finish;
+
+	/// The timing of each WebSocket connect attempt, in order.
+	std::vector<ConnectAttempt> attempts;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,188 @@
+#include "streaming_engine.h"
+#include "ws_streaming_client.h"
+
+namespace verbit {
+namespace streaming {
+
+StreamingEngine::StreamingEngine() :
+	_timers(std::chrono::milliseconds(WSSC_TIMER_RESOLUTION_MS)),
+	_tick_timer(_io_service)
+{
+	// initialize WebSocket++ on the shared io_service and set transport handlers;
+	// all other handlers are set per connection by each WebSocketStreamingClient
+#if defined(DEBUG)
+	_ws_endpoint.set_access_channels(websocketpp::log::alevel::all);
+#if !defined(VERBOSE_DEBUG)
+	_ws_endpoint.clear_access_channels(websocketpp::log::alevel::frame_payload);
+	_ws_endpoint.clear_access_channels(websocketpp::log::alevel::frame_header);
+#endif
+	_ws_endpoint.set_error_channels(websocketpp::log::elevel::all);
+#else
+	_ws_endpoint.clear_access_channels(websocketpp::log::alevel::all);
+	_ws_endpoint.clear_error_channels(websocketpp::log::elevel::all);
+#endif
+	_ws_endpoint.init_asio(&_io_service);
+	_ws_endpoint.set_socket_init_handler(bind(&StreamingEngine::on_socket_init, this, websocketpp::lib::placeholders::_1));
+	_ws_endpoint.set_tls_init_handler(bind(&StreamingEngine::on_tls_init, this, websocketpp::lib::placeholders::_1));
+}
+
+StreamingEngine::~StreamingEngine()
+{
+	stop();
+}
+
+void StreamingEngine::start(size_t num_threads)
+{
+	if (!_threads.empty()) {
+		throw std::runtime_error("streaming engine is already started");
+	}
+	if (num_threads == 0) {
+		throw std::runtime_error("streaming engine requires at least one I/O thread");
+	}
+	_io_service.reset();
+	_work.reset(new boost::asio::io_service::work(_io_service));
+	schedule_tick();
+	for (size_t i = 0; i < num_threads; i++) {
+		_threads.push_back(std::thread(&StreamingEngine::run_io, this));
+	}
+}
+
+void StreamingEngine::run()
+{
+	schedule_tick();
+	run_io();
+}
+
+void StreamingEngine::stop()
+{
+	boost::system::error_code ec;
+	_tick_timer.cancel(ec);
+	_work.reset();
+	_io_service.stop();
+	for (std::thread& t : _threads) {
+		if (t.get_id() == std::this_thread::get_id()) {
+			// stop() called from an I/O thread (_e.g._ from a handler): can't join ourselves
+			t.detach();
+		} else if (t.joinable()) {
+			t.join();
+		}
+	}
+	_threads.clear();
+}
+
+size_t StreamingEngine::num_sessions()
+{
+	std::unique_lock<std::mutex> lock(_sessions_mutex);
+	return _sessions.size();
+}
+
+// NOTE: WebSocket++ calls the TLS init handler synchronously from within
+// `get_connection()`, before the caller can learn the new connection handle;
+// so the client being connected is noted here for `on_tls_init()`.
+wspp_client::connection_ptr StreamingEngine::get_connection(WebSocketStreamingClient* client,
+	const std::string& url, websocketpp::lib::error_code& ec)
+{
+	std::unique_lock<std::mutex> lock(_connect_mutex);
+	_connecting_client = client;
+	wspp_client::connection_ptr con = _ws_endpoint.get_connection(url, ec);
+	_connecting_client = nullptr;
+	if (!ec) {
+		attach(con->get_handle(), client);
+	}
+	return con;
+}
+
+void StreamingEngine::attach(websocketpp::connection_hdl hdl, WebSocketStreamingClient* client)
+{
+	std::unique_lock<std::mutex> lock(_sessions_mutex);
+	_sessions[hdl] = client;
+}
+
+void StreamingEngine::detach(websocketpp::connection_hdl hdl)
+{
+	std::unique_lock<std::mutex> lock(_sessions_mutex);
+	_sessions.erase(hdl);
+}
+
+WebSocketStreamingClient* StreamingEngine::find_session(websocketpp::connection_hdl hdl)
+{
+	std::unique_lock<std::mutex> lock(_sessions_mutex);
+	session_map::iterator it = _sessions.find(hdl);
+	return (it == _sessions.end()) ? nullptr : it->second;
+}
+
+// TLS contexts are shared by all sessions with the same verification behavior,
+// rather than being rebuilt for every connection
+wspp_context_ptr StreamingEngine::tls_context(bool verify_ssl_cert)
+{
+	std::unique_lock<std::mutex> lock(_tls_mutex);
+	wspp_context_ptr& ctx = verify_ssl_cert ? _tls_ctx_verify : _tls_ctx_no_verify;
+	if (!ctx) {
+		ctx = websocketpp::lib::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tlsv12);
+		if (!verify_ssl_cert) {
+			ctx->set_verify_mode(boost::asio::ssl::verify_none);
+		}
+		ctx->set_options(boost::asio::ssl::context::default_workarounds |
+		                 boost::asio::ssl::context::no_sslv2 |
+		                 boost::asio::ssl::context::no_sslv3 |
+		                 boost::asio::ssl::context::no_tlsv1 |
+		                 boost::asio::ssl::context::single_dh_use);
+	}
+	return ctx;
+}
+
+// An exception from a handler only unwinds this thread's call of `run()`, which is
+// restarted (no reset is needed), so the thread goes on serving the other sessions.
+void StreamingEngine::run_io()
+{
+	while (true) {
+		try {
+			_io_service.run();
+			return;
+		} catch (std::exception & e) {
+			_ws_endpoint.get_elog().write(websocketpp::log::elevel::rerror,
+				std::string("StreamingEngine I/O thread exception: ") + e.what());
+		} catch (...) {
+			_ws_endpoint.get_elog().write(websocketpp::log::elevel::rerror,
+				"StreamingEngine I/O thread exception");
+		}
+	}
+}
+
+void StreamingEngine::schedule_tick()
+{
+	_tick_timer.expires_from_now(_timers.resolution());
+	_tick_timer.async_wait(bind(&StreamingEngine::on_tick, this, websocketpp::lib::placeholders::_1));
+}
+
+void StreamingEngine::on_tick(const boost::system::error_code& ec)
+{
+	if (ec == boost::asio::error::operation_aborted) {
+		return;
+	}
+	_timers.advance();
+	schedule_tick();
+}
+
+void StreamingEngine::on_socket_init(websocketpp::connection_hdl hdl)
+{
+	WebSocketStreamingClient* client = find_session(hdl);
+	if (client) {
+		client->on_socket_init(hdl);
+	}
+}
+
+wspp_context_ptr StreamingEngine::on_tls_init(websocketpp::connection_hdl hdl)
+{
+	WebSocketStreamingClient* client = _connecting_client;
+	if (!client) {
+		client = find_session(hdl);
+	}
+	if (client) {
+		return client->on_tls_init(hdl);
+	}
+	return tls_context(true);
+}
+
+} // namespace
+} // namespace
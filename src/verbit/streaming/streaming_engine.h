@@ -0,0 +1,123 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <websocketpp/config/asio_client.hpp>
+#include <websocketpp/client.hpp>
+
+#include <verbit/streaming/timer_wheel.h>
+
+#define WSSC_DEFAULT_ENGINE_THREADS 2
+#define WSSC_TIMER_RESOLUTION_MS 50
+
+namespace verbit {
+namespace streaming {
+
+typedef websocketpp::client<websocketpp::config::asio_tls_client> wspp_client;
+typedef websocketpp::config::asio_tls_client::message_type wspp_message;
+typedef wspp_message::ptr wspp_message_ptr;
+typedef websocketpp::lib::shared_ptr<boost::asio::ssl::context> wspp_context_ptr;
+
+class WebSocketStreamingClient;
+
+/**
+ * Class to run many streaming sessions over one shared WebSocket endpoint.
+ *
+ * A `StreamingEngine` owns a single ASIO `io_service`, a single WebSocket++
+ * endpoint, and a small, fixed pool of I/O threads. Any number of
+ * `WebSocketStreamingClient` sessions can be attached to it; their network
+ * events are multiplexed over the shared I/O threads instead of each session
+ * running its own reactor. Session timers (keepalive, end-of-stream reply
+ * and connect retry) all live on one shared `TimerWheel`, driven by a single
+ * ASIO timer.
+ *
+ * ```
+ * StreamingEngine engine;
+ * engine.start(2);
+ * WebSocketStreamingClient client {access_token, engine};
+ * ```
+ *
+ * **NOTE** All clients attached to an engine must be destroyed before the engine.
+ */
+class StreamingEngine
+{
+public:
+	/// Construct a new streaming engine. No I/O threads are started until `start()` is called.
+	StreamingEngine();
+
+	/// Stop the I/O threads and destruct the streaming engine.
+	~StreamingEngine();
+
+	/// Start the pool of I/O threads.
+	/// The threads keep running (even with no sessions attached) until `stop()` is called.
+	///
+	/// \param num_threads the number of I/O threads to run
+	void start(size_t num_threads = WSSC_DEFAULT_ENGINE_THREADS);
+
+	/// Run the I/O loop on the calling thread.
+	///
+	/// **NOTE** This method will not return until `stop()` is called, or there is no more I/O work.
+	void run();
+
+	/// Stop the I/O loop and join the I/O threads.
+	void stop();
+
+	/// Return the number of I/O threads started by `start()`.
+	size_t num_threads() { return _threads.size(); }
+
+	/// Return the number of sessions currently attached to the shared endpoint.
+	size_t num_sessions();
+
+	/// Return the shared ASIO `io_service`.
+	boost::asio::io_service& io_service() { return _io_service; }
+
+	/// Return the shared WebSocket++ endpoint.
+	wspp_client& endpoint() { return _ws_endpoint; }
+
+	/// Return the shared timer wheel.
+	/// Its timers fire on the engine's I/O threads, with `WSSC_TIMER_RESOLUTION_MS` resolution.
+	TimerWheel& timers() { return _timers; }
+
+private:
+	friend class WebSocketStreamingClient;
+
+	typedef std::map<websocketpp::connection_hdl, WebSocketStreamingClient*,
+		std::owner_less<websocketpp::connection_hdl>> session_map;
+
+	boost::asio::io_service _io_service;
+	std::unique_ptr<boost::asio::io_service::work> _work;
+	wspp_client _ws_endpoint;
+	std::vector<std::thread> _threads;
+	TimerWheel _timers;
+	boost::asio::steady_timer _tick_timer;
+
+	std::mutex _sessions_mutex;
+	session_map _sessions;
+
+	std::mutex _connect_mutex;
+	WebSocketStreamingClient* _connecting_client = nullptr;
+
+	std::mutex _tls_mutex;
+	wspp_context_ptr _tls_ctx_verify;
+	wspp_context_ptr _tls_ctx_no_verify;
+
+	wspp_client::connection_ptr get_connection(WebSocketStreamingClient* client, const std::string& url,
+		websocketpp::lib::error_code& ec);
+	void attach(websocketpp::connection_hdl hdl, WebSocketStreamingClient* client);
+	void detach(websocketpp::connection_hdl hdl);
+	WebSocketStreamingClient* find_session(websocketpp::connection_hdl hdl);
+	wspp_context_ptr tls_context(bool verify_ssl_cert);
+	void run_io();
+	void schedule_tick();
+	void on_tick(const boost::system::error_code& ec);
+
+	void on_socket_init(websocketpp::connection_hdl hdl);
+	wspp_context_ptr on_tls_init(websocketpp::connection_hdl hdl);
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,188 @@
+#include <stdexcept>
+
+#include "timer_wheel.h"
+
+namespace verbit {
+namespace streaming {
+
+WheelTimer::~WheelTimer()
+{
+	if (_owner) {
+		_owner->cancel(*this);
+	}
+}
+
+TimerWheel::TimerWheel(std::chrono::milliseconds resolution, std::chrono::steady_clock::time_point start) :
+	_resolution(resolution),
+	_start(start),
+	_current_tick(0),
+	_size(0),
+	_running(nullptr)
+{
+	if (resolution.count() <= 0) {
+		throw std::runtime_error("timer wheel resolution must be positive");
+	}
+}
+
+TimerWheel::~TimerWheel()
+{
+	// detach any timers still armed, so their destructors don't refer back to us
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (int level = 0; level < LEVELS; level++) {
+		for (int i = 0; i < LEVEL_SLOTS; i++) {
+			WheelTimer& head = _slots[level][i].head;
+			while (head._next != &head) {
+				WheelTimer* timer = head._next;
+				unlink(*timer);
+				timer->_owner = nullptr;
+			}
+		}
+	}
+}
+
+void TimerWheel::arm(WheelTimer& timer, std::chrono::milliseconds delay, std::function<void()> callback)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (timer._wheel) {
+		unlink(timer);
+	}
+	// round up to whole ticks, and always fire on a later tick than the current one
+	int64_t ticks = (delay.count() + _resolution.count() - 1) / _resolution.count();
+	if (ticks < 1) {
+		ticks = 1;
+	}
+	timer._expiry_tick = _current_tick + ticks;
+	timer._callback = std::move(callback);
+	timer._owner = this;
+	place(timer);
+}
+
+bool TimerWheel::cancel(WheelTimer& timer)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	bool was_armed = (timer._wheel != nullptr);
+	if (was_armed) {
+		unlink(timer);
+	}
+	// don't return while the callback is running on another thread
+	// (it is fine to cancel a timer from within its own callback)
+	if (_running == &timer && _running_thread != std::this_thread::get_id()) {
+		_callback_done.wait(lock, [this, &timer]{ return _running != &timer; });
+		// the callback may have re-armed the timer
+		if (timer._wheel) {
+			unlink(timer);
+		}
+	}
+	return was_armed;
+}
+
+size_t TimerWheel::advance(std::chrono::steady_clock::time_point now)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	size_t fired = 0;
+	if (now < _start) {
+		return fired;
+	}
+	uint64_t target_tick = (now - _start) / _resolution;
+	while (_current_tick < target_tick) {
+		_current_tick++;
+
+		// cascade coarser levels whose slot has come around, highest level first
+		int top = 0;
+		while ((top + 1 < LEVELS) && ((_current_tick & ((1ULL << (LEVEL_BITS * (top + 1))) - 1)) == 0)) {
+			top++;
+		}
+		for (int level = top; level > 0; level--) {
+			cascade(level);
+		}
+
+		// move the timers due on this tick to the due list
+		WheelTimer& head = _slots[0][_current_tick & (LEVEL_SLOTS - 1)].head;
+		while (head._next != &head) {
+			WheelTimer* timer = head._next;
+			unlink(*timer);
+			timer->_wheel = this;
+			timer->_prev = _due.head._prev;
+			timer->_next = &_due.head;
+			_due.head._prev->_next = timer;
+			_due.head._prev = timer;
+			_size++;
+		}
+
+		// fire them one at a time, without holding the lock during the callback
+		while (_due.head._next != &_due.head) {
+			WheelTimer* timer = _due.head._next;
+			unlink(*timer);
+			std::function<void()> callback = std::move(timer->_callback);
+			_running = timer;
+			_running_thread = std::this_thread::get_id();
+			lock.unlock();
+			callback();
+			lock.lock();
+			_running = nullptr;
+			_callback_done.notify_all();
+			fired++;
+		}
+	}
+	return fired;
+}
+
+size_t TimerWheel::size()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _size;
+}
+
+void TimerWheel::place(WheelTimer& timer)
+{
+	uint64_t expiry = timer._expiry_tick;
+	uint64_t delta = (expiry > _current_tick) ? (expiry - _current_tick) : 0;
+	int level = 0;
+	while ((level + 1 < LEVELS) && (delta >= (1ULL << (LEVEL_BITS * (level + 1))))) {
+		level++;
+	}
+	if (delta >= (1ULL << (LEVEL_BITS * LEVELS))) {
+		// beyond the range of the wheel: park it in the last slot of the top level;
+		// it will be placed again (with its real expiry) when that slot cascades
+		expiry = _current_tick + (1ULL << (LEVEL_BITS * LEVELS)) - 1;
+	}
+	WheelTimer& head = _slots[level][(expiry >> (LEVEL_BITS * level)) & (LEVEL_SLOTS - 1)].head;
+	timer._wheel = this;
+	timer._prev = head._prev;
+	timer._next = &head;
+	head._prev->_next = &timer;
+	head._prev = &timer;
+	_size++;
+}
+
+void TimerWheel::unlink(WheelTimer& timer)
+{
+	timer._prev->_next = timer._next;
+	timer._next->_prev = timer._prev;
+	timer._prev = timer._next = nullptr;
+	timer._wheel = nullptr;
+	_size--;
+}
+
+void TimerWheel::cascade(int level)
+{
+	WheelTimer& head = _slots[level][(_current_tick >> (LEVEL_BITS * level)) & (LEVEL_SLOTS - 1)].head;
+	// detach the whole slot first, since timers may be placed back into this level
+	WheelTimer pending;
+	if (head._next == &head) {
+		return;
+	}
+	pending._next = head._next;
+	pending._prev = head._prev;
+	pending._next->_prev = &pending;
+	pending._prev->_next = &pending;
+	head._prev = head._next = &head;
+	while (pending._next != &pending) {
+		WheelTimer* timer = pending._next;
+		unlink(*timer);
+		place(*timer);
+	}
+}
+
+} // namespace
+} // namespace
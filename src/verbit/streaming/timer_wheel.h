@@ -0,0 +1,122 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace verbit {
+namespace streaming {
+
+class TimerWheel;
+
+/**
+ * Class for a timer that can be armed on a `TimerWheel`.
+ *
+ * The timer is an intrusive list node, so arming and cancelling are O(1).
+ * The destructor cancels the timer (waiting for its callback, if running);
+ * the wheel it was armed on must outlive it.
+ */
+class WheelTimer
+{
+public:
+	WheelTimer() { }
+	~WheelTimer();
+
+	/// Is this timer currently armed (waiting to fire)?
+	bool armed() const { return _wheel != nullptr; }
+
+private:
+	friend class TimerWheel;
+
+	WheelTimer(const WheelTimer&) = delete;
+	WheelTimer& operator=(const WheelTimer&) = delete;
+
+	TimerWheel* _wheel = nullptr;  // wheel this timer is armed on, or `nullptr`
+	TimerWheel* _owner = nullptr;  // wheel this timer was last armed on
+	WheelTimer* _prev = nullptr;
+	WheelTimer* _next = nullptr;
+	uint64_t _expiry_tick = 0;
+	std::function<void()> _callback;
+};
+
+/**
+ * Class implementing a hierarchical timer wheel.
+ *
+ * Time is divided into ticks of a fixed resolution. Timers due within the next
+ * 64 ticks live in the first level of 64 slots; timers due further out live in
+ * coarser levels and are cascaded down as time advances. Arming and cancelling
+ * a timer is O(1); advancing the wheel costs O(1) per tick plus the timers
+ * that fire or cascade.
+ *
+ * The wheel does not run by itself: its owner calls `advance()` periodically
+ * (see `StreamingEngine`). Callbacks run on the thread calling `advance()`.
+ */
+class TimerWheel
+{
+public:
+	static const int LEVEL_BITS = 6;
+	static const int LEVEL_SLOTS = 1 << LEVEL_BITS;  ///< slots per level
+	static const int LEVELS = 4;                     ///< levels; 64^4 ticks covers days at 50ms resolution
+
+	/// Construct a new timer wheel.
+	///
+	/// \param resolution the duration of one tick
+	/// \param start the time of tick zero
+	TimerWheel(std::chrono::milliseconds resolution,
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now());
+
+	~TimerWheel();
+
+	/// Return the duration of one tick.
+	std::chrono::milliseconds resolution() { return _resolution; }
+
+	/// Arm (or re-arm) a timer.
+	/// If the timer is already armed, it is moved to the new expiry time.
+	///
+	/// \param timer the timer to arm
+	/// \param delay how long from now until the timer fires (rounded up to whole ticks)
+	/// \param callback the function to call when the timer fires
+	void arm(WheelTimer& timer, std::chrono::milliseconds delay, std::function<void()> callback);
+
+	/// Cancel a timer.
+	/// If the timer's callback is running on another thread, this waits for it to return.
+	///
+	/// \return `true` if the timer was armed and will no longer fire
+	bool cancel(WheelTimer& timer);
+
+	/// Advance the wheel to the given time, firing all timers that are due.
+	///
+	/// \return the number of timers fired
+	size_t advance(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+	/// Return the number of armed timers.
+	size_t size();
+
+private:
+	struct Slot {
+		WheelTimer head;  // sentinel of a circular list
+		Slot() { head._prev = head._next = &head; }
+	};
+
+	std::chrono::milliseconds _resolution;
+	std::chrono::steady_clock::time_point _start;
+	uint64_t _current_tick;
+	size_t _size;
+	Slot _slots[LEVELS][LEVEL_SLOTS];
+	Slot _due;
+
+	std::mutex _mutex;
+	std::condition_variable _callback_done;
+	WheelTimer* _running;
+	std::thread::id _running_thread;
+
+	void place(WheelTimer& timer);
+	void unlink(WheelTimer& timer);
+	void cascade(int level);
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "transcript_assembler.h"
+
+namespace verbit {
+namespace streaming {
+
+// final utterances per block
+static const size_t UTTERANCE_BLOCK = 256;
+
+// minimum size of an append-only memory block
+static const size_t MEMORY_BLOCK = 64 * 1024;
+
+struct TranscriptSnapshot::Final {
+	Utterance utterance;
+
+	// the latest end of this and every earlier utterance, for time range searches
+	double max_end;
+};
+
+struct TranscriptSnapshot::Open {
+	Utterance utterance;
+	std::string strings;
+	std::vector<Item> items;
+};
+
+const TranscriptSnapshot::Final& TranscriptSnapshot::at(size_t i) const
+{
+	return (*_blocks)[i / UTTERANCE_BLOCK][i % UTTERANCE_BLOCK];
+}
+
+const Utterance& TranscriptSnapshot::operator[](size_t i) const
+{
+	return at(i).utterance;
+}
+
+const Utterance* TranscriptSnapshot::open() const
+{
+	return _open ? &_open->utterance : nullptr;
+}
+
+std::string TranscriptSnapshot::text() const
+{
+	std::string text;
+	auto append = [&text](const StringRef& transcript) {
+		if (transcript.empty()) {
+			return;
+		}
+		if (!text.empty()) {
+			text += ' ';
+		}
+		text.append(transcript.data, transcript.length);
+	};
+	for (size_t i = 0; i < _count; i++) {
+		append(at(i).utterance.transcript);
+	}
+	if (_open) {
+		append(_open->utterance.transcript);
+	}
+	return text;
+}
+
+std::pair<size_t, size_t> TranscriptSnapshot::find(double start, double end) const
+{
+	// the first utterance ending after `start` (the latest ends never decrease)
+	size_t lo = 0;
+	size_t hi = _count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (at(mid).max_end > start) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	size_t first = lo;
+
+	// the first utterance from there starting at or after `end` (responses come in media order)
+	hi = _count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (at(mid).utterance.start < end) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return std::make_pair(first, std::max(first, lo));
+}
+
+std::vector<Item> TranscriptSnapshot::items(double start, double end) const
+{
+	std::vector<Item> items;
+	auto append = [&](const Utterance& utterance) {
+		for (const Item& item : utterance.items) {
+			if ( (item.end > start) && (item.start < end) ) {
+				items.push_back(item);
+			}
+		}
+	};
+	std::pair<size_t, size_t> range = find(start, end);
+	for (size_t i = range.first; i < range.second; i++) {
+		append(at(i).utterance);
+	}
+	if (_open) {
+		append(_open->utterance);
+	}
+	return items;
+}
+
+TranscriptAssembler::TranscriptAssembler(int type)
+	: _type(type), _blocks(std::make_shared<std::vector<const TranscriptSnapshot::Final*>>())
+{
+	if ( (type != ResponseType::Transcript) && (type != ResponseType::Captions) ) {
+		throw std::runtime_error("transcript assembler needs a single response type");
+	}
+}
+
+TranscriptAssembler::~TranscriptAssembler()
+{
+}
+
+void TranscriptAssembler::add(const Response& response)
+{
+	if ( !response.has_response || !accepts(response) ) {
+		return;
+	}
+	const Alternative* alternative = response.alternatives.empty() ? nullptr : &response.alternatives[0];
+	if (response.is_final || response.is_end_of_stream) {
+		if (alternative) {
+			add_final(*alternative, response.id);
+		}
+		std::unique_lock<std::mutex> lock(_mutex);
+		_has_open = false;
+	} else {
+		set_open(alternative, response.id);
+	}
+}
+
+TranscriptSnapshot TranscriptAssembler::snapshot() const
+{
+	TranscriptSnapshot snapshot;
+	std::unique_lock<std::mutex> lock(_mutex);
+	snapshot._blocks = _blocks;
+	snapshot._count = _count;
+	if (_has_open) {
+		snapshot._open = _open;
+	}
+	return snapshot;
+}
+
+size_t TranscriptAssembler::size() const
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _count;
+}
+
+size_t TranscriptAssembler::item_count() const
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	return _item_count;
+}
+
+bool TranscriptAssembler::accepts(const Response& response) const
+{
+	if (_type == ResponseType::Transcript) {
+		return (response.type == "transcript") || (response.type == "Transcript");
+	}
+	return (response.type == "captions") || (response.type == "Captions");
+}
+
+char* TranscriptAssembler::allocate(size_t size, size_t align)
+{
+	size_t offset = (_memory_used + align - 1) & ~(align - 1);
+	if (_memory.empty() || (offset + size > _memory_size)) {
+		_memory_size = std::max(size, MEMORY_BLOCK);
+		_memory.emplace_back(new char[_memory_size]);
+		offset = 0;
+	}
+	_memory_used = offset + size;
+	return _memory.back().get() + offset;
+}
+
+StringRef TranscriptAssembler::store(const StringRef& s)
+{
+	StringRef stored;
+	if (!s.empty()) {
+		char* data = allocate(s.length, 1);
+		memcpy(data, s.data, s.length);
+		stored.data = data;
+		stored.length = s.length;
+	}
+	return stored;
+}
+
+// item kinds and speaker IDs come from a handful of values, so are only stored once
+StringRef TranscriptAssembler::intern(const StringRef& s)
+{
+	for (const StringRef& interned : _interned) {
+		if ( (interned.length == s.length) && (memcmp(interned.data, s.data, s.length) == 0) ) {
+			return interned;
+		}
+	}
+	_interned.push_back(store(s));
+	return _interned.back();
+}
+
+void TranscriptAssembler::add_final(const Alternative& alternative, const StringRef& id)
+{
+	size_t block = _count / UTTERANCE_BLOCK;
+	if (block == _blocks->size()) {
+		// copy the block index, as snapshots may share the current one
+		TranscriptSnapshot::Final* finals = (TranscriptSnapshot::Final*)allocate(
+			UTTERANCE_BLOCK * sizeof(TranscriptSnapshot::Final), alignof(TranscriptSnapshot::Final));
+		auto blocks = std::make_shared<std::vector<const TranscriptSnapshot::Final*>>(*_blocks);
+		blocks->push_back(finals);
+		std::unique_lock<std::mutex> lock(_mutex);
+		_blocks = blocks;
+	}
+	TranscriptSnapshot::Final* final = const_cast<TranscriptSnapshot::Final*>((*_blocks)[block]) + (_count % UTTERANCE_BLOCK);
+	new (final) TranscriptSnapshot::Final();
+
+	Utterance& utterance = final->utterance;
+	utterance.id = store(id);
+	utterance.transcript = store(alternative.transcript);
+	size_t count = alternative.items.size();
+	if (count > 0) {
+		Item* items = (Item*)allocate(count * sizeof(Item), alignof(Item));
+		for (size_t i = 0; i < count; i++) {
+			const Item& item = alternative.items[i];
+			new (&items[i]) Item();
+			items[i].kind = intern(item.kind);
+			items[i].value = store(item.value);
+			items[i].speaker_id = intern(item.speaker_id);
+			items[i].start = item.start;
+			items[i].end = item.end;
+		}
+		utterance.items.data = items;
+		utterance.items.count = count;
+		utterance.start = items[0].start;
+		utterance.end = items[count - 1].end;
+	} else {
+		utterance.start = utterance.end = _max_end;
+	}
+	_max_end = std::max(_max_end, utterance.end);
+	final->max_end = _max_end;
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_item_count += count;
+	_count++;
+}
+
+void TranscriptAssembler::set_open(const Alternative* alternative, const StringRef& id)
+{
+	// build in the spare, unless a snapshot still holds it; once unshared, a
+	// snapshot cannot share it again, and the fence orders its reads before our writes
+	if ( !_spare || (_spare.use_count() > 1) ) {
+		_spare = std::make_shared<TranscriptSnapshot::Open>();
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	TranscriptSnapshot::Open& open = *_spare;
+	size_t count = alternative ? alternative->items.size() : 0;
+	size_t length = id.length;
+	if (alternative) {
+		length += alternative->transcript.length;
+		for (const Item& item : alternative->items) {
+			length += item.value.length;
+		}
+	}
+	// reserved up front, so the strings never move while they are added
+	open.strings.clear();
+	open.strings.reserve(length);
+	auto store = [&open](const StringRef& s) {
+		StringRef stored;
+		stored.data = open.strings.data() + open.strings.size();
+		stored.length = s.length;
+		open.strings.append(s.data, s.length);
+		return stored;
+	};
+
+	open.utterance = Utterance();
+	open.utterance.id = store(id);
+	open.items.resize(count);
+	if (alternative) {
+		open.utterance.transcript = store(alternative->transcript);
+		for (size_t i = 0; i < count; i++) {
+			const Item& item = alternative->items[i];
+			open.items[i].kind = intern(item.kind);
+			open.items[i].value = store(item.value);
+			open.items[i].speaker_id = intern(item.speaker_id);
+			open.items[i].start = item.start;
+			open.items[i].end = item.end;
+		}
+	}
+	if (count > 0) {
+		open.utterance.items.data = open.items.data();
+		open.utterance.items.count = count;
+		open.utterance.start = open.items[0].start;
+		open.utterance.end = open.items[count - 1].end;
+	} else {
+		open.utterance.start = open.utterance.end = _max_end;
+	}
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_open.swap(_spare);
+	_has_open = true;
+}
+
+} // namespace
+} // namespace
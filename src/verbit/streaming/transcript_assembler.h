@@ -0,0 +1,192 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <verbit/streaming/response.h>
+#include <verbit/streaming/response_type.h>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct describing one utterance of an assembled transcript.
+ *
+ * The strings and items refer to memory owned by the `TranscriptAssembler`;
+ * a final utterance never changes once added, and stays valid as long as the
+ * assembler.
+ */
+struct Utterance {
+	/// The ID of the response(s) for the utterance.
+	StringRef id;
+
+	/// The utterance transcript text.
+	StringRef transcript;
+
+	/// The utterance items, in order.
+	Span<Item> items;
+
+	/// The start time of the first item, in seconds from the start of the media.
+	double start = 0.0;
+
+	/// The end time of the last item, in seconds from the start of the media.
+	double end = 0.0;
+};
+
+class TranscriptAssembler;
+
+/**
+ * Class giving a consistent view of an assembled transcript, as of when it was taken.
+ *
+ * A snapshot is cheap to take and to copy: it shares the final utterances with
+ * the assembler (they never change), and holds the open utterance (if any) as
+ * it was. It may be read on any thread, while the assembler carries on adding
+ * responses, but must not outlive the assembler.
+ */
+class TranscriptSnapshot
+{
+public:
+	/// Construct an empty snapshot.
+	TranscriptSnapshot() { }
+
+	/// Return the number of final utterances.
+	size_t size() const { return _count; }
+
+	/// Return a final utterance.
+	///
+	/// \param i the utterance index, from 0 (the first) to `size() - 1`
+	const Utterance& operator[](size_t i) const;
+
+	/// Return the open (not yet final) utterance, or `nullptr` if there is none.
+	const Utterance* open() const;
+
+	/// Return the whole transcript text: each utterance's transcript (including the
+	/// open one), separated by spaces. This copies every utterance, so takes time
+	/// in proportion to the length of the transcript.
+	std::string text() const;
+
+	/// Find the final utterances with items between two times.
+	///
+	/// \param start the start of the time range, in seconds from the start of the media
+	/// \param end the end of the time range
+	/// \return the index of the first utterance ending after `start`, and one past the last
+	///         starting before `end` (equal if there are none)
+	std::pair<size_t, size_t> find(double start, double end) const;
+
+	/// Return the items (final, then open) overlapping a time range, _i.e._
+	/// ending after `start` and starting before `end`.
+	///
+	/// \param start the start of the time range, in seconds from the start of the media
+	/// \param end the end of the time range
+	std::vector<Item> items(double start, double end) const;
+
+private:
+	friend class TranscriptAssembler;
+
+	struct Final;
+	struct Open;
+
+	const Final& at(size_t i) const;
+
+	std::shared_ptr<const std::vector<const Final*>> _blocks;
+	size_t _count = 0;
+	std::shared_ptr<const Open> _open;
+};
+
+/**
+ * Class assembling the running transcript of a session from its responses.
+ *
+ * Feed it every response from the typed response handler; it keeps the
+ * responses of one type (Transcript, by default). A non-final response
+ * replaces the open utterance; a final (or end-of-stream) response closes it,
+ * and is appended to the final utterances.
+ *
+ * Final utterances are copied once into append-only, segmented memory, which
+ * never moves; only the open utterance is rebuilt by each partial response. So
+ * each response costs time in proportion to its own size, however long the
+ * session, and a `snapshot()` is taken in constant time (apart from sharing
+ * the open utterance).
+ *
+ * ```
+ * TranscriptAssembler assembler;
+ * client.set_typed_response_handler([&assembler](WebSocketStreamingClient*, const Response& response) {
+ *     assembler.add(response);
+ * });
+ * ...
+ * TranscriptSnapshot snapshot = assembler.snapshot();  // from any thread
+ * std::vector<Item> last_minute = snapshot.items(now - 60.0, now);
+ * ```
+ *
+ * **NOTE** Responses must be added from one thread at a time (as the client
+ * delivers them), and in order. Snapshots may be taken from any thread.
+ */
+class TranscriptAssembler
+{
+public:
+	/// Construct a new transcript assembler.
+	///
+	/// \param type the response type to assemble, `ResponseType::Transcript` or `ResponseType::Captions`
+	/// \throws std::runtime_error if `type` is not a single response type
+	TranscriptAssembler(int type = ResponseType::Transcript);
+
+	/// Destroy the assembler, and the memory of its utterances.
+	~TranscriptAssembler();
+
+	/// Add a response. Responses of other types, or with no `response` object, are ignored;
+	/// only the first (most likely) alternative is kept.
+	///
+	/// \param response the response, which is copied
+	void add(const Response& response);
+
+	/// Return a snapshot of the transcript so far.
+	TranscriptSnapshot snapshot() const;
+
+	/// Return the number of final utterances.
+	size_t size() const;
+
+	/// Return the total number of items in the final utterances.
+	size_t item_count() const;
+
+private:
+	TranscriptAssembler(const TranscriptAssembler&) = delete;
+	TranscriptAssembler& operator=(const TranscriptAssembler&) = delete;
+
+	bool accepts(const Response& response) const;
+	char* allocate(size_t size, size_t align);
+	StringRef store(const StringRef& s);
+	StringRef intern(const StringRef& s);
+	void add_final(const Alternative& alternative, const StringRef& id);
+	void set_open(const Alternative* alternative, const StringRef& id);
+
+	int _type;
+
+	// append-only memory, in blocks which never move
+	std::vector<std::unique_ptr<char[]>> _memory;
+	size_t _memory_used = 0;
+	size_t _memory_size = 0;
+
+	// item kinds and speaker IDs, stored once each
+	std::vector<StringRef> _interned;
+
+	// the final utterances, in blocks of fixed size; the block index is copied on
+	// write, so snapshots share it
+	std::shared_ptr<const std::vector<const TranscriptSnapshot::Final*>> _blocks;
+	size_t _count = 0;
+	size_t _item_count = 0;
+	double _max_end = 0.0;
+
+	// the open utterance, and a spare which the next partial response is built in
+	// (and swapped with the open one); the spare is reused unless a snapshot shares it
+	std::shared_ptr<TranscriptSnapshot::Open> _open;
+	std::shared_ptr<TranscriptSnapshot::Open> _spare;
+	bool _has_open = false;
+
+	// guards what other threads read: _blocks, _count, _item_count, _open and _has_open
+	mutable std::mutex _mutex;
+};
+
+} // namespace
+} // namespace
@@ -0,0 +1,9 @@
+#include <string>
+
+namespace verbit {
+namespace streaming {
+
+const std::string WSSC_VERSION = "1.1.4";
+
+} // namespace
+} // namespace
@@ -0,0 +1,343 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define WSSC_VOICE_GATE_X86 1
+#endif
+
+#include "voice_gate.h"
+
+namespace verbit {
+namespace streaming {
+
+namespace {
+
+// the level of a window of digital silence
+const double SILENCE_DB = -120.0;
+
+// how fast the noise floor rises, in dB per second
+const double NOISE_RISE_DB = 1.0;
+
+// the energy of a full scale sample
+const double FULL_SCALE_SQUARED = 32768.0 * 32768.0;
+
+// measure samples `[from, samples)`, each against the sample `stride` before it (in `in`)
+void analyse_scalar(const uint8_t* in, size_t from, size_t samples, size_t stride, uint64_t& energy, uint64_t& crossings)
+{
+	for (size_t i = from; i < samples; i++) {
+		int16_t x;
+		int16_t p;
+		memcpy(&x, in + 2 * i, 2);
+		memcpy(&p, in + 2 * (i - stride), 2);
+		energy += (uint64_t)((int32_t)x * x);
+		crossings += (uint16_t)(x ^ p) >> 15;
+	}
+}
+
+#ifdef WSSC_VOICE_GATE_X86
+
+// (the int16 crossing counts are added up before they can overflow)
+const size_t COUNT_BLOCK = 4096;
+
+size_t analyse_sse2(const uint8_t* in, size_t from, size_t samples, size_t stride, uint64_t& energy, uint64_t& crossings)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i sum = zero;     // 2 x uint64
+	__m128i count = zero;   // 2 x uint64
+	size_t i = from;
+	while (i + 8 <= samples) {
+		__m128i block = zero;  // 8 x int16
+		size_t end = std::min(samples, i + 8 * COUNT_BLOCK);
+		for (; i + 8 <= end; i += 8) {
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+			__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * (i - stride)));
+			// pairs of squares fit in uint32 (at most 2^31)
+			__m128i squares = _mm_madd_epi16(x, x);
+			sum = _mm_add_epi64(sum, _mm_add_epi64(_mm_unpacklo_epi32(squares, zero), _mm_unpackhi_epi32(squares, zero)));
+			block = _mm_sub_epi16(block, _mm_srai_epi16(_mm_xor_si128(x, p), 15));
+		}
+		__m128i pairs = _mm_madd_epi16(block, ones);
+		count = _mm_add_epi64(count, _mm_add_epi64(_mm_unpacklo_epi32(pairs, zero), _mm_unpackhi_epi32(pairs, zero)));
+	}
+	uint64_t lanes[2];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sum);
+	energy += lanes[0] + lanes[1];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), count);
+	crossings += lanes[0] + lanes[1];
+	return i;
+}
+
+__attribute__((target("avx2"))) size_t analyse_avx2(const uint8_t* in, size_t from, size_t samples, size_t stride,
+	uint64_t& energy, uint64_t& crossings)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum = zero;
+	__m256i count = zero;
+	size_t i = from;
+	while (i + 16 <= samples) {
+		__m256i block = zero;
+		size_t end = std::min(samples, i + 16 * COUNT_BLOCK);
+		for (; i + 16 <= end; i += 16) {
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * i));
+			__m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * (i - stride)));
+			__m256i squares = _mm256_madd_epi16(x, x);
+			sum = _mm256_add_epi64(sum, _mm256_add_epi64(_mm256_unpacklo_epi32(squares, zero), _mm256_unpackhi_epi32(squares, zero)));
+			block = _mm256_sub_epi16(block, _mm256_srai_epi16(_mm256_xor_si256(x, p), 15));
+		}
+		__m256i pairs = _mm256_madd_epi16(block, ones);
+		count = _mm256_add_epi64(count, _mm256_add_epi64(_mm256_unpacklo_epi32(pairs, zero), _mm256_unpackhi_epi32(pairs, zero)));
+	}
+	uint64_t lanes[4];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sum);
+	energy += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), count);
+	crossings += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	return i;
+}
+
+#endif
+
+// a duration of media, in whole frames
+size_t frames_in(int sample_rate, std::chrono::milliseconds duration)
+{
+	return (size_t)((uint64_t)sample_rate * duration.count() / 1000);
+}
+
+} // anonymous namespace
+
+VoiceGate::VoiceGate(const VoiceGateConfig& config, int sample_rate, int channels, SampleConverter::Isa isa) :
+	_config(config), _isa(isa)
+{
+	if ( (sample_rate <= 0) || (channels <= 0) ) {
+		throw std::runtime_error("voice gate sample rate and channels must be positive");
+	}
+	if ( (frames_in(sample_rate, config.window) == 0) || (config.hangover.count() < 0) || (config.pre_roll.count() < 0) ) {
+		throw std::runtime_error("voice gate window must hold a frame, and hangover and pre-roll must not be negative");
+	}
+	if ( (config.mode == VoiceGateConfig::gate_keepalive) &&
+		( (frames_in(sample_rate, config.keepalive_frame) == 0) || (config.keepalive_interval < config.keepalive_frame) ) ) {
+		throw std::runtime_error("voice gate keep-alive frame must hold a frame, and be within the keep-alive interval");
+	}
+	if (!SampleConverter::supported(isa)) {
+		throw std::runtime_error(std::string("voice gate ISA not supported: ") + SampleConverter::isa_name(isa));
+	}
+
+	_channels = channels;
+	_frame_bytes = 2 * _channels;
+	_window_bytes = frames_in(sample_rate, config.window) * _frame_bytes;
+	_hangover_windows = (config.hangover.count() + config.window.count() - 1) / config.window.count();
+	_preroll_bytes = frames_in(sample_rate, config.pre_roll) * _frame_bytes;
+	_keepalive_bytes = frames_in(sample_rate, config.keepalive_interval) * _frame_bytes;
+	_keepalive_frame_bytes = frames_in(sample_rate, config.keepalive_frame) * _frame_bytes;
+	_bytes_per_second = (uint64_t)sample_rate * _frame_bytes;
+	_noise_rise_db = NOISE_RISE_DB * config.window.count() / 1000.0;
+	_prev.assign(_channels, 0);
+	_level_db = SILENCE_DB;
+	_noise_db = config.threshold_db - config.noise_margin_db;
+	_ring.resize(_preroll_bytes);
+	_out.reserve(_preroll_bytes + _keepalive_frame_bytes + _window_bytes);
+}
+
+void VoiceGate::analyse(const void* in, size_t samples, size_t stride, const int16_t* prev,
+	uint64_t& energy, uint64_t& crossings, SampleConverter::Isa isa)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(in);
+	// the first samples of each channel are measured against the previous ones
+	size_t head = std::min(samples, stride);
+	for (size_t i = 0; i < head; i++) {
+		int16_t x;
+		memcpy(&x, bytes + 2 * i, 2);
+		energy += (uint64_t)((int32_t)x * x);
+		crossings += (uint16_t)(x ^ prev[i]) >> 15;
+	}
+	size_t i = head;
+#ifdef WSSC_VOICE_GATE_X86
+	if (isa == SampleConverter::isa_avx2) {
+		i = analyse_avx2(bytes, i, samples, stride, energy, crossings);
+	} else if (isa == SampleConverter::isa_sse2) {
+		i = analyse_sse2(bytes, i, samples, stride, energy, crossings);
+	}
+#endif
+	analyse_scalar(bytes, i, samples, stride, energy, crossings);
+}
+
+void VoiceGate::process(std::string& media)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_out.clear();
+	const char* in = media.data();
+	size_t size = media.size();
+	for (size_t pos = 0; pos < size; ) {
+		// up to the end of the window: its media follows the gate as it was when the window started
+		size_t n = std::min(size - pos, _window_bytes - _window_fill);
+		measure(in + pos, n);
+		if (_open) {
+			emit(in + pos, n);
+		} else {
+			hold(in + pos, n);
+		}
+		pos += n;
+		_window_fill += n;
+		if (_window_fill == _window_bytes) {
+			decide();
+			_window_fill = 0;
+		}
+	}
+	_stats.bytes_in += size;
+	_stats.bytes_sent += _out.size();
+	media.swap(_out);
+}
+
+// Measure media bytes, which may split samples.
+void VoiceGate::measure(const char* in, size_t bytes)
+{
+	if ( _has_odd_byte && (bytes > 0) ) {
+		char sample[2] = {_odd_byte, in[0]};
+		analyse(sample, 1, _channels, _prev.data(), _energy, _crossings, SampleConverter::isa_scalar);
+		memmove(_prev.data(), _prev.data() + 1, (_channels - 1) * 2);
+		memcpy(&_prev[_channels - 1], sample, 2);
+		_has_odd_byte = false;
+		in++;
+		bytes--;
+	}
+	size_t samples = bytes / 2;
+	if (samples > 0) {
+		analyse(in, samples, _channels, _prev.data(), _energy, _crossings, _isa);
+		if (samples >= _channels) {
+			memcpy(_prev.data(), in + 2 * (samples - _channels), _channels * 2);
+		} else {
+			memmove(_prev.data(), _prev.data() + samples, (_channels - samples) * 2);
+			memcpy(&_prev[_channels - samples], in, samples * 2);
+		}
+	}
+	if (bytes % 2) {
+		_odd_byte = in[bytes - 1];
+		_has_odd_byte = true;
+	}
+}
+
+// Classify the window just measured, and open or close the gate.
+void VoiceGate::decide()
+{
+	double samples = (double)(_window_bytes / 2);
+	_level_db = (_energy > 0) ? 10 * std::log10(_energy / samples / FULL_SCALE_SQUARED) : SILENCE_DB;
+	double zcr = _crossings / samples;
+	_energy = 0;
+	_crossings = 0;
+
+	double threshold = std::max(_config.threshold_db, _noise_db + _config.noise_margin_db);
+	bool speech = (_level_db >= threshold) ||
+		( (zcr >= _config.zcr_threshold) && (_level_db >= threshold - _config.zcr_margin_db) );
+	_noise_db = std::min(_level_db, _noise_db + _noise_rise_db);
+
+	if (speech) {
+		_quiet_windows = 0;
+		if (!_open) {
+			_open = true;
+			_stats.speech_segments++;
+			emit_preroll();
+		}
+	} else if ( _open && (++_quiet_windows > _hangover_windows) ) {
+		_open = false;
+		_since_keepalive = 0;
+	}
+
+	// stand in for the silence withheld (at window ends, so frames stay whole)
+	if ( !_open && (_config.mode == VoiceGateConfig::gate_keepalive) ) {
+		while (_since_keepalive >= _keepalive_bytes) {
+			_since_keepalive -= _keepalive_bytes;
+			_skipped -= _keepalive_frame_bytes;
+			emit(nullptr, _keepalive_frame_bytes);
+			_stats.keepalive_frames++;
+		}
+	}
+}
+
+// Hold back media while the gate is closed, dropping what falls out of the pre-roll.
+void VoiceGate::hold(const char* in, size_t bytes)
+{
+	const size_t capacity = _preroll_bytes;
+	if (bytes >= capacity) {
+		drop(_ring_size + bytes - capacity);
+		if (capacity > 0) {
+			memcpy(_ring.data(), in + bytes - capacity, capacity);
+		}
+		_ring_start = 0;
+		_ring_size = capacity;
+		return;
+	}
+	if (_ring_size + bytes > capacity) {
+		size_t over = _ring_size + bytes - capacity;
+		drop(over);
+		_ring_start = (_ring_start + over) % capacity;
+		_ring_size -= over;
+	}
+	size_t end = (_ring_start + _ring_size) % capacity;
+	size_t first = std::min(bytes, capacity - end);
+	memcpy(&_ring[end], in, first);
+	memcpy(_ring.data(), in + first, bytes - first);
+	_ring_size += bytes;
+}
+
+void VoiceGate::drop(size_t bytes)
+{
+	_skipped += bytes;
+	_since_keepalive += bytes;
+	_stats.bytes_gated += bytes;
+}
+
+// Pass media (or digital silence, if `in` is null) on, noting where it follows a gap.
+void VoiceGate::emit(const char* in, size_t bytes)
+{
+	if (_gaps.empty() || (_gaps.back().second != _skipped)) {
+		if (!_gaps.empty() && (_gaps.back().first == _out_offset)) {
+			_gaps.back().second = _skipped;
+		} else if (_skipped != 0) {
+			_gaps.push_back(std::make_pair(_out_offset, _skipped));
+		}
+	}
+	if (in) {
+		_out.append(in, bytes);
+	} else {
+		_out.append(bytes, '\0');
+	}
+	_out_offset += bytes;
+}
+
+void VoiceGate::emit_preroll()
+{
+	size_t first = std::min(_ring_size, _preroll_bytes - _ring_start);
+	if (_ring_size > 0) {
+		emit(&_ring[_ring_start], first);
+		// (a second part adds no gap)
+		emit(_ring.data(), _ring_size - first);
+	}
+	_ring_start = 0;
+	_ring_size = 0;
+}
+
+uint64_t VoiceGate::media_offset(uint64_t offset)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	auto it = std::upper_bound(_gaps.begin(), _gaps.end(), std::make_pair(offset, UINT64_MAX));
+	if (it == _gaps.begin()) {
+		return offset;
+	}
+	return offset + (it - 1)->second;
+}
+
+GateStats VoiceGate::stats()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	GateStats stats = _stats;
+	stats.time_gated = std::chrono::milliseconds(_stats.bytes_gated * 1000 / _bytes_per_second);
+	return stats;
+}
+
+} // namespace
+} // namespace
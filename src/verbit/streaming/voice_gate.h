@@ -0,0 +1,193 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <verbit/streaming/gate_stats.h>
+#include <verbit/streaming/sample_converter.h>
+
+namespace verbit {
+namespace streaming {
+
+/**
+ * Struct holding the settings of a `VoiceGate`.
+ */
+struct VoiceGateConfig {
+	/// How a closed gate treats silence.
+	enum Mode {
+		gate_drop,      ///< send nothing
+		gate_keepalive  ///< send a short frame of digital silence every `keepalive_interval`
+	};
+
+	/// The level (of a window, in dBFS) from which it is always speech.
+	double threshold_db = -50.0;
+
+	/// How far (in dB) above the tracked noise floor a window must be to be speech, if that
+	/// is above `threshold_db`.
+	double noise_margin_db = 12.0;
+
+	/// The zero-crossing rate (per sample) from which a quieter window is still speech
+	/// (unvoiced consonants such as "s" and "f" are quiet, but cross zero often).
+	double zcr_threshold = 0.25;
+
+	/// How far (in dB) below the speech level a window crossing zero often may be.
+	double zcr_margin_db = 10.0;
+
+	/// The analysis window.
+	std::chrono::milliseconds window {10};
+
+	/// How long the gate stays open after the last speech.
+	std::chrono::milliseconds hangover {300};
+
+	/// How much of the media before speech is sent when the gate opens.
+	std::chrono::milliseconds pre_roll {200};
+
+	/// How a closed gate treats silence.
+	Mode mode = gate_keepalive;
+
+	/// How much silence (media time) a keep-alive frame stands for, in `gate_keepalive` mode.
+	std::chrono::milliseconds keepalive_interval {5000};
+
+	/// The length of a keep-alive frame, in `gate_keepalive` mode.
+	std::chrono::milliseconds keepalive_frame {10};
+};
+
+/**
+ * Class gating S16LE media on voice activity, to not send silence.
+ *
+ * Each analysis window (10ms by default) is measured for its energy and zero-crossing
+ * rate, by SSE2 or AVX2 kernels picked at run time, or by scalar code. A window is
+ * speech if it is louder than both `threshold_db` and `noise_margin_db` above a noise
+ * floor which follows quieter windows down at once, and creeps up slowly (1dB a second)
+ * otherwise; or a bit quieter (`zcr_margin_db`) but crossing zero often.
+ *
+ * Media passes through the open gate as is. It closes once there has been no speech
+ * for `hangover`; the last `pre_roll` of the media since is held back, and sent as the
+ * gate opens again, so speech onsets are not clipped. The rest is not sent at all, or
+ * (in `gate_keepalive` mode) stood in for by a short frame of digital silence every
+ * `keepalive_interval`, for services timing out media which stalls.
+ *
+ * The service times its responses by the media it gets, so times from it skip the
+ * gaps; `media_offset()` maps an offset in the media sent back to the original media.
+ *
+ * ```
+ * VoiceGate gate {VoiceGateConfig(), 16000, 1};
+ * gate.process(chunk);  // now only what to send
+ * ```
+ *
+ * `process()` must not be called concurrently; `media_offset()` and `stats()` may be
+ * called from any thread.
+ */
+class VoiceGate
+{
+public:
+	/// Construct a new voice gate (closed, until the first speech).
+	///
+	/// \param config the gate settings
+	/// \param sample_rate the media's sample rate, in Hz
+	/// \param channels the media's number of (interleaved) channels
+	/// \param isa the kernels to use (by default, the best the CPU supports)
+	/// \throws std::runtime_error if a parameter is invalid, or the CPU does not support `isa`
+	VoiceGate(const VoiceGateConfig& config, int sample_rate, int channels = 1,
+		SampleConverter::Isa isa = SampleConverter::best_isa());
+
+	/// Gate a chunk of media in place.
+	///
+	/// \param media a chunk of S16LE media, which need not hold whole frames; replaced
+	///        by the media to send for it (maybe none, or more as the gate opens)
+	void process(std::string& media);
+
+	/// Is the gate open (passing media through)?
+	bool is_open() const { return _open; }
+
+	/// Map an offset in the media passed on back to the offset in the original media.
+	///
+	/// \param offset a byte offset in the media passed on by `process()`
+	/// \return the byte offset in the media given to `process()`
+	uint64_t media_offset(uint64_t offset);
+
+	/// Return the gate's metrics so far.
+	GateStats stats();
+
+	/// Return the gate settings.
+	const VoiceGateConfig& config() const { return _config; }
+
+	/// Return the kernels used.
+	SampleConverter::Isa isa() const { return _isa; }
+
+	/// Return the level of the last whole window, in dBFS.
+	double level_db() const { return _level_db; }
+
+	/// Return the tracked noise floor, in dBFS.
+	double noise_floor_db() const { return _noise_db; }
+
+	/// Measure S16LE samples.
+	///
+	/// \param in `samples` S16LE samples (need not be aligned)
+	/// \param samples the number of samples
+	/// \param stride the distance between samples of a channel (the number of channels)
+	/// \param prev the `stride` samples before `in`, to count zero crossings from
+	/// \param energy added the sum of the squared samples
+	/// \param crossings added the number of sign changes from each sample `stride` before
+	/// \param isa the kernels to use
+	static void analyse(const void* in, size_t samples, size_t stride, const int16_t* prev,
+		uint64_t& energy, uint64_t& crossings, SampleConverter::Isa isa);
+
+private:
+	VoiceGate(const VoiceGate&) = delete;
+	VoiceGate& operator=(const VoiceGate&) = delete;
+
+	void measure(const char* in, size_t bytes);
+	void decide();
+	void hold(const char* in, size_t bytes);
+	void drop(size_t bytes);
+	void emit(const char* in, size_t bytes);
+	void emit_preroll();
+
+	VoiceGateConfig _config;
+	SampleConverter::Isa _isa;
+	size_t _channels;
+	size_t _frame_bytes;
+	size_t _window_bytes;
+	size_t _hangover_windows;
+	size_t _preroll_bytes;
+	size_t _keepalive_bytes;     // of silence withheld per keep-alive frame
+	size_t _keepalive_frame_bytes;
+	uint64_t _bytes_per_second;
+	double _noise_rise_db;       // per window
+
+	// analysis of the current window
+	size_t _window_fill = 0;     // bytes
+	uint64_t _energy = 0;
+	uint64_t _crossings = 0;
+	std::vector<int16_t> _prev;  // the last `_channels` samples
+	char _odd_byte = 0;          // a sample split between chunks
+	bool _has_odd_byte = false;
+	double _level_db;
+	double _noise_db;
+
+	bool _open = false;
+	size_t _quiet_windows = 0;
+
+	// the held back media, a ring of the last `_preroll_bytes` (or fewer)
+	std::vector<char> _ring;
+	size_t _ring_start = 0;
+	size_t _ring_size = 0;
+	uint64_t _since_keepalive = 0;
+
+	std::string _out;
+	uint64_t _out_offset = 0;
+	uint64_t _skipped = 0;       // bytes of the original media not stood for by media passed on
+
+	std::mutex _mutex;
+	std::vector<std::pair<uint64_t, uint64_t>> _gaps;  // (offset passed on, `_skipped` from there)
+	GateStats _stats;
+};
+
+} // namespace
+} // namespace
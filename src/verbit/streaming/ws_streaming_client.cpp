@@ -1,53 +1,122 @@
+#include <algorithm>
 #include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <unistd.h>
+#include <vector>
 
 #include "ws_streaming_client.h"
 
 namespace verbit {
 namespace streaming {
 
+// State for waiting on a media generator's `event_fd()`. Pending waits hold a
+// reference to it, so it can outlive the client; all access is under `mutex`.
+struct WebSocketStreamingClient::MediaWatch {
+	MediaWatch(boost::asio::io_service& io_service, int fd, int drain_fd, WebSocketStreamingClient* client) :
+		descriptor(io_service, fd), drain(io_service, drain_fd), client(client) { }
+
+	boost::asio::posix::stream_descriptor descriptor;  // owns a dup() of the media generator's descriptor
+	boost::asio::posix::stream_descriptor drain;       // owns a dup() of the send drain's descriptor
+	std::mutex mutex;
+	WebSocketStreamingClient* client;
+};
+
+// how often to check for (and if need be, resend) EOS while waiting for its replies
+static const std::chrono::milliseconds EOS_CHECK_INTERVAL(1000);
+
+// return a duration in whole microseconds, for the metrics histograms
+static uint64_t _micros(std::chrono::steady_clock::duration duration)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+// log a line formatted printf-style, at a `Logger` level; the arguments are only
+// evaluated, and the line formatted, if the level is enabled (see `log_enabled()`)
+#define CLIENT_LOG(level, tag, ...) \
+	do { \
+		if (log_enabled(Logger::level)) { \
+			log_line(Logger::level, (tag), __VA_ARGS__); \
+		} \
+	} while (0)
+
 WebSocketStreamingClient::WebSocketStreamingClient(std::string access_token) :
+	WebSocketStreamingClient(access_token, std::unique_ptr<StreamingEngine>(new StreamingEngine()), nullptr)
+{
+}
+
+WebSocketStreamingClient::WebSocketStreamingClient(std::string access_token, StreamingEngine& engine) :
+	WebSocketStreamingClient(access_token, std::unique_ptr<StreamingEngine>(), &engine)
+{
+}
+
+WebSocketStreamingClient::WebSocketStreamingClient(std::string access_token, std::unique_ptr<StreamingEngine> own_engine, StreamingEngine* engine) :
+	_own_engine(std::move(own_engine)),
+	_engine(engine ? *engine : *_own_engine),
+	_ws_endpoint(_engine.endpoint()),
 	_access_token(access_token),
 	_ws_url(WSSC_DEFAULT_WS_URL),
 	_max_conn_retry(WSSC_DEFAULT_CONNECTION_RETRY_SECONDS),
+	_retry_rng(std::random_device()()),
 	_verify_ssl_cert(true),
-	_error_code(0)
+	_error_code(0),
+	_keepalive_time(0),
+	_keepalive_timeout(WSSC_DEFAULT_KEEPALIVE_SECONDS),
+	_eos_sent(false),
+	_eos_timeout(std::chrono::seconds(WSSC_DEFAULT_EOS_TIMEOUT_SECONDS)),
+	_connect_attempts(0),
+	_acked_offset(0),
+	_conn_base_offset(0),
+	_reconnect_pending(false),
+	_resume_pending(false)
 {
 	if (access_token.empty()) {
 		throw std::runtime_error("access token is required");
 	}
 
-	// initialize WebSocket++ and set handlers
+	_state.flight_recorder(&_flight);
+
+	// WebSocket++ handlers are set per connection by connect_ws(), since the endpoint may be shared
 #if defined(DEBUG)
-	_ws_endpoint.set_access_channels(websocketpp::log::alevel::all);
-#if !defined(VERBOSE_DEBUG)
-	_ws_endpoint.clear_access_channels(websocketpp::log::alevel::frame_payload);
-	_ws_endpoint.clear_access_channels(websocketpp::log::alevel::frame_header);
-#endif
-	_ws_endpoint.set_error_channels(websocketpp::log::elevel::all);
-	write_alog("WebSocketStreamingClient ver", WSSC_VERSION);
-#else
-	_ws_endpoint.clear_access_channels(websocketpp::log::alevel::all);
-	_ws_endpoint.clear_error_channels(websocketpp::log::elevel::all);
+	CLIENT_LOG(info, "WebSocketStreamingClient ver", "%s", WSSC_VERSION);
 #endif
-	_ws_endpoint.init_asio();
-	_ws_endpoint.set_socket_init_handler(bind(&WebSocketStreamingClient::on_socket_init, this, websocketpp::lib::placeholders::_1));
-	_ws_endpoint.set_tls_init_handler(bind(&WebSocketStreamingClient::on_tls_init, this, websocketpp::lib::placeholders::_1));
-	_ws_endpoint.set_open_handler(bind(&WebSocketStreamingClient::on_open, this, websocketpp::lib::placeholders::_1));
-	_ws_endpoint.set_message_handler(bind(&WebSocketStreamingClient::on_message, this, websocketpp::lib::placeholders::_1, websocketpp::lib::placeholders::_2));
-	_ws_endpoint.set_close_handler(bind(&WebSocketStreamingClient::on_close, this, websocketpp::lib::placeholders::_1));
-	_ws_endpoint.set_fail_handler(bind(&WebSocketStreamingClient::on_fail, this, websocketpp::lib::placeholders::_1));
-	_ws_endpoint.set_ping_handler(bind(&WebSocketStreamingClient::on_ping, this, websocketpp::lib::placeholders::_1, websocketpp::lib::placeholders::_2));
 }
 
 WebSocketStreamingClient::~WebSocketStreamingClient()
 {
-	write_alog("WebSocketStreamingClient",  "destructor");
+	CLIENT_LOG(info, "WebSocketStreamingClient", "destructor");
+
+	// the registry keeps this session's final metrics
+	if (_metrics_added) {
+		_metrics_registry->remove(_metrics_id);
+	}
+
+	// no timer or media callbacks may run once destruction has started
+	cancel_timers();
+	stop_media_watch();
 
 	// make the media worker thread exit, if needed, so the following join will not hang
 	if (!_state.is_final()) {
 		_state.change(ServiceState::state_closing);
-		_keepalive_check.notify_one();
+	}
+
+	// on a shared engine (or our own, running asynchronously), the connection
+	// outlives this client unless it is closed first
+	if ((_async || !_own_engine) && _ws_con) {
+		std::unique_lock<std::mutex> lock(_finished_mutex);
+		if (!_finished) {
+			lock.unlock();
+			close_ws();
+			lock.lock();
+			_finished_cv.wait_for(lock, std::chrono::seconds(2), [this]{ return _finished; });
+		}
+	}
+
+	// no response may be delivered once the client is going away
+	if (_dispatch_queue) {
+		_dispatch_queue->close();
 	}
 
 	// clean up media worker thread
@@ -59,16 +128,12 @@ WebSocketStreamingClient::~WebSocketStreamingClient()
 		_media_thread = nullptr;
 	}
 
-	// clean up keepalive thread
-	if (_keepalive_thread) {
-		if (_keepalive_thread->joinable()) {
-			_keepalive_thread->join();
-		}
-		delete _keepalive_thread;
-		_keepalive_thread = nullptr;
-	}
+	CLIENT_LOG(info, "WebSocketStreamingClient", "media thread exited");
 
-	write_alog("WebSocketStreamingClient",  "media thread exited");
+	// make sure the shared endpoint no longer routes events to this client
+	if (_ws_con) {
+		_engine.detach(_ws_con->get_handle());
+	}
 
 	// close any previously opened log files
 	if (_alog) {
@@ -113,7 +178,7 @@ void WebSocketStreamingClient::log_path(const std::string log_path) {
 			_ws_endpoint.clear_access_channels(websocketpp::log::alevel::frame_header);
 #endif
 			_ws_endpoint.set_error_channels(websocketpp::log::elevel::all);
-			write_alog("WebSocketStreamingClient ver", WSSC_VERSION);
+			CLIENT_LOG(info, "WebSocketStreamingClient ver", "%s", WSSC_VERSION);
 		}
 
 		// open error log file
@@ -126,6 +191,75 @@ void WebSocketStreamingClient::log_path(const std::string log_path) {
 	}
 }
 
+void WebSocketStreamingClient::send_watermarks(size_t high, size_t low)
+{
+	if (low > high) {
+		throw std::runtime_error("low watermark must not be above high watermark");
+	}
+	_high_watermark = high;
+	_low_watermark = low;
+}
+
+CongestionStats WebSocketStreamingClient::congestion_stats()
+{
+	std::unique_lock<std::mutex> lock(_congestion_mutex);
+	CongestionStats stats = _congestion_stats;
+	if (_congested) {
+		stats.time_congested += std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - _congested_since);
+	}
+	return stats;
+}
+
+GateStats WebSocketStreamingClient::gate_stats()
+{
+	if (!_gate) {
+		return GateStats();
+	}
+	return _gate->stats();
+}
+
+double WebSocketStreamingClient::media_time(double service_time)
+{
+	if (_media_bytes_per_second == 0) {
+		return service_time;
+	}
+	uint64_t offset = _conn_base_offset.load() + (uint64_t)(service_time * _media_bytes_per_second);
+	if (!_gate) {
+		return (double)offset / _media_bytes_per_second;
+	}
+	return (double)_gate->media_offset(offset) / _media_bytes_per_second;
+}
+
+StreamTimes WebSocketStreamingClient::stream_times()
+{
+	std::unique_lock<std::mutex> lock(_times_mutex);
+	return _times;
+}
+
+ReconnectStats WebSocketStreamingClient::reconnect_stats()
+{
+	std::unique_lock<std::mutex> lock(_reconnect_mutex);
+	return _reconnect_stats;
+}
+
+SessionMetrics WebSocketStreamingClient::metrics()
+{
+	SessionMetrics metrics = _metrics;
+	for (int state = 0; state < SessionMetrics::STATES; state++) {
+		metrics.time_in_state[state] = std::chrono::duration_cast<std::chrono::microseconds>(_state.time_in(state));
+	}
+	return metrics;
+}
+
+DispatchStats WebSocketStreamingClient::dispatch_stats()
+{
+	if (!_dispatch_queue) {
+		return DispatchStats();
+	}
+	return _dispatch_queue->stats();
+}
+
 const std::string WebSocketStreamingClient::ws_full_url()
 {
 	std::string url = _ws_url;
@@ -145,6 +279,60 @@ bool WebSocketStreamingClient::run_stream(MediaGenerator& media_generator)
 }
 
 bool WebSocketStreamingClient::run_stream(MediaGenerator& media_generator, const MediaConfig& media_config, const ResponseType& response_types)
+{
+	if (!start_stream(media_generator, media_config, response_types)) {
+		return false;
+	}
+
+	if (_own_engine) {
+		// start the ASIO io_service run loop: this doesn't return until the WebSocket closes
+		_engine.run();
+	}
+	if (!_own_engine || _finish_dispatched) {
+		// the shared engine's I/O threads run the session, and/or a dispatch pool
+		// delivers its last responses: wait for it to finish
+		std::unique_lock<std::mutex> lock(_finished_mutex);
+		_finished_cv.wait(lock, [this]{ return _finished; });
+	}
+
+	CLIENT_LOG(info, "media", "run is finished; error_code=%d", _error_code);
+
+	return (_error_code == 0);
+}
+
+std::future<StreamResult> WebSocketStreamingClient::async_run_stream(MediaGenerator& media_generator,
+	wssc_completion_handler completion_handler)
+{
+	// construct with default `MediaConfig` and `ResponseType`
+	return async_run_stream(media_generator, MediaConfig(), ResponseType(), completion_handler);
+}
+
+std::future<StreamResult> WebSocketStreamingClient::async_run_stream(MediaGenerator& media_generator,
+	const MediaConfig& media_config, const ResponseType& response_types, wssc_completion_handler completion_handler)
+{
+	if (_state.get() != ServiceState::state_initial) {
+		throw std::runtime_error("retrying is not currently supported");
+	}
+
+	_async = true;
+	_completion_handler = completion_handler;
+	std::future<StreamResult> result = _result_promise.get_future();
+
+	if (_own_engine) {
+		// a standalone client needs an I/O thread of its own to run the session
+		_engine.start(1);
+	}
+	if (!start_stream(media_generator, media_config, response_types)) {
+		// nothing was queued, so nothing else will complete the stream
+		complete_stream();
+	}
+	return result;
+}
+
+// Common setup for `run_stream()` and `async_run_stream()`: queue the connection
+// and start the media and keepalive workers. Returns `false` if the connection
+// could not be queued.
+bool WebSocketStreamingClient::start_stream(MediaGenerator& media_generator, const MediaConfig& media_config, const ResponseType& response_types)
 {
 	if (_state.get() != ServiceState::state_initial) {
 		throw std::runtime_error("retrying is not currently supported");
@@ -154,64 +342,99 @@ bool WebSocketStreamingClient::run_stream(MediaGenerator& media_generator, const
 	_media_generator = &media_generator;
 	_media_config = media_config;
 	_response_types = response_types;
+	if (media_config.is_pcm()) {
+		_media_frame_bytes = std::max(1, media_config.sample_width * media_config.num_channels);
+		_media_bytes_per_second = media_config.sample_rate * _media_frame_bytes;
+	} else {
+		// encoded media has no fixed bytes per second to map the service's times with
+		if (_resilient) {
+			throw std::runtime_error("resilient streaming needs PCM media, not " + media_config.format);
+		}
+		_media_frame_bytes = 1;
+		_media_bytes_per_second = 0;
+	}
+	if (_gate_enabled) {
+		if ( (media_config.format == "S16LE") && (media_config.sample_width == 2) ) {
+			_gate.reset(new VoiceGate(_gate_config, media_config.sample_rate, media_config.num_channels));
+		} else {
+			CLIENT_LOG(warn, "voice gate", "not gating %s media", media_config.format.c_str());
+		}
+	}
+	if (_resilient) {
+		size_t capacity = std::max((size_t)(_media_bytes_per_second * _replay_window.count() / 1000), _media_frame_bytes);
+		_replay.reset(new ReplayRing(capacity, _media_frame_bytes));
+	}
+	if (_dispatch_pool) {
+		_dispatch_queue = std::make_shared<DispatchQueue>(*_dispatch_pool, [this](std::string& payload) {
+			try {
+				deliver_response(payload, nullptr);
+			} catch (std::exception& e) {
+				CLIENT_LOG(error, "dispatch handler error", "%s", e.what());
+			}
+		}, _dispatch_capacity, _dispatch_policy, _dispatch_block_timeout);
+	}
 
-	write_alog("ws_full_url", ws_full_url());
+	if (_metrics_registry) {
+		_metrics_id = _metrics_registry->add(std::bind(&WebSocketStreamingClient::metrics, this));
+		_metrics_added = true;
+	}
+
+	CLIENT_LOG(info, "ws_full_url", "%s", ws_full_url().c_str());
 
 	// connect to the WebSocket server (first attempt)
 	_state.change(ServiceState::state_opening);
-	websocketpp::lib::error_code ec;
-	_ws_con = _ws_endpoint.get_connection(ws_full_url(), ec);
-	if (ec) {
-		write_alog("get_connection error", ec.message());
-		websocketpp::lib::error_code transport_ec = _ws_con->get_transport_ec();
-		write_alog("transport-specific get_connection error", transport_ec.message());
-		_error_code = _ws_con->get_local_close_code();
-		_service_error = _ws_con->get_local_close_reason();
+	mark_time(_times.connect);
+	_connect_start = std::chrono::steady_clock::now();
+	if (!connect_ws()) {
 		return false;
 	}
-	_ws_con->append_header("Authorization", std::string("Bearer ") + _access_token);
-	_ws_endpoint.connect(_ws_con);
 
-	write_alog("WebSocket", "connect queued");
+	CLIENT_LOG(info, "WebSocket", "connect queued");
 
-	// start media_generator thread
-	_media_thread = new std::thread(&WebSocketStreamingClient::run_media, this);
+	if (media_generator.event_fd() < 0) {
+		// start media_generator thread
+		_media_thread = new std::thread(&WebSocketStreamingClient::run_media, this);
+	} else {
+		// wait for media on the I/O threads, once the WebSocket is open
+		_media_watch = std::make_shared<MediaWatch>(_engine.io_service(), ::dup(media_generator.event_fd()),
+			::dup(_send_drain->event_fd()), this);
+	}
 
-	// start keepalive thread
+	// start keepalive timer
+	// (the NO_KEEPALIVE_THREAD name is historical: it now disables the keepalive timer)
 	update_keepalive();
 #if !defined(NO_KEEPALIVE_THREAD)
-	_keepalive_thread = new std::thread(&WebSocketStreamingClient::run_keepalive, this);
+	char *env_ptr = getenv("VERBIT_KEEPALIVE_SECONDS");
+	if (env_ptr != nullptr) {
+		int env_i = atoi(env_ptr);
+		if (env_i > 0) {
+			_keepalive_timeout = std::chrono::seconds(env_i);
+		}
+	}
+	arm_keepalive(_keepalive_timeout);
 #endif
 
-	// start the ASIO io_service run loop: this doesn't return until the WebSocket closes
-	_ws_endpoint.run();
-
-	std::string debug = std::string("run is finished; error_code=") + std::to_string(_error_code);
-	write_alog("media", debug);
-
-	return (_error_code == 0);
+	return true;
 }
 
 bool WebSocketStreamingClient::stop_stream()
 {
 	int stateBefore = _state.get();
 
-	write_alog("stop_stream from state",  _state.c_str());
+	CLIENT_LOG(info, "stop_stream from state", "%s", _state.c_str());
 
 	if (!_state.is_final()) {
 		_state.change(ServiceState::state_closing);
-		_keepalive_check.notify_one();
 	}
 
 	// perform additional steps if the state was state_open
 	if (stateBefore == ServiceState::state_open) {
-		// allow time for the media worker thread to read and send the last chunk
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
-		// close websocket to make run_stream() return
-		write_alog("stop_stream", "closing WebSocket");
+		// close websocket to make run_stream() return; the media loop sees
+		// `state_closing` and stops before its next chunk
+		CLIENT_LOG(info, "stop_stream", "closing WebSocket");
 		close_ws();
-		// wait up to a second for the websocket to close
-		_state.wait_for(ServiceState::state_done, std::chrono::milliseconds(1000));
+		// wait up to a second for the websocket to close (`on_close` wakes us)
+		_state.wait_while(ServiceState::state_closing, std::chrono::milliseconds(1000));
 	}
 
 	return (_state.get() == ServiceState::state_done);
@@ -219,238 +442,884 @@ bool WebSocketStreamingClient::stop_stream()
 
 void WebSocketStreamingClient::run_media()
 {
-	static ssize_t wssc_bytes_sent = 0L;
-	static ssize_t wssc_report_at_bytes = 0L;
+	wspp_message_ptr msg;
+	for (;;) {
+		// wait for WebSocket to be open: `on_open` (or a failure) wakes us
+		_state.wait_while(ServiceState::state_opening);
+
+		CLIENT_LOG(info, "WebSocket", "finished opening; state=%s", _state.c_str());
+
+		if (_resume_pending.exchange(false) && !replay_media()) {
+			stop_stream();
+		}
+
+		// start sending audio chunks
+		send_media(msg);
 
-	// wait for WebSocket to be open
-	while (_state.get() == ServiceState::state_opening) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		// after an unexpected close, this thread reconnects, since it is the one using the connection
+		if ( (_state.get() != ServiceState::state_opening) || !_reconnect_pending.exchange(false) ) {
+			break;
+		}
+		msg.reset();
+		if (!queue_reconnect()) {
+			fail_reconnect();
+			return;
+		}
 	}
 
-	std::string debug = std::string("finished opening; state=") + _state.c_str();
-	write_alog("WebSocket", debug);
+	finish_media();
+}
 
-	// start sending audio chunks
+// The media thread's send loop: returns when the WebSocket is no longer open, or all media is sent.
+void WebSocketStreamingClient::send_media(wspp_message_ptr& msg)
+{
 	while ( (_state.get() == ServiceState::state_open) && !_media_generator->finished() ) {
-		std::string chunk = _media_generator->get_chunk();
-		if (chunk == MediaGenerator::END_OF_FILE) {
+		if (_congestion_policy == congestion_block) {
+			// leave the media in the generator until the send queue drains: look again
+			// each time one of our messages is written (or the connection closes)
+			uint64_t seen = _send_drain->count();
+			if (is_congested()) {
+				_send_drain->wait(seen);
+				continue;
+			}
+		}
+		if (!read_media(msg)) {
 			_error_code = AUDIO_SOURCE_EOF;
+			_flight.record(FlightEvent::media_eof);
 			stop_stream();
 		}
-		else if (chunk.length() > 0) {
-			websocketpp::connection_hdl hdl = _ws_con->get_handle();
-			websocketpp::lib::error_code ec;
-
-			_ws_endpoint.send(hdl, chunk, websocketpp::frame::opcode::binary, ec);
-
-			if (ec) {
-				static int errorCount = 0;
-				errorCount++;
-				std::stringstream ec_ss;
-				ec_ss << ec;
-				write_alog("send audio error count", std::to_string(errorCount));
-				write_alog("send audio ec", ec_ss.str());
-				write_alog("send audio ec message", ec.message());
-				if (errorCount > 10) {
-					_error_code = ec.value();
-					stop_stream();
-				}
+		else if (msg->get_payload().length() > 0) {
+			if (!queue_chunk(msg)) {
+				stop_stream();
 			}
+		}
+	}
+}
 
-			wssc_bytes_sent += chunk.length();
-			if (wssc_bytes_sent > wssc_report_at_bytes) {
-				std::stringstream media_ss;
-				media_ss << "sent chunk " << chunk.length() << " bytes" <<
-					" get_buffered_amount() " << _ws_con->get_buffered_amount() <<
-					" have sent " << wssc_bytes_sent << " bytes";
-				write_alog("media", media_ss.str());
-				wssc_report_at_bytes += 500000L;
+// Called (from an I/O thread) when a media generator with an `event_fd()` may have media.
+// Sends what is available without blocking, then waits for the descriptor again.
+void WebSocketStreamingClient::on_media_ready()
+{
+	while ( (_state.get() == ServiceState::state_open) && !_media_generator->finished() ) {
+		if (_congestion_policy == congestion_block) {
+			// arm the drain signal before looking, so a message written after the look
+			// is not missed; if congested, stop reading until one of our messages is
+			// written, waiting on the drain (the media descriptor stays readable meanwhile)
+			_send_drain->arm();
+			if (is_congested()) {
+				wait_drain();
+				return;
 			}
-
-#if defined(VERBOSE_DEBUG)
-			std::stringstream media_ss;
-			media_ss << "sent chunk " << chunk.length() << " bytes" <<
-				" get_buffered_amount() " << _ws_con->get_buffered_amount();
-			write_alog("media", media_ss.str());
-#endif
+		}
+		wspp_message_ptr msg;
+		if (!read_media(msg)) {
+			_error_code = AUDIO_SOURCE_EOF;
+			_flight.record(FlightEvent::media_eof);
+			abort_stream();
+			return;
+		}
+		if (msg->get_payload().empty()) {
+			wait_media();
+			return;
+		}
+		if (!queue_chunk(msg)) {
+			abort_stream();
+			return;
 		}
 	}
 
-	if ( (_state.get() == ServiceState::state_open) && _media_generator->finished() ) {
-		std::string event_eos = "{\"event\":\"EOS\",\"payload\":{}}";
-		bool eosSent = false;
-		static const int EOS_REPLY_TIMEOUT_S = 15;
+	finish_media();
+}
 
-		write_alog("media", "finished");
+// Check the send queue against the watermarks, and track the congestion metrics.
+// Congested from above the high watermark until at or below the low watermark.
+bool WebSocketStreamingClient::is_congested()
+{
+	if (_high_watermark == 0) {
+		return false;
+	}
+	size_t buffered = _ws_con->get_buffered_amount();
+	_metrics.buffered_amount.record(buffered);
+	_flight.record(FlightEvent::buffered, (uint32_t)std::min(buffered, (size_t)UINT32_MAX));
 
-		_state.change_if(ServiceState::state_closing, ServiceState::state_open, false);
+	std::unique_lock<std::mutex> lock(_congestion_mutex);
+	if (buffered > _congestion_stats.max_buffered) {
+		_congestion_stats.max_buffered = buffered;
+	}
+	if (!_congested && (buffered > _high_watermark)) {
+		_congested = true;
+		_congested_since = std::chrono::steady_clock::now();
+		_congestion_stats.congestion_events++;
+		CLIENT_LOG(info, "media", "congested; get_buffered_amount() %zu", buffered);
+	} else if (_congested && (buffered <= _low_watermark)) {
+		_congested = false;
+		_congestion_stats.time_congested += std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - _congested_since);
+		CLIENT_LOG(info, "media", "drained; get_buffered_amount() %zu", buffered);
+	}
+	return _congested;
+}
 
-		// send EOS and wait EOS_REPLY_TIMEOUT_S for EOS reply from the service
-		for (int i = 0; i < EOS_REPLY_TIMEOUT_S && _state.get() != ServiceState::state_done; i++) {
-			// the EOS (end of stream) message tells the service we are done
-			// sending media, and the order can be finalized; after this point
-			// we should see responses with `is_end_of_stream=true`
-			// which will cause us to close the WebSocket
-			websocketpp::connection_hdl hdl = _ws_con->get_handle();
-			websocketpp::lib::error_code ec;
+// Send a chunk read by `read_media()`, or hold it back or drop it if the send queue is
+// congested. On return, `msg` is empty if the message was consumed, and otherwise can
+// be reused for the next read.
+// Returns `false` when there have been too many send errors to continue.
+bool WebSocketStreamingClient::queue_chunk(wspp_message_ptr& msg)
+{
+	if ( (_congestion_policy != congestion_block) && is_congested() ) {
+		size_t len = msg->get_payload().length();
+		size_t dropped = 0;
+		if (_congestion_policy == congestion_drop) {
+			dropped = len;
+		} else if (!_held_msg) {
+			_held_msg = msg;
+			msg.reset();
+		} else if (_held_msg->get_payload().length() + len > _high_watermark) {
+			// holding back more than the high watermark is no better than having sent it:
+			// drop the oldest media, and reuse its message
+			dropped = _held_msg->get_payload().length();
+			std::swap(_held_msg, msg);
+		} else {
+			_held_msg->get_raw_payload().append(msg->get_payload());
+		}
+		if (dropped > 0) {
+			std::unique_lock<std::mutex> lock(_congestion_mutex);
+			_congestion_stats.bytes_dropped += dropped;
+		}
+		return true;
+	}
 
-			if (!eosSent) {
-				_ws_endpoint.send(hdl, event_eos, websocketpp::frame::opcode::text, ec);
-			}
+	if (_held_msg) {
+		// send the media held back while congested, and this chunk, as one message
+		return flush_held(&msg->get_payload());
+	}
 
-			if (ec) {
-				std::stringstream ec_ss;
-				ec_ss << ec;
-				write_alog("send eos error count", std::to_string(i));
-				write_alog("send eos ec", ec_ss.str());
-				write_alog("send eos ec message", ec.message());
-			}
-			else if (!eosSent) {
-				write_alog("media", "sent EOS");
-				eosSent = true;
-			}
-			else {
-				write_alog("media", "waiting for is_end_of_stream=true response");
-			}
+	bool ok = send_chunk(msg);
+	// the message now belongs to the send queue
+	msg.reset();
+	return ok;
+}
 
-			// 1 second wait per iteration
-			_state.wait_for(ServiceState::state_done, std::chrono::milliseconds(1000));
+// Send the media held back while congested, followed by `tail` if given.
+bool WebSocketStreamingClient::flush_held(const std::string* tail)
+{
+	wspp_message_ptr held;
+	std::swap(held, _held_msg);
+	if (!held) {
+		return true;
+	}
+	{
+		std::unique_lock<std::mutex> lock(_congestion_mutex);
+		_congestion_stats.bytes_coalesced += held->get_payload().length();
+	}
+	if (tail) {
+		held->get_raw_payload().append(*tail);
+	}
+	return send_chunk(held);
+}
+
+// Allocate an outgoing media message, which notifies the session's send drain signal
+// when released: WebSocket++ releases it once it has been written to the socket.
+wspp_message_ptr WebSocketStreamingClient::new_message()
+{
+	std::shared_ptr<SendDrain> drain = _send_drain;
+	return wspp_message_ptr(new wspp_message(wspp_message::con_msg_man_ptr(), websocketpp::frame::opcode::binary, _chunk_bytes_hint),
+		[drain](wspp_message* msg) {
+			delete msg;
+			drain->notify();
+		});
+}
+
+// Read the next chunk from the media generator straight into the payload of
+// an outgoing message (allocating the message if `msg` is empty), so the media
+// is not copied again until WebSocket++ frames it.
+// Returns `false` if the media source ended unexpectedly.
+bool WebSocketStreamingClient::read_media(wspp_message_ptr& msg)
+{
+	if (!msg) {
+		msg = new_message();
+	}
+	bool more;
+	{
+		// (the payload holds just the media read once the buffer is gone)
+		ChunkBuffer chunk(msg->get_raw_payload());
+		more = _media_generator->read_chunk(chunk);
+	}
+	std::string& payload = msg->get_raw_payload();
+	if (_gate) {
+		// (an empty payload is not sent)
+		uint64_t gated = _gate->stats().bytes_gated;
+		_gate->process(payload);
+		_metrics.bytes_gated.add(_gate->stats().bytes_gated - gated);
+	}
+	if (payload.size() > _chunk_bytes_hint) {
+		_chunk_bytes_hint = payload.size();
+	}
+	return more;
+}
+
+// Send again the media not acknowledged before an unexpected close, from the replay ring.
+// Returns `false` when there have been too many send errors to continue.
+bool WebSocketStreamingClient::replay_media()
+{
+	// media held back while congested was never sent, so is not in the ring:
+	// it is kept, and sent after the replay
+	uint64_t end = _replay->end_offset();
+	uint64_t acked = std::min(_acked_offset.load(), end);
+	uint64_t from = std::max(acked, _replay->begin_offset());
+	// the service times its responses on the new connection from here
+	_conn_base_offset.store(from);
+	_send_offset = from;
+
+	uint64_t offset = from;
+	bool ok = true;
+	while (ok && (offset < end)) {
+		wspp_message_ptr msg = new_message();
+		{
+			ChunkBuffer chunk(msg->get_raw_payload());
+			chunk.commit(_replay->copy(offset, chunk.prepare(_chunk_bytes_hint), _chunk_bytes_hint));
+			offset += chunk.size();
 		}
-		if (_state.get() == ServiceState::state_done) {
-			write_alog("WebSocket", "closed due to EOS");
+		ok = send_chunk(msg, true);
+	}
+
+	CLIENT_LOG(info, "media", "replayed %llu bytes from offset %llu; lost %llu bytes",
+		(unsigned long long)(offset - from), (unsigned long long)from, (unsigned long long)(from - acked));
+	std::unique_lock<std::mutex> lock(_reconnect_mutex);
+	_reconnect_stats.bytes_replayed += offset - from;
+	_reconnect_stats.bytes_lost += from - acked;
+	return ok;
+}
+
+// Track the media acknowledged by final responses, from the end time of their last item.
+void WebSocketStreamingClient::record_ack(const Response& response)
+{
+	if ( !response.is_final || response.alternatives.empty() || response.alternatives[0].items.empty() ) {
+		return;
+	}
+	double end_t = response.alternatives[0].items.back().end;
+	uint64_t acked = _conn_base_offset.load() + (uint64_t)(end_t * _media_bytes_per_second);
+	acked -= acked % _media_frame_bytes;
+	uint64_t current = _acked_offset.load();
+	while ( (acked > current) && !_acked_offset.compare_exchange_weak(current, acked) ) {
+	}
+}
+
+// Measure the emission latency of a response: from when the audio up to the end of its last
+// item was sent, until the response arrived. The service times media from the connection's start.
+void WebSocketStreamingClient::record_latency(const Response& response, std::chrono::steady_clock::time_point arrival)
+{
+	if ( response.alternatives.empty() || response.alternatives[0].items.empty() || (_media_bytes_per_second == 0) ) {
+		return;
+	}
+	double end_t = response.alternatives[0].items.back().end;
+	uint64_t offset = _conn_base_offset.load() + (uint64_t)(end_t * _media_bytes_per_second);
+	std::chrono::steady_clock::time_point sent;
+	if (!_timeline.sent_time(offset, sent)) {
+		return;
+	}
+	_response_latency = std::max(std::chrono::microseconds(0),
+		std::chrono::duration_cast<std::chrono::microseconds>(arrival - sent));
+	_metrics.emission_latency.record(_response_latency.count());
+}
+
+// Media sent for the first time goes into the replay ring (media dropped or failing to send
+// never reaches the service, so the ring follows the service's timeline); `replayed` media
+// came from the ring.
+// Returns `false` when there have been too many send errors to continue.
+bool WebSocketStreamingClient::send_chunk(wspp_message_ptr msg, bool replayed)
+{
+	const std::string& chunk = msg->get_payload();
+	std::chrono::steady_clock::time_point send_start = std::chrono::steady_clock::now();
+	websocketpp::lib::error_code ec = _ws_con->send(msg);
+	_metrics.send_latency.record(_micros(std::chrono::steady_clock::now() - send_start));
+	if (ec) {
+		_flight.record(FlightEvent::send_error, ec.value());
+		_metrics.send_errors.add();
+		_send_error_count++;
+		CLIENT_LOG(warn, "send audio", "error count %d; ec %s:%d %s", _send_error_count,
+			ec.category().name(), ec.value(), ec.message().c_str());
+		if (_send_error_count > 10) {
+			_error_code = ec.value();
+			return false;
 		}
-		else {
-			write_alog("media", "is_end_of_stream=true not received from service within "
-					+ std::to_string(EOS_REPLY_TIMEOUT_S) + "s");
-			// this will cause run_stream() to exit
-			close_ws();
+		return true;
+	}
+
+	_send_offset += chunk.length();
+	_timeline.sent(_send_offset, send_start);
+	if (_replay && !replayed) {
+		_replay->append(chunk.data(), chunk.length());
+	}
+	if (_recorder) {
+		record(CaptureRecord::media, chunk);
+	}
+	_flight.record(FlightEvent::send, chunk.length());
+	if (_metrics.bytes_sent.value() == 0) {
+		mark_time(_times.first_send);
+	}
+	_metrics.frames_sent.add();
+	_metrics.bytes_sent.add(chunk.length());
+	size_t bytes_sent = _metrics.bytes_sent.value();
+	if (bytes_sent > _report_at_bytes) {
+		CLIENT_LOG(info, "media", "sent chunk %zu bytes get_buffered_amount() %zu have sent %zu bytes",
+			chunk.length(), _ws_con->get_buffered_amount(), bytes_sent);
+		_report_at_bytes += 500000L;
+	}
+
+#if defined(VERBOSE_DEBUG)
+	CLIENT_LOG(debug, "media", "sent chunk %zu bytes get_buffered_amount() %zu",
+		chunk.length(), _ws_con->get_buffered_amount());
+#endif
+	return true;
+}
+
+// Called when the media loop exits: sends EOS if all media has been sent.
+void WebSocketStreamingClient::finish_media()
+{
+	if ( (_state.get() == ServiceState::state_open) && _media_generator->finished() ) {
+		CLIENT_LOG(info, "media", "finished");
+
+		// media held back by the coalesce policy goes before EOS, congested or not
+		if (!flush_held(nullptr)) {
+			abort_stream();
+			return;
 		}
+
+		_state.change_if(ServiceState::state_closing, ServiceState::state_open, false);
+
+		// send EOS, then wait up to `_eos_timeout` for EOS reply from the service;
+		// the wait (and any resend) is done by _eos_timer, not by this thread,
+		// and the reply closes the WebSocket as soon as it arrives
+		_eos_start = std::chrono::steady_clock::now();
+		send_eos();
+		_engine.timers().arm(_eos_timer, std::min(EOS_CHECK_INTERVAL, _eos_timeout),
+			std::bind(&WebSocketStreamingClient::on_eos_timer, this));
 	}
 	else {
-		std::string debug = std::string("exited loop without finish; state=") + _state.c_str();
-		write_alog("media", debug);
+		CLIENT_LOG(info, "media", "exited loop without finish; state=%s", _state.c_str());
 	}
 }
 
-void WebSocketStreamingClient::run_keepalive()
+bool WebSocketStreamingClient::send_eos()
 {
-	int keepalive_timeout_seconds = 30;
-	char *env_ptr = getenv("VERBIT_KEEPALIVE_SECONDS");
-	if (env_ptr != nullptr) {
-		int env_i = atoi(env_ptr);
-		if (env_i > 0) {
-			keepalive_timeout_seconds = env_i;
+	// the EOS (end of stream) message tells the service we are done
+	// sending media, and the order can be finalized; after this point
+	// we should see responses with `is_end_of_stream=true`
+	// which will cause us to close the WebSocket
+	static const std::string event_eos = "{\"event\":\"EOS\",\"payload\":{}}";
+	websocketpp::connection_hdl hdl = _ws_con->get_handle();
+	websocketpp::lib::error_code ec;
+
+	_ws_endpoint.send(hdl, event_eos, websocketpp::frame::opcode::text, ec);
+
+	if (ec) {
+		CLIENT_LOG(warn, "send eos", "ec %s:%d %s", ec.category().name(), ec.value(), ec.message().c_str());
+		return false;
+	}
+	CLIENT_LOG(info, "media", "sent EOS");
+	_flight.record(FlightEvent::eos);
+	if (_recorder) {
+		record(CaptureRecord::event, event_eos);
+	}
+	mark_time(_times.eos);
+	_eos_sent = true;
+	return true;
+}
+
+void WebSocketStreamingClient::on_eos_timer()
+{
+	if (_state.get() == ServiceState::state_done) {
+		return;
+	}
+	std::chrono::milliseconds waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - _eos_start);
+	if (waited >= _eos_timeout) {
+		CLIENT_LOG(warn, "media", "is_end_of_stream=true not received from service within %lldms",
+			(long long)_eos_timeout.count());
+		// this will cause run_stream() to exit
+		close_ws();
+		return;
+	}
+	if (!_eos_sent) {
+		send_eos();
+	} else {
+		CLIENT_LOG(info, "media", "waiting for is_end_of_stream=true response");
+	}
+	// check again in 1 second, or at the timeout if that is sooner
+	_engine.timers().arm(_eos_timer, std::min(EOS_CHECK_INTERVAL, _eos_timeout - waited),
+		std::bind(&WebSocketStreamingClient::on_eos_timer, this));
+}
+
+// Record the time a session phase was (first) reached.
+void WebSocketStreamingClient::mark_time(StreamTimes::time_point& time)
+{
+	std::unique_lock<std::mutex> lock(_times_mutex);
+	if (time == StreamTimes::time_point()) {
+		time = std::chrono::steady_clock::now();
+	}
+}
+
+// called on every message and ping, so this is a single lock-free store
+void WebSocketStreamingClient::update_keepalive()
+{
+	_keepalive_time.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+void WebSocketStreamingClient::arm_keepalive(std::chrono::milliseconds delay)
+{
+	_engine.timers().arm(_keepalive_timer, delay, std::bind(&WebSocketStreamingClient::on_keepalive_timer, this));
+}
+
+void WebSocketStreamingClient::on_keepalive_timer()
+{
+	if (_state.is_final()) {
+		return;
+	}
+	std::chrono::steady_clock::time_point keepalive_time {
+		std::chrono::steady_clock::duration(_keepalive_time.load(std::memory_order_relaxed))
+	};
+	std::chrono::steady_clock::duration idle = std::chrono::steady_clock::now() - keepalive_time;
+	if (idle > _keepalive_timeout) {
+		// _keepalive_time was not updated recently
+		_error_code = KEEPALIVE_TIMEOUT;
+		_flight.record(FlightEvent::keepalive_timeout);
+		CLIENT_LOG(warn, "keepalive", "no pings received for %llds", (long long)_keepalive_timeout.count());
+		abort_stream();
+		return;
+	}
+	// not expired yet: check again when it would expire
+	arm_keepalive(std::chrono::duration_cast<std::chrono::milliseconds>(_keepalive_timeout - idle));
+}
+
+bool WebSocketStreamingClient::connect_ws()
+{
+	websocketpp::lib::error_code ec;
+	wspp_client::connection_ptr con = _engine.get_connection(this, ws_full_url(), ec);
+	if (ec) {
+		CLIENT_LOG(error, "get_connection error", "%s", ec.message().c_str());
+		CLIENT_LOG(error, "transport-specific get_connection error", "%s", con->get_transport_ec().message().c_str());
+		_error_code = con->get_local_close_code();
+		_service_error = con->get_local_close_reason();
+		return false;
+	}
+	if (_ws_con) {
+		// this is a retry: stop routing shared-endpoint events for the failed connection
+		_engine.detach(_ws_con->get_handle());
+	}
+	_ws_con = con;
+
+	// set handlers on the connection itself, since the endpoint may be shared by many clients
+	_ws_con->set_open_handler(bind(&WebSocketStreamingClient::on_open, this, websocketpp::lib::placeholders::_1));
+	_ws_con->set_message_handler(bind(&WebSocketStreamingClient::on_message, this, websocketpp::lib::placeholders::_1, websocketpp::lib::placeholders::_2));
+	_ws_con->set_close_handler(bind(&WebSocketStreamingClient::on_close, this, websocketpp::lib::placeholders::_1));
+	_ws_con->set_fail_handler(bind(&WebSocketStreamingClient::on_fail, this, websocketpp::lib::placeholders::_1));
+	_ws_con->set_ping_handler(bind(&WebSocketStreamingClient::on_ping, this, websocketpp::lib::placeholders::_1, websocketpp::lib::placeholders::_2));
+	_ws_con->set_tcp_pre_init_handler(bind(&WebSocketStreamingClient::on_tcp_pre_init, this, websocketpp::lib::placeholders::_1));
+	_ws_con->set_tcp_post_init_handler(bind(&WebSocketStreamingClient::on_tcp_post_init, this, websocketpp::lib::placeholders::_1));
+
+	// don't let the HTTP upgrade outlive the connect deadline
+	std::chrono::milliseconds time_left = connect_time_left();
+	if (time_left.count() > 0) {
+		_ws_con->set_open_handshake_timeout(time_left.count());
+	}
+
+	_ws_con->append_header("Authorization", std::string("Bearer ") + _access_token);
+	_connect_attempts++;
+	_metrics.connect_attempts.add();
+	_flight.record(FlightEvent::connect, _connect_attempts.load());
+	{
+		std::unique_lock<std::mutex> lock(_times_mutex);
+		ConnectAttempt attempt;
+		attempt.start = std::chrono::steady_clock::now();
+		_times.attempts.push_back(attempt);
+	}
+	_ws_endpoint.connect(_ws_con);
+	return true;
+}
+
+// Return the time left before the connect deadline, or 0 if there is no deadline
+// (or, at least 1ms, if it has passed).
+std::chrono::milliseconds WebSocketStreamingClient::connect_time_left()
+{
+	if (_connect_deadline.count() <= 0) {
+		return std::chrono::milliseconds(0);
+	}
+	std::chrono::steady_clock::time_point deadline = _connect_start + _connect_deadline;
+	std::chrono::milliseconds left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+	return std::max(left, std::chrono::milliseconds(1));
+}
+
+void WebSocketStreamingClient::on_tcp_pre_init(websocketpp::connection_hdl hdl)
+{
+	std::unique_lock<std::mutex> lock(_times_mutex);
+	if (!_times.attempts.empty()) {
+		_times.attempts.back().tcp_connected = std::chrono::steady_clock::now();
+	}
+}
+
+void WebSocketStreamingClient::on_tcp_post_init(websocketpp::connection_hdl hdl)
+{
+	std::unique_lock<std::mutex> lock(_times_mutex);
+	if (!_times.attempts.empty()) {
+		_times.attempts.back().tls_done = std::chrono::steady_clock::now();
+	}
+}
+
+// Record the end of the current connect attempt, and log where its time went.
+void WebSocketStreamingClient::end_attempt(bool ok)
+{
+	ConnectAttempt attempt;
+	size_t n;
+	{
+		std::unique_lock<std::mutex> lock(_times_mutex);
+		if (_times.attempts.empty()) {
+			return;
 		}
+		_times.attempts.back().end = std::chrono::steady_clock::now();
+		_times.attempts.back().ok = ok;
+		attempt = _times.attempts.back();
+		n = _times.attempts.size();
 	}
+	if (!log_enabled(Logger::info)) {
+		return;
+	}
+	// phases not reached are logged as -1
+	long long tcp_ms = -1;
+	long long tls_ms = -1;
+	long long upgrade_ms = -1;
+	if (attempt.tcp_connected != ConnectAttempt::time_point()) {
+		tcp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(attempt.tcp_connected - attempt.start).count();
+	}
+	if (attempt.tls_done != ConnectAttempt::time_point()) {
+		tls_ms = std::chrono::duration_cast<std::chrono::milliseconds>(attempt.tls_done - attempt.tcp_connected).count();
+		upgrade_ms = std::chrono::duration_cast<std::chrono::milliseconds>(attempt.end - attempt.tls_done).count();
+	}
+	log_line(Logger::info, "connect", "attempt %zu %s; ms in DNS+TCP %lld TLS %lld HTTP upgrade %lld total %lld",
+		n, (ok ? "open" : "failed"), tcp_ms, tls_ms, upgrade_ms,
+		(long long)std::chrono::duration_cast<std::chrono::milliseconds>(attempt.end - attempt.start).count());
+}
 
-	while (!_state.is_final() ) {
-		std::unique_lock<std::mutex> lock(_keepalive_mutex);
-		std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-		if (now > (_keepalive_time + std::chrono::seconds(keepalive_timeout_seconds))) {
-			// _keepalive_time was not updated recently
-			_error_code = KEEPALIVE_TIMEOUT;
-			lock.unlock();
-			write_alog("run_keepalive", "no pings received for " + std::to_string(keepalive_timeout_seconds) +"s");
-			stop_stream();
-			break;
+// In resilient mode, start reconnecting after an unexpected close while media is being sent.
+// Returns `false` if the close should finish the session as usual.
+bool WebSocketStreamingClient::begin_reconnect(websocketpp::connection_hdl hdl)
+{
+	wspp_client::connection_ptr con = _ws_endpoint.get_con_from_hdl(hdl);
+	bool unexpected = con->get_ec() || (con->get_remote_close_code() != websocketpp::close::status::normal);
+	if (!unexpected || (_state.get() != ServiceState::state_open)) {
+		return false;
+	}
+	if (_reconnects_begun >= _max_reconnects) {
+		CLIENT_LOG(warn, "WebSocket", "not reconnecting: made %d reconnects", _reconnects_begun);
+		return false;
+	}
+
+	// a new connect cycle, with its own attempt limit and deadline
+	_gap_start = std::chrono::steady_clock::now();
+	_connect_start = _gap_start;
+	_connect_attempts = 0;
+	update_keepalive();
+
+	// the media path replays, and (for the media thread) reconnects, once it sees the state change
+	_reconnect_pending = true;
+	_resume_pending = true;
+	if (!_state.change_if(ServiceState::state_opening, ServiceState::state_open, false)) {
+		// the session is already being stopped
+		_reconnect_pending = false;
+		_resume_pending = false;
+		return false;
+	}
+	_reconnects_begun++;
+	_metrics.reconnects.add();
+	_flight.record(FlightEvent::reconnect, _reconnects_begun);
+	CLIENT_LOG(warn, "WebSocket", "unexpected close (remote code %d, ec %s:%d); reconnecting",
+		(int)con->get_remote_close_code(), con->get_ec().category().name(), con->get_ec().value());
+
+	if (_media_watch) {
+		// no media thread: reconnect here, while the media path is not running
+		bool queued;
+		{
+			std::unique_lock<std::mutex> lock(_media_watch->mutex);
+			_reconnect_pending = false;
+			queued = queue_reconnect();
+		}
+		if (!queued) {
+			fail_reconnect();
 		}
-		// wait for _keepalive_check to be signaled or up to 5 seconds
-		_keepalive_check.wait_for(lock, std::chrono::seconds(5));
 	}
+	return true;
 }
 
-void WebSocketStreamingClient::update_keepalive()
+// Queue a new connection after an unexpected close.
+// Returns `false` if it can't be queued, or the session was stopped meanwhile.
+bool WebSocketStreamingClient::queue_reconnect()
 {
-	std::unique_lock<std::mutex> lock(_keepalive_mutex);
-	_keepalive_time = std::chrono::system_clock::now();
+	if ( (_state.get() == ServiceState::state_opening) && connect_ws() ) {
+		CLIENT_LOG(info, "WebSocket", "reconnect queued");
+		return true;
+	}
+	return false;
+}
+
+// Fail the session when a reconnect could not be queued.
+void WebSocketStreamingClient::fail_reconnect()
+{
+	if (_error_code == 0) {
+		_error_code = WS_1006;
+	}
+	_state.change_if(ServiceState::state_fail, ServiceState::state_opening, false);
+	_state.change_if(ServiceState::state_fail, ServiceState::state_closing, false);
+	finish_stream();
+}
+
+// Full-jitter exponential backoff: a random delay of up to the initial backoff,
+// doubled for each further retry, capped at MAX_RETRY_SECONDS.
+std::chrono::milliseconds WebSocketStreamingClient::retry_backoff(int retry)
+{
+	double ceiling = _max_conn_retry;
+	for (int i = 1; (i < retry) && (ceiling < MAX_RETRY_SECONDS); i++) {
+		ceiling *= 2;
+	}
+	if (ceiling > MAX_RETRY_SECONDS) {
+		ceiling = MAX_RETRY_SECONDS;
+	}
+	std::uniform_real_distribution<double> jitter(0.0, ceiling * 1000);
+	return std::chrono::milliseconds((long)jitter(_retry_rng));
+}
+
+// Called once, when the WebSocket session has completely finished (closed or failed).
+void WebSocketStreamingClient::finish_stream()
+{
+	mark_time(_times.finish);
+	CLIENT_LOG(info, "session", "ms in opening %lld open %lld closing %lld",
+		(long long)std::chrono::duration_cast<std::chrono::milliseconds>(_state.time_in(ServiceState::state_opening)).count(),
+		(long long)std::chrono::duration_cast<std::chrono::milliseconds>(_state.time_in(ServiceState::state_open)).count(),
+		(long long)std::chrono::duration_cast<std::chrono::milliseconds>(_state.time_in(ServiceState::state_closing)).count());
+	_flight.record(FlightEvent::finish, _error_code);
+	if ( (_error_code != 0) && !_flight_dump_dir.empty() ) {
+		dump_flight();
+	}
+	cancel_timers();
+	stop_media_watch();
+	_engine.detach(_ws_con->get_handle());
+	if (_own_engine) {
+		// Stop the io_service object's event processing loop.
+		// This ensures that the call to _engine.run() returns.
+		// See comments in /usr/local/include/boost/asio/io_service.hpp.
+		_ws_endpoint.stop();
+	}
+	if (_dispatch_queue) {
+		// finish once every response queued so far has been delivered
+		_finish_dispatched = true;
+		_dispatch_queue->finish(std::bind(&WebSocketStreamingClient::finished, this));
+		return;
+	}
+	finished();
+}
+
+// Report the session finished, to `run_stream()` or `async_run_stream()`.
+void WebSocketStreamingClient::finished()
+{
+	if (_async) {
+		complete_stream();
+		return;
+	}
+	std::unique_lock<std::mutex> lock(_finished_mutex);
+	_finished = true;
+	_finished_cv.notify_all();
+}
+
+// Deliver the final result of an `async_run_stream()` session.
+void WebSocketStreamingClient::complete_stream()
+{
+	StreamResult result;
+	result.error_code = _error_code;
+	result.service_error = _service_error;
+
+	CLIENT_LOG(info, "media", "async run is finished; error_code=%d", _error_code);
+
+	// once the result is delivered the client may be destroyed at any time,
+	// so nothing below may touch members after taking them
+	wssc_completion_handler handler = std::move(_completion_handler);
+	std::promise<StreamResult> promise(std::move(_result_promise));
+	{
+		std::unique_lock<std::mutex> lock(_finished_mutex);
+		_finished = true;
+		_finished_cv.notify_all();
+	}
+	if (handler) {
+		handler(this, result);
+	}
+	promise.set_value(result);
+}
+
+// Like `stop_stream()`, but does not block; for use from I/O threads (_e.g._ timer callbacks).
+void WebSocketStreamingClient::abort_stream()
+{
+	int stateBefore = _state.get();
+
+	CLIENT_LOG(info, "abort_stream from state", "%s", _state.c_str());
+
+	if (!_state.is_final()) {
+		_state.change(ServiceState::state_closing);
+	}
+	if (stateBefore == ServiceState::state_open) {
+		close_ws();
+	}
+}
+
+// Wait (asynchronously) for the media generator's `event_fd()` to become readable.
+// The caller must hold `_media_watch->mutex`.
+void WebSocketStreamingClient::wait_media()
+{
+	std::shared_ptr<MediaWatch> watch = _media_watch;
+	watch->descriptor.async_read_some(boost::asio::null_buffers(),
+		[watch](const boost::system::error_code& ec, size_t) {
+			// the watch outlives the client, so check the client is still there
+			std::unique_lock<std::mutex> lock(watch->mutex);
+			if (!ec && watch->client) {
+				watch->client->on_media_ready();
+			}
+		});
+}
+
+// Wait (asynchronously) for one of our messages to be written, while the send queue is congested.
+// The caller must hold `_media_watch->mutex`.
+void WebSocketStreamingClient::wait_drain()
+{
+	std::shared_ptr<MediaWatch> watch = _media_watch;
+	std::shared_ptr<SendDrain> drain = _send_drain;
+	watch->drain.async_read_some(boost::asio::null_buffers(),
+		[watch, drain](const boost::system::error_code& ec, size_t) {
+			drain->clear();
+			std::unique_lock<std::mutex> lock(watch->mutex);
+			if (!ec && watch->client) {
+				watch->client->on_media_ready();
+			}
+		});
+}
+
+void WebSocketStreamingClient::stop_media_watch()
+{
+	if (_media_watch) {
+		std::unique_lock<std::mutex> lock(_media_watch->mutex);
+		_media_watch->client = nullptr;
+		boost::system::error_code ec;
+		_media_watch->descriptor.cancel(ec);
+		_media_watch->drain.cancel(ec);
+	}
+}
+
+void WebSocketStreamingClient::cancel_timers()
+{
+	TimerWheel& timers = _engine.timers();
+	timers.cancel(_keepalive_timer);
+	timers.cancel(_eos_timer);
+	timers.cancel(_retry_timer);
 }
 
 void WebSocketStreamingClient::close_ws()
 {
-	write_alog("WebSocket", "closing");
+	CLIENT_LOG(info, "WebSocket", "closing");
 	if (_ws_con)
 	{
 		try {
 			websocketpp::connection_hdl hdl = _ws_con->get_handle();
 			_ws_endpoint.close(hdl, websocketpp::close::status::going_away, "");
 		} catch (std::exception & e) {
-			write_alog("WebSocket", std::string("endpoint::close threw exception: ") + e.what());
+			CLIENT_LOG(warn, "WebSocket", "endpoint::close threw exception: %s", e.what());
 			// and then don't worry about it - no other action needed
 		}
 	}
 }
 
-// NOTE: this method has no effect and does no logging unless
-// _ws_endpoint.set_access_channels() has been called in the constructor
-// or in the WebSocketStreamingClient::log_path() method.
-void WebSocketStreamingClient::write_alog(std::string tag, std::string message)
+// Lines are logged at any level to the WebSocket++ access log, if its app channel is set
+// (by `log_path()`); otherwise, without a logger, nothing is logged.
+bool WebSocketStreamingClient::log_enabled(Logger::Level level)
+{
+	if (_logger) {
+		return _logger->enabled(level);
+	}
+	return _ws_endpoint.get_alog().dynamic_test(websocketpp::log::alevel::app);
+}
+
+void WebSocketStreamingClient::log_line(Logger::Level level, const char* tag, const char* format, ...)
 {
-	std::string line;
-	if (tag.empty()) {
-		line = message;
+	va_list args;
+	va_start(args, format);
+	if (_logger) {
+		_logger->vlog(level, tag, format, args);
 	} else {
-		line = tag + ": " + message;
+		// size the line from a first, measuring pass over a copy of the arguments
+		std::string prefix = *tag ? std::string(tag) + ": " : std::string();
+		va_list measure;
+		va_copy(measure, args);
+		int len = vsnprintf(nullptr, 0, format, measure);
+		va_end(measure);
+		if (len >= 0) {
+			std::vector<char> text(prefix.length() + len + 1);
+			memcpy(text.data(), prefix.data(), prefix.length());
+			vsnprintf(text.data() + prefix.length(), len + 1, format, args);
+			_ws_endpoint.get_alog().write(websocketpp::log::alevel::app, text.data());
+		}
 	}
-	_ws_endpoint.get_alog().write(websocketpp::log::alevel::app, line);
+	va_end(args);
 }
 
 void WebSocketStreamingClient::on_socket_init(websocketpp::connection_hdl hdl)
 {
-	write_alog("WebSocket", "on_socket_init called");
+	CLIENT_LOG(info, "WebSocket", "on_socket_init called");
 }
 
 wspp_context_ptr WebSocketStreamingClient::on_tls_init(websocketpp::connection_hdl hdl)
 {
-	write_alog("WebSocket", "on_tls_init called");
-	wspp_context_ptr ctx = websocketpp::lib::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tlsv12);
-	if (!_verify_ssl_cert) {
-		ctx->set_verify_mode(boost::asio::ssl::verify_none);
-	}
-	ctx->set_options(boost::asio::ssl::context::default_workarounds |
-	                 boost::asio::ssl::context::no_sslv2 |
-	                 boost::asio::ssl::context::no_sslv3 |
-	                 boost::asio::ssl::context::no_tlsv1 |
-	                 boost::asio::ssl::context::single_dh_use);
-	return ctx;
+	CLIENT_LOG(info, "WebSocket", "on_tls_init called");
+	return _engine.tls_context(_verify_ssl_cert);
 }
 
 // NOTE: the `on_fail` handler will only be called during initialization;
 // after `on_open` is called, `on_fail` will never be called
 void WebSocketStreamingClient::on_fail(websocketpp::connection_hdl hdl)
 {
-	if (_max_conn_retry < MAX_RETRY_SECONDS) {
-		// backoff delay before next attempt
-		std::chrono::duration<double> dur(_max_conn_retry);
-		std::this_thread::sleep_for(dur);
-
-		// connect to the WebSocket server (subsequent retry)
-		websocketpp::lib::error_code ec;
-		_ws_con = _ws_endpoint.get_connection(ws_full_url(), ec);
-		auto still_opening = (_state.get() == ServiceState::state_opening);
-		if (ec) {
-			write_alog("get_connection error", ec.message());
-			websocketpp::lib::error_code transport_ec = _ws_con->get_transport_ec();
-			write_alog("transport-specific get_connection error", transport_ec.message());
-			_error_code = _ws_con->get_local_close_code();
-			_service_error = _ws_con->get_local_close_reason();
-			// fall through to final `state_fail`
-		} else if (!still_opening) {
-			write_alog("WebSocket", "not requeuing connect in on_fail: state no longer opening");
-			_error_code = _ws_con->get_local_close_code();
-			_service_error = _ws_con->get_local_close_reason();
-			// fall through to final `state_fail`
-		} else {
-			// leave `_state` in `ServiceState::state_opening`
-			_ws_con->append_header("Authorization", std::string("Bearer ") + _access_token);
-			_ws_endpoint.connect(_ws_con);
-			std::string debug = std::string("connect requeued by on_fail, after retry_delay=") + std::to_string(_max_conn_retry);
-			write_alog("WebSocket", debug);
-			_max_conn_retry *= 1.5;
+	_flight.record(FlightEvent::fail, _ws_endpoint.get_con_from_hdl(hdl)->get_local_close_code());
+	end_attempt(false);
+	int attempts = _connect_attempts.load();
+	if (attempts < _max_connect_attempts) {
+		// backoff delay before next attempt, without blocking the I/O thread
+		std::chrono::milliseconds delay = retry_backoff(attempts);
+		std::chrono::milliseconds time_left = connect_time_left();
+		if ((time_left.count() == 0) || (delay < time_left)) {
+			_engine.timers().arm(_retry_timer, delay, std::bind(&WebSocketStreamingClient::retry_connect, this, hdl));
 			return;
 		}
+		CLIENT_LOG(warn, "WebSocket", "not retrying connect: deadline would pass during backoff");
+	} else {
+		CLIENT_LOG(warn, "WebSocket", "not retrying connect: made %d attempts", attempts);
 	}
+	fail_connect(hdl);
+}
 
-	// "If `stop_stream()` is called during the retry phase (either by the keepalive thread timing out
+void WebSocketStreamingClient::retry_connect(websocketpp::connection_hdl hdl)
+{
+	// connect to the WebSocket server (subsequent retry)
+	auto still_opening = (_state.get() == ServiceState::state_opening);
+	if (!still_opening) {
+		CLIENT_LOG(info, "WebSocket", "not requeuing connect in on_fail: state no longer opening");
+		_error_code = _ws_con->get_local_close_code();
+		_service_error = _ws_con->get_local_close_reason();
+		// fall through to final `state_fail`
+	} else if (connect_ws()) {
+		// leave `_state` in `ServiceState::state_opening`
+		CLIENT_LOG(info, "WebSocket", "connect requeued by on_fail");
+		return;
+	}
+	// else fall through to final `state_fail`
+	fail_connect(hdl);
+}
+
+void WebSocketStreamingClient::fail_connect(websocketpp::connection_hdl hdl)
+{
+	// "If `stop_stream()` is called during the retry phase (either by the keepalive timer timing out
 	// or by explicit user call), the state becomes `state_closing`." So here we transform either case
 	// to `state_fail`.
 	_state.change_if(ServiceState::state_fail, ServiceState::state_opening, false);
@@ -458,23 +1327,18 @@ void WebSocketStreamingClient::on_fail(websocketpp::connection_hdl hdl)
 
 	wspp_client::connection_ptr con = _ws_endpoint.get_con_from_hdl(hdl);
 
-	write_alog("on_fail state", std::to_string(con->get_state()));
-	websocketpp::lib::error_code ec = con->get_ec();
-	std::stringstream ec_ss;
-	ec_ss << ec;
-	write_alog("on_fail ec", ec_ss.str());
-	write_alog("on_fail ec message", con->get_ec().message());
-	// unfortunately this doesn't provide detail like "Connection refused":
-	websocketpp::lib::error_code transport_ec = con->get_transport_ec();
-	std::stringstream transport_ec_ss;
-	transport_ec_ss << transport_ec;
-	write_alog("on_fail transport-specific ec", transport_ec_ss.str());
-	write_alog("on_fail transport-specific ec message", transport_ec.message());
-	write_alog("on_fail local code", std::to_string(con->get_local_close_code()));
-	write_alog("on_fail local code", con->get_local_close_reason());
-	write_alog("on_fail remote code", std::to_string(con->get_remote_close_code()));
-	write_alog("on_fail remote code", con->get_remote_close_reason());
-	write_alog("on_fail response message", con->get_response_msg());
+	if (log_enabled(Logger::warn)) {
+		websocketpp::lib::error_code ec = con->get_ec();
+		// unfortunately this doesn't provide detail like "Connection refused":
+		websocketpp::lib::error_code transport_ec = con->get_transport_ec();
+		log_line(Logger::warn, "on_fail", "state %d; ec %s:%d %s; transport-specific ec %s:%d %s",
+			(int)con->get_state(), ec.category().name(), ec.value(), ec.message().c_str(),
+			transport_ec.category().name(), transport_ec.value(), transport_ec.message().c_str());
+		log_line(Logger::warn, "on_fail", "local code %d %s; remote code %d %s; response message %s",
+			(int)con->get_local_close_code(), con->get_local_close_reason().c_str(),
+			(int)con->get_remote_close_code(), con->get_remote_close_reason().c_str(),
+			con->get_response_msg().c_str());
+	}
 
 	if (con->get_local_close_code() == WS_1006) {  // abnormal WS close
 		_error_code = WS_1006;
@@ -490,13 +1354,37 @@ void WebSocketStreamingClient::on_fail(websocketpp::connection_hdl hdl)
 			}
 		}
 	}
+
+	finish_stream();
 }
 
 void WebSocketStreamingClient::on_open(websocketpp::connection_hdl hdl)
 {
+	_flight.record(FlightEvent::open);
+	mark_time(_times.open);
+	end_attempt(true);
+	if (_gap_start != std::chrono::steady_clock::time_point()) {
+		std::chrono::milliseconds gap = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - _gap_start);
+		_gap_start = std::chrono::steady_clock::time_point();
+		std::unique_lock<std::mutex> lock(_reconnect_mutex);
+		_reconnect_stats.reconnects++;
+		_reconnect_stats.total_gap += gap;
+		_reconnect_stats.max_gap = std::max(_reconnect_stats.max_gap, gap);
+		_send_error_count = 0;
+		CLIENT_LOG(info, "WebSocket", "reopened after %lldms", (long long)gap.count());
+	}
 	_state.change_if(ServiceState::state_open, ServiceState::state_opening, true);
-	std::string debug = std::string("on_open called; state=") + _state.c_str();
-	write_alog("WebSocket", debug);
+	CLIENT_LOG(info, "WebSocket", "on_open called; state=%s", _state.c_str());
+
+	if (_media_watch) {
+		std::unique_lock<std::mutex> lock(_media_watch->mutex);
+		if (_resume_pending.exchange(false) && !replay_media()) {
+			abort_stream();
+			return;
+		}
+		wait_media();
+	}
 }
 
 // anonymous namespace is used here to define translation-unit-local helper methods
@@ -544,58 +1432,178 @@ std::string _frame_type_str(websocketpp::frame::opcode::value opcode, bool compr
 
 void WebSocketStreamingClient::on_message(websocketpp::connection_hdl hdl, wspp_message_ptr msg)
 {
-	size_t payload_len = msg->get_payload().length();
-	std::string debug = std::string("on_message called:")
-		+ " frame_type " + _frame_type_str(msg->get_opcode(), msg->get_compressed(), msg->get_fin())
-		+ " payload_len " + std::to_string(payload_len);
-	write_alog("WebSocket", debug);
+	CLIENT_LOG(debug, "WebSocket", "on_message called: frame_type %s payload_len %zu",
+		_frame_type_str(msg->get_opcode(), msg->get_compressed(), msg->get_fin()).c_str(),
+		msg->get_payload().length());
 
 	update_keepalive();
 
-	// parse message JSON and deliver to handler
-	nlohmann::json message = nlohmann::json::parse(msg->get_payload());
-	if (_handler) {
-		_handler(this, &message);
+	// parse message into a typed response only if something on this thread needs it;
+	// otherwise just scan the text for its top-level fields (type, id and flags)
+	std::string& payload = msg->get_raw_payload();
+	if (_recorder) {
+		record(CaptureRecord::response, payload);
 	}
-
-	// when all `is_end_of_stream=true` responses have been received, close the WebSocket
-	auto it = message.find("response");
-	if (it == message.end()) {
-		write_alog("", "JSON message received with no 'response' entry");
+	const Response* response = nullptr;
+	const Response* header = nullptr;
+	_response_latency = std::chrono::microseconds(-1);
+	if (_replay || _track_latency || (_typed_handler && !_dispatch_queue)) {
+		std::chrono::steady_clock::time_point arrival = std::chrono::steady_clock::now();
+		try {
+			response = &_response_parser.parse(payload);
+		} catch (std::exception& e) {
+			// a malformed response fails this session, not the I/O thread shared with others
+			fail_response(e);
+			return;
+		}
+		_metrics.parse_time.record(_micros(std::chrono::steady_clock::now() - arrival));
+		header = response;
+		record_latency(*response, arrival);
+		if (_replay) {
+			record_ack(*response);
+		}
+		if (!response->has_response) {
+			CLIENT_LOG(warn, "", "JSON message received with no 'response' entry");
+		} else {
+			_response_types.record_eos(*response);
+		}
 	} else {
-		_response_types.record_eos(message["response"]);
+		ResponseParser::scan(payload, _scanned_response);
+		header = &_scanned_response;
+		_response_types.record_eos(*header);
 	}
+	uint16_t flags = (header->is_final ? FlightEvent::response_final : 0) | (header->is_end_of_stream ? FlightEvent::response_eos : 0);
+	_flight.record(FlightEvent::response, payload.length(), flags);
+	_metrics.responses[header->has_response ? SessionMetrics::response_kind(header->type) : SessionMetrics::response_other].add();
+
+	if (_dispatch_queue) {
+		// hand the text over to a dispatch pool worker, which calls the handler(s);
+		// a transcript partial supersedes a queued one for the same utterance, and
+		// only partials are dropped if the queue is full, never a final or EOS response
+		bool queued;
+		if ( _dispatch_coalesce && (header->type == "transcript") && !header->is_final
+			&& !header->is_end_of_stream && !header->id.empty() ) {
+			queued = _dispatch_queue->push_latest(std::move(payload), header->id.data, header->id.length);
+		} else {
+			bool keep = header->is_final || header->is_end_of_stream || !header->has_response;
+			queued = _dispatch_queue->push(std::move(payload), keep);
+		}
+		if (!queued) {
+			CLIENT_LOG(warn, "dispatch", "queue full; a response was dropped");
+		}
+	} else {
+		try {
+			deliver_response(payload, response);
+		} catch (std::exception& e) {
+			// a handler (or the JSON parse for it) fails this session, not the I/O thread
+			fail_response(e);
+			return;
+		}
+	}
+
+	// when all `is_end_of_stream=true` responses have been received, close the WebSocket
 	if (_response_types.is_eos()) {
+		CLIENT_LOG(info, "WebSocket", "closing due to EOS");
 		close_ws();
 	}
 }
 
+// Fail the session on a response which could not be handled.
+void WebSocketStreamingClient::fail_response(const std::exception& e)
+{
+	CLIENT_LOG(error, "response error", "%s", e.what());
+	_error_code = RESPONSE_ERROR;
+	_service_error = e.what();
+	int state = _state.get();
+	abort_stream();
+	if (state != ServiceState::state_open) {
+		// abort_stream() only closes an open WebSocket, and responses still arrive after EOS is sent
+		close_ws();
+	}
+}
+
+// Dump the flight record of a failed session to `_flight_dump_dir`; a failure is logged.
+void WebSocketStreamingClient::dump_flight()
+{
+	static std::atomic<int> dumps {0};
+	std::string path = _flight_dump_dir + "/flight_" + std::to_string(getpid()) + "_" + std::to_string(++dumps) + ".vbfr";
+	try {
+		_flight.dump(path, _error_code);
+		CLIENT_LOG(info, "flight recorder", "dumped to %s", path.c_str());
+	} catch (const std::runtime_error& e) {
+		CLIENT_LOG(warn, "flight recorder", "%s", e.what());
+	}
+}
+
+// Record a message in the session capture; a failure is logged, but does not stop the stream.
+void WebSocketStreamingClient::record(CaptureRecord::Kind kind, const std::string& payload)
+{
+	try {
+		_recorder->record(kind, payload.data(), payload.length());
+	} catch (const std::runtime_error& e) {
+		CLIENT_LOG(warn, "recorder", "%s", e.what());
+	}
+}
+
+// Deliver a response to the handler(s); `response` is its typed form, if already parsed.
+void WebSocketStreamingClient::deliver_response(std::string& payload, const Response* response)
+{
+	if (!_typed_handler && !_handler && !_raw_handler) {
+		return;
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (_typed_handler) {
+		if (!response) {
+			response = &_dispatch_parser.parse(payload);
+			std::chrono::steady_clock::time_point parsed = std::chrono::steady_clock::now();
+			_metrics.parse_time.record(_micros(parsed - start));
+			start = parsed;
+		}
+		_typed_handler(this, *response);
+	}
+	if (_handler) {
+		nlohmann::json message = nlohmann::json::parse(payload);
+		_handler(this, &message);
+	}
+	// the raw handler may move the payload out, so it goes last
+	if (_raw_handler) {
+		_raw_handler(this, payload);
+	}
+	_metrics.handler_time.record(_micros(std::chrono::steady_clock::now() - start));
+}
+
 void WebSocketStreamingClient::on_close(websocketpp::connection_hdl hdl)
 {
+	{
+		wspp_client::connection_ptr con = _ws_endpoint.get_con_from_hdl(hdl);
+		_flight.record(FlightEvent::close, con->get_local_close_code(), con->get_remote_close_code());
+	}
+	if (_replay && begin_reconnect(hdl)) {
+		// wake the media path if it waits for the send queue to drain
+		_send_drain->notify();
+		return;
+	}
+
 	_state.change_unless(ServiceState::state_done, ServiceState::state_fail, false);
-	std::string debug = std::string("on_close called; state=") + _state.c_str();
-	write_alog("WebSocket", debug);
+	_send_drain->notify();
+	CLIENT_LOG(info, "WebSocket", "on_close called; state=%s", _state.c_str());
 
 	// check if this close was caused by an error
 	wspp_client::connection_ptr con = _ws_endpoint.get_con_from_hdl(hdl);
 	websocketpp::lib::error_code ec = con->get_ec();
 	if (ec) {
-		std::stringstream ec_ss;
-		ec_ss << ec;
-		write_alog("on_close ec", ec_ss.str());
-		write_alog("on_close ec message", ec.message());
+		CLIENT_LOG(warn, "on_close", "ec %s:%d %s", ec.category().name(), ec.value(), ec.message().c_str());
 		// setting _error_code causes run_stream() to return false
 		_error_code = ec.value();
 	}
 
-	// Stop the io_service object's event processing loop.
-	// This ensures that the call to _ws_endpoint.run() returns.
-	// See comments in /usr/local/include/boost/asio/io_service.hpp.
-	_ws_endpoint.stop();
+	finish_stream();
 }
 
 bool WebSocketStreamingClient::on_ping(websocketpp::connection_hdl hdl, std::string msg) {
-	write_alog("on_ping", "received");
+	_flight.record(FlightEvent::ping);
+	_metrics.pings.add();
+	CLIENT_LOG(debug, "on_ping", "received");
 	update_keepalive();
 	return true;
 }
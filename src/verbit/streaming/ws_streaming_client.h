@@ -1,29 +1,57 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <thread>
 
 #include <nlohmann/json.hpp>
-#include <websocketpp/config/asio_client.hpp>
-#include <websocketpp/client.hpp>
 
+#include <verbit/streaming/congestion_stats.h>
+#include <verbit/streaming/dispatch_pool.h>
+#include <verbit/streaming/flight_recorder.h>
+#include <verbit/streaming/logger.h>
 #include <verbit/streaming/media_config.h>
 #include <verbit/streaming/media_generator.h>
+#include <verbit/streaming/metrics_registry.h>
+#include <verbit/streaming/reconnect_stats.h>
+#include <verbit/streaming/replay_ring.h>
+#include <verbit/streaming/response_parser.h>
 #include <verbit/streaming/response_type.h>
+#include <verbit/streaming/send_drain.h>
+#include <verbit/streaming/send_timeline.h>
 #include <verbit/streaming/service_state.h>
+#include <verbit/streaming/session_capture.h>
+#include <verbit/streaming/session_metrics.h>
+#include <verbit/streaming/stream_result.h>
+#include <verbit/streaming/stream_times.h>
+#include <verbit/streaming/streaming_engine.h>
 #include <verbit/streaming/version.h>
+#include <verbit/streaming/voice_gate.h>
 
 #define WSSC_DEFAULT_WS_URL "wss://speech.verbit.co/ws"
 #define WSSC_DEFAULT_CONNECTION_RETRY_SECONDS 0.4
+#define WSSC_DEFAULT_CONNECT_ATTEMPTS 6
+#define WSSC_DEFAULT_CONNECT_DEADLINE_SECONDS 30
+#define WSSC_DEFAULT_REPLAY_SECONDS 10
+#define WSSC_DEFAULT_MAX_RECONNECTS 5
+#define WSSC_DEFAULT_KEEPALIVE_SECONDS 30
+#define WSSC_DEFAULT_CHUNK_BYTES 3200
+#define WSSC_DEFAULT_EOS_TIMEOUT_SECONDS 15
+#define WSSC_DEFAULT_HIGH_WATERMARK 320000
+#define WSSC_DEFAULT_LOW_WATERMARK 160000
 
 namespace verbit {
 namespace streaming {
 
-typedef websocketpp::client<websocketpp::config::asio_tls_client> wspp_client;
-typedef websocketpp::config::asio_tls_client::message_type::ptr wspp_message_ptr;
-typedef websocketpp::lib::shared_ptr<boost::asio::ssl::context> wspp_context_ptr;
-
 class WebSocketStreamingClient;
 typedef std::function<void(WebSocketStreamingClient*, nlohmann::json*)> wssc_response_handler;
+typedef std::function<void(WebSocketStreamingClient*, const Response&)> wssc_typed_response_handler;
+typedef std::function<void(WebSocketStreamingClient*, std::string&)> wssc_raw_response_handler;
+typedef std::function<void(WebSocketStreamingClient*, const StreamResult&)> wssc_completion_handler;
 
 /**
  * Class to connect to the Verbit Transcribe Streaming service.
@@ -34,13 +62,34 @@ public:
 	static constexpr const int WS_1006 = 1006;
 	static constexpr const int AUDIO_SOURCE_EOF = 3500;
 	static constexpr const int KEEPALIVE_TIMEOUT = 3510;
+	static constexpr const int RESPONSE_ERROR = 3520;
 	static constexpr const double MAX_RETRY_SECONDS = 2.5;
 
+	/// What to do with media while the send queue is congested.
+	enum CongestionPolicy {
+		congestion_block,     ///< stop reading from the media generator until the queue drains (default)
+		congestion_coalesce,  ///< hold media back, up to the high watermark, and send it as one message
+		congestion_drop       ///< drop media until the queue drains
+	};
+
 	/// Construct a new streaming client.
 	///
+	/// The client runs its own private WebSocket endpoint, and `run_stream()`
+	/// runs the I/O loop on the calling thread.
+	///
 	/// \param access_token credential required to access the service
 	WebSocketStreamingClient(std::string access_token);
 
+	/// Construct a new streaming client attached to a shared streaming engine.
+	///
+	/// The client's WebSocket connection is multiplexed with other sessions over
+	/// the engine's endpoint and I/O threads; `run_stream()` waits for the session
+	/// to finish but does not run an I/O loop itself.
+	///
+	/// \param access_token credential required to access the service
+	/// \param engine the streaming engine to attach to; must outlive this client
+	WebSocketStreamingClient(std::string access_token, StreamingEngine& engine);
+
 	/// Destruct the streaming client.
 	~WebSocketStreamingClient();
 
@@ -53,8 +102,21 @@ public:
 	/// Enable logging to file and set the log path.
 	/// If your client code does not call this method, you can still get logging
 	/// to std::cout/std::cerr by compiling with -DDEBUG
+	///
+	/// **NOTE** A client attached to a `StreamingEngine` logs through the engine's
+	/// shared endpoint, so this setting applies to all sessions of that engine.
 	void log_path(const std::string log_path);
 
+	/// Return the logger this client logs to, if any.
+	Logger* logger() { return _logger; }
+
+	/// Set a logger for this client's log lines, instead of the WebSocket++ access log
+	/// (which `log_path()` opens, and which still gets WebSocket++'s own lines).
+	/// Lines below the logger's level are not even formatted. Default `nullptr`.
+	///
+	/// \param logger the logger, which must outlive the client
+	void logger(Logger* logger) { _logger = logger; }
+
 	/// Return the WebSocket complete URL (with parameters).
 	const std::string ws_full_url();
 
@@ -64,8 +126,24 @@ public:
 
 	/// Set the number of seconds for the **initial** WebSocket connect retry backoff.
 	/// Retry uses a backoff time that is a multiple of this value (`max_` is a misnomer).
+	///
+	/// Each retry waits a random time (full jitter) of up to this value, doubled for
+	/// each further retry, and capped at `MAX_RETRY_SECONDS`.
 	void max_connection_retry_seconds(double seconds) { _max_conn_retry = seconds; }
 
+	/// Return the maximum number of WebSocket connect attempts, including the first.
+	int max_connect_attempts() { return _max_connect_attempts; }
+
+	/// Set the maximum number of WebSocket connect attempts, including the first. Default 6.
+	void max_connect_attempts(int attempts) { _max_connect_attempts = attempts; }
+
+	/// Return the overall deadline for opening the WebSocket, across all attempts.
+	std::chrono::milliseconds connect_deadline() { return _connect_deadline; }
+
+	/// Set the overall deadline for opening the WebSocket, from the first attempt, across all
+	/// attempts and retry backoff. Default 30 seconds. Set to 0 for no deadline.
+	void connect_deadline(std::chrono::milliseconds deadline) { _connect_deadline = deadline; }
+
 	/// Return the SSL certificate verification behavior.
 	constexpr bool verify_ssl_cert() { return _verify_ssl_cert; }
 
@@ -74,6 +152,215 @@ public:
 	/// This has security implications, and should only be used for testing!
 	void verify_ssl_cert(bool verify_ssl_cert) { _verify_ssl_cert = verify_ssl_cert; }
 
+	/// Return whether the session reconnects and resumes after an unexpected close.
+	bool resilient() { return _resilient; }
+
+	/// Set whether the session reconnects and resumes after an unexpected close. Default `false`.
+	///
+	/// In resilient mode, the most recent media sent (up to `replay_window()`) is kept in a
+	/// ring allocated when the stream starts. If the WebSocket closes unexpectedly while
+	/// media is being sent (_e.g._ an abnormal 1006 close), the client reconnects (with the
+	/// usual retry backoff, attempt limit and deadline), sends again the media not yet
+	/// acknowledged by a final response, and goes on reading from the media generator.
+	/// Media is not read while reconnecting. A close after end-of-stream is not resumed.
+	/// Encoded media (see `MediaConfig::is_pcm()`) cannot be resumed, and is refused.
+	void resilient(bool resilient) { _resilient = resilient; }
+
+	/// Return how much of the most recent media is kept for replay in resilient mode.
+	std::chrono::milliseconds replay_window() { return _replay_window; }
+
+	/// Set how much of the most recent media is kept for replay in resilient mode. Default 10 seconds.
+	void replay_window(std::chrono::milliseconds window) { _replay_window = window; }
+
+	/// Return the maximum number of reconnects per session in resilient mode.
+	int max_reconnects() { return _max_reconnects; }
+
+	/// Set the maximum number of reconnects per session in resilient mode. Default 5.
+	void max_reconnects(int reconnects) { _max_reconnects = reconnects; }
+
+	/// Return the reconnect metrics for this session so far.
+	ReconnectStats reconnect_stats();
+
+	/// Return the pool delivering responses off the I/O threads, if any.
+	DispatchPool* dispatch_pool() { return _dispatch_pool; }
+
+	/// Set a pool to deliver responses off the I/O threads. Default `nullptr` (deliver on the I/O thread).
+	///
+	/// With a dispatch pool, the I/O thread only scans each response for its top-level fields, and
+	/// queues its text (without copying it) for a pool worker, which parses it as needed and
+	/// calls the response handler(s); so a slow handler does not hold up pings, keepalives or
+	/// media for the session. Responses are still delivered one at a time, in order. The
+	/// stream only finishes (`run_stream()` returns, or `async_run_stream()` completes) once
+	/// every queued response has been delivered.
+	///
+	/// \param pool the dispatch pool, which must outlive the stream; set before running the stream
+	void dispatch_pool(DispatchPool* pool) { _dispatch_pool = pool; }
+
+	/// Return the maximum number of responses queued for the dispatch pool.
+	size_t dispatch_capacity() { return _dispatch_capacity; }
+
+	/// Set the maximum number of responses queued for the dispatch pool. Default 256.
+	/// Final and end-of-stream responses are never dropped: when the queue is full, they are
+	/// queued beyond this capacity if there is no non-final response to make room.
+	void dispatch_capacity(size_t capacity) { _dispatch_capacity = capacity; }
+
+	/// Return what happens to a response when the dispatch queue is full.
+	DispatchQueue::OverflowPolicy dispatch_policy() { return _dispatch_policy; }
+
+	/// Set what happens to a non-final response when the dispatch queue is full. Default
+	/// `DispatchQueue::drop_oldest` (the oldest queued non-final response is dropped); or
+	/// `drop_newest` (the arriving one); or `block`, which waits up to `dispatch_block_timeout()`
+	/// for a worker to make room, then drops the oldest. Responses are queued from the I/O thread,
+	/// so a blocked queue stalls pings, keepalives and media (and on a shared engine, every other
+	/// session) for up to the timeout. Final and end-of-stream responses are never dropped.
+	void dispatch_policy(DispatchQueue::OverflowPolicy policy) { _dispatch_policy = policy; }
+
+	/// Return how long the `DispatchQueue::block` policy waits for room in the dispatch queue.
+	std::chrono::milliseconds dispatch_block_timeout() { return _dispatch_block_timeout; }
+
+	/// Set how long the `DispatchQueue::block` policy waits for room in the dispatch queue. Default 50ms.
+	void dispatch_block_timeout(std::chrono::milliseconds timeout) { _dispatch_block_timeout = timeout; }
+
+	/// Are non-final transcript responses coalesced in the dispatch queue?
+	bool dispatch_coalesce() { return _dispatch_coalesce; }
+
+	/// Set whether non-final transcript responses are coalesced in the dispatch queue. Default `false`.
+	///
+	/// Transcript responses for an utterance (which share their `id`) supersede each other until
+	/// the final one. With coalescing, a queued non-final transcript response is replaced by the
+	/// next one for the same utterance, so a handler which falls behind only sees the newest;
+	/// elided responses are counted in `dispatch_stats().coalesced`. A partial which finds the
+	/// queue full, with none to replace, is dropped (counted in `dispatch_stats().dropped`). Final,
+	/// end-of-stream and captions responses are never coalesced, and finals and end-of-stream
+	/// responses are never dropped. Only applies with a `dispatch_pool()`.
+	void dispatch_coalesce(bool coalesce) { _dispatch_coalesce = coalesce; }
+
+	/// Return the response dispatch metrics for this session so far (empty without a dispatch pool).
+	DispatchStats dispatch_stats();
+
+	/// Return the recorder capturing this session, if any.
+	SessionRecorder* session_recorder() { return _recorder; }
+
+	/// Set a recorder to capture the media and events sent, and the responses received, with
+	/// their times, _e.g._ to replay the session with the test server (`test_server -r`).
+	/// Default `nullptr` (no capture).
+	///
+	/// \param recorder the session recorder, which must outlive the stream; set before running the stream
+	void session_recorder(SessionRecorder* recorder) { _recorder = recorder; }
+
+	/// Return the flight recorder, which always keeps the last `WSSC_DEFAULT_FLIGHT_EVENTS` events
+	/// of the session (state transitions, sends, send queue samples, pings, responses, ...),
+	/// _e.g._ to `dump()` when `run_stream()` returns `false`.
+	FlightRecorder& flight_recorder() { return _flight; }
+
+	/// Return the directory flight records of failed sessions are dumped to, if any.
+	const std::string flight_dump_dir() { return _flight_dump_dir; }
+
+	/// Set a directory to dump the flight record to, automatically, when the session fails
+	/// (as `flight_<pid>_<n>.vbfr`; decode with `flight_decode`). Default empty (no dump).
+	void flight_dump_dir(const std::string dir) { _flight_dump_dir = dir; }
+
+	/// Return a snapshot of this session's metrics so far (bytes and messages sent, send latency,
+	/// send queue size, responses by type, parse and handler times, pings, connect attempts,
+	/// reconnects, and time in each state).
+	SessionMetrics metrics();
+
+	/// Are responses parsed on the I/O thread, if nothing else needs them parsed there, to measure their latency?
+	bool track_latency() { return _track_latency; }
+
+	/// Set whether to parse every response on the I/O thread to measure its emission latency. Default `false`.
+	///
+	/// The client maps each media byte offset to the time it was sent. The emission latency of a
+	/// response is the time from sending the audio up to the `end` of its last item, until the
+	/// response arrived; it is recorded in `metrics().emission_latency`, and available to response
+	/// handlers through `response_latency()`. Responses are parsed on the I/O thread (and so measured)
+	/// anyway for a typed handler without a `dispatch_pool()`, or in resilient mode; this makes the
+	/// client parse the others too, _e.g._ for a raw handler or a dispatch pool.
+	void track_latency(bool track) { _track_latency = track; }
+
+	/// Return the emission latency of the response being delivered (see `track_latency()`), or a
+	/// negative duration if it was not measured. Only valid in a response handler called on the
+	/// I/O thread, _i.e._ without a `dispatch_pool()`.
+	std::chrono::microseconds response_latency() { return _response_latency; }
+
+	/// Is silence gated (not sent)?
+	bool voice_gate() { return _gate_enabled; }
+
+	/// Set whether to gate silence: not send it, or send only short keep-alive frames in it.
+	/// Default `false`.
+	///
+	/// A `VoiceGate` between the media generator and the WebSocket passes media through while
+	/// there is speech (and for the `hangover` after), and holds back the rest, sending the
+	/// last `pre_roll` of it as speech starts. Only S16LE media is gated (other formats are sent
+	/// as is). The service times its responses by the media it got; `media_time()` maps those
+	/// times back to the media's.
+	///
+	/// \param enabled whether to gate silence; set before running the stream
+	/// \param config the gate settings
+	void voice_gate(bool enabled, const VoiceGateConfig& config = VoiceGateConfig())
+	{
+		_gate_enabled = enabled;
+		_gate_config = config;
+	}
+
+	/// Return the voice gate metrics for this session so far (all zero if not gated).
+	GateStats gate_stats();
+
+	/// Map a time in the media the service got (_e.g._ a response item's `end`), on the current
+	/// connection, to the time in the media read from the media generator, skipping the silence
+	/// not sent by the voice gate (and the media acknowledged before reconnecting).
+	///
+	/// \param service_time a time from the service, in seconds
+	/// \return the time in the media, in seconds (`service_time` as is, for encoded media)
+	double media_time(double service_time);
+
+	/// Return the registry this session's metrics are collected in, if any.
+	MetricsRegistry* metrics_registry() { return _metrics_registry; }
+
+	/// Set a registry to collect this session's metrics in, for process-wide totals and export.
+	/// The session is added when the stream starts, and removed (its metrics added to the
+	/// registry's totals) when the client is destroyed. Default `nullptr`.
+	///
+	/// \param registry the metrics registry, which must outlive the client; set before running the stream
+	void metrics_registry(MetricsRegistry* registry) { _metrics_registry = registry; }
+
+	/// Return how long to wait for the final `is_end_of_stream=true` responses after sending end-of-stream.
+	std::chrono::milliseconds eos_timeout() { return _eos_timeout; }
+
+	/// Set how long to wait for the final `is_end_of_stream=true` responses after sending end-of-stream,
+	/// before closing the WebSocket anyway. Default 15 seconds.
+	void eos_timeout(std::chrono::milliseconds timeout) { _eos_timeout = timeout; }
+
+	/// Return the send queue high watermark, in bytes.
+	size_t high_watermark() { return _high_watermark; }
+
+	/// Return the send queue low watermark, in bytes.
+	size_t low_watermark() { return _low_watermark; }
+
+	/// Set the send queue watermarks.
+	///
+	/// When more than `high` bytes are queued for sending (_e.g._ on a congested uplink),
+	/// the session is congested, and media is handled according to `congestion_policy()`
+	/// until the queue drains to `low` bytes. Default 320000 and 160000 bytes (10s and 5s
+	/// of S16LE 16kHz mono). Set `high` to 0 to never be congested.
+	void send_watermarks(size_t high, size_t low);
+
+	/// Return the congestion policy.
+	CongestionPolicy congestion_policy() { return _congestion_policy; }
+
+	/// Set the congestion policy. Default `congestion_block`.
+	void congestion_policy(CongestionPolicy policy) { _congestion_policy = policy; }
+
+	/// Return the send congestion metrics for this session so far.
+	CongestionStats congestion_stats();
+
+	/// Return the times at which this session reached each phase so far.
+	StreamTimes stream_times();
+
+	/// Return the total time this session has spent in a `ServiceState` state so far
+	/// (_e.g._ `ServiceState::state_opening`), including the current stay in it.
+	std::chrono::steady_clock::duration time_in_state(int state) { return _state.time_in(state); }
+
 	/// Set the handler used to deliver responses from the service.
 	///
 	/// The `handler` function should take two arguments (and return `void`):
@@ -91,17 +378,51 @@ public:
 	/// ```
 	void set_response_handler(wssc_response_handler handler) { _handler = handler; }
 
+	/// Set the handler used to deliver typed responses from the service.
+	///
+	/// The `handler` function should take two arguments (and return `void`):
+	/// - `WebSocketStreamingClient*` — pointer to this client
+	/// - `const Response&` — the parsed response
+	///
+	/// Typed responses are parsed in a single pass into memory which the client
+	/// reuses for every message, without building a JSON DOM; so the `Response`,
+	/// and the strings and items it refers to, are only valid during the handler
+	/// call. Prefer this handler to `set_response_handler()`, which makes the client
+	/// also parse each message into a `nlohmann::json` object.
+	///
+	/// Both handlers may be set; the typed handler is called first.
+	void set_typed_response_handler(wssc_typed_response_handler handler) { _typed_handler = handler; }
+
+	/// Set the handler used to deliver raw responses from the service, for relaying them verbatim.
+	///
+	/// The `handler` function should take two arguments (and return `void`):
+	/// - `WebSocketStreamingClient*` — pointer to this client
+	/// - `std::string&` — the JSON text of the response, as received
+	///
+	/// The response text is not parsed: the client finds end-of-stream responses
+	/// with a targeted scan of the text (see `ResponseParser::scan()`). The handler
+	/// owns the text for the duration of the call, and may move it out
+	/// (`std::string mine = std::move(payload);`) to keep it without a copy.
+	///
+	/// The raw handler is called after any typed or JSON handler. In resilient mode,
+	/// each response is also parsed into a typed response, to find acknowledged media.
+	void set_raw_response_handler(wssc_raw_response_handler handler) { _raw_handler = handler; }
+
 	/// Return the numeric error code.
 	///
 	/// \return
 	/// - 0 for no error
 	/// - 400-599 for HTTP status codes (_e.g._ 401 for Unauthorized)
 	/// - 1000+ for WebSocket errors (_e.g._ 1006 for abnormal close)
+	/// - 3500+ for client errors (_e.g._ 3510 for keepalive timeout, 3520 for a response which could not be handled)
 	constexpr int error_code() { return _error_code; }
 
 	/// Return the service-level error message.
 	const std::string service_error() { return _service_error; }
 
+	/// Return the number of media bytes sent by this session so far.
+	size_t bytes_sent() { return _metrics.bytes_sent.value(); }
+
 	/// Start the WebSocket stream using the given media generator.
 	///
 	/// In this form, the default media config (S16LE 16kHz mono PCM) and response types (Captions) will be used.
@@ -118,6 +439,38 @@ public:
 	/// \return `false` if an error was encountered; use error methods for details
 	bool run_stream(MediaGenerator& media_generator, const MediaConfig& media_config, const ResponseType& response_types);
 
+	/// Start the WebSocket stream using the given media generator, without blocking.
+	///
+	/// In this form, the default media config (S16LE 16kHz mono PCM) and response types (Captions) will be used.
+	///
+	/// \param media_generator the media source; must outlive the stream
+	/// \param completion_handler optional function called once when the stream has finished
+	/// \return a future for the final result of the stream
+	std::future<StreamResult> async_run_stream(MediaGenerator& media_generator,
+		wssc_completion_handler completion_handler = nullptr);
+
+	/// Start the WebSocket stream using the given media generator, media config, and desired response types,
+	/// without blocking.
+	///
+	/// This method returns as soon as the connection has been queued. When the stream has finished
+	/// (successfully or not), the returned future becomes ready and `completion_handler`, if any, is called.
+	/// Both report the final `error_code()` and `service_error()`.
+	///
+	/// A client attached to a `StreamingEngine` is run by the engine's I/O threads; a standalone client
+	/// starts one I/O thread of its own.
+	///
+	/// **NOTE** `completion_handler` is called from an I/O thread (or from the calling thread, if the
+	/// connection could not be queued, or from a worker, with a `dispatch_pool()`), and must not block. It may destroy a client attached to a
+	/// `StreamingEngine`, but not a standalone client (whose own I/O thread is running the handler).
+	///
+	/// \param media_generator the media source; must outlive the stream
+	/// \param media_config the media format
+	/// \param response_types the response types to request from the service
+	/// \param completion_handler optional function called once when the stream has finished
+	/// \return a future for the final result of the stream
+	std::future<StreamResult> async_run_stream(MediaGenerator& media_generator, const MediaConfig& media_config,
+		const ResponseType& response_types, wssc_completion_handler completion_handler = nullptr);
+
 	/// Stop the WebSocket stream.
 	///
 	/// This method will cause `run_stream` to return and it closes the WebSocket connection.
@@ -132,33 +485,160 @@ public:
 	bool stop_stream();
 
 private:
+	friend class StreamingEngine;
+
+	std::unique_ptr<StreamingEngine> _own_engine;
+	StreamingEngine& _engine;
+	wspp_client& _ws_endpoint;
 	std::string _access_token;
 	std::ofstream *_alog = nullptr;
 	std::ofstream *_elog = nullptr;
+	Logger* _logger = nullptr;
 	std::string _ws_url;
 	double _max_conn_retry;
+	int _max_connect_attempts = WSSC_DEFAULT_CONNECT_ATTEMPTS;
+	std::chrono::milliseconds _connect_deadline {std::chrono::seconds(WSSC_DEFAULT_CONNECT_DEADLINE_SECONDS)};
+	std::minstd_rand _retry_rng;
 	bool _verify_ssl_cert;
 	wssc_response_handler _handler = nullptr;
+	wssc_typed_response_handler _typed_handler = nullptr;
+	wssc_raw_response_handler _raw_handler = nullptr;
+	ResponseParser _response_parser;
+	DispatchPool* _dispatch_pool = nullptr;
+	size_t _dispatch_capacity = WSSC_DEFAULT_DISPATCH_CAPACITY;
+	DispatchQueue::OverflowPolicy _dispatch_policy = DispatchQueue::drop_oldest;
+	std::chrono::milliseconds _dispatch_block_timeout {WSSC_DEFAULT_DISPATCH_BLOCK_MS};
+	std::shared_ptr<DispatchQueue> _dispatch_queue;
+	ResponseParser _dispatch_parser;
+	SessionRecorder* _recorder = nullptr;
+	bool _dispatch_coalesce = false;
+	Response _scanned_response;
+	bool _finish_dispatched = false;
 	MediaGenerator* _media_generator = nullptr;
 	std::thread* _media_thread = nullptr;
-	std::thread* _keepalive_thread = nullptr;
+	struct MediaWatch;
+	std::shared_ptr<MediaWatch> _media_watch;
 	MediaConfig _media_config;
 	ResponseType _response_types;
 	ServiceState _state;
-	wspp_client _ws_endpoint;
+	FlightRecorder _flight;
+	std::string _flight_dump_dir;
 	wspp_client::connection_ptr _ws_con = nullptr;
 	int _error_code;
 	std::string _service_error;
 
-	std::chrono::system_clock::time_point _keepalive_time;
-	std::mutex _keepalive_mutex;
-	std::condition_variable _keepalive_check;
+	SessionMetrics _metrics;
+	MetricsRegistry* _metrics_registry = nullptr;
+	uint64_t _metrics_id = 0;
+	bool _metrics_added = false;
+	bool _track_latency = false;
+	SendTimeline _timeline;
+	uint64_t _send_offset = 0;
+	std::chrono::microseconds _response_latency {-1};
+	bool _gate_enabled = false;
+	VoiceGateConfig _gate_config;
+	std::unique_ptr<VoiceGate> _gate;
+	size_t _chunk_bytes_hint = WSSC_DEFAULT_CHUNK_BYTES;
+
+	size_t _high_watermark = WSSC_DEFAULT_HIGH_WATERMARK;
+	size_t _low_watermark = WSSC_DEFAULT_LOW_WATERMARK;
+	CongestionPolicy _congestion_policy = congestion_block;
+	bool _congested = false;
+	std::chrono::steady_clock::time_point _congested_since;
+	CongestionStats _congestion_stats;
+	std::mutex _congestion_mutex;
+	wspp_message_ptr _held_msg;
+	std::shared_ptr<SendDrain> _send_drain {std::make_shared<SendDrain>()};
+	size_t _report_at_bytes = 0;
+	int _send_error_count = 0;
+
+	bool _finished = false;
+	std::mutex _finished_mutex;
+	std::condition_variable _finished_cv;
+
+	bool _async = false;
+	std::promise<StreamResult> _result_promise;
+	wssc_completion_handler _completion_handler = nullptr;
+
+	// timers on the engine's shared timer wheel (instead of a thread per client)
+	std::atomic<std::chrono::steady_clock::rep> _keepalive_time;
+	std::chrono::seconds _keepalive_timeout;
+	WheelTimer _keepalive_timer;
+	std::atomic<bool> _eos_sent;
+	std::chrono::steady_clock::time_point _eos_start;
+	std::chrono::milliseconds _eos_timeout;
+	WheelTimer _eos_timer;
+	WheelTimer _retry_timer;
+
+	StreamTimes _times;
+	std::mutex _times_mutex;
+	std::chrono::steady_clock::time_point _connect_start;
+	std::atomic<int> _connect_attempts;
+
+	// resilient mode: the replay ring is only used by the media path
+	bool _resilient = false;
+	std::chrono::milliseconds _replay_window {std::chrono::seconds(WSSC_DEFAULT_REPLAY_SECONDS)};
+	int _max_reconnects = WSSC_DEFAULT_MAX_RECONNECTS;
+	std::unique_ptr<ReplayRing> _replay;
+	size_t _media_bytes_per_second = 0;
+	size_t _media_frame_bytes = 1;
+	int _reconnects_begun = 0;
+	std::atomic<uint64_t> _acked_offset;
+	std::atomic<uint64_t> _conn_base_offset;
+	std::atomic<bool> _reconnect_pending;
+	std::atomic<bool> _resume_pending;
+	std::chrono::steady_clock::time_point _gap_start;
+	ReconnectStats _reconnect_stats;
+	std::mutex _reconnect_mutex;
+
+	WebSocketStreamingClient(std::string access_token, std::unique_ptr<StreamingEngine> own_engine, StreamingEngine* engine);
 
+	bool start_stream(MediaGenerator& media_generator, const MediaConfig& media_config, const ResponseType& response_types);
+	void complete_stream();
+	bool connect_ws();
+	void retry_connect(websocketpp::connection_hdl hdl);
+	void fail_connect(websocketpp::connection_hdl hdl);
+	std::chrono::milliseconds retry_backoff(int retry);
+	std::chrono::milliseconds connect_time_left();
+	void on_tcp_pre_init(websocketpp::connection_hdl hdl);
+	void on_tcp_post_init(websocketpp::connection_hdl hdl);
+	void end_attempt(bool ok);
+	bool begin_reconnect(websocketpp::connection_hdl hdl);
+	bool queue_reconnect();
+	void fail_reconnect();
+	bool replay_media();
+	void record_ack(const Response& response);
+	void record_latency(const Response& response, std::chrono::steady_clock::time_point arrival);
+	void finish_stream();
+	void finished();
+	void deliver_response(std::string& payload, const Response* response);
+	void fail_response(const std::exception& e);
+	void record(CaptureRecord::Kind kind, const std::string& payload);
+	void dump_flight();
+	void abort_stream();
+	void cancel_timers();
 	void run_media();
-	void run_keepalive();
+	void send_media(wspp_message_ptr& msg);
+	void on_media_ready();
+	void wait_media();
+	void wait_drain();
+	void stop_media_watch();
+	wspp_message_ptr new_message();
+	bool read_media(wspp_message_ptr& msg);
+	bool send_chunk(wspp_message_ptr msg, bool replayed = false);
+	bool queue_chunk(wspp_message_ptr& msg);
+	bool flush_held(const std::string* tail);
+	bool is_congested();
+	void finish_media();
+	void mark_time(StreamTimes::time_point& time);
 	void update_keepalive();
+	void arm_keepalive(std::chrono::milliseconds delay);
+	void on_keepalive_timer();
+	bool send_eos();
+	void on_eos_timer();
 	void close_ws();
-	void write_alog(std::string tag, std::string message);
+	bool log_enabled(Logger::Level level);
+	void log_line(Logger::Level level, const char* tag, const char* format, ...) __attribute__((format(printf, 4, 5)));
 
 	void on_socket_init(websocketpp::connection_hdl hdl);
 	wspp_context_ptr on_tls_init(websocketpp::connection_hdl hdl);
@@ -0,0 +1,100 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+#include "async_file_writer_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AsyncFileWriterTest);
+
+namespace {
+
+std::string test_path()
+{
+	return "/tmp/async_file_writer_test." + std::to_string(getpid());
+}
+
+std::string read_file(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream text;
+	text << file.rdbuf();
+	return text.str();
+}
+
+} // anonymous namespace
+
+void AsyncFileWriterTest::tearDown()
+{
+	unlink(test_path().c_str());
+}
+
+void AsyncFileWriterTest::test_ctor_invalid()
+{
+	CPPUNIT_ASSERT_THROW_MESSAGE("no directory", AsyncFileWriter("/nonexistent/dir/file"), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("one buffer", AsyncFileWriter(test_path(), 16, 1), std::runtime_error);
+}
+
+void AsyncFileWriterTest::test_write()
+{
+	// small buffers, so text is split across many of them
+	std::string expected;
+	{
+		AsyncFileWriter writer {test_path(), 7, 2};
+		for (int i = 0; i < 1000; i++) {
+			std::string line = "line " + std::to_string(i);
+			writer.append(line.data(), line.length());
+			writer.append('\n');
+			expected += line + "\n";
+		}
+		writer.close();
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("bytes written", (uint64_t)expected.length(), writer.bytes_written());
+	}
+	CPPUNIT_ASSERT_MESSAGE("file contents", read_file(test_path()) == expected);
+}
+
+void AsyncFileWriterTest::test_flush()
+{
+	AsyncFileWriter writer {test_path()};
+	writer.append("hello", 5);
+	CPPUNIT_ASSERT_MESSAGE("buffered", read_file(test_path()).empty());
+	writer.flush();
+	CPPUNIT_ASSERT_MESSAGE("flushed", read_file(test_path()) == "hello");
+	writer.append(' ');
+	writer.append("world", 5);
+	writer.flush();
+	CPPUNIT_ASSERT_MESSAGE("flushed again", read_file(test_path()) == "hello world");
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("no stalls", (uint64_t)0, writer.stalls());
+}
+
+void AsyncFileWriterTest::test_closed()
+{
+	{
+		// the destructor writes out the rest
+		AsyncFileWriter writer {test_path()};
+		writer.append("unflushed", 9);
+	}
+	CPPUNIT_ASSERT_MESSAGE("destructor", read_file(test_path()) == "unflushed");
+
+	AsyncFileWriter writer {test_path()};
+	writer.close();
+	writer.close();
+	CPPUNIT_ASSERT_THROW_MESSAGE("append after close", writer.append("late", 4), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("flush after close", writer.flush(), std::runtime_error);
+}
+
+void AsyncFileWriterTest::test_write_error()
+{
+	if (access("/dev/full", W_OK) != 0) {
+		std::cout << "(no /dev/full, skipped) ";
+		return;
+	}
+	AsyncFileWriter writer {"/dev/full"};
+	writer.append("doomed", 6);
+	CPPUNIT_ASSERT_THROW_MESSAGE("flush fails", writer.flush(), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("close fails", writer.close(), std::runtime_error);
+}
@@ -0,0 +1,27 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/async_file_writer.h>
+
+/**
+ * Unit tests for `AsyncFileWriter` class.
+ */
+class AsyncFileWriterTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(AsyncFileWriterTest);
+
+	CPPUNIT_TEST(test_ctor_invalid);
+	CPPUNIT_TEST(test_write);
+	CPPUNIT_TEST(test_flush);
+	CPPUNIT_TEST(test_closed);
+	CPPUNIT_TEST(test_write_error);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void tearDown();
+
+	void test_ctor_invalid();
+	void test_write();
+	void test_flush();
+	void test_closed();
+	void test_write_error();
+};
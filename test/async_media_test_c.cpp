@@ -0,0 +1,95 @@
+#include <atomic>
+#include <iostream>
+#include <sysexits.h>
+
+#include <nlohmann/json.hpp>
+
+#include <verbit/streaming/ws_streaming_client.h>
+
+#include "empty_media_generator.h"
+
+#define TEST_WS_URL "wss://localhost:9002"
+
+#define N_STREAMS             3
+#define EXPECTED_N_RESPONSES  (1 + N_STREAMS)
+#define EXPECTED_FINAL_TEXT   "I saw 0 bytes. "
+std::atomic<int> n_responses(0);
+std::atomic<int> n_final_text_ok(0);
+std::atomic<int> n_completed(0);
+
+using namespace verbit::streaming;
+
+void on_response(WebSocketStreamingClient* client, nlohmann::json* response)
+{
+	n_responses++;
+	auto is_eos = (*response)["response"]["is_end_of_stream"];
+	if (is_eos.get<bool>()) {
+		auto alternatives = (*response)["response"]["alternatives"];
+		if (alternatives[0]["transcript"].get<std::string>() == EXPECTED_FINAL_TEXT) {
+			n_final_text_ok++;
+		}
+	}
+}
+
+void on_complete(WebSocketStreamingClient* client, const StreamResult& result)
+{
+	if (result.ok()) {
+		n_completed++;
+	} else {
+		std::cout << "FAILED error " << result.error_code << ": " << result.service_error << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	/*
+	 * Test a standalone client, waiting on the future
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		client.ws_url(TEST_WS_URL);
+		client.verify_ssl_cert(false);
+		client.set_response_handler(&on_response);
+		EmptyMediaGenerator media_gen;
+		std::future<StreamResult> future = client.async_run_stream(media_gen);
+		StreamResult result = future.get();
+		if (!result.ok()) {
+			std::cout << "FAILED error " << result.error_code << ": " << result.service_error << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	/*
+	 * Test several streams started from one thread on a shared engine,
+	 * with completion handlers
+	 */
+	StreamingEngine engine;
+	engine.start(2);
+	std::vector<std::unique_ptr<WebSocketStreamingClient>> clients;
+	std::vector<std::unique_ptr<EmptyMediaGenerator>> generators;
+	std::vector<std::future<StreamResult>> futures;
+	for (int i = 0; i < N_STREAMS; i++) {
+		clients.emplace_back(new WebSocketStreamingClient(access_token, engine));
+		generators.emplace_back(new EmptyMediaGenerator());
+		clients.back()->ws_url(TEST_WS_URL);
+		clients.back()->verify_ssl_cert(false);
+		clients.back()->set_response_handler(&on_response);
+		futures.push_back(clients.back()->async_run_stream(*generators.back(), &on_complete));
+	}
+	for (auto& f : futures) {
+		f.wait();
+	}
+	clients.clear();
+	engine.stop();
+	if (n_completed != N_STREAMS) {
+		std::cout << "FAILED expected n_completed=" << N_STREAMS << " actual n_completed=" << n_completed << std::endl;
+	} else if (n_responses != EXPECTED_N_RESPONSES) {
+		std::cout << "FAILED expected n_responses=" << EXPECTED_N_RESPONSES << " actual n_responses=" << n_responses << std::endl;
+	} else if (n_final_text_ok != 1 + N_STREAMS) {
+		std::cout << "FAILED expected final_text=\"" << EXPECTED_FINAL_TEXT << "\" for all " << (1 + N_STREAMS) << " streams" << std::endl;
+	} else {
+		std::cout << "OK (2 tests)" << std::endl;
+		return EX_OK;
+	}
+	return EX_SOFTWARE;
+}
@@ -0,0 +1,151 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "caption_writer_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CaptionWriterTest);
+
+namespace {
+
+std::string test_path()
+{
+	return "/tmp/caption_writer_test." + std::to_string(getpid());
+}
+
+std::string read_file(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream text;
+	text << file.rdbuf();
+	return text.str();
+}
+
+StringRef string_ref(const std::string& s)
+{
+	StringRef r;
+	r.data = s.data();
+	r.length = s.length();
+	return r;
+}
+
+// builds a final captions response, holding the strings it refers to
+class Caption
+{
+public:
+	Caption(const std::string& id, const std::vector<std::string>& words, double start,
+		const std::string& type = "captions")
+		: _id(id), _type(type), _words(words), _text("text"), _punct("punct")
+	{
+		for (size_t i = 0; i < _words.size(); i++) {
+			Item item;
+			bool punct = (_words[i] == ".") || (_words[i] == ",");
+			item.kind = string_ref(punct ? _punct : _text);
+			item.value = string_ref(_words[i]);
+			item.start = start + 0.5 * i;
+			item.end = item.start + 0.4;
+			_items.push_back(item);
+		}
+		response.has_response = true;
+		response.id = string_ref(_id);
+		response.type = string_ref(_type);
+		response.is_final = true;
+		Alternative alternative;
+		alternative.items.data = _items.data();
+		alternative.items.count = _items.size();
+		response.alternatives.push_back(alternative);
+	}
+
+	Response response;
+
+private:
+	std::string _id;
+	std::string _type;
+	std::vector<std::string> _words;
+	std::string _text;
+	std::string _punct;
+	std::vector<Item> _items;
+};
+
+std::string format_time(double seconds, char sep)
+{
+	char text[32];
+	return std::string(text, CaptionWriter::format_time(seconds, sep, text));
+}
+
+} // anonymous namespace
+
+void CaptionWriterTest::tearDown()
+{
+	unlink(test_path().c_str());
+}
+
+void CaptionWriterTest::test_format_time()
+{
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("zero", std::string("00:00:00,000"), format_time(0.0, ','));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("negative", std::string("00:00:00.000"), format_time(-1.5, '.'));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("rounded", std::string("00:00:01,235"), format_time(1.2346, ','));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("minutes", std::string("00:02:03.040"), format_time(123.04, '.'));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("hours", std::string("08:00:00,000"), format_time(8 * 3600.0, ','));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("many hours", std::string("123:00:59,999"), format_time(123 * 3600.0 + 59.999, ','));
+}
+
+void CaptionWriterTest::test_srt()
+{
+	{
+		CaptionWriter writer {test_path(), CaptionWriter::srt};
+		CPPUNIT_ASSERT_MESSAGE("srt add 1", writer.add(Caption("c1", {"Hello", "there", "."}, 1.0).response));
+		CPPUNIT_ASSERT_MESSAGE("srt add 2", writer.add(Caption("c2", {"General", "Kenobi"}, 3661.5).response));
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("srt cues", (uint64_t)2, writer.cues());
+		writer.close();
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("srt file", std::string(
+		"1\n00:00:01,000 --> 00:00:02,400\nHello there.\n\n"
+		"2\n01:01:01,500 --> 01:01:02,400\nGeneral Kenobi\n\n"), read_file(test_path()));
+}
+
+void CaptionWriterTest::test_webvtt()
+{
+	{
+		CaptionWriter writer {test_path(), CaptionWriter::webvtt};
+		writer.add(Caption("c1", {"Fish", "&", "<chips>"}, 0.25).response);
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("webvtt file", std::string(
+		"WEBVTT\n\n"
+		"1\n00:00:00.250 --> 00:00:01.650\nFish &amp; &lt;chips&gt;\n\n"), read_file(test_path()));
+}
+
+void CaptionWriterTest::test_jsonl()
+{
+	{
+		CaptionWriter writer {test_path(), CaptionWriter::jsonl};
+		writer.add(Caption("c\"1", {"Say", "\"hi\\", ","}, 12.0).response);
+		writer.add(Caption("c2", {"tab\there"}, 13.0005).response);
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("jsonl file", std::string(
+		"{\"index\":1,\"id\":\"c\\\"1\",\"start\":12.000,\"end\":13.400,\"text\":\"Say \\\"hi\\\\,\"}\n"
+		"{\"index\":2,\"id\":\"c2\",\"start\":13.001,\"end\":13.401,\"text\":\"tab\\u0009here\"}\n"),
+		read_file(test_path()));
+}
+
+void CaptionWriterTest::test_skipped()
+{
+	CaptionWriter writer {test_path(), CaptionWriter::srt};
+	Caption partial("c1", {"not", "yet"}, 0.0);
+	partial.response.is_final = false;
+	CPPUNIT_ASSERT_MESSAGE("partial skipped", !writer.add(partial.response));
+	CPPUNIT_ASSERT_MESSAGE("transcript skipped", !writer.add(Caption("t1", {"other"}, 0.0, "transcript").response));
+	CPPUNIT_ASSERT_MESSAGE("no items skipped", !writer.add(Caption("c2", {}, 0.0).response));
+	CPPUNIT_ASSERT_MESSAGE("no response skipped", !writer.add(Response()));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("no cues", (uint64_t)0, writer.cues());
+
+	CaptionWriter transcript {test_path() + ".t", CaptionWriter::srt, ResponseType::Transcript};
+	CPPUNIT_ASSERT_MESSAGE("transcript writer", transcript.add(Caption("t1", {"other"}, 0.0, "transcript").response));
+	transcript.close();
+	unlink((test_path() + ".t").c_str());
+}
@@ -0,0 +1,27 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/caption_writer.h>
+
+/**
+ * Unit tests for `CaptionWriter` class.
+ */
+class CaptionWriterTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(CaptionWriterTest);
+
+	CPPUNIT_TEST(test_format_time);
+	CPPUNIT_TEST(test_srt);
+	CPPUNIT_TEST(test_webvtt);
+	CPPUNIT_TEST(test_jsonl);
+	CPPUNIT_TEST(test_skipped);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void tearDown();
+
+	void test_format_time();
+	void test_srt();
+	void test_webvtt();
+	void test_jsonl();
+	void test_skipped();
+};
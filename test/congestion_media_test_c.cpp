@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/eventfd.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include <verbit/streaming/ws_streaming_client.h>
+
+// the test server stops reading each connection for a second once media arrives
+#define TEST_WS_URL "wss://localhost:9002?stall_ms=1000"
+
+#define CHUNK_BYTES     3200
+#define N_CHUNKS        1000
+#define TOTAL_BYTES     (CHUNK_BYTES * N_CHUNKS)
+#define HIGH_WATERMARK  64000
+#define LOW_WATERMARK   32000
+
+size_t final_bytes = 0;
+
+using namespace verbit::streaming;
+
+/**
+ * Media generator producing silence as fast as it is read, so that it outruns the stalled server.
+ */
+class FastMediaGenerator : public MediaGenerator
+{
+public:
+	bool read_chunk(ChunkBuffer& chunk)
+	{
+		memset(chunk.prepare(CHUNK_BYTES), 0, CHUNK_BYTES);
+		chunk.commit(CHUNK_BYTES);
+		_chunks++;
+		return true;
+	}
+
+	const std::string get_chunk() { return read_chunk_string(); }
+
+	bool finished() { return (_chunks >= N_CHUNKS); }
+
+private:
+	int _chunks = 0;
+};
+
+/**
+ * Like `FastMediaGenerator`, but waited on through an `event_fd()` which is always readable,
+ * so the client reads it on the I/O threads rather than on a media thread.
+ */
+class FastEventMediaGenerator : public FastMediaGenerator
+{
+public:
+	FastEventMediaGenerator() : _event_fd(::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC)) { }
+	~FastEventMediaGenerator() { ::close(_event_fd); }
+
+	int event_fd() { return _event_fd; }
+
+private:
+	int _event_fd;
+};
+
+void on_response(WebSocketStreamingClient* client, nlohmann::json* response)
+{
+	auto is_eos = (*response)["response"]["is_end_of_stream"];
+	if (is_eos.get<bool>()) {
+		auto alternatives = (*response)["response"]["alternatives"];
+		std::string transcript = alternatives[0]["transcript"].get<std::string>();
+		sscanf(transcript.c_str(), "I saw %zu bytes", &final_bytes);
+	}
+}
+
+// Stream all the media with `policy` through the stalled server; returns `false` if the session failed.
+bool run_congested(WebSocketStreamingClient& client, WebSocketStreamingClient::CongestionPolicy policy,
+	FastMediaGenerator&& media_gen = FastMediaGenerator())
+{
+	client.ws_url(TEST_WS_URL);
+	client.verify_ssl_cert(false);
+	client.set_response_handler(&on_response);
+	client.send_watermarks(HIGH_WATERMARK, LOW_WATERMARK);
+	client.congestion_policy(policy);
+	final_bytes = 0;
+	if (!client.run_stream(media_gen)) {
+		std::cout << "FAILED run_stream error " << client.error_code() << ": " << client.service_error() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Every byte the client counts as sent must have reached the server.
+bool check_sent(WebSocketStreamingClient& client, const char* policy)
+{
+	CongestionStats stats = client.congestion_stats();
+	SessionMetrics metrics = client.metrics();
+	std::cout << policy << ": congestion_events " << stats.congestion_events
+		<< " max_buffered " << stats.max_buffered
+		<< " bytes_dropped " << stats.bytes_dropped
+		<< " bytes_coalesced " << stats.bytes_coalesced
+		<< " bytes_sent " << metrics.bytes_sent.value()
+		<< " frames_sent " << metrics.frames_sent.value()
+		<< " server saw " << final_bytes << std::endl;
+	if (stats.congestion_events == 0) {
+		std::cout << "FAILED " << policy << ": expected the session to be congested" << std::endl;
+		return false;
+	} else if (final_bytes != metrics.bytes_sent.value()) {
+		std::cout << "FAILED " << policy << ": server saw " << final_bytes << " bytes, client sent "
+			<< metrics.bytes_sent.value() << std::endl;
+		return false;
+	} else if (metrics.bytes_sent.value() + stats.bytes_dropped != TOTAL_BYTES) {
+		std::cout << "FAILED " << policy << ": expected sent plus dropped bytes to be " << TOTAL_BYTES << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	/*
+	 * Test block sends all media, one chunk at a time, keeping the send queue near the high watermark
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		if (!run_congested(client, WebSocketStreamingClient::congestion_block) || !check_sent(client, "block")) {
+			return EX_SOFTWARE;
+		}
+		CongestionStats stats = client.congestion_stats();
+		if ( (stats.bytes_dropped != 0) || (stats.bytes_coalesced != 0)
+			|| (client.metrics().frames_sent.value() != N_CHUNKS) ) {
+			std::cout << "FAILED block: expected every chunk sent as it was read" << std::endl;
+			return EX_SOFTWARE;
+		}
+		if (stats.max_buffered > HIGH_WATERMARK + 2 * CHUNK_BYTES) {
+			std::cout << "FAILED block: expected the send queue to stop near the high watermark" << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	/*
+	 * Test block without a media thread: the I/O thread stops reading the media until
+	 * the client's own messages are written, rather than polling the send queue
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		if (!run_congested(client, WebSocketStreamingClient::congestion_block, FastEventMediaGenerator())
+			|| !check_sent(client, "block (event_fd)")) {
+			return EX_SOFTWARE;
+		}
+		CongestionStats stats = client.congestion_stats();
+		if ( (stats.bytes_dropped != 0) || (client.metrics().frames_sent.value() != N_CHUNKS)
+			|| (stats.max_buffered > HIGH_WATERMARK + 2 * CHUNK_BYTES) ) {
+			std::cout << "FAILED block (event_fd): expected every chunk sent, the send queue stopping near the high watermark" << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	/*
+	 * Test coalesce holds media back while congested, and sends it in fewer, larger messages
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		if (!run_congested(client, WebSocketStreamingClient::congestion_coalesce) || !check_sent(client, "coalesce")) {
+			return EX_SOFTWARE;
+		}
+		if ( (client.congestion_stats().bytes_coalesced == 0)
+			|| (client.metrics().frames_sent.value() >= N_CHUNKS) ) {
+			std::cout << "FAILED coalesce: expected media held back and sent coalesced" << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	/*
+	 * Test drop discards media while congested, and does not send it
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		if (!run_congested(client, WebSocketStreamingClient::congestion_drop) || !check_sent(client, "drop")) {
+			return EX_SOFTWARE;
+		}
+		CongestionStats stats = client.congestion_stats();
+		if ( (stats.bytes_dropped == 0) || (stats.bytes_coalesced != 0)
+			|| (client.metrics().bytes_sent.value() >= TOTAL_BYTES) ) {
+			std::cout << "FAILED drop: expected media dropped" << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	std::cout << "OK (4 tests)" << std::endl;
+	return EX_OK;
+}
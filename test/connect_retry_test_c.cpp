@@ -0,0 +1,121 @@
+#include <chrono>
+#include <iostream>
+#include <sysexits.h>
+
+#include <verbit/streaming/ws_streaming_client.h>
+
+#include "empty_media_generator.h"
+
+// nothing listens here, so every connect attempt fails
+#define TEST_WS_URL_REFUSED "wss://localhost:9079"
+
+// retry ceilings 0.1s, 0.2s, 0.4s, 0.8s, 1.6s
+#define RETRY_SECONDS   0.1
+#define RETRY_ATTEMPTS  6
+
+using namespace verbit::streaming;
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	/*
+	 * Test connect gives up after the maximum number of attempts
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		client.ws_url(TEST_WS_URL_REFUSED);
+		client.verify_ssl_cert(false);
+		client.max_connection_retry_seconds(0.1);
+		client.max_connect_attempts(3);
+		EmptyMediaGenerator media_gen;
+		if (client.run_stream(media_gen)) {
+			std::cout << "FAILED expected run_stream to fail" << std::endl;
+			return EX_SOFTWARE;
+		}
+		StreamTimes times = client.stream_times();
+		if (times.attempts.size() != 3) {
+			std::cout << "FAILED expected 3 attempts, actual " << times.attempts.size() << std::endl;
+			return EX_SOFTWARE;
+		}
+		for (const ConnectAttempt& attempt : times.attempts) {
+			if (attempt.ok || (attempt.end < attempt.start)) {
+				std::cout << "FAILED expected failed attempt with end time" << std::endl;
+				return EX_SOFTWARE;
+			}
+		}
+	}
+	/*
+	 * Test connect gives up at the deadline, however many attempts are left
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		client.ws_url(TEST_WS_URL_REFUSED);
+		client.verify_ssl_cert(false);
+		client.max_connection_retry_seconds(0.2);
+		client.max_connect_attempts(1000);
+		client.connect_deadline(std::chrono::milliseconds(1000));
+		EmptyMediaGenerator media_gen;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (client.run_stream(media_gen)) {
+			std::cout << "FAILED expected run_stream to fail" << std::endl;
+			return EX_SOFTWARE;
+		}
+		std::chrono::steady_clock::duration took = std::chrono::steady_clock::now() - start;
+		if (took > std::chrono::milliseconds(2000)) {
+			std::cout << "FAILED expected to give up at the deadline, took "
+				<< std::chrono::duration_cast<std::chrono::milliseconds>(took).count() << "ms" << std::endl;
+			return EX_SOFTWARE;
+		}
+		if (client.stream_times().attempts.size() >= 1000) {
+			std::cout << "FAILED expected fewer than 1000 attempts" << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	/*
+	 * Test the delay before each retry is jittered below a ceiling doubled for each retry
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		client.ws_url(TEST_WS_URL_REFUSED);
+		client.verify_ssl_cert(false);
+		client.max_connection_retry_seconds(RETRY_SECONDS);
+		client.max_connect_attempts(RETRY_ATTEMPTS);
+		EmptyMediaGenerator media_gen;
+		if (client.run_stream(media_gen)) {
+			std::cout << "FAILED expected run_stream to fail" << std::endl;
+			return EX_SOFTWARE;
+		}
+		StreamTimes times = client.stream_times();
+		if (times.attempts.size() != RETRY_ATTEMPTS) {
+			std::cout << "FAILED expected " << RETRY_ATTEMPTS << " attempts, actual " << times.attempts.size() << std::endl;
+			return EX_SOFTWARE;
+		}
+		const double max_ceiling = WebSocketStreamingClient::MAX_RETRY_SECONDS;
+		double ceiling = RETRY_SECONDS;
+		double total_ceilings = 0;
+		double total_delays = 0;
+		bool jittered = false;
+		for (size_t i = 1; i < times.attempts.size(); i++) {
+			double delay = std::chrono::duration<double>(times.attempts[i].start - times.attempts[i - 1].end).count();
+			std::cout << "retry " << i << " delay " << delay << "s ceiling " << ceiling << "s" << std::endl;
+			// the timer wheel fires up to a tick late
+			if (delay > ceiling + 2 * WSSC_TIMER_RESOLUTION_MS / 1000.0) {
+				std::cout << "FAILED expected retry " << i << " within " << ceiling << "s" << std::endl;
+				return EX_SOFTWARE;
+			}
+			jittered = jittered || (delay < 0.9 * ceiling);
+			total_ceilings += ceiling;
+			total_delays += delay;
+			ceiling = (2 * ceiling > max_ceiling) ? max_ceiling : 2 * ceiling;
+		}
+		if (!jittered) {
+			std::cout << "FAILED expected retry delays jittered below their ceilings" << std::endl;
+			return EX_SOFTWARE;
+		} else if (total_delays < 0.1 * total_ceilings) {
+			std::cout << "FAILED expected retry delays to back off, total " << total_delays << "s" << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	std::cout << "OK (3 tests)" << std::endl;
+	return EX_OK;
+}
@@ -0,0 +1,121 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <sysexits.h>
+
+#include <verbit/streaming/ws_streaming_client.h>
+
+#include "empty_media_generator.h"
+
+#define TEST_WS_URL "wss://localhost:9002"
+
+#define N_STREAMS             3
+#define EXPECTED_FINAL_TEXT   "I saw 0 bytes. "
+#define HANDLER_DELAY_MS      200
+
+std::atomic<int> n_responses(0);
+std::atomic<int> n_final_text_ok(0);
+std::atomic<int> n_on_caller_thread(0);
+std::atomic<int> n_completed_early(0);
+std::atomic<int> n_completed(0);
+std::thread::id caller_thread;
+
+using namespace verbit::streaming;
+
+// a slow handler, which must not run on the I/O thread
+void on_response(WebSocketStreamingClient* client, const Response& response)
+{
+	if (std::this_thread::get_id() == caller_thread) {
+		n_on_caller_thread++;
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(HANDLER_DELAY_MS));
+	if (response.is_end_of_stream && !response.alternatives.empty()
+		&& (response.alternatives[0].transcript == EXPECTED_FINAL_TEXT)) {
+		n_final_text_ok++;
+	}
+	n_responses++;
+}
+
+void on_complete(WebSocketStreamingClient* client, const StreamResult& result)
+{
+	// every response is delivered before the stream completes
+	if (client->dispatch_stats().delivered != 1) {
+		n_completed_early++;
+	}
+	if (result.ok()) {
+		n_completed++;
+	} else {
+		std::cout << "FAILED error " << result.error_code << ": " << result.service_error << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	caller_thread = std::this_thread::get_id();
+	DispatchPool pool {2};
+	/*
+	 * Test a standalone client: its I/O runs on this thread, so the handler must not
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		client.ws_url(TEST_WS_URL);
+		client.verify_ssl_cert(false);
+		client.set_typed_response_handler(&on_response);
+		client.dispatch_pool(&pool);
+		EmptyMediaGenerator media_gen;
+		if (!client.run_stream(media_gen)) {
+			std::cout << "FAILED error " << client.error_code() << ": " << client.service_error() << std::endl;
+			return EX_SOFTWARE;
+		}
+		if (n_responses != 1) {
+			std::cout << "FAILED run_stream returned before the response was delivered" << std::endl;
+			return EX_SOFTWARE;
+		}
+		DispatchStats stats = client.dispatch_stats();
+		if ( (stats.delivered != 1) || (stats.handler_latency.max() < HANDLER_DELAY_MS * 1000) ) {
+			std::cout << "FAILED dispatch_stats delivered=" << stats.delivered
+				<< " handler_latency max=" << stats.handler_latency.max() << "us" << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	/*
+	 * Test several streams on a shared engine, sharing the dispatch pool
+	 */
+	StreamingEngine engine;
+	engine.start(1);
+	std::vector<std::unique_ptr<WebSocketStreamingClient>> clients;
+	std::vector<std::unique_ptr<EmptyMediaGenerator>> generators;
+	std::vector<std::future<StreamResult>> futures;
+	for (int i = 0; i < N_STREAMS; i++) {
+		clients.emplace_back(new WebSocketStreamingClient(access_token, engine));
+		generators.emplace_back(new EmptyMediaGenerator());
+		clients.back()->ws_url(TEST_WS_URL);
+		clients.back()->verify_ssl_cert(false);
+		clients.back()->set_typed_response_handler(&on_response);
+		clients.back()->dispatch_pool(&pool);
+		clients.back()->dispatch_coalesce(true);  // end-of-stream is then found by the header scan
+		futures.push_back(clients.back()->async_run_stream(*generators.back(), &on_complete));
+	}
+	for (auto& f : futures) {
+		f.wait();
+	}
+	clients.clear();
+	engine.stop();
+	if (n_completed != N_STREAMS) {
+		std::cout << "FAILED expected n_completed=" << N_STREAMS << " actual n_completed=" << n_completed << std::endl;
+	} else if (n_completed_early != 0) {
+		std::cout << "FAILED " << n_completed_early << " streams completed before their responses were delivered" << std::endl;
+	} else if (n_on_caller_thread != 0) {
+		std::cout << "FAILED " << n_on_caller_thread << " responses were delivered on the I/O thread" << std::endl;
+	} else if (n_responses != 1 + N_STREAMS) {
+		std::cout << "FAILED expected n_responses=" << (1 + N_STREAMS) << " actual n_responses=" << n_responses << std::endl;
+	} else if (n_final_text_ok != 1 + N_STREAMS) {
+		std::cout << "FAILED expected final_text=\"" << EXPECTED_FINAL_TEXT << "\" for all " << (1 + N_STREAMS) << " streams" << std::endl;
+	} else {
+		std::cout << "OK (2 tests)" << std::endl;
+		return EX_OK;
+	}
+	return EX_SOFTWARE;
+}
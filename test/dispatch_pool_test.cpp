@@ -0,0 +1,423 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "dispatch_pool_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DispatchPoolTest);
+
+namespace {
+
+// a flag one thread can wait on and another can set
+class Gate
+{
+public:
+	void open()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_open = true;
+		_cv.notify_all();
+	}
+
+	bool wait(std::chrono::milliseconds timeout = std::chrono::milliseconds(2000))
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		return _cv.wait_for(lock, timeout, [this]{ return _open; });
+	}
+
+private:
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	bool _open = false;
+};
+
+// records the responses delivered, holding up the first one until `release` opens
+class Recorder
+{
+public:
+	Recorder(bool hold_first = false) : _hold_first(hold_first) { }
+
+	DispatchQueue::consumer consumer()
+	{
+		return [this](std::string& payload) {
+			if (_in_flight.fetch_add(1) != 0) {
+				_overlapped = true;
+			}
+			if (_hold_first && _delivered.empty()) {
+				entered.open();
+				release.wait();
+			}
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_delivered.push_back(std::move(payload));
+			}
+			_in_flight--;
+		};
+	}
+
+	std::vector<std::string> delivered()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		return _delivered;
+	}
+
+	bool overlapped() { return _overlapped; }
+
+	Gate entered;
+	Gate release;
+
+private:
+	bool _hold_first;
+	std::mutex _mutex;
+	std::vector<std::string> _delivered;
+	std::atomic<int> _in_flight {0};
+	std::atomic<bool> _overlapped {false};
+};
+
+// push `payload` (as a temporary) onto `queue`
+bool push(DispatchQueue& queue, const std::string& payload, bool keep = false)
+{
+	std::string text = payload;
+	return queue.push(std::move(text), keep);
+}
+
+// push `payload` (as a temporary) onto `queue`, superseding any queued with `key`
+bool push_latest(DispatchQueue& queue, const std::string& payload, const std::string& key)
+{
+	std::string text = payload;
+	return queue.push_latest(std::move(text), key.data(), key.length());
+}
+
+// finish `queue`, and wait for the finish function to run
+bool finish(DispatchQueue& queue)
+{
+	Gate finished;
+	queue.finish([&finished]{ finished.open(); });
+	return finished.wait();
+}
+
+} // anonymous namespace
+
+void DispatchPoolTest::test_ctor_invalid()
+{
+	CPPUNIT_ASSERT_THROW_MESSAGE("no workers", DispatchPool(0), std::runtime_error);
+}
+
+void DispatchPoolTest::test_order()
+{
+	DispatchPool pool {4};
+	Recorder recorder;
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer(), 10000);
+	for (int i = 0; i < 1000; i++) {
+		CPPUNIT_ASSERT_MESSAGE("order push", push(*queue, std::to_string(i)));
+	}
+	CPPUNIT_ASSERT_MESSAGE("order finish", finish(*queue));
+
+	std::vector<std::string> delivered = recorder.delivered();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("order delivered", (size_t)1000, delivered.size());
+	for (int i = 0; i < 1000; i++) {
+		CPPUNIT_ASSERT_MESSAGE("order in order", delivered[i] == std::to_string(i));
+	}
+	CPPUNIT_ASSERT_MESSAGE("order one at a time", !recorder.overlapped());
+	CPPUNIT_ASSERT_MESSAGE("order push after finish", !push(*queue, "late"));
+
+	DispatchStats stats = queue->stats();
+	CPPUNIT_ASSERT_MESSAGE("order stats delivered", stats.delivered == 1000);
+	CPPUNIT_ASSERT_MESSAGE("order stats dropped", stats.dropped == 0);
+	CPPUNIT_ASSERT_MESSAGE("order stats depth count", stats.queue_depth.count() == 1000);
+	CPPUNIT_ASSERT_MESSAGE("order stats depth max", (stats.queue_depth.max() >= 1) && (stats.queue_depth.max() <= 1000));
+	CPPUNIT_ASSERT_MESSAGE("order stats wait count", stats.queue_wait.count() == 1000);
+	CPPUNIT_ASSERT_MESSAGE("order stats latency count", stats.handler_latency.count() == 1000);
+}
+
+void DispatchPoolTest::test_sessions_independent()
+{
+	DispatchPool pool {2};
+	Recorder slow {true};
+	Recorder fast;
+	auto slow_queue = std::make_shared<DispatchQueue>(pool, slow.consumer());
+	auto fast_queue = std::make_shared<DispatchQueue>(pool, fast.consumer());
+
+	push(*slow_queue, "slow");
+	CPPUNIT_ASSERT_MESSAGE("independent slow entered", slow.entered.wait());
+	push(*fast_queue, "fast");
+	CPPUNIT_ASSERT_MESSAGE("independent fast finish", finish(*fast_queue));
+	CPPUNIT_ASSERT_MESSAGE("independent fast delivered", fast.delivered().size() == 1);
+	CPPUNIT_ASSERT_MESSAGE("independent slow still held", slow.delivered().empty());
+
+	slow.release.open();
+	CPPUNIT_ASSERT_MESSAGE("independent slow finish", finish(*slow_queue));
+	CPPUNIT_ASSERT_MESSAGE("independent slow delivered", slow.delivered().size() == 1);
+}
+
+void DispatchPoolTest::test_drop_newest()
+{
+	DispatchPool pool {1};
+	Recorder recorder {true};
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer(), 2, DispatchQueue::drop_newest);
+	push(*queue, "1");
+	CPPUNIT_ASSERT_MESSAGE("drop_newest entered", recorder.entered.wait());
+	CPPUNIT_ASSERT_MESSAGE("drop_newest push 2", push(*queue, "2"));
+	CPPUNIT_ASSERT_MESSAGE("drop_newest push 3", push(*queue, "3"));
+	CPPUNIT_ASSERT_MESSAGE("drop_newest push 4 dropped", !push(*queue, "4"));
+	CPPUNIT_ASSERT_MESSAGE("drop_newest depth", queue->depth() == 2);
+	recorder.release.open();
+	CPPUNIT_ASSERT_MESSAGE("drop_newest finish", finish(*queue));
+
+	std::vector<std::string> delivered = recorder.delivered();
+	CPPUNIT_ASSERT_MESSAGE("drop_newest delivered", (delivered == std::vector<std::string>{"1", "2", "3"}));
+	CPPUNIT_ASSERT_MESSAGE("drop_newest stats dropped", queue->stats().dropped == 1);
+}
+
+void DispatchPoolTest::test_drop_oldest()
+{
+	DispatchPool pool {1};
+	Recorder recorder {true};
+	// (the default policy)
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer(), 2);
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest default", queue->policy() == DispatchQueue::drop_oldest);
+	push(*queue, "1");
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest entered", recorder.entered.wait());
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest push 2", push(*queue, "2"));
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest push 3", push(*queue, "3"));
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest push 4 drops 2", !push(*queue, "4"));
+	recorder.release.open();
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest finish", finish(*queue));
+
+	std::vector<std::string> delivered = recorder.delivered();
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest delivered", (delivered == std::vector<std::string>{"1", "3", "4"}));
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest stats dropped", queue->stats().dropped == 1);
+}
+
+// responses to keep (finals, EOS) are never dropped; the oldest of the others makes room
+void DispatchPoolTest::test_drop_oldest_keep()
+{
+	DispatchPool pool {1};
+	Recorder recorder {true};
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer(), 2);
+	push(*queue, "held");
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest keep entered", recorder.entered.wait());
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest keep final 1", push(*queue, "final 1", true));
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest keep partial", push(*queue, "partial"));
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest keep final 2 drops partial", !push(*queue, "final 2", true));
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest keep partial dropped", !push(*queue, "late partial"));
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest keep eos", push(*queue, "eos", true));
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest keep beyond capacity", queue->depth() == 3);
+	recorder.release.open();
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest keep finish", finish(*queue));
+
+	std::vector<std::string> delivered = recorder.delivered();
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest keep delivered", (delivered == std::vector<std::string>{"held", "final 1", "final 2", "eos"}));
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest keep stats dropped", queue->stats().dropped == 2);
+}
+
+void DispatchPoolTest::test_drop_newest_keep()
+{
+	DispatchPool pool {1};
+	Recorder recorder {true};
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer(), 1, DispatchQueue::drop_newest);
+	push(*queue, "held");
+	CPPUNIT_ASSERT_MESSAGE("drop_newest keep entered", recorder.entered.wait());
+	push(*queue, "partial");
+	CPPUNIT_ASSERT_MESSAGE("drop_newest keep partial dropped", !push(*queue, "late partial"));
+	CPPUNIT_ASSERT_MESSAGE("drop_newest keep final", push(*queue, "final", true));
+	recorder.release.open();
+	CPPUNIT_ASSERT_MESSAGE("drop_newest keep finish", finish(*queue));
+
+	std::vector<std::string> delivered = recorder.delivered();
+	CPPUNIT_ASSERT_MESSAGE("drop_newest keep delivered", (delivered == std::vector<std::string>{"held", "partial", "final"}));
+	CPPUNIT_ASSERT_MESSAGE("drop_newest keep stats dropped", queue->stats().dropped == 1);
+}
+
+// the time a response waits behind a slow handler is queue wait, not its own handler latency
+void DispatchPoolTest::test_queue_wait()
+{
+	DispatchPool pool {1};
+	Recorder recorder {true};
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer());
+	push(*queue, "slow");
+	CPPUNIT_ASSERT_MESSAGE("queue_wait entered", recorder.entered.wait());
+	push(*queue, "waiting");
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	recorder.release.open();
+	CPPUNIT_ASSERT_MESSAGE("queue_wait finish", finish(*queue));
+
+	DispatchStats stats = queue->stats();
+	CPPUNIT_ASSERT_MESSAGE("queue_wait count", (stats.queue_wait.count() == 2) && (stats.handler_latency.count() == 2));
+	CPPUNIT_ASSERT_MESSAGE("queue_wait waited", stats.queue_wait.max() >= 50000);
+	CPPUNIT_ASSERT_MESSAGE("queue_wait slow handler", stats.handler_latency.max() >= 50000);
+	CPPUNIT_ASSERT_MESSAGE("queue_wait fast handler", stats.handler_latency.percentile(0.5) < 50000);
+}
+
+void DispatchPoolTest::test_block()
+{
+	DispatchPool pool {1};
+	Recorder recorder {true};
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer(), 1, DispatchQueue::block,
+		std::chrono::milliseconds(5000));
+	push(*queue, "1");
+	CPPUNIT_ASSERT_MESSAGE("block entered", recorder.entered.wait());
+	push(*queue, "2");
+
+	std::atomic<bool> pushed {false};
+	std::thread producer([&]{
+		push(*queue, "3");
+		pushed = true;
+	});
+	for (int i = 0; (i < 200) && (queue->stats().blocked == 0); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	CPPUNIT_ASSERT_MESSAGE("block blocked", queue->stats().blocked == 1);
+	CPPUNIT_ASSERT_MESSAGE("block not pushed", !pushed);
+
+	recorder.release.open();
+	producer.join();
+	CPPUNIT_ASSERT_MESSAGE("block pushed", pushed);
+	CPPUNIT_ASSERT_MESSAGE("block finish", finish(*queue));
+	CPPUNIT_ASSERT_MESSAGE("block delivered", (recorder.delivered() == std::vector<std::string>{"1", "2", "3"}));
+	CPPUNIT_ASSERT_MESSAGE("block nothing dropped", queue->stats().dropped == 0);
+}
+
+// a blocked push gives up after the block timeout, and drops the oldest (but never one to keep)
+void DispatchPoolTest::test_block_timeout()
+{
+	DispatchPool pool {1};
+	Recorder recorder {true};
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer(), 1, DispatchQueue::block,
+		std::chrono::milliseconds(50));
+	push(*queue, "1");
+	CPPUNIT_ASSERT_MESSAGE("block timeout entered", recorder.entered.wait());
+	push(*queue, "2");
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	CPPUNIT_ASSERT_MESSAGE("block timeout push 3 drops 2", !push(*queue, "3", true));
+	CPPUNIT_ASSERT_MESSAGE("block timeout waited", std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50));
+	CPPUNIT_ASSERT_MESSAGE("block timeout push 4 kept", push(*queue, "4", true));
+	CPPUNIT_ASSERT_MESSAGE("block timeout depth", queue->depth() == 2);
+	recorder.release.open();
+	CPPUNIT_ASSERT_MESSAGE("block timeout finish", finish(*queue));
+
+	CPPUNIT_ASSERT_MESSAGE("block timeout delivered", (recorder.delivered() == std::vector<std::string>{"1", "3", "4"}));
+	DispatchStats stats = queue->stats();
+	CPPUNIT_ASSERT_MESSAGE("block timeout stats blocked", stats.blocked == 2);
+	CPPUNIT_ASSERT_MESSAGE("block timeout stats dropped", stats.dropped == 1);
+}
+
+void DispatchPoolTest::test_finish_idle()
+{
+	DispatchPool pool {1};
+	Recorder recorder;
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer());
+	std::thread::id worker;
+	Gate finished;
+	queue->finish([&]{
+		worker = std::this_thread::get_id();
+		finished.open();
+	});
+	CPPUNIT_ASSERT_MESSAGE("finish idle runs", finished.wait());
+	CPPUNIT_ASSERT_MESSAGE("finish idle on a worker", worker != std::this_thread::get_id());
+}
+
+void DispatchPoolTest::test_close()
+{
+	DispatchPool pool {1};
+	Recorder recorder {true};
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer());
+	push(*queue, "1");
+	CPPUNIT_ASSERT_MESSAGE("close entered", recorder.entered.wait());
+	push(*queue, "2");
+	bool finish_ran = false;
+	queue->finish([&finish_ran]{ finish_ran = true; });
+
+	// close waits for the delivery in progress, and discards the rest
+	std::thread closer([&]{ queue->close(); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	recorder.release.open();
+	closer.join();
+	CPPUNIT_ASSERT_MESSAGE("close depth", queue->depth() == 0);
+	CPPUNIT_ASSERT_MESSAGE("close push", !push(*queue, "3"));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	CPPUNIT_ASSERT_MESSAGE("close delivered only the first", (recorder.delivered() == std::vector<std::string>{"1"}));
+	CPPUNIT_ASSERT_MESSAGE("close finish discarded", !finish_ran);
+
+	bool late_finish_ran = false;
+	queue->finish([&late_finish_ran]{ late_finish_ran = true; });
+	CPPUNIT_ASSERT_MESSAGE("close finish after close runs at once", late_finish_ran);
+}
+
+void DispatchPoolTest::test_handler_exception()
+{
+	DispatchPool pool {1};
+	std::vector<std::string> delivered;
+	auto queue = std::make_shared<DispatchQueue>(pool, [&delivered](std::string& payload) {
+		if (payload == "bad") {
+			throw std::runtime_error("bad response");
+		}
+		delivered.push_back(payload);
+	});
+	push(*queue, "good");
+	push(*queue, "bad");
+	push(*queue, "better");
+	CPPUNIT_ASSERT_MESSAGE("exception finish", finish(*queue));
+	CPPUNIT_ASSERT_MESSAGE("exception delivered the rest", (delivered == std::vector<std::string>{"good", "better"}));
+	CPPUNIT_ASSERT_MESSAGE("exception stats delivered", queue->stats().delivered == 3);
+}
+
+void DispatchPoolTest::test_coalesce()
+{
+	DispatchPool pool {1};
+	Recorder recorder {true};
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer());
+	push(*queue, "held");
+	CPPUNIT_ASSERT_MESSAGE("coalesce entered", recorder.entered.wait());
+
+	// partials of utterance a and b interleaved with other responses; each is
+	// replaced in place by the newest with its key, and the rest keep their order
+	CPPUNIT_ASSERT_MESSAGE("coalesce a1", push_latest(*queue, "a1", "a"));
+	push(*queue, "c1");
+	CPPUNIT_ASSERT_MESSAGE("coalesce a2", push_latest(*queue, "a2", "a"));
+	CPPUNIT_ASSERT_MESSAGE("coalesce a3", push_latest(*queue, "a3", "a"));
+	push(*queue, "a final");
+	CPPUNIT_ASSERT_MESSAGE("coalesce b1", push_latest(*queue, "b1", "b"));
+	CPPUNIT_ASSERT_MESSAGE("coalesce b2", push_latest(*queue, "b2", "b"));
+	CPPUNIT_ASSERT_MESSAGE("coalesce depth", queue->depth() == 4);
+
+	recorder.release.open();
+	CPPUNIT_ASSERT_MESSAGE("coalesce finish", finish(*queue));
+	std::vector<std::string> delivered = recorder.delivered();
+	CPPUNIT_ASSERT_MESSAGE("coalesce delivered", (delivered == std::vector<std::string>{"held", "a3", "c1", "a final", "b2"}));
+
+	DispatchStats stats = queue->stats();
+	CPPUNIT_ASSERT_MESSAGE("coalesce stats coalesced", stats.coalesced == 3);
+	CPPUNIT_ASSERT_MESSAGE("coalesce stats delivered", stats.delivered == 5);
+	CPPUNIT_ASSERT_MESSAGE("coalesce stats dropped", stats.dropped == 0);
+}
+
+void DispatchPoolTest::test_coalesce_full()
+{
+	DispatchPool pool {1};
+	Recorder recorder {true};
+	auto queue = std::make_shared<DispatchQueue>(pool, recorder.consumer(), 2, DispatchQueue::block);
+	push(*queue, "held");
+	CPPUNIT_ASSERT_MESSAGE("coalesce full entered", recorder.entered.wait());
+	push_latest(*queue, "a1", "a");
+	push(*queue, "c1");
+
+	// a full queue drops a new partial rather than blocking, but still supersedes a queued one
+	CPPUNIT_ASSERT_MESSAGE("coalesce full b1 dropped", !push_latest(*queue, "b1", "b"));
+	CPPUNIT_ASSERT_MESSAGE("coalesce full a2", push_latest(*queue, "a2", "a"));
+	CPPUNIT_ASSERT_MESSAGE("coalesce full not blocked", queue->stats().blocked == 0);
+
+	recorder.release.open();
+	CPPUNIT_ASSERT_MESSAGE("coalesce full finish", finish(*queue));
+	CPPUNIT_ASSERT_MESSAGE("coalesce full delivered", (recorder.delivered() == std::vector<std::string>{"held", "a2", "c1"}));
+	CPPUNIT_ASSERT_MESSAGE("coalesce full stats coalesced", queue->stats().coalesced == 1);
+	CPPUNIT_ASSERT_MESSAGE("coalesce full stats dropped", queue->stats().dropped == 1);
+	CPPUNIT_ASSERT_MESSAGE("coalesce full push_latest after finish", !push_latest(*queue, "a3", "a"));
+}
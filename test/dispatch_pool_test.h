@@ -0,0 +1,45 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/dispatch_pool.h>
+
+/**
+ * Unit tests for `DispatchPool` and `DispatchQueue` classes.
+ */
+class DispatchPoolTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DispatchPoolTest);
+
+	CPPUNIT_TEST(test_ctor_invalid);
+	CPPUNIT_TEST(test_order);
+	CPPUNIT_TEST(test_sessions_independent);
+	CPPUNIT_TEST(test_drop_newest);
+	CPPUNIT_TEST(test_drop_oldest);
+	CPPUNIT_TEST(test_drop_oldest_keep);
+	CPPUNIT_TEST(test_drop_newest_keep);
+	CPPUNIT_TEST(test_queue_wait);
+	CPPUNIT_TEST(test_block);
+	CPPUNIT_TEST(test_block_timeout);
+	CPPUNIT_TEST(test_finish_idle);
+	CPPUNIT_TEST(test_close);
+	CPPUNIT_TEST(test_handler_exception);
+	CPPUNIT_TEST(test_coalesce);
+	CPPUNIT_TEST(test_coalesce_full);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_ctor_invalid();
+	void test_order();
+	void test_sessions_independent();
+	void test_drop_newest();
+	void test_drop_oldest();
+	void test_drop_oldest_keep();
+	void test_drop_newest_keep();
+	void test_queue_wait();
+	void test_block();
+	void test_block_timeout();
+	void test_finish_idle();
+	void test_close();
+	void test_handler_exception();
+	void test_coalesce();
+	void test_coalesce_full();
+};
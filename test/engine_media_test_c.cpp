@@ -0,0 +1,100 @@
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <sysexits.h>
+
+#include <nlohmann/json.hpp>
+
+#include <verbit/streaming/ws_streaming_client.h>
+
+#include "empty_media_generator.h"
+
+#define TEST_WS_URL "wss://localhost:9002"
+
+#define N_STREAMS             3
+#define EXPECTED_N_RESPONSES  (1 * N_STREAMS)
+#define EXPECTED_FINAL_TEXT   "I saw 0 bytes. "
+std::atomic<int> n_responses(0);
+std::atomic<int> n_final_text_ok(0);
+
+using namespace verbit::streaming;
+
+void on_response(WebSocketStreamingClient* client, nlohmann::json* response)
+{
+	n_responses++;
+	auto is_eos = (*response)["response"]["is_end_of_stream"];
+	if (is_eos.get<bool>()) {
+		auto alternatives = (*response)["response"]["alternatives"];
+		if (alternatives[0]["transcript"].get<std::string>() == EXPECTED_FINAL_TEXT) {
+			n_final_text_ok++;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	/*
+	 * Test several concurrent streams sharing one engine
+	 */
+	StreamingEngine engine;
+	engine.start(2);
+	std::atomic<int> n_failed(0);
+	std::vector<std::thread> runners;
+	for (int i = 0; i < N_STREAMS; i++) {
+		runners.push_back(std::thread([&access_token, &engine, &n_failed]() {
+			WebSocketStreamingClient client {access_token, engine};
+			client.ws_url(TEST_WS_URL);
+			client.verify_ssl_cert(false);
+			client.set_response_handler(&on_response);
+			EmptyMediaGenerator media_gen;
+			if (!client.run_stream(media_gen)) {
+				std::cout << "FAILED error " << client.error_code() << ": " << client.service_error() << std::endl;
+				n_failed++;
+			}
+		}));
+	}
+	for (auto& t : runners) {
+		t.join();
+	}
+	if (n_failed > 0) {
+		// emitted its own FAILED message
+		return EX_SOFTWARE;
+	} else if (n_responses != EXPECTED_N_RESPONSES) {
+		std::cout << "FAILED expected n_responses=" << EXPECTED_N_RESPONSES << " actual n_responses=" << n_responses << std::endl;
+		return EX_SOFTWARE;
+	} else if (n_final_text_ok != N_STREAMS) {
+		std::cout << "FAILED expected final_text=\"" << EXPECTED_FINAL_TEXT << "\" for all " << N_STREAMS << " streams" << std::endl;
+		return EX_SOFTWARE;
+	}
+	/*
+	 * Test a throwing response handler fails only its own session, and the engine runs on
+	 */
+	{
+		WebSocketStreamingClient client {access_token, engine};
+		client.ws_url(TEST_WS_URL);
+		client.verify_ssl_cert(false);
+		client.set_response_handler([](WebSocketStreamingClient*, nlohmann::json*) {
+			throw std::runtime_error("handler failed");
+		});
+		EmptyMediaGenerator media_gen;
+		if (client.run_stream(media_gen) || (client.error_code() != WebSocketStreamingClient::RESPONSE_ERROR)) {
+			std::cout << "FAILED expected error " << WebSocketStreamingClient::RESPONSE_ERROR
+				<< " from the throwing handler, actual " << client.error_code() << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	{
+		WebSocketStreamingClient client {access_token, engine};
+		client.ws_url(TEST_WS_URL);
+		client.verify_ssl_cert(false);
+		EmptyMediaGenerator media_gen;
+		if (!client.run_stream(media_gen)) {
+			std::cout << "FAILED error after a throwing handler " << client.error_code() << ": " << client.service_error() << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	engine.stop();
+	std::cout << "OK (5 tests)" << std::endl;
+	return EX_OK;
+}
@@ -0,0 +1,147 @@
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include <verbit/streaming/service_state.h>
+
+#include "flight_recorder_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FlightRecorderTest);
+
+namespace {
+
+std::string test_path()
+{
+	return "/tmp/flight_recorder_test." + std::to_string(getpid());
+}
+
+} // anonymous namespace
+
+void FlightRecorderTest::tearDown()
+{
+	unlink(test_path().c_str());
+}
+
+void FlightRecorderTest::test_record()
+{
+	FlightRecorder recorder {16};
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("empty", (size_t)0, recorder.events().size());
+	recorder.record(FlightEvent::send, 3200);
+	recorder.record(FlightEvent::response, 512, FlightEvent::response_final);
+	recorder.record(FlightEvent::close, 1006, 1011);
+
+	std::vector<FlightEvent> events = recorder.events();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("events", (size_t)3, events.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("1st kind", FlightEvent::send, events[0].kind);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("1st value", (uint32_t)3200, events[0].value);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("2nd kind", FlightEvent::response, events[1].kind);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("2nd arg", FlightEvent::response_final, events[1].arg);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("3rd value", (uint32_t)1006, events[2].value);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("3rd arg", (uint16_t)1011, events[2].arg);
+	CPPUNIT_ASSERT_MESSAGE("kind name", std::string(FlightEvent::kind_name(FlightEvent::send)) == "send");
+}
+
+void FlightRecorderTest::test_wrap()
+{
+	FlightRecorder recorder {10};
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("capacity", (size_t)16, recorder.capacity());
+	for (uint32_t i = 0; i < 100; i++) {
+		recorder.record(FlightEvent::send, i);
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("recorded", (uint64_t)100, recorder.recorded());
+	std::vector<FlightEvent> events = recorder.events();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("events", (size_t)16, events.size());
+	for (uint32_t i = 0; i < 16; i++) {
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("last events, oldest first", 84 + i, events[i].value);
+	}
+}
+
+void FlightRecorderTest::test_times()
+{
+	FlightRecorder recorder;
+	auto start = std::chrono::steady_clock::now();
+	recorder.record(FlightEvent::open);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	recorder.record(FlightEvent::ping);
+	auto end = std::chrono::steady_clock::now();
+
+	std::vector<FlightEvent> events = recorder.events();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("events", (size_t)2, events.size());
+	double gap_ms = (events[1].time_ns - events[0].time_ns) / 1e6;
+	double elapsed_ms = std::chrono::duration<double, std::milli>(end - start).count();
+	CPPUNIT_ASSERT_MESSAGE("gap at least the sleep: " + std::to_string(gap_ms), gap_ms >= 45.0);
+	CPPUNIT_ASSERT_MESSAGE("gap at most the elapsed time: " + std::to_string(gap_ms), gap_ms <= elapsed_ms * 1.1);
+	uint64_t start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+	CPPUNIT_ASSERT_MESSAGE("monotonic clock", (events[0].time_ns + 1000000 >= start_ns)
+		&& (events[0].time_ns <= start_ns + 1000000));
+}
+
+void FlightRecorderTest::test_dump()
+{
+	FlightRecorder recorder {8};
+	for (uint32_t i = 0; i < 20; i++) {
+		recorder.record(FlightEvent::buffered, i * 1000);
+	}
+	recorder.record(FlightEvent::finish, 3510);
+	recorder.dump(test_path(), 3510);
+
+	std::vector<FlightEvent> expected = recorder.events();
+	std::vector<FlightEvent> events;
+	int error_code = 0;
+	uint64_t wall_us = 0;
+	uint64_t time_ns = 0;
+	FlightRecorder::load(test_path(), events, error_code, wall_us, time_ns);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("error code", 3510, error_code);
+	CPPUNIT_ASSERT_MESSAGE("wall time", wall_us > 0);
+	CPPUNIT_ASSERT_MESSAGE("dump time after the events", time_ns >= events.back().time_ns);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("events", expected.size(), events.size());
+	for (size_t i = 0; i < events.size(); i++) {
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("kind", expected[i].kind, events[i].kind);
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("value", expected[i].value, events[i].value);
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("last", FlightEvent::finish, events.back().kind);
+
+	CPPUNIT_ASSERT_THROW_MESSAGE("can't write", recorder.dump("/nonexistent/dir/dump"), std::runtime_error);
+}
+
+void FlightRecorderTest::test_not_dump()
+{
+	std::vector<FlightEvent> events;
+	int error_code;
+	uint64_t wall_us;
+	uint64_t time_ns;
+	CPPUNIT_ASSERT_THROW_MESSAGE("missing", FlightRecorder::load("/nonexistent/dump", events, error_code, wall_us, time_ns),
+		std::runtime_error);
+	std::ofstream(test_path()) << "this is not a flight recorder dump";
+	CPPUNIT_ASSERT_THROW_MESSAGE("bad magic", FlightRecorder::load(test_path(), events, error_code, wall_us, time_ns),
+		std::runtime_error);
+
+	FlightRecorder recorder;
+	recorder.record(FlightEvent::open);
+	recorder.record(FlightEvent::ping);
+	recorder.dump(test_path());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("truncate", 0, truncate(test_path().c_str(), 32 + 16 + 8));
+	CPPUNIT_ASSERT_THROW_MESSAGE("truncated", FlightRecorder::load(test_path(), events, error_code, wall_us, time_ns),
+		std::runtime_error);
+}
+
+void FlightRecorderTest::test_service_state()
+{
+	FlightRecorder recorder;
+	ServiceState state;
+	state.flight_recorder(&recorder);
+	state.change(ServiceState::state_opening);
+	state.change_if(ServiceState::state_open, ServiceState::state_opening, false);
+	state.change_if(ServiceState::state_done, ServiceState::state_opening, false);  // not changed
+
+	std::vector<FlightEvent> events = recorder.events();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("transitions", (size_t)2, events.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("kind", FlightEvent::state, events[1].kind);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("from", (uint32_t)ServiceState::state_opening, events[1].value);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("to", (uint16_t)ServiceState::state_open, events[1].arg);
+}
@@ -0,0 +1,29 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/flight_recorder.h>
+
+/**
+ * Unit tests for `FlightRecorder` class.
+ */
+class FlightRecorderTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(FlightRecorderTest);
+
+	CPPUNIT_TEST(test_record);
+	CPPUNIT_TEST(test_wrap);
+	CPPUNIT_TEST(test_times);
+	CPPUNIT_TEST(test_dump);
+	CPPUNIT_TEST(test_not_dump);
+	CPPUNIT_TEST(test_service_state);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void tearDown();
+
+	void test_record();
+	void test_wrap();
+	void test_times();
+	void test_dump();
+	void test_not_dump();
+	void test_service_state();
+};
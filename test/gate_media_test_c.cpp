@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sysexits.h>
+
+#include <nlohmann/json.hpp>
+
+#include <verbit/streaming/metrics_registry.h>
+#include <verbit/streaming/voice_gate.h>
+#include <verbit/streaming/ws_streaming_client.h>
+
+#define TEST_WS_URL "wss://localhost:9002"
+
+#define RATE              16000
+#define BYTES_PER_SECOND  (2 * RATE)
+#define CHUNK_BYTES       3200
+
+// the gate closes 300ms (hangover) after speech, and sends 200ms (pre-roll) before it
+#define LEADING_SKIPPED   1.8  // of the 2s of silence before the first speech
+#define GAP_SKIPPED       2.5  // of the 3s of silence between speech
+
+size_t final_bytes = 0;
+// each response's last item end, mapped by the client as the response arrived
+std::vector<double> service_times;
+std::vector<double> mapped_times;
+
+using namespace verbit::streaming;
+
+// S16LE media builders, appending `seconds` of a signal to `media`
+
+void silence(std::string& media, double seconds)
+{
+	media.append((size_t)(RATE * seconds) * 2, '\0');
+}
+
+void tone(std::string& media, double seconds)
+{
+	for (size_t i = 0; i < (size_t)(RATE * seconds); i++) {
+		int16_t sample = (int16_t)lrint(8000 * std::sin(2 * M_PI * 1000 * i / RATE));
+		media.append(reinterpret_cast<const char*>(&sample), 2);
+	}
+}
+
+/**
+ * Media generator producing the given media, as fast as it is read.
+ */
+class StringMediaGenerator : public MediaGenerator
+{
+public:
+	StringMediaGenerator(const std::string& media) : _media(media) {}
+
+	bool read_chunk(ChunkBuffer& chunk)
+	{
+		size_t bytes = std::min((size_t)CHUNK_BYTES, _media.size() - _pos);
+		memcpy(chunk.prepare(bytes), _media.data() + _pos, bytes);
+		chunk.commit(bytes);
+		_pos += bytes;
+		return true;
+	}
+
+	const std::string get_chunk() { return read_chunk_string(); }
+
+	bool finished() { return (_pos >= _media.size()); }
+
+private:
+	const std::string& _media;
+	size_t _pos = 0;
+};
+
+void on_response(WebSocketStreamingClient* client, nlohmann::json* response)
+{
+	auto alternatives = (*response)["response"]["alternatives"];
+	double end_t = alternatives[0]["items"].back()["end"].get<double>();
+	service_times.push_back(end_t);
+	mapped_times.push_back(client->media_time(end_t));
+	auto is_eos = (*response)["response"]["is_end_of_stream"];
+	if (is_eos.get<bool>()) {
+		std::string transcript = alternatives[0]["transcript"].get<std::string>();
+		sscanf(transcript.c_str(), "I saw %zu bytes", &final_bytes);
+	}
+}
+
+bool contains(const std::string& text, const std::string& line)
+{
+	if (text.find(line + "\n") == std::string::npos) {
+		std::cout << "FAILED expected Prometheus line \"" << line << "\" in:" << std::endl << text;
+		return false;
+	}
+	return true;
+}
+
+bool near(double actual, double expected)
+{
+	return std::fabs(actual - expected) < 0.05;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	std::string media;
+	silence(media, 2.0);
+	tone(media, 1.0);
+	silence(media, 3.0);
+	tone(media, 1.0);
+	silence(media, 1.0);
+	VoiceGateConfig config;
+	config.mode = VoiceGateConfig::gate_drop;
+
+	// the gate is deterministic, so a gate of its own shows what the client's sends
+	VoiceGate reference {config, RATE, 1};
+	std::string expected;
+	for (size_t pos = 0; pos < media.size(); pos += CHUNK_BYTES) {
+		std::string payload = media.substr(pos, CHUNK_BYTES);
+		reference.process(payload);
+		expected += payload;
+	}
+	/*
+	 * Test the gate sends only speech, with its hangover and pre-roll
+	 */
+	MetricsRegistry registry;
+	WebSocketStreamingClient client {access_token};
+	client.metrics_registry(&registry);
+	client.ws_url(TEST_WS_URL);
+	client.verify_ssl_cert(false);
+	client.set_response_handler(&on_response);
+	client.voice_gate(true, config);
+	StringMediaGenerator media_gen {media};
+	if (!client.run_stream(media_gen)) {
+		std::cout << "FAILED run_stream error " << client.error_code() << ": " << client.service_error() << std::endl;
+		return EX_SOFTWARE;
+	}
+	GateStats stats = client.gate_stats();
+	GateStats expected_stats = reference.stats();
+	std::cout << "bytes_in " << stats.bytes_in << " bytes_sent " << stats.bytes_sent << " bytes_gated " << stats.bytes_gated
+		<< " speech_segments " << stats.speech_segments << " server saw " << final_bytes << std::endl;
+	if ( (stats.bytes_in != media.size()) || (stats.bytes_sent != expected.size())
+		|| (stats.bytes_gated != expected_stats.bytes_gated) || (stats.speech_segments != 2) ) {
+		std::cout << "FAILED expected the gate to pass " << expected.size() << " bytes in 2 segments" << std::endl;
+		return EX_SOFTWARE;
+	} else if ( (final_bytes != expected.size()) || (client.metrics().bytes_sent.value() != expected.size())
+		|| (client.metrics().bytes_gated.value() != expected_stats.bytes_gated) ) {
+		std::cout << "FAILED expected the server to see " << expected.size() << " bytes" << std::endl;
+		return EX_SOFTWARE;
+	}
+	std::string text = registry.prometheus();
+	if (!contains(text, "verbit_streaming_media_bytes_sent_total " + std::to_string(expected.size()))
+		|| !contains(text, "verbit_streaming_media_bytes_gated_total " + std::to_string(expected_stats.bytes_gated))) {
+		return EX_SOFTWARE;
+	}
+	/*
+	 * Test response times map back across the gaps to times in the original media
+	 */
+	if (service_times.size() < 2) {
+		std::cout << "FAILED expected responses, actual " << service_times.size() << std::endl;
+		return EX_SOFTWARE;
+	}
+	for (size_t i = 0; i < service_times.size(); i++) {
+		double expected_time = (double)reference.media_offset((uint64_t)(service_times[i] * BYTES_PER_SECOND)) / BYTES_PER_SECOND;
+		std::cout << "response " << i << " end " << service_times[i] << "s maps to " << mapped_times[i] << "s" << std::endl;
+		if (mapped_times[i] != expected_time) {
+			std::cout << "FAILED expected " << service_times[i] << "s to map to " << expected_time << "s" << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	// the first response is 1s into the first speech, the second 1s later, across the gap
+	if (!near(mapped_times[0] - service_times[0], LEADING_SKIPPED)) {
+		std::cout << "FAILED expected " << LEADING_SKIPPED << "s skipped before the first speech" << std::endl;
+		return EX_SOFTWARE;
+	} else if (!near((mapped_times[1] - service_times[1]) - (mapped_times[0] - service_times[0]), GAP_SKIPPED)) {
+		std::cout << "FAILED expected " << GAP_SKIPPED << "s skipped between speech" << std::endl;
+		return EX_SOFTWARE;
+	}
+	std::cout << "OK (2 tests)" << std::endl;
+	return EX_OK;
+}
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "histogram_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(HistogramTest);
+
+void HistogramTest::test_empty()
+{
+	Histogram h;
+	CPPUNIT_ASSERT_MESSAGE("empty count", h.count() == 0);
+	CPPUNIT_ASSERT_MESSAGE("empty max", h.max() == 0);
+	CPPUNIT_ASSERT_MESSAGE("empty mean", h.mean() == 0.0);
+	CPPUNIT_ASSERT_MESSAGE("empty percentile", h.percentile(0.99) == 0);
+}
+
+void HistogramTest::test_buckets()
+{
+	// every value is in the bucket whose range it falls in, and buckets are contiguous
+	CPPUNIT_ASSERT_MESSAGE("first bucket", Histogram::bucket(0) == 0);
+	for (int b = 1; b < Histogram::BUCKETS; b++) {
+		uint64_t first = Histogram::bucket_max(b - 1) + 1;
+		CPPUNIT_ASSERT_MESSAGE("bucket start", Histogram::bucket(first) == b);
+		CPPUNIT_ASSERT_MESSAGE("bucket end", Histogram::bucket(Histogram::bucket_max(b)) == b);
+		CPPUNIT_ASSERT_MESSAGE("bucket width within 1/8", (Histogram::bucket_max(b) - first) <= first / 8);
+	}
+	CPPUNIT_ASSERT_MESSAGE("last bucket", Histogram::bucket_max(Histogram::BUCKETS - 1) == UINT64_MAX);
+	CPPUNIT_ASSERT_MESSAGE("largest value", Histogram::bucket(UINT64_MAX) == Histogram::BUCKETS - 1);
+}
+
+void HistogramTest::test_small_values()
+{
+	Histogram h;
+	for (uint64_t v = 1; v <= 10; v++) {
+		h.record(v);
+	}
+	CPPUNIT_ASSERT_MESSAGE("small count", h.count() == 10);
+	CPPUNIT_ASSERT_MESSAGE("small max", h.max() == 10);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("small mean", 5.5, h.mean(), 1e-9);
+	CPPUNIT_ASSERT_MESSAGE("small p50 exact", h.percentile(0.5) == 5);
+	CPPUNIT_ASSERT_MESSAGE("small p100 exact", h.percentile(1.0) == 10);
+	CPPUNIT_ASSERT_MESSAGE("small p0 is smallest", h.percentile(0.0) == 1);
+}
+
+void HistogramTest::test_percentile()
+{
+	Histogram h;
+	for (uint64_t v = 1; v <= 10000; v++) {
+		h.record(v);
+	}
+	uint64_t p50 = h.percentile(0.50);
+	uint64_t p99 = h.percentile(0.99);
+	CPPUNIT_ASSERT_MESSAGE("p50 within bucket precision", (p50 >= 5000) && (p50 <= 5000 + 5000 / 8));
+	CPPUNIT_ASSERT_MESSAGE("p99 within bucket precision", (p99 >= 9900) && (p99 <= 10000));
+	CPPUNIT_ASSERT_MESSAGE("p100 is max", h.percentile(1.0) == 10000);
+	h.reset();
+	CPPUNIT_ASSERT_MESSAGE("reset count", h.count() == 0);
+	CPPUNIT_ASSERT_MESSAGE("reset percentile", h.percentile(0.5) == 0);
+}
+
+void HistogramTest::test_snapshot()
+{
+	Histogram h;
+	h.record(100);
+	h.record(200);
+	Histogram snapshot = h;
+	h.record(300);
+	CPPUNIT_ASSERT_MESSAGE("snapshot count", snapshot.count() == 2);
+	CPPUNIT_ASSERT_MESSAGE("snapshot max", snapshot.max() == 200);
+	CPPUNIT_ASSERT_MESSAGE("original count", h.count() == 3);
+	snapshot = h;
+	CPPUNIT_ASSERT_MESSAGE("assigned count", snapshot.count() == 3);
+	CPPUNIT_ASSERT_MESSAGE("assigned max", snapshot.max() == 300);
+}
+
+void HistogramTest::test_merge()
+{
+	Histogram a;
+	Histogram b;
+	for (uint64_t v = 1; v <= 100; v++) {
+		a.record(v);
+		b.record(v + 100);
+	}
+	a.merge(b);
+	CPPUNIT_ASSERT_MESSAGE("merged count", a.count() == 200);
+	CPPUNIT_ASSERT_MESSAGE("merged sum", a.sum() == 20100);
+	CPPUNIT_ASSERT_MESSAGE("merged max", a.max() == 200);
+	CPPUNIT_ASSERT_MESSAGE("merged p50 within bucket precision", (a.percentile(0.5) >= 100) && (a.percentile(0.5) <= 100 + 100 / 8));
+	CPPUNIT_ASSERT_MESSAGE("merged from unchanged", b.count() == 100);
+}
+
+void HistogramTest::test_concurrent()
+{
+	Histogram h;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.push_back(std::thread([&h, t]{
+			for (uint64_t v = 0; v < 10000; v++) {
+				h.record(v + t);
+			}
+		}));
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	CPPUNIT_ASSERT_MESSAGE("concurrent count", h.count() == 40000);
+	CPPUNIT_ASSERT_MESSAGE("concurrent max", h.max() == 10002);
+}
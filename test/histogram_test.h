@@ -0,0 +1,29 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/histogram.h>
+
+/**
+ * Unit tests for `Histogram` class.
+ */
+class HistogramTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(HistogramTest);
+
+	CPPUNIT_TEST(test_empty);
+	CPPUNIT_TEST(test_buckets);
+	CPPUNIT_TEST(test_small_values);
+	CPPUNIT_TEST(test_percentile);
+	CPPUNIT_TEST(test_snapshot);
+	CPPUNIT_TEST(test_merge);
+	CPPUNIT_TEST(test_concurrent);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_empty();
+	void test_buckets();
+	void test_small_values();
+	void test_percentile();
+	void test_snapshot();
+	void test_merge();
+	void test_concurrent();
+};
@@ -0,0 +1,64 @@
+#include <chrono>
+#include <iostream>
+#include <sysexits.h>
+
+#include <nlohmann/json.hpp>
+
+#include <verbit/streaming/ws_streaming_client.h>
+
+#include "../examples/wav_media_generator.h"
+
+#define TEST_WS_URL    "wss://localhost:9002"
+#define TEST_WAV_FILE  "test-files/thats-good.wav"
+
+#define EXPECTED_N_RESPONSES  2
+// the test server answers at once: anything slower is mapped to the wrong send time
+#define MAX_LATENCY_US  5000000
+int n_responses = 0;
+int n_latencies = 0;
+bool latency_ok = true;
+
+using namespace verbit::streaming;
+
+void on_response(WebSocketStreamingClient* client, nlohmann::json* response)
+{
+	n_responses++;
+	std::chrono::microseconds latency = client->response_latency();
+	if (latency.count() >= 0) {
+		n_latencies++;
+		if (latency.count() > MAX_LATENCY_US) {
+			std::cout << "FAILED latency " << latency.count() << "us" << std::endl;
+			latency_ok = false;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	/*
+	 * Test each response handled on the I/O thread has its emission latency measured and recorded
+	 */
+	WebSocketStreamingClient client {access_token};
+	client.track_latency(true);
+	client.ws_url(TEST_WS_URL);
+	client.verify_ssl_cert(false);
+	client.set_response_handler(&on_response);
+	WAVMediaGenerator media_gen {TEST_WAV_FILE};
+	if (!client.run_stream(media_gen)) {
+		std::cout << "FAILED error " << client.error_code() << ": " << client.service_error() << std::endl;
+		return EX_SOFTWARE;
+	}
+	SessionMetrics metrics = client.metrics();
+	if (n_responses != EXPECTED_N_RESPONSES) {
+		std::cout << "FAILED expected n_responses=" << EXPECTED_N_RESPONSES << " actual n_responses=" << n_responses << std::endl;
+	} else if ( (n_latencies == 0) || (metrics.emission_latency.count() != (uint64_t)n_latencies) ) {
+		std::cout << "FAILED latencies=" << n_latencies << " emission_latency count=" << metrics.emission_latency.count() << std::endl;
+	} else if (!latency_ok) {
+		// emits its own FAILED message
+	} else {
+		std::cout << "OK (1 tests)" << std::endl;
+		return EX_OK;
+	}
+	return EX_SOFTWARE;
+}
@@ -0,0 +1,160 @@
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "logger_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LoggerTest);
+
+namespace {
+
+std::string test_path()
+{
+	return "/tmp/logger_test." + std::to_string(getpid());
+}
+
+std::vector<std::string> read_lines(const std::string& path)
+{
+	std::ifstream file(path);
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(file, line)) {
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+// the line text, after the "[time] [level] " prefix
+std::string text(const std::string& line)
+{
+	size_t pos = line.find("] [");
+	pos = line.find("] ", pos + 3);
+	return line.substr(pos + 2);
+}
+
+int evaluated = 0;
+
+int count_evaluation()
+{
+	return ++evaluated;
+}
+
+} // anonymous namespace
+
+void LoggerTest::tearDown()
+{
+	unlink(test_path().c_str());
+}
+
+void LoggerTest::test_ctor_invalid()
+{
+	CPPUNIT_ASSERT_THROW_MESSAGE("no directory", Logger("/nonexistent/dir/file"), std::runtime_error);
+}
+
+void LoggerTest::test_levels()
+{
+	evaluated = 0;
+	{
+		Logger logger {test_path(), Logger::info};
+		CPPUNIT_ASSERT_MESSAGE("debug disabled", !logger.enabled(Logger::debug));
+		CPPUNIT_ASSERT_MESSAGE("warn enabled", logger.enabled(Logger::warn));
+		WSSC_LOG(logger, Logger::debug, "test", "debug %d", count_evaluation());
+		WSSC_LOG(logger, Logger::info, "test", "info %d", count_evaluation());
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("disabled arguments not evaluated", 1, evaluated);
+		CPPUNIT_ASSERT_MESSAGE("error", logger.log(Logger::error, "test", "error"));
+		logger.level(Logger::off);
+		CPPUNIT_ASSERT_MESSAGE("off", !logger.log(Logger::error, "test", "error when off"));
+		logger.level(Logger::debug);
+		CPPUNIT_ASSERT_MESSAGE("debug", logger.log(Logger::debug, "test", "debug"));
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("logged", (uint64_t)3, logger.logged());
+	}
+	std::vector<std::string> lines = read_lines(test_path());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("lines", (size_t)3, lines.size());
+	CPPUNIT_ASSERT_MESSAGE("info level", lines[0].find("] [info] test: info 1") != std::string::npos);
+	CPPUNIT_ASSERT_MESSAGE("error level", lines[1].find("] [error] test: error") != std::string::npos);
+	CPPUNIT_ASSERT_MESSAGE("debug level", lines[2].find("] [debug] test: debug") != std::string::npos);
+}
+
+void LoggerTest::test_format()
+{
+	Logger logger {test_path()};
+	logger.log(Logger::info, "media", "sent %zu bytes, %s", (size_t)3200, "ok");
+	logger.log(Logger::info, nullptr, "no tag");
+	logger.log(Logger::info, "", "empty tag");
+	logger.flush();
+	std::vector<std::string> lines = read_lines(test_path());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("lines", (size_t)3, lines.size());
+	// [YYYY-MM-DD HH:MM:SS.uuuuuu] [info] ...
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("time", std::string("] [info] "), lines[0].substr(27, 9));
+	CPPUNIT_ASSERT_MESSAGE("text", text(lines[0]) == "media: sent 3200 bytes, ok");
+	CPPUNIT_ASSERT_MESSAGE("no tag", text(lines[1]) == "no tag");
+	CPPUNIT_ASSERT_MESSAGE("empty tag", text(lines[2]) == "empty tag");
+}
+
+void LoggerTest::test_truncate()
+{
+	Logger logger {test_path()};
+	std::string tag(1000, 't');
+	std::string long_text(1000, 'x');
+	logger.log(Logger::info, "tag", "%s", long_text.c_str());
+	logger.log(Logger::info, tag.c_str(), "%s", long_text.c_str());
+	logger.flush();
+	std::vector<std::string> lines = read_lines(test_path());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("lines", (size_t)2, lines.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("long text", "tag: " + long_text.substr(0, WSSC_LOG_RECORD_TEXT - 6), text(lines[0]));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("long tag", tag.substr(0, WSSC_LOG_RECORD_TEXT - 3) + ": ", text(lines[1]));
+}
+
+void LoggerTest::test_full()
+{
+	const uint64_t lines_logged = 100000;
+	uint64_t logged;
+	{
+		Logger logger {test_path(), Logger::info, 4};
+		for (uint64_t i = 0; i < lines_logged; i++) {
+			logger.log(Logger::info, "test", "line %d", (int)i);
+		}
+		logged = logger.logged();
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("logged or dropped", lines_logged, logged + logger.dropped());
+		CPPUNIT_ASSERT_MESSAGE("some dropped", logger.dropped() > 0);
+	}
+	std::vector<std::string> lines = read_lines(test_path());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("lines written", (size_t)logged, lines.size());
+}
+
+void LoggerTest::test_threads()
+{
+	const int threads = 4;
+	const int lines_each = 20000;
+	uint64_t logged;
+	{
+		Logger logger {test_path(), Logger::debug, 1024};
+		std::vector<std::thread> producers;
+		for (int t = 0; t < threads; t++) {
+			producers.emplace_back([&logger, t]() {
+				for (int i = 0; i < lines_each; i++) {
+					logger.log(Logger::debug, "thread", "%d %d", t, i);
+				}
+			});
+		}
+		for (std::thread& producer : producers) {
+			producer.join();
+		}
+		logged = logger.logged();
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("logged or dropped", (uint64_t)(threads * lines_each), logged + logger.dropped());
+	}
+	// each line whole, and no line twice
+	std::set<std::string> seen;
+	for (const std::string& line : read_lines(test_path())) {
+		std::string t = text(line);
+		CPPUNIT_ASSERT_MESSAGE("whole line: " + line, t.compare(0, 8, "thread: ") == 0);
+		CPPUNIT_ASSERT_MESSAGE("once: " + line, seen.insert(t).second);
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("lines written", (size_t)logged, seen.size());
+}
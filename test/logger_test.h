@@ -0,0 +1,29 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/logger.h>
+
+/**
+ * Unit tests for `Logger` class.
+ */
+class LoggerTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(LoggerTest);
+
+	CPPUNIT_TEST(test_ctor_invalid);
+	CPPUNIT_TEST(test_levels);
+	CPPUNIT_TEST(test_format);
+	CPPUNIT_TEST(test_truncate);
+	CPPUNIT_TEST(test_full);
+	CPPUNIT_TEST(test_threads);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void tearDown();
+
+	void test_ctor_invalid();
+	void test_levels();
+	void test_format();
+	void test_truncate();
+	void test_full();
+	void test_threads();
+};
@@ -0,0 +1,73 @@
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <sysexits.h>
+
+#include <verbit/streaming/ws_streaming_client.h>
+
+#include "empty_media_generator.h"
+
+#define TEST_WS_URL       "wss://localhost:9002"
+// the test server truncates its responses on a connection with `malformed=1` in its query
+#define MALFORMED_WS_URL  TEST_WS_URL "?malformed=1"
+
+std::atomic<int> n_responses(0);
+
+using namespace verbit::streaming;
+
+void on_response(WebSocketStreamingClient* client, const Response& response)
+{
+	n_responses++;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	/*
+	 * Test a malformed response fails only its own session, not the I/O thread it shares
+	 */
+	StreamingEngine engine;
+	engine.start(1);
+	WebSocketStreamingClient bad_client {access_token, engine};
+	bad_client.ws_url(MALFORMED_WS_URL);
+	bad_client.verify_ssl_cert(false);
+	bad_client.set_typed_response_handler(&on_response);
+	EmptyMediaGenerator bad_media_gen;
+	std::future<StreamResult> bad_future = bad_client.async_run_stream(bad_media_gen);
+
+	WebSocketStreamingClient good_client {access_token, engine};
+	good_client.ws_url(TEST_WS_URL);
+	good_client.verify_ssl_cert(false);
+	good_client.set_typed_response_handler(&on_response);
+	EmptyMediaGenerator good_media_gen;
+	std::future<StreamResult> good_future = good_client.async_run_stream(good_media_gen);
+
+	StreamResult bad_result = bad_future.get();
+	StreamResult good_result = good_future.get();
+	if (bad_result.error_code != WebSocketStreamingClient::RESPONSE_ERROR) {
+		std::cout << "FAILED expected error " << WebSocketStreamingClient::RESPONSE_ERROR
+			<< " for the malformed response, actual " << bad_result.error_code << ": " << bad_result.service_error << std::endl;
+		return EX_SOFTWARE;
+	} else if (!good_result.ok()) {
+		std::cout << "FAILED error " << good_result.error_code << ": " << good_result.service_error << std::endl;
+		return EX_SOFTWARE;
+	} else if (n_responses != 1) {
+		std::cout << "FAILED expected 1 response (from the good session), actual " << n_responses << std::endl;
+		return EX_SOFTWARE;
+	}
+	/*
+	 * Test the engine still runs streams afterwards
+	 */
+	WebSocketStreamingClient later_client {access_token, engine};
+	later_client.ws_url(TEST_WS_URL);
+	later_client.verify_ssl_cert(false);
+	EmptyMediaGenerator later_media_gen;
+	StreamResult later_result = later_client.async_run_stream(later_media_gen).get();
+	engine.stop();
+	if (!later_result.ok()) {
+		std::cout << "FAILED error " << later_result.error_code << ": " << later_result.service_error << std::endl;
+		return EX_SOFTWARE;
+	}
+	std::cout << "OK (2 tests)" << std::endl;
+	return EX_OK;
+}
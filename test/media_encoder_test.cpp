@@ -0,0 +1,334 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <verbit/streaming/flac_codec.h>
+#include <verbit/streaming/ogg_stream.h>
+#include <verbit/streaming/opus_codec.h>
+
+#include "media_encoder_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MediaEncoderTest);
+
+namespace {
+
+// `frames` of speech-like media: two tones with a slow envelope and a little noise,
+// the second channel (if any) a delayed, quieter copy of the first
+std::vector<int16_t> speech(size_t frames, int channels, int rate = 16000)
+{
+	std::vector<int16_t> samples(frames * channels);
+	srand(7);
+	for (size_t i = 0; i < frames; i++) {
+		double t = (double)i / rate;
+		double envelope = 0.5 + 0.5 * std::sin(2 * M_PI * 3 * t);
+		double value = envelope * (6000 * std::sin(2 * M_PI * 220 * t) + 2000 * std::sin(2 * M_PI * 1330 * t))
+			+ (rand() % 64) - 32;
+		samples[i * channels] = (int16_t)lrint(value);
+		for (int c = 1; c < channels; c++) {
+			samples[i * channels + c] = (i >= 5) ? (int16_t)(samples[(i - 5) * channels] / 2 + c) : 0;
+		}
+	}
+	return samples;
+}
+
+std::string bytes(const std::vector<int16_t>& samples)
+{
+	return std::string(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(int16_t));
+}
+
+// encode all of `in` in pieces of `chunk` frames, and flush
+std::string encode(MediaEncoder& encoder, const std::vector<int16_t>& in, size_t chunk)
+{
+	const size_t channels = encoder.channels();
+	const size_t frames = in.size() / channels;
+	std::string out;
+	for (size_t done = 0; done < frames; ) {
+		size_t n = std::min(chunk, frames - done);
+		encoder.encode(&in[done * channels], n, out);
+		done += n;
+	}
+	encoder.flush(out);
+	return out;
+}
+
+// decode all of `in` in pieces of `chunk` bytes
+std::string decode(MediaDecoder& decoder, const std::string& in, size_t chunk)
+{
+	std::string out;
+	for (size_t pos = 0; pos < in.size(); pos += chunk) {
+		decoder.decode(in.data() + pos, std::min(chunk, in.size() - pos), out);
+	}
+	return out;
+}
+
+// a media generator returning a fixed chunk sequence
+class ChunksMediaGenerator : public MediaGenerator
+{
+public:
+	ChunksMediaGenerator(const std::vector<std::string>& chunks) : _chunks(chunks) { }
+	bool read_chunk(ChunkBuffer& chunk)
+	{
+		if (_next < _chunks.size()) {
+			chunk.append(_chunks[_next].data(), _chunks[_next].length());
+			_next++;
+		}
+		return true;
+	}
+	const std::string get_chunk() { return read_chunk_string(); }
+	bool finished() { return _next == _chunks.size(); }
+private:
+	std::vector<std::string> _chunks;
+	size_t _next = 0;
+};
+
+} // anonymous namespace
+
+void MediaEncoderTest::test_flac_mono()
+{
+	std::vector<int16_t> in = speech(16000 * 3 + 123, 1);
+	FlacMediaEncoder encoder {16000};
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("format", std::string("FLAC"), encoder.format());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("block frames", (size_t)1600, encoder.block_frames());
+	std::string flac = encode(encoder, in, 1600);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("stream marker", std::string("fLaC"), flac.substr(0, 4));
+	CPPUNIT_ASSERT_MESSAGE("compressed", flac.size() < in.size() * 2 * 6 / 10);
+
+	FlacMediaDecoder decoder;
+	std::string out = decode(decoder, flac, flac.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("rate", 16000, decoder.sample_rate());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("channels", 1, decoder.channels());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("decoded size", in.size() * 2, out.size());
+	CPPUNIT_ASSERT_MESSAGE("lossless", out == bytes(in));
+}
+
+void MediaEncoderTest::test_flac_stereo()
+{
+	std::vector<int16_t> in = speech(16000 * 2, 2);
+	FlacMediaEncoder encoder {16000, 2, std::chrono::milliseconds(20)};
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("block frames", (size_t)320, encoder.block_frames());
+	std::string flac = encode(encoder, in, 1000);
+	CPPUNIT_ASSERT_MESSAGE("compressed", flac.size() < in.size() * 2 * 6 / 10);
+
+	FlacMediaDecoder decoder;
+	std::string out = decode(decoder, flac, 4096);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("channels", 2, decoder.channels());
+	CPPUNIT_ASSERT_MESSAGE("lossless", out == bytes(in));
+}
+
+void MediaEncoderTest::test_flac_chunks()
+{
+	// whatever the pieces encoded and decoded, the result is the same
+	std::vector<int16_t> in = speech(12345, 2);
+	FlacMediaEncoder whole {16000, 2};
+	std::string expected = encode(whole, in, in.size());
+	for (size_t chunk : {1, 7, 1599, 1600, 1601, 5000}) {
+		FlacMediaEncoder encoder {16000, 2};
+		CPPUNIT_ASSERT_MESSAGE("encoded in " + std::to_string(chunk), encode(encoder, in, chunk) == expected);
+	}
+	for (size_t chunk : {1, 3, 100, 1000}) {
+		FlacMediaDecoder decoder;
+		CPPUNIT_ASSERT_MESSAGE("decoded in " + std::to_string(chunk), decode(decoder, expected, chunk) == bytes(in));
+	}
+}
+
+void MediaEncoderTest::test_flac_edges()
+{
+	// silence (constant subframes), full-scale noise (verbatim), extremes, and short last blocks
+	std::vector<std::vector<int16_t>> cases;
+	cases.push_back(std::vector<int16_t>(4000, 0));
+	std::vector<int16_t> noise(4000);
+	for (int16_t& sample : noise) {
+		sample = (int16_t)(rand() & 0xffff);
+	}
+	cases.push_back(noise);
+	std::vector<int16_t> extremes(4000);
+	for (size_t i = 0; i < extremes.size(); i++) {
+		extremes[i] = (i % 3 == 0) ? -32768 : 32767;
+	}
+	cases.push_back(extremes);
+	for (size_t n : {0, 1, 2, 8, 9, 1601}) {
+		std::vector<int16_t> in = speech(n, 1);
+		cases.push_back(in);
+	}
+	for (const std::vector<int16_t>& in : cases) {
+		FlacMediaEncoder encoder {16000};
+		std::string flac = encode(encoder, in, 1000);
+		FlacMediaDecoder decoder;
+		std::string out = decode(decoder, flac, 999);
+		CPPUNIT_ASSERT_MESSAGE("lossless, " + std::to_string(in.size()) + " samples", out == bytes(in));
+	}
+	FlacMediaEncoder silence {16000};
+	CPPUNIT_ASSERT_MESSAGE("silence is constant", encode(silence, cases[0], 1600).size() < 200);
+}
+
+void MediaEncoderTest::test_flac_corrupt()
+{
+	std::vector<int16_t> in = speech(16000, 1);
+	FlacMediaEncoder encoder {16000};
+	std::string flac = encode(encoder, in, 1600);
+
+	std::string damaged = flac;
+	damaged[damaged.size() / 2] ^= 0x10;
+	FlacMediaDecoder decoder;
+	CPPUNIT_ASSERT_THROW_MESSAGE("CRC mismatch", decode(decoder, damaged, damaged.size()), std::runtime_error);
+
+	FlacMediaDecoder not_flac;
+	CPPUNIT_ASSERT_THROW_MESSAGE("no stream marker", decode(not_flac, bytes(in), 4096), std::runtime_error);
+
+	// a truncated stream decodes the whole frames only
+	FlacMediaDecoder truncated;
+	std::string out = decode(truncated, flac.substr(0, flac.size() - 10), 512);
+	CPPUNIT_ASSERT_MESSAGE("whole frames", (out.size() > 0) && (out.size() < in.size() * 2) && (out.size() % 3200 == 0));
+	CPPUNIT_ASSERT_MESSAGE("prefix", bytes(in).compare(0, out.size(), out) == 0);
+}
+
+void MediaEncoderTest::test_flac_invalid()
+{
+	CPPUNIT_ASSERT_THROW_MESSAGE("no channels", FlacMediaEncoder(16000, 0), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("too many channels", FlacMediaEncoder(16000, 9), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("bad rate", FlacMediaEncoder(0), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("block too short", FlacMediaEncoder(8000, 1, std::chrono::milliseconds(1)), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("block too long", FlacMediaEncoder(48000, 1, std::chrono::milliseconds(2000)), std::runtime_error);
+}
+
+void MediaEncoderTest::test_ogg()
+{
+	// packets on one page, spanning pages (over 255 lacing values), and empty
+	std::vector<std::string> packets;
+	for (size_t size : {19, 0, 255, 510, 1000, 70000, 3}) {
+		std::string packet(size, '\0');
+		for (size_t i = 0; i < size; i++) {
+			packet[i] = (char)(i * 7 + size);
+		}
+		packets.push_back(packet);
+	}
+	OggPageWriter writer {1234};
+	std::string stream;
+	writer.packet(packets[0].data(), packets[0].size(), 0);
+	writer.flush(stream);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("page size", (size_t)(27 + 1 + 19), stream.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("capture pattern", std::string("OggS"), stream.substr(0, 4));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("first page", 0x02, (int)stream[5]);
+	writer.flush(stream);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("nothing to flush", (size_t)(27 + 1 + 19), stream.size());
+	for (size_t i = 1; i < packets.size(); i++) {
+		writer.packet(packets[i].data(), packets[i].size(), i * 100);
+		if (i % 2 == 1) {
+			writer.flush(stream);
+		}
+	}
+	writer.flush(stream, true);
+
+	OggPacketReader reader;
+	for (size_t pos = 0; pos < stream.size(); pos += 1000) {
+		reader.append(stream.data() + pos, std::min((size_t)1000, stream.size() - pos));
+	}
+	CPPUNIT_ASSERT_MESSAGE("end of stream", reader.eos());
+	std::string packet;
+	uint64_t granule;
+	bool eos;
+	for (size_t i = 0; i < packets.size(); i++) {
+		CPPUNIT_ASSERT_MESSAGE("packet " + std::to_string(i), reader.next(packet, granule, eos));
+		CPPUNIT_ASSERT_MESSAGE("packet data " + std::to_string(i), packet == packets[i]);
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("last packet", i + 1 == packets.size(), eos);
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("last granule", (uint64_t)600, granule);
+	CPPUNIT_ASSERT_MESSAGE("no more packets", !reader.next(packet, granule, eos));
+
+	std::string damaged = stream;
+	damaged[40] ^= 1;
+	OggPacketReader bad_crc;
+	CPPUNIT_ASSERT_THROW_MESSAGE("CRC mismatch", bad_crc.append(damaged.data(), damaged.size()), std::runtime_error);
+	OggPacketReader no_sync;
+	CPPUNIT_ASSERT_THROW_MESSAGE("sync lost", no_sync.append("fLaC", 4), std::runtime_error);
+
+	// an end of stream with nothing queued is a page of its own
+	OggPageWriter empty {1};
+	std::string empty_stream;
+	empty.flush(empty_stream, true);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("empty page", (size_t)27, empty_stream.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("first and last", 0x06, (int)empty_stream[5]);
+}
+
+void MediaEncoderTest::test_opus()
+{
+#ifdef WITH_OPUS
+	std::vector<int16_t> in = speech(16000 * 2 + 77, 1);
+	OpusMediaEncoder encoder {16000};
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("format", std::string("OPUS"), encoder.format());
+	std::string opus = encode(encoder, in, 1000);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("Ogg stream", std::string("OggS"), opus.substr(0, 4));
+
+	OpusMediaDecoder decoder {16000, 1};
+	std::string out = decode(decoder, opus, 333);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("decoded size", in.size() * 2, out.size());
+	// lossy, but aligned: the decoded media follows the original
+	const int16_t* decoded = reinterpret_cast<const int16_t*>(out.data());
+	double signal = 0.0;
+	double noise = 0.0;
+	for (size_t i = 0; i < in.size(); i++) {
+		signal += (double)in[i] * in[i];
+		noise += ((double)decoded[i] - in[i]) * ((double)decoded[i] - in[i]);
+	}
+	CPPUNIT_ASSERT_MESSAGE("aligned", noise < signal / 4);
+
+	CPPUNIT_ASSERT_THROW_MESSAGE("bad rate", OpusMediaEncoder(44100), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("bad channels", OpusMediaEncoder(16000, 3), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("bad frame", OpusMediaEncoder(16000, 1, 24000, std::chrono::milliseconds(30)), std::runtime_error);
+#else
+	CPPUNIT_ASSERT_THROW_MESSAGE("no Opus encoder", OpusMediaEncoder(16000), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("no Opus decoder", OpusMediaDecoder(16000, 1), std::runtime_error);
+#endif
+}
+
+void MediaEncoderTest::test_create()
+{
+	CPPUNIT_ASSERT_MESSAGE("PCM", !MediaDecoder::create("S16LE", 16000, 1));
+	CPPUNIT_ASSERT_MESSAGE("FLAC", (bool)MediaDecoder::create("FLAC", 16000, 1));
+#ifdef WITH_OPUS
+	CPPUNIT_ASSERT_MESSAGE("Opus", (bool)MediaDecoder::create("OPUS", 16000, 1));
+#else
+	CPPUNIT_ASSERT_MESSAGE("no Opus", !MediaDecoder::create("OPUS", 16000, 1));
+#endif
+	MediaConfig config;
+	CPPUNIT_ASSERT_MESSAGE("S16LE is PCM", config.is_pcm());
+	config.format = "FLAC";
+	CPPUNIT_ASSERT_MESSAGE("FLAC is not PCM", !config.is_pcm());
+}
+
+void MediaEncoderTest::test_generator()
+{
+	// stereo S16LE, split into chunks at arbitrary bytes
+	std::vector<int16_t> in = speech(20000, 2);
+	std::string media = bytes(in);
+	std::vector<std::string> chunks;
+	for (size_t pos = 0, len = 1; pos < media.length(); pos += len, len = len * 3 % 4093 + 1) {
+		chunks.push_back(media.substr(pos, len));
+	}
+
+	ChunksMediaGenerator source {chunks};
+	FlacMediaEncoder encoder {16000, 2};
+	EncodingMediaGenerator generator {source, encoder};
+	MediaConfig config = generator.media_config();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("config format", std::string("FLAC"), config.format);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("config rate", 16000, config.sample_rate);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("config channels", 2, config.num_channels);
+
+	std::string flac;
+	while (!generator.finished()) {
+		std::string storage;
+		ChunkBuffer chunk(storage);
+		CPPUNIT_ASSERT_MESSAGE("read", generator.read_chunk(chunk));
+		flac.append(chunk.data(), chunk.size());
+	}
+	FlacMediaEncoder whole {16000, 2};
+	CPPUNIT_ASSERT_MESSAGE("encoded", flac == encode(whole, in, in.size()));
+	FlacMediaDecoder decoder;
+	CPPUNIT_ASSERT_MESSAGE("decoded", decode(decoder, flac, flac.size()) == media);
+}
@@ -0,0 +1,36 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/media_encoder.h>
+
+/**
+ * Unit tests for `MediaEncoder` implementations (FLAC, Opus), `OggPageWriter`,
+ * `OggPacketReader` and `EncodingMediaGenerator` classes.
+ */
+class MediaEncoderTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MediaEncoderTest);
+
+	CPPUNIT_TEST(test_flac_mono);
+	CPPUNIT_TEST(test_flac_stereo);
+	CPPUNIT_TEST(test_flac_chunks);
+	CPPUNIT_TEST(test_flac_edges);
+	CPPUNIT_TEST(test_flac_corrupt);
+	CPPUNIT_TEST(test_flac_invalid);
+	CPPUNIT_TEST(test_ogg);
+	CPPUNIT_TEST(test_opus);
+	CPPUNIT_TEST(test_create);
+	CPPUNIT_TEST(test_generator);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_flac_mono();
+	void test_flac_stereo();
+	void test_flac_chunks();
+	void test_flac_edges();
+	void test_flac_corrupt();
+	void test_flac_invalid();
+	void test_ogg();
+	void test_opus();
+	void test_create();
+	void test_generator();
+};
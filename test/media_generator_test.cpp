@@ -0,0 +1,141 @@
+#include <iostream>
+
+#include "media_generator_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MediaGeneratorTest);
+
+namespace {
+
+// implements only the original pull interface
+class StringMediaGenerator : public MediaGenerator
+{
+public:
+	StringMediaGenerator(const std::string& chunk) : _chunk(chunk) { }
+	const std::string get_chunk() { return _chunk; }
+	bool finished() { return false; }
+private:
+	std::string _chunk;
+};
+
+// implements the buffer-lending interface, and get_chunk() with it
+class BufferMediaGenerator : public MediaGenerator
+{
+public:
+	BufferMediaGenerator(const std::string& chunk, bool more) : _chunk(chunk), _more(more) { }
+	bool read_chunk(ChunkBuffer& chunk)
+	{
+		chunk.append(_chunk.data(), _chunk.length());
+		return _more;
+	}
+	const std::string get_chunk() { return read_chunk_string(); }
+	bool finished() { return false; }
+private:
+	std::string _chunk;
+	bool _more;
+};
+
+} // anonymous namespace
+
+void MediaGeneratorTest::test_chunk_buffer()
+{
+	std::string storage = "stale";
+	{
+		ChunkBuffer chunk {storage};
+		CPPUNIT_ASSERT_MESSAGE("chunk_buffer empty", chunk.size() == 0);
+		memcpy(chunk.prepare(3), "abc", 3);
+		chunk.commit(3);
+		chunk.append("def", 3);
+		CPPUNIT_ASSERT_MESSAGE("chunk_buffer size", chunk.size() == 6);
+		CPPUNIT_ASSERT_MESSAGE("chunk_buffer data", std::string(chunk.data(), chunk.size()) == "abcdef");
+		chunk.clear();
+		CPPUNIT_ASSERT_MESSAGE("chunk_buffer clear", chunk.size() == 0);
+		chunk.append("ghi", 3);
+	}
+	CPPUNIT_ASSERT_MESSAGE("chunk_buffer storage", storage == "ghi");
+}
+
+void MediaGeneratorTest::test_chunk_buffer_partial_commit()
+{
+	std::string storage;
+	{
+		ChunkBuffer chunk {storage};
+		memcpy(chunk.prepare(10), "abcdefghij", 10);
+		chunk.commit(4);
+		CPPUNIT_ASSERT_MESSAGE("chunk_buffer_partial_commit size", chunk.size() == 4);
+	}
+	CPPUNIT_ASSERT_MESSAGE("chunk_buffer_partial_commit storage", storage == "abcd");
+}
+
+// the storage is grown to its reserved capacity once, not once per prepare()
+void MediaGeneratorTest::test_chunk_buffer_reserved()
+{
+	std::string storage;
+	storage.reserve(100);
+	{
+		ChunkBuffer chunk {storage};
+		memcpy(chunk.prepare(10), "abcdefghij", 10);
+		chunk.commit(10);
+		CPPUNIT_ASSERT_MESSAGE("chunk_buffer_reserved grown", storage.size() == storage.capacity());
+		const char* grown = storage.data();
+		memcpy(chunk.prepare(10), "klmnopqrst", 10);
+		chunk.commit(10);
+		CPPUNIT_ASSERT_MESSAGE("chunk_buffer_reserved not reallocated", storage.data() == grown);
+	}
+	CPPUNIT_ASSERT_MESSAGE("chunk_buffer_reserved storage", storage == "abcdefghijklmnopqrst");
+}
+
+// appending to the storage as a string keeps the committed bytes, and the reserved capacity
+void MediaGeneratorTest::test_chunk_buffer_string()
+{
+	std::string storage;
+	storage.reserve(100);
+	const char* reserved = storage.data();
+	{
+		ChunkBuffer chunk {storage};
+		memcpy(chunk.prepare(10), "abcdefghij", 10);
+		chunk.commit(4);
+		std::string& appended = chunk.string();
+		CPPUNIT_ASSERT_MESSAGE("chunk_buffer_string committed", appended == "abcd");
+		appended.append("klmn");
+		chunk.commit_string();
+		CPPUNIT_ASSERT_MESSAGE("chunk_buffer_string size", chunk.size() == 8);
+		CPPUNIT_ASSERT_MESSAGE("chunk_buffer_string not reallocated", storage.data() == reserved);
+		memcpy(chunk.prepare(2), "op", 2);
+		chunk.commit(2);
+	}
+	CPPUNIT_ASSERT_MESSAGE("chunk_buffer_string storage", storage == "abcdklmnop");
+}
+
+void MediaGeneratorTest::test_read_chunk_default()
+{
+	StringMediaGenerator gen {"media"};
+	std::string storage;
+	{
+		ChunkBuffer chunk {storage};
+		CPPUNIT_ASSERT_MESSAGE("read_chunk_default more", gen.read_chunk(chunk));
+	}
+	CPPUNIT_ASSERT_MESSAGE("read_chunk_default storage", storage == "media");
+}
+
+void MediaGeneratorTest::test_read_chunk_default_eof()
+{
+	StringMediaGenerator gen {MediaGenerator::END_OF_FILE};
+	std::string storage;
+	ChunkBuffer chunk {storage};
+	CPPUNIT_ASSERT_MESSAGE("read_chunk_default_eof ended", !gen.read_chunk(chunk));
+	CPPUNIT_ASSERT_MESSAGE("read_chunk_default_eof empty", chunk.size() == 0);
+}
+
+void MediaGeneratorTest::test_read_chunk_string()
+{
+	BufferMediaGenerator gen {"media", true};
+	CPPUNIT_ASSERT_MESSAGE("read_chunk_string", gen.get_chunk() == "media");
+}
+
+void MediaGeneratorTest::test_read_chunk_string_eof()
+{
+	BufferMediaGenerator gen {"", false};
+	CPPUNIT_ASSERT_MESSAGE("read_chunk_string_eof", gen.get_chunk() == MediaGenerator::END_OF_FILE);
+}
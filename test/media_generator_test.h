@@ -0,0 +1,31 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/media_generator.h>
+
+/**
+ * Unit tests for `MediaGenerator` default and helper methods and `ChunkBuffer` class.
+ */
+class MediaGeneratorTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MediaGeneratorTest);
+
+	CPPUNIT_TEST(test_chunk_buffer);
+	CPPUNIT_TEST(test_chunk_buffer_partial_commit);
+	CPPUNIT_TEST(test_chunk_buffer_reserved);
+	CPPUNIT_TEST(test_chunk_buffer_string);
+	CPPUNIT_TEST(test_read_chunk_default);
+	CPPUNIT_TEST(test_read_chunk_default_eof);
+	CPPUNIT_TEST(test_read_chunk_string);
+	CPPUNIT_TEST(test_read_chunk_string_eof);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_chunk_buffer();
+	void test_chunk_buffer_partial_commit();
+	void test_chunk_buffer_reserved();
+	void test_chunk_buffer_string();
+	void test_read_chunk_default();
+	void test_read_chunk_default_eof();
+	void test_read_chunk_string();
+	void test_read_chunk_string_eof();
+};
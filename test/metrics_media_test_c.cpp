@@ -0,0 +1,93 @@
+#include <iostream>
+#include <sysexits.h>
+
+#include <nlohmann/json.hpp>
+
+#include <verbit/streaming/metrics_registry.h>
+#include <verbit/streaming/ws_streaming_client.h>
+
+#include "../examples/wav_media_generator.h"
+
+#define TEST_WS_URL    "wss://localhost:9002"
+#define TEST_WAV_FILE  "test-files/thats-good.wav"
+
+#define EXPECTED_N_RESPONSES  2
+#define EXPECTED_BYTES_SENT   44346
+int n_responses = 0;
+
+using namespace verbit::streaming;
+
+void on_response(WebSocketStreamingClient* client, nlohmann::json* response)
+{
+	n_responses++;
+}
+
+bool contains(const std::string& text, const std::string& line)
+{
+	if (text.find(line + "\n") == std::string::npos) {
+		std::cout << "FAILED expected Prometheus line \"" << line << "\" in:" << std::endl << text;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	MetricsRegistry registry;
+	/*
+	 * Test the session counts what it sends and receives, and the registry sees it while it runs
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		client.metrics_registry(&registry);
+		client.ws_url(TEST_WS_URL);
+		client.verify_ssl_cert(false);
+		client.set_response_handler(&on_response);
+		WAVMediaGenerator media_gen {TEST_WAV_FILE};
+		if (!client.run_stream(media_gen)) {
+			std::cout << "FAILED error " << client.error_code() << ": " << client.service_error() << std::endl;
+			return EX_SOFTWARE;
+		}
+		SessionMetrics metrics = client.metrics();
+		if ( (n_responses != EXPECTED_N_RESPONSES)
+			|| (metrics.responses[SessionMetrics::response_captions].value() != EXPECTED_N_RESPONSES)
+			|| (metrics.handler_time.count() != EXPECTED_N_RESPONSES)
+			|| (metrics.bytes_sent.value() != EXPECTED_BYTES_SENT)
+			|| (metrics.send_errors.value() != 0)
+			|| (metrics.frames_sent.value() == 0) || (metrics.send_latency.count() != metrics.frames_sent.value()) ) {
+			std::cout << "FAILED metrics responses=" << n_responses
+				<< " captions=" << metrics.responses[SessionMetrics::response_captions].value()
+				<< " handler_time count=" << metrics.handler_time.count()
+				<< " bytes_sent=" << metrics.bytes_sent.value()
+				<< " send_errors=" << metrics.send_errors.value()
+				<< " frames_sent=" << metrics.frames_sent.value()
+				<< " send_latency count=" << metrics.send_latency.count() << std::endl;
+			return EX_SOFTWARE;
+		}
+		if ( (registry.sessions() != 1) || (registry.snapshot().bytes_sent.value() != EXPECTED_BYTES_SENT) ) {
+			std::cout << "FAILED registry sessions=" << registry.sessions()
+				<< " bytes_sent=" << registry.snapshot().bytes_sent.value() << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	/*
+	 * Test the registry keeps the totals of a finished session, and exports them
+	 */
+	if ( (registry.sessions() != 0) || (registry.sessions_total() != 1) ) {
+		std::cout << "FAILED expected the session removed, sessions=" << registry.sessions()
+			<< " sessions_total=" << registry.sessions_total() << std::endl;
+		return EX_SOFTWARE;
+	}
+	std::string text = registry.prometheus();
+	if (!contains(text, "verbit_streaming_sessions 0")
+		|| !contains(text, "verbit_streaming_sessions_total 1")
+		|| !contains(text, "verbit_streaming_media_bytes_sent_total 44346")
+		|| !contains(text, "verbit_streaming_media_send_errors_total 0")
+		|| !contains(text, "verbit_streaming_responses_total{type=\"captions\"} 2")
+		|| !contains(text, "verbit_streaming_response_handler_seconds_count 2")) {
+		return EX_SOFTWARE;
+	}
+	std::cout << "OK (2 tests)" << std::endl;
+	return EX_OK;
+}
@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metrics_registry_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MetricsRegistryTest);
+
+namespace {
+
+std::string test_path()
+{
+	return "/tmp/metrics_registry_test." + std::to_string(getpid());
+}
+
+std::string read_file(const std::string& path)
+{
+	std::ifstream in(path);
+	std::stringstream text;
+	text << in.rdbuf();
+	return text.str();
+}
+
+SessionMetrics some_metrics(uint64_t bytes)
+{
+	SessionMetrics metrics;
+	metrics.bytes_sent.add(bytes);
+	metrics.frames_sent.add(1);
+	metrics.send_latency.record(100);
+	metrics.responses[SessionMetrics::response_captions].add(2);
+	metrics.time_in_state[ServiceState::state_open] = std::chrono::seconds(1);
+	return metrics;
+}
+
+} // anonymous namespace
+
+void MetricsRegistryTest::tearDown()
+{
+	unlink(test_path().c_str());
+}
+
+void MetricsRegistryTest::test_counter()
+{
+	Counter counter;
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("initial", (uint64_t)0, counter.value());
+	counter.add();
+	counter.add(41);
+	Counter snapshot = counter;
+	counter.add();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("snapshot", (uint64_t)42, snapshot.value());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("counter", (uint64_t)43, counter.value());
+}
+
+void MetricsRegistryTest::test_merge()
+{
+	SessionMetrics total = some_metrics(1000);
+	total.merge(some_metrics(500));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("bytes_sent", (uint64_t)1500, total.bytes_sent.value());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("frames_sent", (uint64_t)2, total.frames_sent.value());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("send_latency count", (uint64_t)2, total.send_latency.count());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("captions", (uint64_t)4, total.responses[SessionMetrics::response_captions].value());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("transcript", (uint64_t)0, total.responses[SessionMetrics::response_transcript].value());
+	CPPUNIT_ASSERT_MESSAGE("time open", total.time_in_state[ServiceState::state_open] == std::chrono::seconds(2));
+}
+
+void MetricsRegistryTest::test_response_kind()
+{
+	StringRef type;
+	type.data = "transcript";
+	type.length = strlen(type.data);
+	CPPUNIT_ASSERT_MESSAGE("transcript", SessionMetrics::response_kind(type) == SessionMetrics::response_transcript);
+	type.data = "captions";
+	type.length = strlen(type.data);
+	CPPUNIT_ASSERT_MESSAGE("captions", SessionMetrics::response_kind(type) == SessionMetrics::response_captions);
+	type.length = 3;
+	CPPUNIT_ASSERT_MESSAGE("other", SessionMetrics::response_kind(type) == SessionMetrics::response_other);
+	CPPUNIT_ASSERT_MESSAGE("name", strcmp(SessionMetrics::response_kind_name(SessionMetrics::response_captions), "captions") == 0);
+}
+
+void MetricsRegistryTest::test_totals()
+{
+	MetricsRegistry registry;
+	SessionMetrics live;
+	uint64_t a = registry.add([&live]{ return live; });
+	uint64_t b = registry.add([]{ return some_metrics(100); });
+	live.bytes_sent.add(10);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("sessions", (size_t)2, registry.sessions());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("live total", (uint64_t)110, registry.snapshot().bytes_sent.value());
+
+	// a removed session's final metrics stay in the totals
+	live.bytes_sent.add(10);
+	registry.remove(a);
+	live.bytes_sent.add(1000);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("sessions after remove", (size_t)1, registry.sessions());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("total after remove", (uint64_t)120, registry.snapshot().bytes_sent.value());
+	registry.remove(b);
+	registry.remove(b);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("sessions after all removed", (size_t)0, registry.sessions());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("sessions_total", (uint64_t)2, registry.sessions_total());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("total after all removed", (uint64_t)120, registry.snapshot().bytes_sent.value());
+}
+
+void MetricsRegistryTest::test_prometheus()
+{
+	MetricsRegistry registry;
+	registry.add([]{ return some_metrics(1234); });
+	std::string text = registry.prometheus();
+	CPPUNIT_ASSERT_MESSAGE("sessions", text.find("\nverbit_streaming_sessions 1\n") != std::string::npos);
+	CPPUNIT_ASSERT_MESSAGE("bytes type", text.find("# TYPE verbit_streaming_media_bytes_sent_total counter\n") != std::string::npos);
+	CPPUNIT_ASSERT_MESSAGE("bytes", text.find("\nverbit_streaming_media_bytes_sent_total 1234\n") != std::string::npos);
+	CPPUNIT_ASSERT_MESSAGE("responses", text.find("\nverbit_streaming_responses_total{type=\"captions\"} 2\n") != std::string::npos);
+	CPPUNIT_ASSERT_MESSAGE("send p50", text.find("\nverbit_streaming_media_send_seconds{quantile=\"0.5\"} 0.0001\n") != std::string::npos);
+	CPPUNIT_ASSERT_MESSAGE("send count", text.find("\nverbit_streaming_media_send_seconds_count 1\n") != std::string::npos);
+	CPPUNIT_ASSERT_MESSAGE("state", text.find("\nverbit_streaming_state_seconds_total{state=\"open\"} 1\n") != std::string::npos);
+	CPPUNIT_ASSERT_MESSAGE("ends with newline", text[text.length() - 1] == '\n');
+}
+
+void MetricsRegistryTest::test_export_file()
+{
+	MetricsRegistry registry;
+	registry.add([]{ return some_metrics(1234); });
+	registry.write_prometheus(test_path());
+	CPPUNIT_ASSERT_MESSAGE("written", read_file(test_path()) == registry.prometheus());
+	unlink(test_path().c_str());
+
+	registry.export_file(test_path(), std::chrono::milliseconds(10));
+	std::string text;
+	for (int i = 0; (i < 200) && text.empty(); i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		text = read_file(test_path());
+	}
+	CPPUNIT_ASSERT_MESSAGE("exported", text.find("\nverbit_streaming_media_bytes_sent_total 1234\n") != std::string::npos);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("export errors", (uint64_t)0, registry.export_errors());
+	CPPUNIT_ASSERT_THROW_MESSAGE("unwritable", registry.write_prometheus("/nonexistent/metrics.prom"), std::runtime_error);
+}
+
+void MetricsRegistryTest::test_listen()
+{
+	MetricsRegistry registry;
+	registry.add([]{ return some_metrics(1234); });
+	registry.listen(test_path());
+	CPPUNIT_ASSERT_THROW_MESSAGE("listen twice", registry.listen(test_path()), std::runtime_error);
+
+	for (int n = 0; n < 2; n++) {
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, test_path().c_str(), sizeof(addr.sun_path) - 1);
+		CPPUNIT_ASSERT_MESSAGE("connect", connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+		std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+		CPPUNIT_ASSERT_MESSAGE("request", write(fd, request.data(), request.length()) == (ssize_t)request.length());
+		std::string response;
+		char buffer[1024];
+		ssize_t len;
+		while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+			response.append(buffer, len);
+		}
+		close(fd);
+		CPPUNIT_ASSERT_MESSAGE("status", response.compare(0, 17, "HTTP/1.0 200 OK\r\n") == 0);
+		CPPUNIT_ASSERT_MESSAGE("body", response.find("\r\n\r\n# HELP verbit_streaming_sessions ") != std::string::npos);
+		CPPUNIT_ASSERT_MESSAGE("metrics", response.find("\nverbit_streaming_media_bytes_sent_total 1234\n") != std::string::npos);
+	}
+}
@@ -0,0 +1,31 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/metrics_registry.h>
+
+/**
+ * Unit tests for `MetricsRegistry` class (and `SessionMetrics`).
+ */
+class MetricsRegistryTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MetricsRegistryTest);
+
+	CPPUNIT_TEST(test_counter);
+	CPPUNIT_TEST(test_merge);
+	CPPUNIT_TEST(test_response_kind);
+	CPPUNIT_TEST(test_totals);
+	CPPUNIT_TEST(test_prometheus);
+	CPPUNIT_TEST(test_export_file);
+	CPPUNIT_TEST(test_listen);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void tearDown();
+
+	void test_counter();
+	void test_merge();
+	void test_response_kind();
+	void test_totals();
+	void test_prometheus();
+	void test_export_file();
+	void test_listen();
+};
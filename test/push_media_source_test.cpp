@@ -0,0 +1,222 @@
+#include <iostream>
+#include <poll.h>
+#include <thread>
+#include <vector>
+
+#include "push_media_source_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PushMediaSourceTest);
+
+namespace {
+
+// bytes 0, 1, 2, ... starting from `first`
+std::string sequence(size_t first, size_t len)
+{
+	std::string s(len, '\0');
+	for (size_t i = 0; i < len; i++) {
+		s[i] = (char)(first + i);
+	}
+	return s;
+}
+
+bool readable(int fd)
+{
+	struct pollfd pfd = {fd, POLLIN, 0};
+	return ::poll(&pfd, 1, 0) == 1;
+}
+
+} // anonymous namespace
+
+void PushMediaSourceTest::test_ctor()
+{
+	PushMediaSource source {1000};
+	CPPUNIT_ASSERT_MESSAGE("ctor capacity", source.capacity() == 1024);
+	CPPUNIT_ASSERT_MESSAGE("ctor size", source.size() == 0);
+	CPPUNIT_ASSERT_MESSAGE("ctor event_fd", source.event_fd() >= 0);
+	CPPUNIT_ASSERT_MESSAGE("ctor not finished", !source.finished());
+	CPPUNIT_ASSERT_MESSAGE("ctor empty chunk", source.get_chunk().empty());
+	CPPUNIT_ASSERT_MESSAGE("ctor overflow_count", source.overflow_count() == 0);
+
+	PushMediaSource stereo {1024, PushMediaSource::drop_oldest, 6};
+	CPPUNIT_ASSERT_MESSAGE("ctor whole frames capacity", stereo.capacity() == 1020);
+
+	CPPUNIT_ASSERT_THROW_MESSAGE("ctor zero frame", PushMediaSource(1024, PushMediaSource::drop_oldest, 0), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("ctor tiny capacity", PushMediaSource(1, PushMediaSource::drop_oldest, 2), std::runtime_error);
+}
+
+void PushMediaSourceTest::test_heap()
+{
+	std::vector<std::unique_ptr<PushMediaSource>> sources;
+	for (int i = 0; i < 8; i++) {
+		sources.emplace_back(new PushMediaSource(1000));
+		CPPUNIT_ASSERT_MESSAGE("heap aligned", reinterpret_cast<uintptr_t>(sources.back().get()) % alignof(PushMediaSource) == 0);
+	}
+	CPPUNIT_ASSERT_MESSAGE("heap push", sources.back()->push("abcd", 4) == 4);
+	CPPUNIT_ASSERT_MESSAGE("heap get", sources.back()->get_chunk() == "abcd");
+}
+
+void PushMediaSourceTest::test_push_get()
+{
+	PushMediaSource source {64};
+	std::string data = sequence(0, 20);
+	CPPUNIT_ASSERT_MESSAGE("push_get accepted", source.push(data.data(), data.length()) == 20);
+	CPPUNIT_ASSERT_MESSAGE("push_get size", source.size() == 20);
+	CPPUNIT_ASSERT_MESSAGE("push_get chunk", source.get_chunk() == data);
+	CPPUNIT_ASSERT_MESSAGE("push_get drained", source.size() == 0);
+	CPPUNIT_ASSERT_MESSAGE("push_get empty", source.get_chunk().empty());
+}
+
+void PushMediaSourceTest::test_wrap()
+{
+	PushMediaSource source {64};
+	std::string received;
+	for (size_t i = 0; i < 10; i++) {
+		std::string data = sequence(i * 40, 40);
+		CPPUNIT_ASSERT_MESSAGE("wrap accepted", source.push(data.data(), data.length()) == 40);
+		received += source.get_chunk();
+	}
+	CPPUNIT_ASSERT_MESSAGE("wrap received", received == sequence(0, 400));
+}
+
+void PushMediaSourceTest::test_partial_frame()
+{
+	PushMediaSource source {64};
+	std::string data = sequence(0, 7);
+	CPPUNIT_ASSERT_MESSAGE("partial_frame accepted", source.push(data.data(), data.length()) == 6);
+	CPPUNIT_ASSERT_MESSAGE("partial_frame chunk", source.get_chunk() == sequence(0, 6));
+}
+
+void PushMediaSourceTest::test_max_chunk()
+{
+	PushMediaSource source {1024, PushMediaSource::drop_oldest, 2, 100};
+	std::string data = sequence(0, 250);
+	source.push(data.data(), data.length());
+	CPPUNIT_ASSERT_MESSAGE("max_chunk first", source.get_chunk() == sequence(0, 100));
+	CPPUNIT_ASSERT_MESSAGE("max_chunk second", source.get_chunk() == sequence(100, 100));
+	CPPUNIT_ASSERT_MESSAGE("max_chunk last", source.get_chunk() == sequence(200, 50));
+}
+
+void PushMediaSourceTest::test_drop_newest()
+{
+	PushMediaSource source {64, PushMediaSource::drop_newest};
+	std::string data = sequence(0, 48);
+	source.push(data.data(), data.length());
+	std::string more = sequence(48, 32);
+	CPPUNIT_ASSERT_MESSAGE("drop_newest accepted", source.push(more.data(), more.length()) == 16);
+	CPPUNIT_ASSERT_MESSAGE("drop_newest full accepted", source.push(more.data(), more.length()) == 0);
+	CPPUNIT_ASSERT_MESSAGE("drop_newest overflow_count", source.overflow_count() == 2);
+	CPPUNIT_ASSERT_MESSAGE("drop_newest dropped_bytes", source.dropped_bytes() == 48);
+	std::string received = source.get_chunk();
+	CPPUNIT_ASSERT_MESSAGE("drop_newest kept oldest", received == sequence(0, 64));
+}
+
+void PushMediaSourceTest::test_drop_oldest()
+{
+	PushMediaSource source {64, PushMediaSource::drop_oldest};
+	std::string data = sequence(0, 48);
+	source.push(data.data(), data.length());
+	std::string more = sequence(48, 32);
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest accepted", source.push(more.data(), more.length()) == 32);
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest overflow_count", source.overflow_count() == 1);
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest dropped_bytes", source.dropped_bytes() == 16);
+	CPPUNIT_ASSERT_MESSAGE("drop_oldest kept newest", source.get_chunk() == sequence(16, 64));
+}
+
+void PushMediaSourceTest::test_oversize_push()
+{
+	PushMediaSource oldest {64, PushMediaSource::drop_oldest};
+	std::string data = sequence(0, 100);
+	CPPUNIT_ASSERT_MESSAGE("oversize_push oldest accepted", oldest.push(data.data(), data.length()) == 64);
+	CPPUNIT_ASSERT_MESSAGE("oversize_push oldest kept newest", oldest.get_chunk() == sequence(36, 64));
+	CPPUNIT_ASSERT_MESSAGE("oversize_push oldest dropped_bytes", oldest.dropped_bytes() == 36);
+
+	PushMediaSource newest {64, PushMediaSource::drop_newest};
+	CPPUNIT_ASSERT_MESSAGE("oversize_push newest accepted", newest.push(data.data(), data.length()) == 64);
+	CPPUNIT_ASSERT_MESSAGE("oversize_push newest kept oldest", newest.get_chunk() == sequence(0, 64));
+	CPPUNIT_ASSERT_MESSAGE("oversize_push newest dropped_bytes", newest.dropped_bytes() == 36);
+}
+
+void PushMediaSourceTest::test_close()
+{
+	PushMediaSource source {64};
+	std::string data = sequence(0, 10);
+	source.push(data.data(), data.length());
+	source.close();
+	CPPUNIT_ASSERT_MESSAGE("close not finished while buffered", !source.finished());
+	CPPUNIT_ASSERT_MESSAGE("close push refused", source.push(data.data(), data.length()) == 0);
+	CPPUNIT_ASSERT_MESSAGE("close buffered chunk", source.get_chunk() == data);
+	CPPUNIT_ASSERT_MESSAGE("close finished", source.finished());
+}
+
+void PushMediaSourceTest::test_event_fd()
+{
+	PushMediaSource source {64};
+	int fd = source.event_fd();
+	CPPUNIT_ASSERT_MESSAGE("event_fd initially clear", !readable(fd));
+	std::string data = sequence(0, 10);
+	source.push(data.data(), data.length());
+	CPPUNIT_ASSERT_MESSAGE("event_fd readable after push", readable(fd));
+	source.push(data.data(), data.length());
+	source.get_chunk();
+	CPPUNIT_ASSERT_MESSAGE("event_fd readable until seen empty", readable(fd));
+	CPPUNIT_ASSERT_MESSAGE("event_fd empty chunk", source.get_chunk().empty());
+	CPPUNIT_ASSERT_MESSAGE("event_fd clear when empty", !readable(fd));
+	source.close();
+	CPPUNIT_ASSERT_MESSAGE("event_fd readable after close", readable(fd));
+	source.get_chunk();
+	CPPUNIT_ASSERT_MESSAGE("event_fd stays readable when closed", readable(fd));
+}
+
+void PushMediaSourceTest::test_block()
+{
+	PushMediaSource source {64, PushMediaSource::block};
+	std::string data = sequence(0, 200);
+	std::thread producer([&source, &data]() {
+		source.push(data.data(), data.length());
+		source.close();
+	});
+	std::string received;
+	while (!source.finished()) {
+		received += source.get_chunk();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	producer.join();
+	CPPUNIT_ASSERT_MESSAGE("block received all", received == data);
+	CPPUNIT_ASSERT_MESSAGE("block no overflow", source.overflow_count() == 0);
+}
+
+// producer and consumer on separate threads: whatever is received must be
+// whole runs of the sequence, in order, and nothing is lost without being counted
+void PushMediaSourceTest::test_threads()
+{
+	static const size_t FRAMES = 200000;
+	PushMediaSource source {256, PushMediaSource::drop_oldest, 4};
+	std::thread producer([&source]() {
+		for (uint32_t i = 0; i < FRAMES; i++) {
+			source.push(&i, sizeof(i));
+		}
+		source.close();
+	});
+	size_t received_frames = 0;
+	uint32_t last = 0;
+	bool in_order = true;
+	while (!source.finished()) {
+		struct pollfd pfd = {source.event_fd(), POLLIN, 0};
+		::poll(&pfd, 1, 100);
+		std::string chunk = source.get_chunk();
+		const uint32_t* frames = reinterpret_cast<const uint32_t*>(chunk.data());
+		for (size_t i = 0; i < chunk.length() / 4; i++) {
+			if (received_frames > 0 && frames[i] <= last) {
+				in_order = false;
+			}
+			last = frames[i];
+			received_frames++;
+		}
+	}
+	producer.join();
+	CPPUNIT_ASSERT_MESSAGE("threads in order", in_order);
+	CPPUNIT_ASSERT_MESSAGE("threads last frame", last == FRAMES - 1);
+	CPPUNIT_ASSERT_MESSAGE("threads accounted", received_frames * 4 + source.dropped_bytes() == FRAMES * 4);
+}
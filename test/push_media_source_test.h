@@ -0,0 +1,41 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/push_media_source.h>
+
+/**
+ * Unit tests for `PushMediaSource` class.
+ */
+class PushMediaSourceTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PushMediaSourceTest);
+
+	CPPUNIT_TEST(test_ctor);
+	CPPUNIT_TEST(test_heap);
+	CPPUNIT_TEST(test_push_get);
+	CPPUNIT_TEST(test_wrap);
+	CPPUNIT_TEST(test_partial_frame);
+	CPPUNIT_TEST(test_max_chunk);
+	CPPUNIT_TEST(test_drop_newest);
+	CPPUNIT_TEST(test_drop_oldest);
+	CPPUNIT_TEST(test_oversize_push);
+	CPPUNIT_TEST(test_close);
+	CPPUNIT_TEST(test_event_fd);
+	CPPUNIT_TEST(test_block);
+	CPPUNIT_TEST(test_threads);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_ctor();
+	void test_heap();
+	void test_push_get();
+	void test_wrap();
+	void test_partial_frame();
+	void test_max_chunk();
+	void test_drop_newest();
+	void test_drop_oldest();
+	void test_oversize_push();
+	void test_close();
+	void test_event_fd();
+	void test_block();
+	void test_threads();
+};
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <sysexits.h>
+
+#include <nlohmann/json.hpp>
+
+#include <verbit/streaming/push_media_source.h>
+#include <verbit/streaming/ws_streaming_client.h>
+
+#define TEST_WS_URL "wss://localhost:9002"
+
+// 1s of S16LE 16kHz mono, pushed in 20ms frames as a capture callback would
+#define PUSH_BYTES            640
+#define N_PUSHES              50
+#define EXPECTED_FINAL_TEXT   "I saw 32000 bytes. "
+std::string final_text;
+
+using namespace verbit::streaming;
+
+void on_response(WebSocketStreamingClient* client, nlohmann::json* response)
+{
+	auto is_eos = (*response)["response"]["is_end_of_stream"];
+	if (is_eos.get<bool>()) {
+		auto alternatives = (*response)["response"]["alternatives"];
+		final_text = alternatives[0]["transcript"].get<std::string>();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	WebSocketStreamingClient client {access_token};
+	client.ws_url(TEST_WS_URL);
+	client.verify_ssl_cert(false);
+	client.set_response_handler(&on_response);
+
+	PushMediaSource source {64000};
+	std::thread capture([&source]() {
+		std::string frames(PUSH_BYTES, '\x01');
+		for (int i = 0; i < N_PUSHES; i++) {
+			source.push(frames.data(), frames.length());
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		source.close();
+	});
+
+	bool ok = client.run_stream(source);
+	capture.join();
+	if (!ok) {
+		std::cout << "FAILED error " << client.error_code() << ": " << client.service_error() << std::endl;
+	} else if (source.overflow_count() != 0) {
+		std::cout << "FAILED expected no overflow, dropped_bytes=" << source.dropped_bytes() << std::endl;
+	} else if (client.bytes_sent() != PUSH_BYTES * N_PUSHES) {
+		std::cout << "FAILED expected bytes_sent=" << PUSH_BYTES * N_PUSHES << " actual bytes_sent=" << client.bytes_sent() << std::endl;
+	} else if (final_text != EXPECTED_FINAL_TEXT) {
+		std::cout << "FAILED expected final_text=\"" << EXPECTED_FINAL_TEXT << "\" actual final_text=\"" << final_text << "\"" << std::endl;
+	} else {
+		std::cout << "OK (3 tests)" << std::endl;
+		return EX_OK;
+	}
+	return EX_SOFTWARE;
+}
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "replay_ring_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ReplayRingTest);
+
+namespace {
+
+// bytes 0, 1, 2, ... starting from `first`
+std::string sequence(size_t first, size_t len)
+{
+	std::string s(len, '\0');
+	for (size_t i = 0; i < len; i++) {
+		s[i] = (char)(first + i);
+	}
+	return s;
+}
+
+std::string copy_out(const ReplayRing& ring, uint64_t offset, size_t len)
+{
+	std::string s(len, '\0');
+	s.resize(ring.copy(offset, &s[0], len));
+	return s;
+}
+
+} // anonymous namespace
+
+void ReplayRingTest::test_ctor()
+{
+	ReplayRing ring {101, 2};
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("capacity in whole frames", (size_t)100, ring.capacity());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("empty", (size_t)0, ring.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("begin_offset", (uint64_t)0, ring.begin_offset());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("end_offset", (uint64_t)0, ring.end_offset());
+}
+
+void ReplayRingTest::test_ctor_too_small()
+{
+	CPPUNIT_ASSERT_THROW_MESSAGE("less than one frame", ReplayRing(1, 2), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("zero frame size", ReplayRing(100, 0), std::runtime_error);
+}
+
+void ReplayRingTest::test_append_copy()
+{
+	ReplayRing ring {100};
+	std::string media = sequence(0, 40);
+	ring.append(media.data(), media.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("size", (size_t)40, ring.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("end_offset", (uint64_t)40, ring.end_offset());
+	CPPUNIT_ASSERT_MESSAGE("copy all", copy_out(ring, 0, 100) == media);
+	CPPUNIT_ASSERT_MESSAGE("copy from offset", copy_out(ring, 10, 20) == sequence(10, 20));
+}
+
+void ReplayRingTest::test_wrap()
+{
+	ReplayRing ring {100};
+	std::string media = sequence(0, 250);
+	for (size_t i = 0; i < media.size(); i += 30) {
+		ring.append(media.data() + i, std::min((size_t)30, media.size() - i));
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("size", (size_t)100, ring.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("begin_offset", (uint64_t)150, ring.begin_offset());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("end_offset", (uint64_t)250, ring.end_offset());
+	CPPUNIT_ASSERT_MESSAGE("copy across the wrap", copy_out(ring, 150, 100) == sequence(150, 100));
+	CPPUNIT_ASSERT_MESSAGE("copy the tail", copy_out(ring, 240, 100) == sequence(240, 10));
+}
+
+void ReplayRingTest::test_oversize_append()
+{
+	ReplayRing ring {100};
+	ring.append("ab", 2);
+	std::string media = sequence(0, 230);
+	ring.append(media.data(), media.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("end_offset", (uint64_t)232, ring.end_offset());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("begin_offset", (uint64_t)132, ring.begin_offset());
+	CPPUNIT_ASSERT_MESSAGE("newest media held", copy_out(ring, 132, 100) == sequence(130, 100));
+}
+
+void ReplayRingTest::test_copy_not_held()
+{
+	ReplayRing ring {100};
+	std::string media = sequence(0, 150);
+	ring.append(media.data(), media.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("overwritten", (size_t)0, copy_out(ring, 49, 10).size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("not yet appended", (size_t)0, copy_out(ring, 150, 10).size());
+}
@@ -0,0 +1,27 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/replay_ring.h>
+
+/**
+ * Unit tests for `ReplayRing` class.
+ */
+class ReplayRingTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ReplayRingTest);
+
+	CPPUNIT_TEST(test_ctor);
+	CPPUNIT_TEST(test_ctor_too_small);
+	CPPUNIT_TEST(test_append_copy);
+	CPPUNIT_TEST(test_wrap);
+	CPPUNIT_TEST(test_oversize_append);
+	CPPUNIT_TEST(test_copy_not_held);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_ctor();
+	void test_ctor_too_small();
+	void test_append_copy();
+	void test_wrap();
+	void test_oversize_append();
+	void test_copy_not_held();
+};
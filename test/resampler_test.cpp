@@ -0,0 +1,221 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "resampler_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ResamplerTest);
+
+namespace {
+
+// `seconds` of a sine wave at `frequency`, half full scale
+std::vector<int16_t> tone(int rate, double frequency, double seconds)
+{
+	std::vector<int16_t> samples((size_t)(rate * seconds));
+	for (size_t i = 0; i < samples.size(); i++) {
+		samples[i] = (int16_t)lrint(16384 * std::sin(2 * M_PI * frequency * i / rate));
+	}
+	return samples;
+}
+
+// resample all of `in` in chunks of `chunk` frames, and flush
+std::vector<int16_t> resample(Resampler& resampler, const std::vector<int16_t>& in, size_t chunk)
+{
+	const size_t channels = resampler.channels();
+	const size_t frames = in.size() / channels;
+	std::vector<int16_t> out;
+	std::vector<int16_t> buffer(resampler.max_output(std::max(chunk, (size_t)resampler.latency())) * channels);
+	for (size_t done = 0; done < frames; ) {
+		size_t n = std::min(chunk, frames - done);
+		size_t written = resampler.process(&in[done * channels], n, buffer.data());
+		out.insert(out.end(), buffer.begin(), buffer.begin() + written * channels);
+		done += n;
+	}
+	size_t written = resampler.flush(buffer.data());
+	out.insert(out.end(), buffer.begin(), buffer.begin() + written * channels);
+	return out;
+}
+
+// the signal-to-noise ratio of resampled output against the ideal sine, in dB
+// (away from the ends, where the filter sees the silence before and after)
+double snr(const std::vector<int16_t>& out, int rate, double frequency, size_t skip)
+{
+	double signal = 0.0;
+	double noise = 0.0;
+	for (size_t i = skip; i + skip < out.size(); i++) {
+		double expected = 16384 * std::sin(2 * M_PI * frequency * i / rate);
+		signal += expected * expected;
+		noise += (out[i] - expected) * (out[i] - expected);
+	}
+	return 10 * std::log10(signal / noise);
+}
+
+// a media generator returning a fixed chunk sequence
+class ChunksMediaGenerator : public MediaGenerator
+{
+public:
+	ChunksMediaGenerator(const std::vector<std::string>& chunks) : _chunks(chunks) { }
+	bool read_chunk(ChunkBuffer& chunk)
+	{
+		if (_next < _chunks.size()) {
+			chunk.append(_chunks[_next].data(), _chunks[_next].length());
+			_next++;
+		}
+		return true;
+	}
+	const std::string get_chunk() { return read_chunk_string(); }
+	bool finished() { return _next == _chunks.size(); }
+private:
+	std::vector<std::string> _chunks;
+	size_t _next = 0;
+};
+
+} // anonymous namespace
+
+void ResamplerTest::test_ratios()
+{
+	Resampler down3 {48000, 16000};
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("48k phases", 1, down3.phases());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("48k taps", 144, down3.taps());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("48k latency", 72, down3.latency());
+	Resampler cd {44100, 16000};
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("44.1k phases", 160, cd.phases());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("44.1k taps", 136, cd.taps());
+	Resampler up2 {8000, 16000};
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("8k phases", 2, up2.phases());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("8k taps", 48, up2.taps());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("8k latency", 24, up2.latency());
+}
+
+void ResamplerTest::test_passthrough()
+{
+	Resampler same {16000, 16000, 2};
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("no latency", 0, same.latency());
+	std::vector<int16_t> in = tone(16000, 1000, 0.1);
+	std::vector<int16_t> out = resample(same, in, 100);
+	CPPUNIT_ASSERT_MESSAGE("copied", in == out);
+}
+
+void ResamplerTest::test_snr()
+{
+	const int rates[] = {48000, 44100, 32000, 22050, 11025, 8000};
+	for (int rate : rates) {
+		for (double frequency : {440.0, 1000.0, 3000.0}) {
+			Resampler resampler {rate, 16000};
+			std::vector<int16_t> out = resample(resampler, tone(rate, frequency, 1.0), 1234);
+			std::string message = std::to_string(rate) + "Hz, " + std::to_string((int)frequency) + "Hz tone";
+			CPPUNIT_ASSERT_EQUAL_MESSAGE(message + " length", (size_t)16000, out.size());
+			double db = snr(out, 16000, frequency, 200);
+			CPPUNIT_ASSERT_MESSAGE(message + " SNR " + std::to_string(db), db > 75.0);
+		}
+	}
+	// downsampling too
+	Resampler resampler {16000, 8000};
+	std::vector<int16_t> out = resample(resampler, tone(16000, 1000, 1.0), 320);
+	CPPUNIT_ASSERT_MESSAGE("16k to 8k SNR", snr(out, 8000, 1000, 100) > 75.0);
+}
+
+void ResamplerTest::test_stopband()
+{
+	// tones between the output's Nyquist frequency and the input's are filtered out, not aliased
+	for (double frequency : {8000.0, 10000.0, 15000.0, 23000.0}) {
+		Resampler resampler {48000, 16000};
+		std::vector<int16_t> out = resample(resampler, tone(48000, frequency, 0.5), 960);
+		double energy = 0.0;
+		for (size_t i = 200; i + 200 < out.size(); i++) {
+			energy += (double)out[i] * out[i];
+		}
+		double db = 10 * std::log10(energy / (out.size() - 400) / (16384.0 * 16384.0 / 2) + 1e-12);
+		CPPUNIT_ASSERT_MESSAGE(std::to_string((int)frequency) + "Hz attenuated " + std::to_string(db) + "dB",
+			db < -70.0);
+	}
+}
+
+void ResamplerTest::test_chunks()
+{
+	// the output does not depend on how the input was split
+	std::vector<int16_t> in = tone(44100, 1000, 0.5);
+	for (size_t i = 0; i < in.size(); i += 2) {
+		in[i] = (int16_t)(in[i] + (i * 7919) % 2001 - 1000);
+	}
+	Resampler resampler {44100, 16000, 2};
+	std::vector<int16_t> whole = resample(resampler, in, in.size());
+	for (size_t chunk : {1, 7, 255, 256, 257, 4410}) {
+		CPPUNIT_ASSERT_MESSAGE("chunks of " + std::to_string(chunk), resample(resampler, in, chunk) == whole);
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("stereo length", (size_t)4000 * 2, whole.size());
+}
+
+void ResamplerTest::test_isas()
+{
+	// the SIMD kernels sum in a different order (and with fused multiply-adds), so may round differently
+	const SampleConverter::Isa isas[] = { SampleConverter::isa_sse2, SampleConverter::isa_avx2 };
+	std::vector<int16_t> in = tone(48000, 1000, 0.25);
+	for (size_t i = 0; i < in.size(); i++) {
+		in[i] = (int16_t)(in[i] + (i * 7919) % 20001 - 10000);
+	}
+	Resampler scalar {48000, 16000, 1, WSSC_RESAMPLER_TAPS, SampleConverter::isa_scalar};
+	std::vector<int16_t> expected = resample(scalar, in, 480);
+	for (SampleConverter::Isa isa : isas) {
+		if (!SampleConverter::supported(isa)) {
+			continue;
+		}
+		Resampler resampler {48000, 16000, 1, WSSC_RESAMPLER_TAPS, isa};
+		std::vector<int16_t> out = resample(resampler, in, 480);
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("length", expected.size(), out.size());
+		for (size_t i = 0; i < out.size(); i++) {
+			CPPUNIT_ASSERT_MESSAGE(std::string(SampleConverter::isa_name(isa)) + " sample " + std::to_string(i),
+				std::abs(out[i] - expected[i]) <= 1);
+		}
+	}
+}
+
+void ResamplerTest::test_invalid()
+{
+	CPPUNIT_ASSERT_THROW_MESSAGE("no rate", Resampler(0, 16000), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("no channels", Resampler(48000, 16000, 0), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("too few taps", Resampler(48000, 16000, 1, 4), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("too many phases", Resampler(16001, 16000), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("too far down", Resampler(1280000, 16000), std::runtime_error);
+}
+
+void ResamplerTest::test_generator()
+{
+	// S16LE stereo at 48kHz, split into chunks at arbitrary bytes
+	std::vector<int16_t> samples = tone(48000, 440, 1.0);
+	std::vector<int16_t> stereo;
+	for (int16_t sample : samples) {
+		stereo.push_back(sample);
+		stereo.push_back((int16_t)-sample);
+	}
+	std::string media(reinterpret_cast<const char*>(stereo.data()), stereo.size() * 2);
+	std::vector<std::string> chunks;
+	for (size_t pos = 0, len = 1; pos < media.length(); pos += len, len = len * 3 % 4093 + 1) {
+		chunks.push_back(media.substr(pos, len));
+	}
+
+	ChunksMediaGenerator source {chunks};
+	ResamplingMediaGenerator generator {source, 48000, 16000, 2};
+	MediaConfig config = generator.media_config();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("config rate", 16000, config.sample_rate);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("config channels", 2, config.num_channels);
+
+	std::string resampled;
+	while (!generator.finished()) {
+		std::string storage;
+		ChunkBuffer chunk(storage);
+		CPPUNIT_ASSERT_MESSAGE("read", generator.read_chunk(chunk));
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("whole frames", (size_t)0, chunk.size() % 4);
+		resampled.append(chunk.data(), chunk.size());
+	}
+
+	Resampler resampler {48000, 16000, 2};
+	std::vector<int16_t> expected = resample(resampler, stereo, stereo.size() / 2);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("resampled size", expected.size() * 2, resampled.size());
+	CPPUNIT_ASSERT_MESSAGE("resampled media", memcmp(resampled.data(), expected.data(), resampled.size()) == 0);
+}
@@ -0,0 +1,31 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/resampler.h>
+
+/**
+ * Unit tests for `Resampler` and `ResamplingMediaGenerator` classes.
+ */
+class ResamplerTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ResamplerTest);
+
+	CPPUNIT_TEST(test_ratios);
+	CPPUNIT_TEST(test_passthrough);
+	CPPUNIT_TEST(test_snr);
+	CPPUNIT_TEST(test_stopband);
+	CPPUNIT_TEST(test_chunks);
+	CPPUNIT_TEST(test_isas);
+	CPPUNIT_TEST(test_invalid);
+	CPPUNIT_TEST(test_generator);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_ratios();
+	void test_passthrough();
+	void test_snr();
+	void test_stopband();
+	void test_chunks();
+	void test_isas();
+	void test_invalid();
+	void test_generator();
+};
@@ -0,0 +1,186 @@
+#include <iostream>
+
+#include "response_parser_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ResponseParserTest);
+
+// a captions response, as sent by the test server
+static const std::string CAPTIONS_JSON = "{\"response\":{"
+	"\"id\":\"7b1f0d5e-2f7a-4c52-9d55-3a1e7f6f0c11\","
+	"\"type\":\"captions\","
+	"\"service_type\":\"transcription\","
+	"\"language_code\":\"en-US\","
+	"\"is_final\":true,\"is_end_of_stream\":false,"
+	"\"speakers\":["
+	"{\"id\":\"c6eb6f2b-f85b-478f-af8a-a21b00000001\",\"label\":\"First Host\"},"
+	"{\"id\":\"c6eb6f2b-f85b-478f-af8a-a21b00000002\",\"label\":\"Second Host\"}],"
+	"\"alternatives\":[{"
+	"\"transcript\":\"I've seen 3200 bytes . \","
+	"\"items\":["
+	"{\"kind\":\"text\",\"value\":\"I've\",\"speaker_id\":\"c6eb6f2b-f85b-478f-af8a-a21b00000001\",\"start\":0.100,\"end\":0.107},"
+	"{\"kind\":\"text\",\"value\":\"seen\",\"speaker_id\":\"c6eb6f2b-f85b-478f-af8a-a21b00000001\",\"start\":0.120,\"end\":0.127},"
+	"{\"kind\":\"text\",\"value\":\"3200\",\"speaker_id\":\"c6eb6f2b-f85b-478f-af8a-a21b00000001\",\"start\":0.140,\"end\":0.147},"
+	"{\"kind\":\"text\",\"value\":\"bytes\",\"speaker_id\":\"c6eb6f2b-f85b-478f-af8a-a21b00000001\",\"start\":0.160,\"end\":0.167},"
+	"{\"kind\":\"punct\",\"value\":\".\",\"speaker_id\":\"c6eb6f2b-f85b-478f-af8a-a21b00000001\",\"start\":0.180,\"end\":0.187}"
+	"]}]}}";
+
+void ResponseParserTest::test_captions()
+{
+	ResponseParser parser;
+	const Response& response = parser.parse(CAPTIONS_JSON);
+	CPPUNIT_ASSERT_MESSAGE("has response", response.has_response);
+	CPPUNIT_ASSERT_MESSAGE("id", response.id == "7b1f0d5e-2f7a-4c52-9d55-3a1e7f6f0c11");
+	CPPUNIT_ASSERT_MESSAGE("type", response.type == "captions");
+	CPPUNIT_ASSERT_MESSAGE("service_type", response.service_type == "transcription");
+	CPPUNIT_ASSERT_MESSAGE("language_code", response.language_code == "en-US");
+	CPPUNIT_ASSERT_MESSAGE("is_final", response.is_final);
+	CPPUNIT_ASSERT_MESSAGE("is_end_of_stream", !response.is_end_of_stream);
+
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("speakers", (size_t)2, response.speakers.size());
+	CPPUNIT_ASSERT_MESSAGE("speaker id", response.speakers[1].id == "c6eb6f2b-f85b-478f-af8a-a21b00000002");
+	CPPUNIT_ASSERT_MESSAGE("speaker label", response.speakers[1].label == "Second Host");
+
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("alternatives", (size_t)1, response.alternatives.size());
+	const Alternative& alternative = response.alternatives[0];
+	CPPUNIT_ASSERT_MESSAGE("transcript", alternative.transcript == "I've seen 3200 bytes . ");
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("items", (size_t)5, alternative.items.size());
+	CPPUNIT_ASSERT_MESSAGE("item kind", alternative.items[0].kind == "text");
+	CPPUNIT_ASSERT_MESSAGE("item value", alternative.items[2].value == "3200");
+	CPPUNIT_ASSERT_MESSAGE("item speaker_id", alternative.items[2].speaker_id == "c6eb6f2b-f85b-478f-af8a-a21b00000001");
+	CPPUNIT_ASSERT_MESSAGE("last item kind", alternative.items.back().kind == "punct");
+	CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("item start", 0.140, alternative.items[2].start, 1e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("last item end", 0.187, alternative.items.back().end, 1e-9);
+
+	std::string words;
+	for (const Item& item : alternative.items) {
+		words += item.value.str();
+	}
+	CPPUNIT_ASSERT_MESSAGE("item iteration", words == "I'veseen3200bytes.");
+}
+
+void ResponseParserTest::test_int_speaker_id()
+{
+	ResponseParser parser;
+	const Response& response = parser.parse("{\"response\":{"
+		"\"speakers\":[{\"id\":0,\"label\":\"\"}],"
+		"\"alternatives\":[{\"items\":[{\"kind\":\"text\",\"value\":\"hi\",\"speaker_id\":12,\"start\":1,\"end\":2}]}]}}");
+	CPPUNIT_ASSERT_MESSAGE("int speaker id", response.speakers[0].id == "0");
+	CPPUNIT_ASSERT_MESSAGE("empty speaker label", response.speakers[0].label.empty());
+	const Item& item = response.alternatives[0].items[0];
+	CPPUNIT_ASSERT_MESSAGE("int item speaker_id", item.speaker_id == "12");
+	CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("int item start", 1.0, item.start, 1e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL_MESSAGE("int item end", 2.0, item.end, 1e-9);
+}
+
+void ResponseParserTest::test_alternatives()
+{
+	ResponseParser parser;
+	const Response& response = parser.parse("{\"response\":{\"alternatives\":["
+		"{\"transcript\":\"a b\",\"items\":[{\"value\":\"a\"},{\"value\":\"b\"}]},"
+		"{\"transcript\":\"\",\"items\":[]},"
+		"{\"transcript\":\"c\",\"items\":[{\"value\":\"c\"}]}]}}");
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("alternatives", (size_t)3, response.alternatives.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("first items", (size_t)2, response.alternatives[0].items.size());
+	CPPUNIT_ASSERT_MESSAGE("first items value", response.alternatives[0].items[1].value == "b");
+	CPPUNIT_ASSERT_MESSAGE("second items", response.alternatives[1].items.empty());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("third items", (size_t)1, response.alternatives[2].items.size());
+	CPPUNIT_ASSERT_MESSAGE("third items value", response.alternatives[2].items[0].value == "c");
+}
+
+void ResponseParserTest::test_escapes()
+{
+	ResponseParser parser;
+	const Response& response = parser.parse("{\"response\":{\"alternatives\":["
+		"{\"transcript\":\"say \\\"caf\\u00e9\\\"\\n\",\"items\":[]}]}}");
+	CPPUNIT_ASSERT_MESSAGE("unescaped transcript", response.alternatives[0].transcript == "say \"caf\xc3\xa9\"\n");
+}
+
+void ResponseParserTest::test_skip_unknown()
+{
+	ResponseParser parser;
+	const Response& response = parser.parse("{\"extra\":{\"response\":{\"id\":\"wrong\"}},"
+		"\"response\":{\"meta\":{\"id\":\"nested\",\"list\":[[1,2],{\"type\":\"x\"}]},"
+		"\"id\":\"right\",\"confidence\":0.9,\"is_final\":null,"
+		"\"alternatives\":[{\"extra\":[{\"value\":\"no\"}],\"items\":[{\"value\":\"yes\",\"confidence\":0.5}]}]}}");
+	CPPUNIT_ASSERT_MESSAGE("id not from unknown elements", response.id == "right");
+	CPPUNIT_ASSERT_MESSAGE("type not from unknown elements", response.type.empty());
+	CPPUNIT_ASSERT_MESSAGE("null is_final", !response.is_final);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("items not from unknown elements", (size_t)1, response.alternatives[0].items.size());
+	CPPUNIT_ASSERT_MESSAGE("item value", response.alternatives[0].items[0].value == "yes");
+}
+
+void ResponseParserTest::test_no_response()
+{
+	ResponseParser parser;
+	const Response& response = parser.parse("{\"error\":\"bad things\"}");
+	CPPUNIT_ASSERT_MESSAGE("no response", !response.has_response);
+	CPPUNIT_ASSERT_MESSAGE("no alternatives", response.alternatives.empty());
+}
+
+void ResponseParserTest::test_reuse()
+{
+	ResponseParser parser;
+	parser.parse(CAPTIONS_JSON);
+	const Response& response = parser.parse("{\"response\":{\"type\":\"transcript\",\"is_end_of_stream\":true}}");
+	CPPUNIT_ASSERT_MESSAGE("second type", response.type == "transcript");
+	CPPUNIT_ASSERT_MESSAGE("second is_end_of_stream", response.is_end_of_stream);
+	CPPUNIT_ASSERT_MESSAGE("second id cleared", response.id.empty());
+	CPPUNIT_ASSERT_MESSAGE("second is_final cleared", !response.is_final);
+	CPPUNIT_ASSERT_MESSAGE("second speakers cleared", response.speakers.empty());
+	CPPUNIT_ASSERT_MESSAGE("second alternatives cleared", response.alternatives.empty());
+
+	// parse the first message again, into memory already grown to fit it
+	const Response& again = parser.parse(CAPTIONS_JSON);
+	CPPUNIT_ASSERT_MESSAGE("reparsed transcript", again.alternatives[0].transcript == "I've seen 3200 bytes . ");
+	CPPUNIT_ASSERT_MESSAGE("reparsed speaker label", again.speakers[0].label == "First Host");
+	CPPUNIT_ASSERT_MESSAGE("response()", &parser.response() == &again);
+}
+
+void ResponseParserTest::test_invalid()
+{
+	ResponseParser parser;
+	CPPUNIT_ASSERT_THROW_MESSAGE("truncated message", parser.parse("{\"response\":{\"id\":\"x\""), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("empty message", parser.parse(""), std::runtime_error);
+}
+
+void ResponseParserTest::test_scan()
+{
+	Response response;
+	ResponseParser::scan(CAPTIONS_JSON, response);
+	ResponseParser parser;
+	const Response& parsed = parser.parse(CAPTIONS_JSON);
+	CPPUNIT_ASSERT_MESSAGE("scan has_response", response.has_response);
+	CPPUNIT_ASSERT_MESSAGE("scan id", response.id == "7b1f0d5e-2f7a-4c52-9d55-3a1e7f6f0c11");
+	CPPUNIT_ASSERT_MESSAGE("scan type", response.type == "captions");
+	CPPUNIT_ASSERT_MESSAGE("scan is_final", response.is_final == parsed.is_final);
+	CPPUNIT_ASSERT_MESSAGE("scan is_end_of_stream", !response.is_end_of_stream);
+	CPPUNIT_ASSERT_MESSAGE("scan no alternatives", response.alternatives.empty());
+
+	ResponseParser::scan("{\"response\" : {\"type\" :\n\"transcript\", \"is_end_of_stream\" : true}}", response);
+	CPPUNIT_ASSERT_MESSAGE("scan spaced type", response.type == "transcript");
+	CPPUNIT_ASSERT_MESSAGE("scan spaced is_end_of_stream", response.is_end_of_stream);
+	CPPUNIT_ASSERT_MESSAGE("scan missing id", response.id.empty());
+
+	ResponseParser::scan("{\"error\":\"bad things\"}", response);
+	CPPUNIT_ASSERT_MESSAGE("scan no response", !response.has_response);
+	ResponseParser::scan("not JSON", response);
+	CPPUNIT_ASSERT_MESSAGE("scan not JSON", !response.has_response);
+}
+
+void ResponseParserTest::test_scan_nested()
+{
+	// keys of nested objects, or inside strings, are not the response's
+	Response response;
+	ResponseParser::scan("{\"id\":\"outer\",\"response\":{\"speakers\":[{\"id\":\"speaker\"}],"
+		"\"alternatives\":[{\"transcript\":\"\\\"is_final\\\":true\"}],"
+		"\"id\":\"utterance\",\"is_final\":false}}", response);
+	CPPUNIT_ASSERT_MESSAGE("nested has_response", response.has_response);
+	CPPUNIT_ASSERT_MESSAGE("nested id", response.id == "utterance");
+	CPPUNIT_ASSERT_MESSAGE("nested is_final", !response.is_final);
+
+	ResponseParser::scan("{\"response\":null,\"other\":{\"is_final\":true}}", response);
+	CPPUNIT_ASSERT_MESSAGE("null response", !response.has_response);
+	CPPUNIT_ASSERT_MESSAGE("null response is_final", !response.is_final);
+}
@@ -0,0 +1,35 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/response_parser.h>
+
+/**
+ * Unit tests for `ResponseParser` class.
+ */
+class ResponseParserTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ResponseParserTest);
+
+	CPPUNIT_TEST(test_captions);
+	CPPUNIT_TEST(test_int_speaker_id);
+	CPPUNIT_TEST(test_alternatives);
+	CPPUNIT_TEST(test_escapes);
+	CPPUNIT_TEST(test_skip_unknown);
+	CPPUNIT_TEST(test_no_response);
+	CPPUNIT_TEST(test_reuse);
+	CPPUNIT_TEST(test_invalid);
+	CPPUNIT_TEST(test_scan);
+	CPPUNIT_TEST(test_scan_nested);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_captions();
+	void test_int_speaker_id();
+	void test_alternatives();
+	void test_escapes();
+	void test_skip_unknown();
+	void test_no_response();
+	void test_reuse();
+	void test_invalid();
+	void test_scan();
+	void test_scan_nested();
+};
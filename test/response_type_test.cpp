@@ -1,3 +1,4 @@
+#include <cstring>
 #include <iostream>
 
 #include "response_type_test.h"
@@ -77,3 +78,77 @@ void ResponseTypeTest::test_eos()
 	rt.record_eos(response);
 	CPPUNIT_ASSERT_MESSAGE("eos (all EOS received)", rt.is_eos() == true);
 }
+
+static StringRef _ref(const char* s)
+{
+	StringRef ref;
+	ref.data = s;
+	ref.length = strlen(s);
+	return ref;
+}
+
+void ResponseTypeTest::test_eos_typed()
+{
+	ResponseType rt = ResponseType(ResponseType::Transcript | ResponseType::Captions);
+	Response response;
+	response.type = _ref("captions");
+	rt.record_eos(response);
+	CPPUNIT_ASSERT_MESSAGE("typed eos (non-EOS received)", rt.is_eos() == false);
+	response.type = _ref("transcript");
+	response.is_end_of_stream = true;
+	rt.record_eos(response);
+	CPPUNIT_ASSERT_MESSAGE("typed eos (only transcript EOS received)", rt.is_eos() == false);
+	response.type = _ref("captions");
+	rt.record_eos(response);
+	CPPUNIT_ASSERT_MESSAGE("typed eos (all EOS received)", rt.is_eos() == true);
+
+	// an unknown type is not an error (the I/O thread must not throw), nor end-of-stream
+	rt = ResponseType(ResponseType::Captions);
+	response.type = _ref("gibberish");
+	CPPUNIT_ASSERT_NO_THROW_MESSAGE("typed eos with unknown type", rt.record_eos(response));
+	CPPUNIT_ASSERT_MESSAGE("typed eos (unknown type)", rt.is_eos() == false);
+}
+
+void ResponseTypeTest::test_scan_eos()
+{
+	ResponseType rt = ResponseType(ResponseType::Transcript | ResponseType::Captions);
+	rt.scan_eos("{\"response\":{\"type\":\"captions\",\"is_end_of_stream\":false}}");
+	CPPUNIT_ASSERT_MESSAGE("scan eos (non-EOS received)", rt.is_eos() == false);
+	rt.scan_eos("{\"response\":{\"is_end_of_stream\" : true, \"type\" :\n\"transcript\"}}");
+	CPPUNIT_ASSERT_MESSAGE("scan eos (only transcript EOS received)", rt.is_eos() == false);
+	rt.scan_eos("{\"response\":{\"is_end_of_stream\":true}}");
+	CPPUNIT_ASSERT_MESSAGE("scan eos (EOS received with no type)", rt.is_eos() == false);
+	rt.scan_eos("not JSON at all");
+	CPPUNIT_ASSERT_MESSAGE("scan eos (not JSON)", rt.is_eos() == false);
+	rt.scan_eos("{\"response\":{\"type\":\"captions\",\"is_end_of_stream\":true}}");
+	CPPUNIT_ASSERT_MESSAGE("scan eos (all EOS received)", rt.is_eos() == true);
+
+	rt = ResponseType(ResponseType::Captions);
+	CPPUNIT_ASSERT_NO_THROW_MESSAGE("scan eos with unknown type",
+		rt.scan_eos("{\"response\":{\"type\":\"gibberish\",\"is_end_of_stream\":true}}"));
+	CPPUNIT_ASSERT_MESSAGE("scan eos (unknown type)", rt.is_eos() == false);
+}
+
+void ResponseTypeTest::test_scan_eos_escaped()
+{
+	ResponseType rt = ResponseType(ResponseType::Captions);
+	// key-like text inside a string value is not a key
+	rt.scan_eos("{\"response\":{\"type\":\"captions\",\"alternatives\":[{\"transcript\":"
+		"\"say \\\"is_end_of_stream\\\":true\"}],\"is_end_of_stream\":false}}");
+	CPPUNIT_ASSERT_MESSAGE("scan eos (escaped key in string)", rt.is_eos() == false);
+	rt.scan_eos("{\"response\":{\"id\":\"ends with a backslash \\\\\",\"is_end_of_stream\":true,\"type\":\"captions\"}}");
+	CPPUNIT_ASSERT_MESSAGE("scan eos (key after escaped backslash)", rt.is_eos() == true);
+}
+
+void ResponseTypeTest::test_scan_eos_nested()
+{
+	ResponseType rt = ResponseType(ResponseType::Captions);
+	// only the keys of the response object count, not those of objects nested in it
+	rt.scan_eos("{\"response\":{\"alternatives\":[{\"type\":\"captions\",\"is_end_of_stream\":true}],"
+		"\"type\":\"captions\",\"is_end_of_stream\":false}}");
+	CPPUNIT_ASSERT_MESSAGE("scan eos (nested keys)", rt.is_eos() == false);
+	rt.scan_eos("{\"meta\":{\"type\":\"captions\",\"is_end_of_stream\":true},\"response\":{\"type\":\"captions\"}}");
+	CPPUNIT_ASSERT_MESSAGE("scan eos (keys outside the response)", rt.is_eos() == false);
+	rt.scan_eos("{\"response\":{\"alternatives\":[{\"is_end_of_stream\":false}],\"type\":\"captions\",\"is_end_of_stream\":true}}");
+	CPPUNIT_ASSERT_MESSAGE("scan eos (after nested keys)", rt.is_eos() == true);
+}
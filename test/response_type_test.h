@@ -17,6 +17,10 @@ class ResponseTypeTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(test_to_string_invalid);
 	CPPUNIT_TEST(test_url_params);
 	CPPUNIT_TEST(test_eos);
+	CPPUNIT_TEST(test_eos_typed);
+	CPPUNIT_TEST(test_scan_eos);
+	CPPUNIT_TEST(test_scan_eos_escaped);
+	CPPUNIT_TEST(test_scan_eos_nested);
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -30,4 +34,8 @@ public:
 	void test_to_string_invalid();
 	void test_url_params();
 	void test_eos();
+	void test_eos_typed();
+	void test_scan_eos();
+	void test_scan_eos_escaped();
+	void test_scan_eos_nested();
 };
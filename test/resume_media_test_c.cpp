@@ -0,0 +1,171 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <sysexits.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include <verbit/streaming/metrics_registry.h>
+#include <verbit/streaming/push_media_source.h>
+#include <verbit/streaming/ws_streaming_client.h>
+
+// the test server drops each connection with this query once, after 68000 bytes
+#define TEST_WS_URL "wss://localhost:9002?drop_after=68000&drop_id="
+
+#define CHUNK_BYTES  3200
+#define N_CHUNKS     50
+#define TOTAL_BYTES  (CHUNK_BYTES * N_CHUNKS)
+#define CHUNK_MS     40
+#define DROP_AFTER   68000
+
+// The test server answers each 32000 bytes (1s) of media 250ms later, with items
+// ending at that media time. Paced at 2.5x real time, the answer to the first
+// 32000 bytes arrives about 230ms before the drop, and the answer to the next
+// 32000 bytes about 170ms after it, so the client resumes from 32000 bytes.
+#define ACKED_BYTES  32000
+
+size_t final_bytes = 0;
+
+using namespace verbit::streaming;
+
+/**
+ * Media generator producing silence at 2.5x real time.
+ */
+class PacedMediaGenerator : public MediaGenerator
+{
+public:
+	bool read_chunk(ChunkBuffer& chunk)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(CHUNK_MS));
+		memset(chunk.prepare(CHUNK_BYTES), 0, CHUNK_BYTES);
+		chunk.commit(CHUNK_BYTES);
+		_chunks++;
+		return true;
+	}
+
+	const std::string get_chunk() { return read_chunk_string(); }
+
+	bool finished() { return (_chunks >= N_CHUNKS); }
+
+private:
+	int _chunks = 0;
+};
+
+void on_response(WebSocketStreamingClient* client, nlohmann::json* response)
+{
+	auto is_eos = (*response)["response"]["is_end_of_stream"];
+	if (is_eos.get<bool>()) {
+		auto alternatives = (*response)["response"]["alternatives"];
+		std::string transcript = alternatives[0]["transcript"].get<std::string>();
+		sscanf(transcript.c_str(), "I saw %zu bytes", &final_bytes);
+	}
+}
+
+std::string ws_url(int test)
+{
+	return std::string(TEST_WS_URL) + std::to_string(getpid()) + "-" + std::to_string(test);
+}
+
+bool contains(const std::string& text, const std::string& line)
+{
+	if (text.find(line + "\n") == std::string::npos) {
+		std::cout << "FAILED expected Prometheus line \"" << line << "\" in:" << std::endl << text;
+		return false;
+	}
+	return true;
+}
+
+// The stream must have resumed once, from the acknowledged media: so the new
+// connection must have received exactly the media from there to the end, and
+// the media replayed must be just what was sent after that on the old connection.
+// (A chunk whose send fails as the old connection closes is not sent at all.)
+bool check_resumed(WebSocketStreamingClient& client, bool ok)
+{
+	ReconnectStats stats = client.reconnect_stats();
+	SessionMetrics metrics = client.metrics();
+	uint64_t not_sent = metrics.send_errors.value() * CHUNK_BYTES;
+	if (!ok) {
+		std::cout << "FAILED run_stream error " << client.error_code() << ": " << client.service_error() << std::endl;
+		return false;
+	}
+	std::cout << "reconnects " << stats.reconnects << " bytes_replayed " << stats.bytes_replayed
+		<< " bytes_lost " << stats.bytes_lost << " bytes_sent " << metrics.bytes_sent.value()
+		<< " send_errors " << metrics.send_errors.value() << " resumed connection saw " << final_bytes << std::endl;
+	if (stats.reconnects != 1) {
+		std::cout << "FAILED expected 1 reconnect, actual " << stats.reconnects << std::endl;
+		return false;
+	} else if (stats.bytes_lost != 0) {
+		std::cout << "FAILED expected no media lost" << std::endl;
+		return false;
+	} else if (final_bytes != TOTAL_BYTES - ACKED_BYTES - not_sent) {
+		std::cout << "FAILED expected the resumed connection to see bytes " << ACKED_BYTES
+			<< " to " << TOTAL_BYTES << ", actual " << final_bytes << " bytes" << std::endl;
+		return false;
+	} else if (stats.bytes_replayed < DROP_AFTER - ACKED_BYTES) {
+		std::cout << "FAILED expected at least " << (DROP_AFTER - ACKED_BYTES) << " bytes replayed" << std::endl;
+		return false;
+	} else if (metrics.bytes_sent.value() != TOTAL_BYTES - not_sent + stats.bytes_replayed) {
+		std::cout << "FAILED expected each byte sent once, plus the replay" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	/*
+	 * Test resume with a media generator run by the media thread
+	 */
+	{
+		MetricsRegistry registry;
+		WebSocketStreamingClient client {access_token};
+		client.metrics_registry(&registry);
+		client.ws_url(ws_url(1));
+		client.verify_ssl_cert(false);
+		client.resilient(true);
+		client.set_response_handler(&on_response);
+		PacedMediaGenerator media_gen;
+		final_bytes = 0;
+		if (!check_resumed(client, client.run_stream(media_gen))) {
+			return EX_SOFTWARE;
+		}
+		// the exported metrics count the reconnect, and the replayed media as sent
+		std::string text = registry.prometheus();
+		if (!contains(text, "verbit_streaming_reconnects_total 1")
+			|| !contains(text, "verbit_streaming_media_bytes_sent_total " + std::to_string(client.metrics().bytes_sent.value()))) {
+			return EX_SOFTWARE;
+		}
+	}
+	/*
+	 * Test resume with a push media source, waited on by the I/O threads
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		client.ws_url(ws_url(2));
+		client.verify_ssl_cert(false);
+		client.resilient(true);
+		client.set_response_handler(&on_response);
+		PushMediaSource source {TOTAL_BYTES};
+		std::thread producer([&source]() {
+			char silence[CHUNK_BYTES] = {0};
+			for (int i = 0; i < N_CHUNKS; i++) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(CHUNK_MS));
+				source.push(silence, CHUNK_BYTES);
+			}
+			source.close();
+		});
+		final_bytes = 0;
+		bool ok = client.run_stream(source);
+		producer.join();
+		if (!check_resumed(client, ok)) {
+			return EX_SOFTWARE;
+		}
+	}
+	std::cout << "OK (2 tests)" << std::endl;
+	return EX_OK;
+}
@@ -0,0 +1,270 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "sample_converter_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SampleConverterTest);
+
+namespace {
+
+const SampleConverter::Isa ISAS[] = { SampleConverter::isa_scalar, SampleConverter::isa_sse2, SampleConverter::isa_avx2 };
+const SampleConverter::Format FORMATS[] = { SampleConverter::f32le, SampleConverter::s24le, SampleConverter::s32le };
+
+// convert `frames` frames with the given kernels
+std::vector<int16_t> convert(SampleConverter::Isa isa, SampleConverter::Format format, int in_channels,
+	int out_channels, bool dither, const std::vector<uint8_t>& in, size_t frames)
+{
+	SampleConverter converter {format, in_channels, out_channels, dither, isa};
+	std::vector<int16_t> out(frames * out_channels);
+	converter.convert(in.data(), frames, out.data());
+	return out;
+}
+
+// mono conversion of floats, S24 samples (in their low 3 bytes) or S32 samples, with each supported ISA
+template<typename T>
+void check_mono(SampleConverter::Format format, const std::vector<T>& samples, const std::vector<int16_t>& expected)
+{
+	std::vector<uint8_t> in;
+	for (T sample : samples) {
+		uint8_t bytes[sizeof(T)];
+		memcpy(bytes, &sample, sizeof(T));
+		in.insert(in.end(), bytes, bytes + SampleConverter::sample_width(format));
+	}
+	for (SampleConverter::Isa isa : ISAS) {
+		if (!SampleConverter::supported(isa)) {
+			continue;
+		}
+		std::vector<int16_t> out = convert(isa, format, 1, 1, false, in, samples.size());
+		for (size_t i = 0; i < expected.size(); i++) {
+			CPPUNIT_ASSERT_EQUAL_MESSAGE(std::string(SampleConverter::isa_name(isa)) + " sample " + std::to_string(i),
+				expected[i], out[i]);
+		}
+	}
+}
+
+// repeat samples to fill a whole SIMD block or two, so the kernels (not just their scalar tails) are checked
+template<typename T>
+std::vector<T> repeated(const std::vector<T>& samples)
+{
+	std::vector<T> out;
+	while (out.size() < 40) {
+		out.insert(out.end(), samples.begin(), samples.end());
+	}
+	return out;
+}
+
+// a media generator returning a fixed chunk sequence
+class ChunksMediaGenerator : public MediaGenerator
+{
+public:
+	ChunksMediaGenerator(const std::vector<std::string>& chunks) : _chunks(chunks) { }
+	bool read_chunk(ChunkBuffer& chunk)
+	{
+		if (_next < _chunks.size()) {
+			chunk.append(_chunks[_next].data(), _chunks[_next].length());
+			_next++;
+		}
+		return true;
+	}
+	const std::string get_chunk() { return read_chunk_string(); }
+	bool finished() { return _next == _chunks.size(); }
+private:
+	std::vector<std::string> _chunks;
+	size_t _next = 0;
+};
+
+} // anonymous namespace
+
+void SampleConverterTest::test_f32()
+{
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	const float inf = std::numeric_limits<float>::infinity();
+	std::vector<float> samples {0.0f, 0.5f, -0.5f, 1.0f, -1.0f, 2.0f, -2.0f, 1.5f / 32768, 2.5f / 32768, nan, inf, -inf};
+	std::vector<int16_t> expected {0, 16384, -16384, 32767, -32768, 32767, -32768, 2, 2, 32767, 32767, -32768};
+	check_mono(SampleConverter::f32le, repeated(samples), repeated(expected));
+}
+
+void SampleConverterTest::test_s24()
+{
+	std::vector<int32_t> samples {0, 0x7fffff, -0x800000, 0x100, -0x100, 0x80, 0x180, 0x7f, -0x80};
+	std::vector<int16_t> expected {0, 32767, -32768, 1, -1, 0, 2, 0, 0};
+	check_mono(SampleConverter::s24le, repeated(samples), repeated(expected));
+}
+
+void SampleConverterTest::test_s32()
+{
+	std::vector<int32_t> samples {0, 0x7fffffff, (int32_t)0x80000000, 0x10000, -0x10000, 0x8000, 0x18000, 0x7fff0000};
+	std::vector<int16_t> expected {0, 32767, -32768, 1, -1, 0, 2, 32767};
+	check_mono(SampleConverter::s32le, repeated(samples), repeated(expected));
+}
+
+void SampleConverterTest::test_mix()
+{
+	// three frames of six channels: F32 full-scale fractions
+	std::vector<float> samples {
+		0.5f, 0.25f, 0.0f, 0.0f, 0.0f, 0.0f,
+		-1.0f, 1.0f, 0.5f, 0.5f, 0.5f, 0.5f,
+		0.125f, -0.125f, 0.0f, 0.0f, 0.0f, 0.75f};
+	std::vector<uint8_t> in(samples.size() * 4);
+	memcpy(in.data(), samples.data(), in.size());
+	SampleConverter::Isa isa = SampleConverter::best_isa();
+
+	// stereo to mono averages
+	std::vector<int16_t> out = convert(isa, SampleConverter::f32le, 2, 1, false, in, 9);
+	std::vector<int16_t> expected {12288, 0, 0, 0, 16384, 16384, 0, 0, 12288};
+	CPPUNIT_ASSERT_MESSAGE("stereo to mono", out == expected);
+
+	// 6 channels to mono averages all of them
+	out = convert(isa, SampleConverter::f32le, 6, 1, false, in, 3);
+	expected = {4096, 10923, 4096};
+	CPPUNIT_ASSERT_MESSAGE("6 channels to mono", out == expected);
+
+	// 6 channels to stereo keeps the front left and right
+	out = convert(isa, SampleConverter::f32le, 6, 2, false, in, 3);
+	expected = {16384, 8192, -32768, 32767, 4096, -4096};
+	CPPUNIT_ASSERT_MESSAGE("6 channels to stereo", out == expected);
+
+	// mono to stereo duplicates
+	out = convert(isa, SampleConverter::f32le, 1, 2, false, in, 3);
+	expected = {16384, 16384, 8192, 8192, 0, 0};
+	CPPUNIT_ASSERT_MESSAGE("mono to stereo", out == expected);
+
+	// stereo stays stereo
+	out = convert(isa, SampleConverter::f32le, 2, 2, false, in, 3);
+	expected = {16384, 8192, 0, 0, 0, 0};
+	CPPUNIT_ASSERT_MESSAGE("stereo to stereo", out == expected);
+}
+
+void SampleConverterTest::test_dither()
+{
+	const size_t frames = 10000;
+	std::vector<float> samples(frames);
+	for (size_t i = 0; i < frames; i++) {
+		samples[i] = (float)(i % 200) / 32768;
+	}
+	std::vector<uint8_t> in(frames * 4);
+	memcpy(in.data(), samples.data(), in.size());
+
+	SampleConverter converter {SampleConverter::f32le, 1, 1, true};
+	std::vector<int16_t> dithered(frames);
+	converter.convert(in.data(), frames, dithered.data());
+	std::vector<int16_t> again(frames);
+	converter.convert(in.data(), frames, again.data());
+	CPPUNIT_ASSERT_MESSAGE("noise continues", dithered != again);
+	converter.seed(1);
+	converter.convert(in.data(), frames, again.data());
+	CPPUNIT_ASSERT_MESSAGE("reseeded", dithered == again);
+
+	// at most ±1 LSB of noise, averaging out
+	int changed = 0;
+	long total = 0;
+	for (size_t i = 0; i < frames; i++) {
+		int diff = dithered[i] - (int)(i % 200);
+		CPPUNIT_ASSERT_MESSAGE("within 1 LSB", std::abs(diff) <= 1);
+		changed += (diff != 0) ? 1 : 0;
+		total += diff;
+	}
+	CPPUNIT_ASSERT_MESSAGE("noise added", changed > (int)frames / 8);
+	CPPUNIT_ASSERT_MESSAGE("zero mean", std::abs(total) < (long)frames / 50);
+}
+
+void SampleConverterTest::test_bit_exact()
+{
+	// random samples, a tenth of them beyond full scale, through every ISA, format and layout,
+	// and frame counts exercising whole blocks, vector loops and scalar tails
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> sample(-1.0f, 1.0f);
+	const size_t max_frames = 1001;
+	const int max_channels = 6;
+	std::vector<uint8_t> f32(max_frames * max_channels * 4);
+	for (size_t i = 0; i < max_frames * max_channels; i++) {
+		float v = sample(random) * ((i % 10 == 0) ? 1.5f : 1.0f);
+		memcpy(&f32[4 * i], &v, 4);
+	}
+	std::vector<uint8_t> ints(max_frames * max_channels * 4);
+	for (uint8_t& byte : ints) {
+		byte = (uint8_t)random();
+	}
+
+	int checked = 0;
+	for (SampleConverter::Isa isa : ISAS) {
+		if ( (isa == SampleConverter::isa_scalar) || !SampleConverter::supported(isa) ) {
+			continue;
+		}
+		for (SampleConverter::Format format : FORMATS) {
+			const std::vector<uint8_t>& in = (format == SampleConverter::f32le) ? f32 : ints;
+			for (int in_channels : {1, 2, 3, 6}) {
+				for (int out_channels : {1, 2}) {
+					for (bool dither : {false, true}) {
+						for (size_t frames : {(size_t)1, (size_t)7, (size_t)17, (size_t)256, max_frames}) {
+							std::string message = std::string(SampleConverter::isa_name(isa)) + " "
+								+ SampleConverter::format_name(format) + " " + std::to_string(in_channels) + ">"
+								+ std::to_string(out_channels) + (dither ? " dither " : " ") + std::to_string(frames);
+							CPPUNIT_ASSERT_MESSAGE(message,
+								convert(isa, format, in_channels, out_channels, dither, in, frames)
+								== convert(SampleConverter::isa_scalar, format, in_channels, out_channels, dither, in, frames));
+							checked++;
+						}
+					}
+				}
+			}
+		}
+	}
+	CPPUNIT_ASSERT_MESSAGE("SIMD kernels checked", (checked > 0) || (SampleConverter::best_isa() == SampleConverter::isa_scalar));
+}
+
+void SampleConverterTest::test_invalid()
+{
+	CPPUNIT_ASSERT_THROW_MESSAGE("no input channels", SampleConverter(SampleConverter::f32le, 0), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("3 output channels", SampleConverter(SampleConverter::f32le, 6, 3), std::runtime_error);
+	CPPUNIT_ASSERT_MESSAGE("scalar supported", SampleConverter::supported(SampleConverter::isa_scalar));
+	if (!SampleConverter::supported(SampleConverter::isa_avx2)) {
+		CPPUNIT_ASSERT_THROW_MESSAGE("unsupported ISA",
+			SampleConverter(SampleConverter::f32le, 1, 1, false, SampleConverter::isa_avx2), std::runtime_error);
+	}
+}
+
+void SampleConverterTest::test_generator()
+{
+	// S24 stereo, split into chunks at arbitrary bytes
+	const size_t frames = 1000;
+	std::string media;
+	for (size_t i = 0; i < frames * 2; i++) {
+		int32_t v = (int32_t)(i * 2011) % 0x800000 - 0x400000;
+		media.append(reinterpret_cast<const char*>(&v), 3);
+	}
+	std::vector<std::string> chunks;
+	for (size_t pos = 0, len = 1; pos < media.length(); pos += len, len = len * 3 % 1021 + 1) {
+		chunks.push_back(media.substr(pos, len));
+	}
+	chunks.push_back(std::string("\x01\x02", 2));  // a trailing partial frame is dropped
+
+	ChunksMediaGenerator source {chunks};
+	ConvertingMediaGenerator generator {source, SampleConverter::s24le, 2};
+	MediaConfig config = generator.media_config(48000);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("config format", std::string("S16LE"), config.format);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("config rate", 48000, config.sample_rate);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("config channels", 1, config.num_channels);
+
+	std::string converted;
+	while (!generator.finished()) {
+		std::string storage;
+		ChunkBuffer chunk(storage);
+		CPPUNIT_ASSERT_MESSAGE("read", generator.read_chunk(chunk));
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("whole frames", (size_t)0, chunk.size() % 2);
+		converted.append(chunk.data(), chunk.size());
+	}
+
+	std::vector<int16_t> expected(frames);
+	SampleConverter converter {SampleConverter::s24le, 2};
+	converter.convert(media.data(), frames, expected.data());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("converted size", frames * 2, converted.size());
+	CPPUNIT_ASSERT_MESSAGE("converted media", memcmp(converted.data(), expected.data(), converted.size()) == 0);
+}
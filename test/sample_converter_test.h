@@ -0,0 +1,31 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/sample_converter.h>
+
+/**
+ * Unit tests for `SampleConverter` and `ConvertingMediaGenerator` classes.
+ */
+class SampleConverterTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SampleConverterTest);
+
+	CPPUNIT_TEST(test_f32);
+	CPPUNIT_TEST(test_s24);
+	CPPUNIT_TEST(test_s32);
+	CPPUNIT_TEST(test_mix);
+	CPPUNIT_TEST(test_dither);
+	CPPUNIT_TEST(test_bit_exact);
+	CPPUNIT_TEST(test_invalid);
+	CPPUNIT_TEST(test_generator);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_f32();
+	void test_s24();
+	void test_s32();
+	void test_mix();
+	void test_dither();
+	void test_bit_exact();
+	void test_invalid();
+	void test_generator();
+};
@@ -0,0 +1,91 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <poll.h>
+
+#include "send_drain_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SendDrainTest);
+
+void SendDrainTest::test_count()
+{
+	SendDrain drain;
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("no notifications", (uint64_t)0, drain.count());
+	drain.notify();
+	drain.notify();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("notifications counted", (uint64_t)2, drain.count());
+}
+
+void SendDrainTest::test_wait_notified()
+{
+	SendDrain drain;
+	uint64_t seen = drain.count();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::thread notifier([&drain]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		drain.notify();
+	});
+	drain.wait(seen);
+	std::chrono::steady_clock::duration waited = std::chrono::steady_clock::now() - start;
+	notifier.join();
+	CPPUNIT_ASSERT_MESSAGE("wait waits for the notification", waited >= std::chrono::milliseconds(40));
+	CPPUNIT_ASSERT_MESSAGE("wait returns on notification", waited < std::chrono::milliseconds(1000));
+}
+
+void SendDrainTest::test_wait_already_notified()
+{
+	// a notification between reading the count and waiting is not missed
+	SendDrain drain;
+	uint64_t seen = drain.count();
+	drain.notify();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	drain.wait(seen);
+	CPPUNIT_ASSERT_MESSAGE("wait returns at once", std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000));
+}
+
+void SendDrainTest::test_notify_wakes_all()
+{
+	SendDrain drain;
+	uint64_t seen = drain.count();
+	std::atomic<int> woken(0);
+	std::vector<std::thread> waiters;
+	for (int i = 0; i < 3; i++) {
+		waiters.push_back(std::thread([&drain, &woken, seen]() {
+			drain.wait(seen);
+			woken++;
+		}));
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("no waiter woken yet", 0, woken.load());
+	drain.notify();
+	for (auto& t : waiters) {
+		t.join();
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("all waiters woken", 3, woken.load());
+}
+
+// is the descriptor readable now?
+static bool readable(int fd)
+{
+	struct pollfd pfd = {fd, POLLIN, 0};
+	return (::poll(&pfd, 1, 0) == 1);
+}
+
+void SendDrainTest::test_event_fd_armed()
+{
+	SendDrain drain;
+	CPPUNIT_ASSERT_MESSAGE("event_fd", drain.event_fd() >= 0);
+	drain.notify();
+	CPPUNIT_ASSERT_MESSAGE("not readable unless armed", !readable(drain.event_fd()));
+	drain.arm();
+	CPPUNIT_ASSERT_MESSAGE("not readable until notified", !readable(drain.event_fd()));
+	drain.notify();
+	CPPUNIT_ASSERT_MESSAGE("readable once notified", readable(drain.event_fd()));
+	drain.clear();
+	CPPUNIT_ASSERT_MESSAGE("not readable once cleared", !readable(drain.event_fd()));
+	drain.notify();
+	CPPUNIT_ASSERT_MESSAGE("one notification per arm", !readable(drain.event_fd()));
+}
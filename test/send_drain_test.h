@@ -0,0 +1,25 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/send_drain.h>
+
+/**
+ * Unit tests for `SendDrain` class.
+ */
+class SendDrainTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SendDrainTest);
+
+	CPPUNIT_TEST(test_count);
+	CPPUNIT_TEST(test_wait_notified);
+	CPPUNIT_TEST(test_wait_already_notified);
+	CPPUNIT_TEST(test_notify_wakes_all);
+	CPPUNIT_TEST(test_event_fd_armed);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_count();
+	void test_wait_notified();
+	void test_wait_already_notified();
+	void test_notify_wakes_all();
+	void test_event_fd_armed();
+};
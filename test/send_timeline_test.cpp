@@ -0,0 +1,85 @@
+#include <chrono>
+#include <stdexcept>
+
+#include "send_timeline_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SendTimelineTest);
+
+namespace {
+
+typedef std::chrono::steady_clock::time_point time_point;
+
+// a time point `ms` milliseconds after an arbitrary start
+time_point at_ms(int ms)
+{
+	return time_point(std::chrono::milliseconds(1000000 + ms));
+}
+
+// send `chunks` chunks of 3200 bytes, 100ms apart
+void send_chunks(SendTimeline& timeline, int chunks)
+{
+	for (int i = 0; i < chunks; i++) {
+		timeline.sent((i + 1) * 3200, at_ms(i * 100));
+	}
+}
+
+} // anonymous namespace
+
+void SendTimelineTest::test_empty()
+{
+	SendTimeline timeline;
+	time_point time;
+	CPPUNIT_ASSERT_MESSAGE("nothing sent", !timeline.sent_time(0, time));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("end offset", (uint64_t)0, timeline.end_offset());
+	CPPUNIT_ASSERT_THROW_MESSAGE("no capacity", SendTimeline(0), std::runtime_error);
+}
+
+void SendTimelineTest::test_lookup()
+{
+	SendTimeline timeline;
+	send_chunks(timeline, 10);
+	time_point time;
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("end offset", (uint64_t)32000, timeline.end_offset());
+	CPPUNIT_ASSERT_MESSAGE("offset 0", timeline.sent_time(0, time) && (time == at_ms(0)));
+	CPPUNIT_ASSERT_MESSAGE("first chunk end", timeline.sent_time(3200, time) && (time == at_ms(0)));
+	CPPUNIT_ASSERT_MESSAGE("second chunk start", timeline.sent_time(3201, time) && (time == at_ms(100)));
+	CPPUNIT_ASSERT_MESSAGE("middle", timeline.sent_time(16000, time) && (time == at_ms(400)));
+	CPPUNIT_ASSERT_MESSAGE("last chunk end", timeline.sent_time(32000, time) && (time == at_ms(900)));
+	timeline.clear();
+	CPPUNIT_ASSERT_MESSAGE("cleared", !timeline.sent_time(0, time));
+}
+
+void SendTimelineTest::test_resent()
+{
+	// media sent again after reconnecting keeps the time it was first sent
+	SendTimeline timeline;
+	send_chunks(timeline, 10);
+	timeline.sent(16000, at_ms(5000));
+	timeline.sent(32000, at_ms(5100));
+	timeline.sent(35200, at_ms(5200));
+	time_point time;
+	CPPUNIT_ASSERT_MESSAGE("resent", timeline.sent_time(16000, time) && (time == at_ms(400)));
+	CPPUNIT_ASSERT_MESSAGE("new", timeline.sent_time(35000, time) && (time == at_ms(5200)));
+}
+
+void SendTimelineTest::test_past_end()
+{
+	SendTimeline timeline;
+	send_chunks(timeline, 3);
+	time_point time;
+	CPPUNIT_ASSERT_MESSAGE("past end is the last send", timeline.sent_time(100000, time) && (time == at_ms(200)));
+}
+
+void SendTimelineTest::test_wrap()
+{
+	SendTimeline timeline {8};
+	send_chunks(timeline, 20);
+	time_point time;
+	// chunks 12 to 19 are kept; chunk 12's first bytes might have been in chunk 11
+	CPPUNIT_ASSERT_MESSAGE("forgotten", !timeline.sent_time(3200 * 5, time));
+	CPPUNIT_ASSERT_MESSAGE("oldest kept is ambiguous", !timeline.sent_time(3200 * 13, time));
+	CPPUNIT_ASSERT_MESSAGE("kept", timeline.sent_time(3200 * 13 + 1, time) && (time == at_ms(1300)));
+	CPPUNIT_ASSERT_MESSAGE("newest", timeline.sent_time(3200 * 20, time) && (time == at_ms(1900)));
+}
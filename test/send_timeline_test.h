@@ -0,0 +1,25 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/send_timeline.h>
+
+/**
+ * Unit tests for `SendTimeline` class.
+ */
+class SendTimelineTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SendTimelineTest);
+
+	CPPUNIT_TEST(test_empty);
+	CPPUNIT_TEST(test_lookup);
+	CPPUNIT_TEST(test_resent);
+	CPPUNIT_TEST(test_past_end);
+	CPPUNIT_TEST(test_wrap);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_empty();
+	void test_lookup();
+	void test_resent();
+	void test_past_end();
+	void test_wrap();
+};
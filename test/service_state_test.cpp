@@ -1,5 +1,10 @@
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
 #include <string.h>
+#include <thread>
+#include <vector>
 
 #include "service_state_test.h"
 
@@ -48,9 +53,9 @@ void ServiceStateTest::test_change_if()
 {
 	ServiceState ss;
 	ss.change(ServiceState::state_opening);
-	ss.change_if(ServiceState::state_open, ServiceState::state_opening, false);
+	CPPUNIT_ASSERT_MESSAGE("change_if changed", ss.change_if(ServiceState::state_open, ServiceState::state_opening, false));
 	CPPUNIT_ASSERT_MESSAGE("change_if", ss.get() == ServiceState::state_open);
-	ss.change_if(ServiceState::state_fail, ServiceState::state_initial, false);
+	CPPUNIT_ASSERT_MESSAGE("change_if not changed", !ss.change_if(ServiceState::state_fail, ServiceState::state_initial, false));
 	CPPUNIT_ASSERT_MESSAGE("change_if", ss.get() == ServiceState::state_open);
 }
 
@@ -77,3 +82,101 @@ void ServiceStateTest::test_change_unless_except()
 	ss.change(ServiceState::state_done);
 	CPPUNIT_ASSERT_THROW_MESSAGE("change_unless exception", ss.change_unless(ServiceState::state_fail, ServiceState::state_done, true), std::runtime_error);
 }
+
+void ServiceStateTest::test_wait_for()
+{
+	ServiceState ss;
+	ss.change(ServiceState::state_closing);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::thread changer([&ss]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		ss.change(ServiceState::state_done);
+	});
+	ss.wait_for(ServiceState::state_done, std::chrono::milliseconds(5000));
+	std::chrono::steady_clock::duration waited = std::chrono::steady_clock::now() - start;
+	changer.join();
+	CPPUNIT_ASSERT_MESSAGE("wait_for state", ss.get() == ServiceState::state_done);
+	CPPUNIT_ASSERT_MESSAGE("wait_for returns on change", waited < std::chrono::milliseconds(1000));
+}
+
+void ServiceStateTest::test_wait_while()
+{
+	ServiceState ss;
+	ss.change(ServiceState::state_opening);
+	std::thread changer([&ss]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		ss.change(ServiceState::state_open);
+	});
+	int state = ss.wait_while(ServiceState::state_opening);
+	changer.join();
+	CPPUNIT_ASSERT_MESSAGE("wait_while new state", state == ServiceState::state_open);
+}
+
+void ServiceStateTest::test_wait_while_timeout()
+{
+	ServiceState ss;
+	ss.change(ServiceState::state_closing);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int state = ss.wait_while(ServiceState::state_closing, std::chrono::milliseconds(50));
+	std::chrono::steady_clock::duration waited = std::chrono::steady_clock::now() - start;
+	CPPUNIT_ASSERT_MESSAGE("wait_while timeout state", state == ServiceState::state_closing);
+	CPPUNIT_ASSERT_MESSAGE("wait_while waits for timeout", waited >= std::chrono::milliseconds(50));
+}
+
+void ServiceStateTest::test_wait_wakes_all()
+{
+	ServiceState ss;
+	ss.change(ServiceState::state_opening);
+	std::atomic<int> woken(0);
+	std::vector<std::thread> waiters;
+	for (int i = 0; i < 3; i++) {
+		waiters.push_back(std::thread([&ss, &woken]() {
+			if (ss.wait_while(ServiceState::state_opening, std::chrono::milliseconds(5000)) != ServiceState::state_opening) {
+				woken++;
+			}
+		}));
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ss.change(ServiceState::state_open);
+	for (auto& t : waiters) {
+		t.join();
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("all waiters woken", 3, woken.load());
+}
+
+void ServiceStateTest::test_change_if_concurrent()
+{
+	ServiceState ss;
+	ss.change(ServiceState::state_opening);
+	std::atomic<int> changed(0);
+	std::vector<std::thread> changers;
+	for (int i = 0; i < 8; i++) {
+		changers.push_back(std::thread([&ss, &changed]() {
+			try {
+				ss.change_if(ServiceState::state_open, ServiceState::state_opening, true);
+				changed++;
+			} catch (std::runtime_error& e) {
+			}
+		}));
+	}
+	for (auto& t : changers) {
+		t.join();
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("exactly one change_if succeeds", 1, changed.load());
+	CPPUNIT_ASSERT_MESSAGE("change_if concurrent state", ss.get() == ServiceState::state_open);
+}
+
+void ServiceStateTest::test_time_in()
+{
+	ServiceState ss;
+	CPPUNIT_ASSERT_MESSAGE("opening not entered", ss.entered(ServiceState::state_opening) == std::chrono::steady_clock::time_point());
+	ss.change(ServiceState::state_opening);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	ss.change(ServiceState::state_open);
+	std::chrono::steady_clock::duration opening = ss.time_in(ServiceState::state_opening);
+	CPPUNIT_ASSERT_MESSAGE("time in opening", opening >= std::chrono::milliseconds(20));
+	CPPUNIT_ASSERT_MESSAGE("time in opening is fixed once left", ss.time_in(ServiceState::state_opening) == opening);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CPPUNIT_ASSERT_MESSAGE("time in current state grows", ss.time_in(ServiceState::state_open) >= std::chrono::milliseconds(20));
+	CPPUNIT_ASSERT_MESSAGE("closing never entered", ss.time_in(ServiceState::state_closing) == std::chrono::steady_clock::duration::zero());
+}
@@ -16,6 +16,12 @@ class ServiceStateTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(test_change_if_except);
 	CPPUNIT_TEST(test_change_unless);
 	CPPUNIT_TEST(test_change_unless_except);
+	CPPUNIT_TEST(test_wait_for);
+	CPPUNIT_TEST(test_wait_while);
+	CPPUNIT_TEST(test_wait_while_timeout);
+	CPPUNIT_TEST(test_wait_wakes_all);
+	CPPUNIT_TEST(test_change_if_concurrent);
+	CPPUNIT_TEST(test_time_in);
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -28,4 +34,10 @@ public:
 	void test_change_if_except();
 	void test_change_unless();
 	void test_change_unless_except();
+	void test_wait_for();
+	void test_wait_while();
+	void test_wait_while_timeout();
+	void test_wait_wakes_all();
+	void test_change_if_concurrent();
+	void test_time_in();
 };
@@ -0,0 +1,124 @@
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+#include "session_capture_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SessionCaptureTest);
+
+namespace {
+
+std::string test_path()
+{
+	return "/tmp/session_capture_test." + std::to_string(getpid());
+}
+
+void record(SessionRecorder& recorder, CaptureRecord::Kind kind, const std::string& payload)
+{
+	recorder.record(kind, payload.data(), payload.length());
+}
+
+std::string payload(const CaptureRecord& record)
+{
+	return std::string(record.data, record.length);
+}
+
+} // anonymous namespace
+
+void SessionCaptureTest::tearDown()
+{
+	unlink(test_path().c_str());
+}
+
+void SessionCaptureTest::test_round_trip()
+{
+	{
+		SessionRecorder recorder {test_path()};
+		record(recorder, CaptureRecord::media, std::string(3200, '\x01'));
+		record(recorder, CaptureRecord::response, "{\"response\":{\"id\":\"a\"}}");
+		record(recorder, CaptureRecord::media, "");
+		record(recorder, CaptureRecord::event, "{\"event\":\"EOS\"}");
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("records", (uint64_t)4, recorder.records());
+		recorder.close();
+	}
+	SessionCapture capture {test_path()};
+	CPPUNIT_ASSERT_MESSAGE("start time", capture.start_time_us() > 0);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("size is 8-byte aligned", (size_t)0, capture.size() % 8);
+
+	CaptureRecord rec;
+	CPPUNIT_ASSERT_MESSAGE("1st", capture.next(rec));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("1st kind", CaptureRecord::media, rec.kind);
+	CPPUNIT_ASSERT_MESSAGE("1st payload", payload(rec) == std::string(3200, '\x01'));
+	uint64_t time_us = rec.time_us;
+
+	CPPUNIT_ASSERT_MESSAGE("2nd", capture.next(rec));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("2nd kind", CaptureRecord::response, rec.kind);
+	CPPUNIT_ASSERT_MESSAGE("2nd payload", payload(rec) == "{\"response\":{\"id\":\"a\"}}");
+	CPPUNIT_ASSERT_MESSAGE("times are monotonic", rec.time_us >= time_us);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("payload is 8-byte aligned", (size_t)0, (size_t)rec.data % 8);
+
+	CPPUNIT_ASSERT_MESSAGE("3rd", capture.next(rec));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("3rd kind", CaptureRecord::media, rec.kind);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("3rd length", (size_t)0, rec.length);
+
+	CPPUNIT_ASSERT_MESSAGE("4th", capture.next(rec));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("4th kind", CaptureRecord::event, rec.kind);
+	CPPUNIT_ASSERT_MESSAGE("4th payload", payload(rec) == "{\"event\":\"EOS\"}");
+
+	CPPUNIT_ASSERT_MESSAGE("end", !capture.next(rec));
+}
+
+void SessionCaptureTest::test_rewind()
+{
+	{
+		SessionRecorder recorder {test_path()};
+		for (int i = 0; i < 100; i++) {
+			record(recorder, CaptureRecord::response, "response " + std::to_string(i));
+		}
+		recorder.close();
+	}
+	SessionCapture capture {test_path()};
+	CaptureRecord rec;
+	for (int pass = 0; pass < 2; pass++) {
+		int i = 0;
+		while (capture.next(rec)) {
+			CPPUNIT_ASSERT_MESSAGE("payload", payload(rec) == "response " + std::to_string(i));
+			i++;
+		}
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("records", 100, i);
+		capture.rewind();
+	}
+}
+
+void SessionCaptureTest::test_not_capture()
+{
+	CPPUNIT_ASSERT_THROW_MESSAGE("missing", SessionCapture("/nonexistent/capture"), std::runtime_error);
+	std::ofstream(test_path()) << "this is not a session capture file";
+	CPPUNIT_ASSERT_THROW_MESSAGE("bad magic", SessionCapture {test_path()}, std::runtime_error);
+	std::ofstream(test_path()) << "short";
+	CPPUNIT_ASSERT_THROW_MESSAGE("too short", SessionCapture {test_path()}, std::runtime_error);
+}
+
+void SessionCaptureTest::test_truncated()
+{
+	{
+		SessionRecorder recorder {test_path()};
+		record(recorder, CaptureRecord::response, "first");
+		record(recorder, CaptureRecord::response, std::string(100, 'x'));
+		recorder.close();
+	}
+	SessionCapture whole {test_path()};
+	size_t size = whole.size();
+	// cut into the 2nd payload, then into its header
+	for (size_t cut : {size - 50, (size_t)16 + 16 + 8 + 4}) {
+		CPPUNIT_ASSERT_EQUAL_MESSAGE("truncate", 0, truncate(test_path().c_str(), cut));
+		SessionCapture capture {test_path()};
+		CaptureRecord rec;
+		CPPUNIT_ASSERT_MESSAGE("1st", capture.next(rec));
+		CPPUNIT_ASSERT_MESSAGE("1st payload", payload(rec) == "first");
+		CPPUNIT_ASSERT_THROW_MESSAGE("2nd", capture.next(rec), std::runtime_error);
+	}
+}
@@ -0,0 +1,25 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/session_capture.h>
+
+/**
+ * Unit tests for `SessionRecorder` and `SessionCapture` classes.
+ */
+class SessionCaptureTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SessionCaptureTest);
+
+	CPPUNIT_TEST(test_round_trip);
+	CPPUNIT_TEST(test_rewind);
+	CPPUNIT_TEST(test_not_capture);
+	CPPUNIT_TEST(test_truncated);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void tearDown();
+
+	void test_round_trip();
+	void test_rewind();
+	void test_not_capture();
+	void test_truncated();
+};
@@ -0,0 +1,91 @@
+#include <chrono>
+#include <iostream>
+#include <sysexits.h>
+
+#include <verbit/streaming/ws_streaming_client.h>
+
+#include "../examples/wav_media_generator.h"
+
+#define TEST_WS_URL    "wss://localhost:9002"
+#define TEST_WAV_FILE  "test-files/thats-good.wav"
+
+// the test server replies to EOS after 250ms
+#define EOS_REPLY_MS    250
+#define EOS_TIMEOUT_MS  100
+
+using namespace verbit::streaming;
+
+long long ms_between(StreamTimes::time_point from, StreamTimes::time_point to)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count();
+}
+
+// Each phase must have been reached, in order.
+bool check_phases(const StreamTimes& times)
+{
+	const StreamTimes::time_point none;
+	std::cout << "connect to open " << ms_between(times.connect, times.open) << "ms"
+		<< " open to first_send " << ms_between(times.open, times.first_send) << "ms"
+		<< " first_send to eos " << ms_between(times.first_send, times.eos) << "ms"
+		<< " eos to finish " << ms_between(times.eos, times.finish) << "ms" << std::endl;
+	if ( (times.connect == none) || (times.open < times.connect) || (times.first_send < times.open)
+		|| (times.eos < times.first_send) || (times.finish < times.eos) ) {
+		std::cout << "FAILED expected connect, open, first_send, eos and finish in order" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	const std::string access_token = "a-token-longer-than-40-chars-a-token-longer-than-40-chars";
+	/*
+	 * Test the session finishes as soon as the EOS reply arrives, not on a polling interval
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		client.ws_url(TEST_WS_URL);
+		client.verify_ssl_cert(false);
+		WAVMediaGenerator media_gen {TEST_WAV_FILE};
+		if (!client.run_stream(media_gen)) {
+			std::cout << "FAILED run_stream error " << client.error_code() << ": " << client.service_error() << std::endl;
+			return EX_SOFTWARE;
+		}
+		StreamTimes times = client.stream_times();
+		if (!check_phases(times)) {
+			return EX_SOFTWARE;
+		}
+		if (ms_between(times.eos, times.finish) >= EOS_REPLY_MS + 500) {
+			std::cout << "FAILED expected to finish soon after the EOS reply" << std::endl;
+			return EX_SOFTWARE;
+		}
+		if ( (client.time_in_state(ServiceState::state_opening) == std::chrono::steady_clock::duration::zero())
+			|| (client.time_in_state(ServiceState::state_open) == std::chrono::steady_clock::duration::zero()) ) {
+			std::cout << "FAILED expected time spent opening and open" << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	/*
+	 * Test the session gives up waiting for the EOS reply at the EOS timeout
+	 */
+	{
+		WebSocketStreamingClient client {access_token};
+		client.ws_url(TEST_WS_URL);
+		client.verify_ssl_cert(false);
+		client.eos_timeout(std::chrono::milliseconds(EOS_TIMEOUT_MS));
+		WAVMediaGenerator media_gen {TEST_WAV_FILE};
+		client.run_stream(media_gen);
+		StreamTimes times = client.stream_times();
+		if (!check_phases(times)) {
+			return EX_SOFTWARE;
+		}
+		long long waited = ms_between(times.eos, times.finish);
+		if ( (waited < EOS_TIMEOUT_MS) || (waited >= EOS_REPLY_MS) ) {
+			std::cout << "FAILED expected to stop waiting for the EOS reply after " << EOS_TIMEOUT_MS
+				<< "ms, waited " << waited << "ms" << std::endl;
+			return EX_SOFTWARE;
+		}
+	}
+	std::cout << "OK (2 tests)" << std::endl;
+	return EX_OK;
+}
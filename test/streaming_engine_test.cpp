@@ -0,0 +1,54 @@
+#include <iostream>
+
+#include <verbit/streaming/ws_streaming_client.h>
+
+#include "streaming_engine_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(StreamingEngineTest);
+
+void StreamingEngineTest::test_ctor()
+{
+	StreamingEngine engine;
+	CPPUNIT_ASSERT_MESSAGE("ctor num_threads", engine.num_threads() == 0);
+	CPPUNIT_ASSERT_MESSAGE("ctor num_sessions", engine.num_sessions() == 0);
+}
+
+void StreamingEngineTest::test_start_stop()
+{
+	StreamingEngine engine;
+	engine.start(3);
+	CPPUNIT_ASSERT_MESSAGE("start num_threads", engine.num_threads() == 3);
+	engine.stop();
+	CPPUNIT_ASSERT_MESSAGE("stop num_threads", engine.num_threads() == 0);
+	engine.start(1);
+	CPPUNIT_ASSERT_MESSAGE("restart num_threads", engine.num_threads() == 1);
+}
+
+void StreamingEngineTest::test_start_zero_threads()
+{
+	StreamingEngine engine;
+	CPPUNIT_ASSERT_THROW_MESSAGE("start with zero threads", engine.start(0), std::runtime_error);
+}
+
+void StreamingEngineTest::test_start_twice()
+{
+	StreamingEngine engine;
+	engine.start(1);
+	CPPUNIT_ASSERT_THROW_MESSAGE("start when already started", engine.start(1), std::runtime_error);
+}
+
+void StreamingEngineTest::test_attach_client()
+{
+	StreamingEngine engine;
+	engine.start(1);
+	{
+		WebSocketStreamingClient client {"plugh-xyzzy", engine};
+		CPPUNIT_ASSERT_MESSAGE("attach ws_url", client.ws_url() == WSSC_DEFAULT_WS_URL);
+		CPPUNIT_ASSERT_MESSAGE("attach bytes_sent", client.bytes_sent() == 0);
+		// sessions are only registered once a connection is made
+		CPPUNIT_ASSERT_MESSAGE("attach num_sessions", engine.num_sessions() == 0);
+	}
+	engine.stop();
+}
@@ -0,0 +1,25 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/streaming_engine.h>
+
+/**
+ * Unit tests for `StreamingEngine` class.
+ */
+class StreamingEngineTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(StreamingEngineTest);
+
+	CPPUNIT_TEST(test_ctor);
+	CPPUNIT_TEST(test_start_stop);
+	CPPUNIT_TEST(test_start_zero_threads);
+	CPPUNIT_TEST(test_start_twice);
+	CPPUNIT_TEST(test_attach_client);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_ctor();
+	void test_start_stop();
+	void test_start_zero_threads();
+	void test_start_twice();
+	void test_attach_client();
+};
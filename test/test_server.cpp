@@ -1,7 +1,13 @@
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
 #include <fcntl.h>
+#include <getopt.h>
 #include <signal.h>
 #include <sysexits.h>
 #include <sys/stat.h>
@@ -13,6 +19,9 @@
 #include <websocketpp/config/asio.hpp>
 #include <websocketpp/server.hpp>
 
+#include <verbit/streaming/media_encoder.h>
+#include <verbit/streaming/session_capture.h>
+
 #define LATENCY 250
 //#define ATMOSPHERICS
 //#define NO_LABELS
@@ -27,13 +36,92 @@ using websocketpp::lib::placeholders::_1;
 using websocketpp::lib::placeholders::_2;
 using websocketpp::lib::bind;
 
-// NOTE this breaks if more than one client connects to us simultaneously
+// per-connection state, so that many clients can stream to us simultaneously
+struct session_state {
+	bool media_seen = false;
+	size_t seen_bytes = 0;
+	size_t sent_resp_bytes = 0;
+	bool translation_service = false;
+	std::string query;
+	size_t drop_after = 0;
+	// with `stall_ms=<ms>` in its query, a connection stops reading for that long once its
+	// first media arrives, so the client's send queue backs up, to simulate a congested uplink
+	int stall_ms = 0;
+	// PCM media rate (S16LE), from the `sample_rate` and `num_channels` query parameters
+	size_t bytes_per_second = 32000;
+	// encoded media (`format=FLAC` or `OPUS`) is decoded, so it is counted and dumped as PCM
+	std::shared_ptr<verbit::streaming::MediaDecoder> decoder;
+};
+std::map<websocketpp::connection_hdl, session_state, std::owner_less<websocketpp::connection_hdl>> sessions;
+
+// a connection with `drop_after=<bytes>` in its query is closed with 1011 once it has sent
+// that much media, to simulate a dropped connection; only once per query, so reconnects succeed
+std::set<std::string> dropped_queries;
+
+// NOTE only one connection at a time (the first one opened while no other
+// connection is dumping) has its received media dumped to this file
 #define DUMP_FILENAME "/tmp/wss_test_server.bin"
-std::chrono::time_point<std::chrono::system_clock> media_start;
-size_t seen_bytes;
-size_t sent_resp_bytes;
+std::string dump_filename = DUMP_FILENAME;
 std::ofstream dump_file;
-bool translation_service;
+websocketpp::connection_hdl dump_hdl;
+
+bool is_dumping(websocketpp::connection_hdl hdl)
+{
+	return !dump_hdl.owner_before(hdl) && !hdl.owner_before(dump_hdl) && !dump_hdl.expired();
+}
+
+// in replay mode (`-r capture`), every session is answered with the responses of a
+// session capture (see `SessionRecorder`) instead of fake ones: each is sent when as much
+// time has passed since the session's first media as had in the capture (or at once, with `-f`)
+struct replay_response {
+	const char* data;
+	size_t length;
+	long delay_ms;
+};
+std::unique_ptr<verbit::streaming::SessionCapture> replay_capture;
+std::vector<replay_response> replay_responses;
+bool replay_fast = false;
+
+void load_replay(const std::string& path)
+{
+	using verbit::streaming::CaptureRecord;
+	replay_capture.reset(new verbit::streaming::SessionCapture(path));
+	CaptureRecord record;
+	bool media_seen = false;
+	uint64_t media_start_us = 0;
+	while (replay_capture->next(record)) {
+		if ( (record.kind == CaptureRecord::media) && !media_seen ) {
+			media_seen = true;
+			media_start_us = record.time_us;
+		} else if (record.kind == CaptureRecord::response) {
+			long delay_ms = (record.time_us > media_start_us) ? (long)((record.time_us - media_start_us) / 1000) : 0;
+			replay_responses.push_back(replay_response {record.data, record.length, delay_ms});
+		}
+	}
+	std::cout << "replaying " << replay_responses.size() << " responses from " << path << std::endl;
+}
+
+void send_replay(wspp_server* s, websocketpp::connection_hdl hdl)
+{
+	for (const replay_response& response : replay_responses) {
+		if (replay_fast) {
+			websocketpp::lib::error_code send_ec;
+			s->send(hdl, response.data, response.length, websocketpp::frame::opcode::text, send_ec);
+			if (send_ec) {
+				std::cerr << "replay send failed: " << "(" << send_ec.message() << ")" << std::endl;
+				return;
+			}
+			continue;
+		}
+		s->set_timer(response.delay_ms, [s, hdl, response](websocketpp::lib::error_code const & ec) {
+			websocketpp::lib::error_code send_ec;
+			s->send(hdl, response.data, response.length, websocketpp::frame::opcode::text, send_ec);
+			if (send_ec) {
+				std::cerr << "replay send failed: " << "(" << send_ec.message() << ")" << std::endl;
+			}
+		});
+	}
+}
 
 #define PIDFILE "/tmp/wss_test_server.pid"
 
@@ -103,13 +191,30 @@ bool on_validate(wspp_server* s, websocketpp::connection_hdl hdl) {
 		return false;
 	}
 	if (auth_hdr.find("LANG") == std::string::npos) {
-		translation_service = false;
+		sessions[hdl].translation_service = false;
 	} else {
-		translation_service = true;
+		sessions[hdl].translation_service = true;
 	}
 	return true;
 }
 
+// Return the value of a parameter in a URL query, or "" if it is not there.
+std::string query_param(const std::string& query, const std::string& name)
+{
+	size_t pos = 0;
+	while (pos < query.size()) {
+		size_t end = query.find('&', pos);
+		if (end == std::string::npos) {
+			end = query.size();
+		}
+		if (query.compare(pos, name.size() + 1, name + "=") == 0) {
+			return query.substr(pos + name.size() + 1, end - pos - name.size() - 1);
+		}
+		pos = end + 1;
+	}
+	return "";
+}
+
 void on_open(wspp_server* s, websocketpp::connection_hdl hdl) {
 	wspp_server::connection_ptr con = s->get_con_from_hdl(hdl);
 	websocketpp::uri_ptr uri = con->get_uri();
@@ -118,18 +223,39 @@ void on_open(wspp_server* s, websocketpp::connection_hdl hdl) {
 	std::cout << "on_open query = " << query << std::endl;
 	std::string req_body = con->get_request_body();
 	std::cout << "on_open request_body = " << req_body << std::endl;
-	seen_bytes = 0;
-	sent_resp_bytes = 0;
-
-	// (re)open file
-	if (dump_file.is_open()) {
-		dump_file.close();
-		::unlink(DUMP_FILENAME);
+	session_state& session = sessions[hdl];
+	session.media_seen = false;
+	session.seen_bytes = 0;
+	session.sent_resp_bytes = 0;
+	session.query = query;
+	size_t drop_pos = query.find("drop_after=");
+	if (drop_pos != std::string::npos) {
+		session.drop_after = atol(query.c_str() + drop_pos + 11);
+	}
+	session.stall_ms = atoi(query_param(query, "stall_ms").c_str());
+	int sample_rate = atoi(query_param(query, "sample_rate").c_str());
+	int num_channels = atoi(query_param(query, "num_channels").c_str());
+	session.bytes_per_second = 2 * (sample_rate > 0 ? sample_rate : 16000) * (num_channels > 0 ? num_channels : 1);
+	std::string format = query_param(query, "format");
+	session.decoder = verbit::streaming::MediaDecoder::create(format, sample_rate, num_channels);
+	if (session.decoder) {
+		std::cout << "on_open decoding " << format << " media" << std::endl;
+	} else if ( (format == "FLAC") || (format == "OPUS") ) {
+		std::cerr << "on_open can't decode " << format << " media (not built with it)" << std::endl;
 	}
-	dump_file.exceptions(std::ofstream::badbit);
-	dump_file.open(DUMP_FILENAME, std::ios::binary);
-	if (dump_file.fail()) {
-		throw std::runtime_error(std::string("can't open ") + DUMP_FILENAME + ": " + strerror(errno));
+
+	// (re)open file, unless another connection is still dumping to it
+	if (dump_hdl.expired() || !dump_file.is_open()) {
+		if (dump_file.is_open()) {
+			dump_file.close();
+		}
+		::unlink(dump_filename.c_str());
+		dump_file.exceptions(std::ofstream::badbit);
+		dump_file.open(dump_filename, std::ios::binary);
+		if (dump_file.fail()) {
+			throw std::runtime_error(std::string("can't open ") + dump_filename + ": " + strerror(errno));
+		}
+		dump_hdl = hdl;
 	}
 }
 
@@ -183,13 +309,15 @@ stringVector tokenize(std::string line)
 	return tokens;
 }
 
-std::string response_items(std::string transcript, std::string speaker_id)
+// NOTE responses are built when they are triggered, and then sent after a
+// simulated LATENCY; so item times are simply the media time at the trigger:
+// the items are 20ms apart, and the last one ends at the media seen so far
+std::string response_items(const session_state& session, std::string transcript, std::string speaker_id)
 {
 	stringVector words = tokenize(transcript);
 	std::string r_items;
-	std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
-	auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now - media_start);
-	long tick = milliseconds.count() - LATENCY;
+	long media_ms = (long)(session.seen_bytes * 1000 / session.bytes_per_second);
+	long tick = std::max(0L, media_ms - 7 - 20 * (long)(words.size() - 1));
 	for (const std::string &word: words) {
 		if (!r_items.empty()) {
 			r_items += ",";
@@ -225,8 +353,9 @@ std::string response_items(std::string transcript, std::string speaker_id)
 int didApplause = false;
 #endif
 
-std::string response_json(bool eos, std::string lang)
+std::string response_json(session_state& session, bool eos, std::string lang)
 {
+	size_t seen_bytes = session.seen_bytes;
 	std::string transcript;
 	std::string language_code;
 	// NB punct (final period) must be separate token
@@ -266,9 +395,9 @@ std::string response_json(bool eos, std::string lang)
 		didApplause = true;
 	}
 #endif
-	std::string items = response_items(transcript.substr(0, transcript.length() - 1), speaker_uuid);
+	std::string items = response_items(session, transcript.substr(0, transcript.length() - 1), speaker_uuid);
 	std::string service_type;
-	if (translation_service) {
+	if (session.translation_service) {
 		service_type = "translation";
 	} else {
 		service_type = "transcription";
@@ -303,54 +432,97 @@ std::string response_json(bool eos, std::string lang)
 		"\"items\":[" + items + "]" +
 		"}]}}";
 	delete uuid_p;
-	sent_resp_bytes = seen_bytes;
+	session.sent_resp_bytes = seen_bytes;
 	return json;
 }
 
+// simulate delay from producing captions, without stalling the other connections
+void send_delayed(wspp_server* s, websocketpp::connection_hdl hdl, std::string json, std::string what)
+{
+	s->set_timer(LATENCY, [s, hdl, json, what](websocketpp::lib::error_code const & ec) {
+		websocketpp::lib::error_code send_ec;
+		s->send(hdl, json, websocketpp::frame::opcode::text, send_ec);
+		if (send_ec) {
+			std::cerr << what << " send failed: " << "(" << send_ec.message() << ")" << std::endl;
+		} else {
+			std::cout << what << " replied w/text: " << json << std::endl;
+		}
+	});
+}
+
 void on_message_text(wspp_server* s, websocketpp::connection_hdl hdl, wspp_server::message_ptr msg) {
 	size_t payload_len = msg->get_payload().length();
 	std::cout << "on_message (text) called: frame_type " << _frame_type_str(msg->get_opcode(), msg->get_compressed(), msg->get_fin())
 		<< " payload_len " << std::to_string(payload_len) << std::endl;
-	if (payload_len > 0) {
+	if ( (payload_len > 0) && !replay_capture ) {
 		// assume this is the special "EOS" JSON event message;
 		// reply with a response that has `is_end_of_stream=true`
-		std::string json = response_json(true, "en-US");
-		s->send(hdl, json, websocketpp::frame::opcode::text);
-		std::cout << "on_message (text) replied w/text: " << json << std::endl;
+		// (delayed too, so that it can't overtake a pending captions response)
+		std::string json = response_json(sessions[hdl], true, "en-US");
+		if (query_param(sessions[hdl].query, "malformed") == "1") {
+			json.resize(json.size() / 2);
+		}
+		send_delayed(s, hdl, json, "on_message (text)");
 	}
 }
 
 void on_message_binary(wspp_server* s, websocketpp::connection_hdl hdl, wspp_server::message_ptr msg) {
-	if (seen_bytes == 0) {
-		media_start = std::chrono::system_clock::now();
+	session_state& session = sessions[hdl];
+	if (!session.media_seen) {
+		session.media_seen = true;
+		if (replay_capture) {
+			send_replay(s, hdl);
+		}
+		if (session.stall_ms > 0) {
+			std::cout << "on_message (binary) not reading for " << session.stall_ms << "ms" << std::endl;
+			wspp_server::connection_ptr con = s->get_con_from_hdl(hdl);
+			con->pause_reading();
+			s->set_timer(session.stall_ms, [con](websocketpp::lib::error_code const & ec) {
+				con->resume_reading();
+			});
+		}
 	}
-	size_t payload_len = msg->get_payload().length();
-	seen_bytes += payload_len;
+	const std::string* media = &msg->get_payload();
+	std::string decoded;
+	if (session.decoder) {
+		try {
+			session.decoder->decode(media->data(), media->size(), decoded);
+		} catch (std::exception& e) {
+			std::cerr << "on_message (binary) can't decode media: " << e.what() << std::endl;
+			websocketpp::lib::error_code ec;
+			s->close(hdl, websocketpp::close::status::invalid_payload, e.what(), ec);
+			return;
+		}
+		media = &decoded;
+	}
+	size_t payload_len = media->length();
+	session.seen_bytes += payload_len;
 #if defined(VERBOSE_DEBUG)
 	std::cout << "on_message (binary) called: frame_type " << _frame_type_str(msg->get_opcode(), msg->get_compressed(), msg->get_fin())
-		<< " payload_len " << std::to_string(payload_len)
-		<< " seen_bytes " << std::to_string(seen_bytes) << std::endl;
+		<< " payload_len " << std::to_string(msg->get_payload().length())
+		<< " seen_bytes " << std::to_string(session.seen_bytes) << std::endl;
 #endif
-	if (payload_len > 0) {
-		dump_file.write(msg->get_payload().c_str(), payload_len);
+	if (payload_len > 0 && is_dumping(hdl)) {
+		dump_file.write(media->c_str(), payload_len);
 	}
 
-	if ((seen_bytes - sent_resp_bytes) >= 32000) {  // 1 sec
-		// simulate delay from producing captions:
-		std::this_thread::sleep_for(std::chrono::milliseconds(LATENCY));
-		try {
-			std::string json;
-			if (translation_service) {
-				json = response_json(false, "es-ES");
-				s->send(hdl, json, websocketpp::frame::opcode::text);
-				std::cout << "on_message (binary) replied w/text (es-ES): " << json << std::endl;
-			}
-			json = response_json(false, "en-US");
-			s->send(hdl, json, websocketpp::frame::opcode::text);
-			std::cout << "on_message (binary) replied w/text (en-US): " << json << std::endl;
-		} catch (websocketpp::exception const & e) {
-			std::cerr << "on_message (binary) send failed: " << "(" << e.what() << ")" << std::endl;
+	if ((session.drop_after > 0) && (session.seen_bytes >= session.drop_after) &&
+		(dropped_queries.count(session.query) == 0)) {
+		dropped_queries.insert(session.query);
+		std::cout << "on_message (binary) dropping connection after " << session.seen_bytes << " bytes" << std::endl;
+		websocketpp::lib::error_code ec;
+		s->close(hdl, websocketpp::close::status::internal_endpoint_error, "simulated drop", ec);
+		return;
+	}
+
+	if ( !replay_capture && ((session.seen_bytes - session.sent_resp_bytes) >= 32000) ) {  // 1 sec
+		std::string json;
+		if (session.translation_service) {
+			json = response_json(session, false, "es-ES");
+			send_delayed(s, hdl, json, "on_message (binary) (es-ES)");
 		}
+		json = response_json(session, false, "en-US");
+		send_delayed(s, hdl, json, "on_message (binary) (en-US)");
 	}
 }
 
@@ -368,7 +540,11 @@ void on_message(wspp_server* s, websocketpp::connection_hdl hdl, wspp_server::me
 
 void on_close(wspp_server* s, websocketpp::connection_hdl hdl) {
 	std::cout << "on_close called" << std::endl;
-	dump_file.close();
+	if (is_dumping(hdl)) {
+		dump_file.close();
+		dump_hdl.reset();
+	}
+	sessions.erase(hdl);
 }
 
 void pidlock(char* arg0) {
@@ -403,13 +579,47 @@ void sighandler(int sig) {
 	}
 }
 
+void usage(char* arg0)
+{
+	std::cerr << "Usage: " << arg0 << " [ -r capture [ -f ] ] [ -d dumpfile ] [ port ]" << std::endl;
+	std::cerr << "  -r  answer every session with the responses of a session capture, with their original timing" << std::endl;
+	std::cerr << "  -f  (with -r) send the captured responses as fast as possible" << std::endl;
+	std::cerr << "  -d  dump the received media to dumpfile (default " << DUMP_FILENAME << ")" << std::endl;
+}
+
 int main(int argc, char** argv)
 {
 	wspp_server test_server;
 	int port = 9002;
-
-	if (argc > 1) {
-		port = atoi(argv[1]);
+	std::string replay_path;
+
+	int c;
+	while ((c = getopt(argc, argv, "?hr:fd:")) != -1) {
+		switch (c) {
+		case 'r':
+			replay_path = optarg;
+			break;
+		case 'f':
+			replay_fast = true;
+			break;
+		case 'd':
+			dump_filename = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return EX_USAGE;
+		}
+	}
+	if (optind < argc) {
+		port = atoi(argv[optind]);
+	}
+	if (!replay_path.empty()) {
+		try {
+			load_replay(replay_path);
+		} catch (std::exception& e) {
+			std::cerr << argv[0] << ": " << e.what() << std::endl;
+			return EX_NOINPUT;
+		}
 	}
 	signal(SIGHUP, sighandler);
 	signal(SIGINT, sighandler);
@@ -0,0 +1,158 @@
+#include <iostream>
+
+#include "timer_wheel_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TimerWheelTest);
+
+namespace {
+
+const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+std::chrono::steady_clock::time_point at_ms(long ms)
+{
+	return t0 + std::chrono::milliseconds(ms);
+}
+
+} // anonymous namespace
+
+void TimerWheelTest::test_ctor()
+{
+	TimerWheel wheel {std::chrono::milliseconds(10), t0};
+	CPPUNIT_ASSERT_MESSAGE("ctor resolution", wheel.resolution() == std::chrono::milliseconds(10));
+	CPPUNIT_ASSERT_MESSAGE("ctor size", wheel.size() == 0);
+	CPPUNIT_ASSERT_THROW_MESSAGE("ctor zero resolution", TimerWheel(std::chrono::milliseconds(0)), std::runtime_error);
+}
+
+void TimerWheelTest::test_fire()
+{
+	TimerWheel wheel {std::chrono::milliseconds(10), t0};
+	WheelTimer timer;
+	int fired = 0;
+	wheel.arm(timer, std::chrono::milliseconds(50), [&fired]{ fired++; });
+	CPPUNIT_ASSERT_MESSAGE("fire armed", timer.armed());
+	CPPUNIT_ASSERT_MESSAGE("fire size", wheel.size() == 1);
+	wheel.advance(at_ms(49));
+	CPPUNIT_ASSERT_MESSAGE("fire not early", fired == 0);
+	CPPUNIT_ASSERT_MESSAGE("fire advance count", wheel.advance(at_ms(50)) == 1);
+	CPPUNIT_ASSERT_MESSAGE("fire on time", fired == 1);
+	CPPUNIT_ASSERT_MESSAGE("fire disarmed", !timer.armed());
+	CPPUNIT_ASSERT_MESSAGE("fire size after", wheel.size() == 0);
+	wheel.advance(at_ms(1000));
+	CPPUNIT_ASSERT_MESSAGE("fire only once", fired == 1);
+}
+
+void TimerWheelTest::test_round_up()
+{
+	TimerWheel wheel {std::chrono::milliseconds(10), t0};
+	WheelTimer timer;
+	int fired = 0;
+	wheel.arm(timer, std::chrono::milliseconds(0), [&fired]{ fired++; });
+	wheel.advance(at_ms(9));
+	CPPUNIT_ASSERT_MESSAGE("round_up zero delay not in same tick", fired == 0);
+	wheel.advance(at_ms(10));
+	CPPUNIT_ASSERT_MESSAGE("round_up zero delay next tick", fired == 1);
+	wheel.arm(timer, std::chrono::milliseconds(11), [&fired]{ fired++; });
+	wheel.advance(at_ms(29));
+	CPPUNIT_ASSERT_MESSAGE("round_up partial tick", fired == 1);
+	wheel.advance(at_ms(30));
+	CPPUNIT_ASSERT_MESSAGE("round_up partial tick fired", fired == 2);
+}
+
+void TimerWheelTest::test_cancel()
+{
+	TimerWheel wheel {std::chrono::milliseconds(10), t0};
+	WheelTimer timer;
+	int fired = 0;
+	wheel.arm(timer, std::chrono::milliseconds(50), [&fired]{ fired++; });
+	CPPUNIT_ASSERT_MESSAGE("cancel armed", wheel.cancel(timer));
+	CPPUNIT_ASSERT_MESSAGE("cancel not armed", !wheel.cancel(timer));
+	CPPUNIT_ASSERT_MESSAGE("cancel size", wheel.size() == 0);
+	wheel.advance(at_ms(1000));
+	CPPUNIT_ASSERT_MESSAGE("cancel did not fire", fired == 0);
+}
+
+void TimerWheelTest::test_rearm()
+{
+	TimerWheel wheel {std::chrono::milliseconds(10), t0};
+	WheelTimer timer;
+	int fired = 0;
+	wheel.arm(timer, std::chrono::milliseconds(50), [&fired]{ fired++; });
+	wheel.arm(timer, std::chrono::milliseconds(100), [&fired]{ fired += 10; });
+	CPPUNIT_ASSERT_MESSAGE("rearm size", wheel.size() == 1);
+	wheel.advance(at_ms(99));
+	CPPUNIT_ASSERT_MESSAGE("rearm moved", fired == 0);
+	wheel.advance(at_ms(100));
+	CPPUNIT_ASSERT_MESSAGE("rearm new callback", fired == 10);
+}
+
+void TimerWheelTest::test_rearm_from_callback()
+{
+	TimerWheel wheel {std::chrono::milliseconds(10), t0};
+	WheelTimer timer;
+	int fired = 0;
+	std::function<void()> periodic = [&]{
+		fired++;
+		wheel.arm(timer, std::chrono::milliseconds(100), periodic);
+	};
+	wheel.arm(timer, std::chrono::milliseconds(100), periodic);
+	wheel.advance(at_ms(1050));
+	CPPUNIT_ASSERT_MESSAGE("rearm_from_callback count", fired == 10);
+	CPPUNIT_ASSERT_MESSAGE("rearm_from_callback armed", timer.armed());
+	wheel.cancel(timer);
+}
+
+void TimerWheelTest::test_cascade()
+{
+	TimerWheel wheel {std::chrono::milliseconds(1), t0};
+	const int N = 8;
+	const long delays[N] = {63, 64, 65, 4095, 4096, 4097, 262143, 300001};
+	WheelTimer timers[N];
+	long fired_at[N];
+	for (int i = 0; i < N; i++) {
+		fired_at[i] = -1;
+		long* slot = &fired_at[i];
+		wheel.arm(timers[i], std::chrono::milliseconds(delays[i]), [slot, i, &delays]{ *slot = delays[i]; });
+	}
+	// advance in irregular steps, checking that nothing fires early or late
+	for (long ms = 1; ms <= 300001; ms += 7) {
+		wheel.advance(at_ms(ms));
+		for (int i = 0; i < N; i++) {
+			if (delays[i] <= ms) {
+				CPPUNIT_ASSERT_MESSAGE("cascade fired", fired_at[i] == delays[i]);
+			} else {
+				CPPUNIT_ASSERT_MESSAGE("cascade not early", fired_at[i] == -1);
+			}
+		}
+	}
+	wheel.advance(at_ms(300010));
+	CPPUNIT_ASSERT_MESSAGE("cascade all fired", wheel.size() == 0);
+}
+
+void TimerWheelTest::test_beyond_range()
+{
+	TimerWheel wheel {std::chrono::milliseconds(1000), t0};
+	WheelTimer timer;
+	int fired = 0;
+	// 64^4 ticks of 1s is ~194 days; arm further out than that
+	long long ticks = (1LL << (TimerWheel::LEVEL_BITS * TimerWheel::LEVELS)) + 100;
+	wheel.arm(timer, std::chrono::milliseconds(ticks * 1000), [&fired]{ fired++; });
+	wheel.advance(t0 + std::chrono::seconds(ticks - 1));
+	CPPUNIT_ASSERT_MESSAGE("beyond_range not early", fired == 0);
+	wheel.advance(t0 + std::chrono::seconds(ticks));
+	CPPUNIT_ASSERT_MESSAGE("beyond_range fired", fired == 1);
+}
+
+void TimerWheelTest::test_timer_dtor()
+{
+	TimerWheel wheel {std::chrono::milliseconds(10), t0};
+	int fired = 0;
+	{
+		WheelTimer timer;
+		wheel.arm(timer, std::chrono::milliseconds(50), [&fired]{ fired++; });
+	}
+	CPPUNIT_ASSERT_MESSAGE("timer_dtor size", wheel.size() == 0);
+	wheel.advance(at_ms(1000));
+	CPPUNIT_ASSERT_MESSAGE("timer_dtor did not fire", fired == 0);
+}
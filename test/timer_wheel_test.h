@@ -0,0 +1,33 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/timer_wheel.h>
+
+/**
+ * Unit tests for `TimerWheel` class.
+ */
+class TimerWheelTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TimerWheelTest);
+
+	CPPUNIT_TEST(test_ctor);
+	CPPUNIT_TEST(test_fire);
+	CPPUNIT_TEST(test_round_up);
+	CPPUNIT_TEST(test_cancel);
+	CPPUNIT_TEST(test_rearm);
+	CPPUNIT_TEST(test_rearm_from_callback);
+	CPPUNIT_TEST(test_cascade);
+	CPPUNIT_TEST(test_beyond_range);
+	CPPUNIT_TEST(test_timer_dtor);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_ctor();
+	void test_fire();
+	void test_round_up();
+	void test_cancel();
+	void test_rearm();
+	void test_rearm_from_callback();
+	void test_cascade();
+	void test_beyond_range();
+	void test_timer_dtor();
+};
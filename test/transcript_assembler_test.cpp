@@ -0,0 +1,203 @@
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "transcript_assembler_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TranscriptAssemblerTest);
+
+namespace {
+
+StringRef string_ref(const std::string& s)
+{
+	StringRef r;
+	r.data = s.data();
+	r.length = s.length();
+	return r;
+}
+
+// builds a response of one alternative, with a word every 0.1s from `start`,
+// holding the strings it refers to
+class Message
+{
+public:
+	Message(const std::string& type, const std::string& id, const std::vector<std::string>& words,
+		double start, bool is_final)
+		: _type(type), _id(id), _words(words), _kind("text"), _speaker("1")
+	{
+		for (const std::string& word : _words) {
+			_transcript += (_transcript.empty() ? "" : " ") + word;
+		}
+		for (size_t i = 0; i < _words.size(); i++) {
+			Item item;
+			item.kind = string_ref(_kind);
+			item.value = string_ref(_words[i]);
+			item.speaker_id = string_ref(_speaker);
+			item.start = start + 0.1 * i;
+			item.end = item.start + 0.05;
+			_items.push_back(item);
+		}
+		response.has_response = true;
+		response.type = string_ref(_type);
+		response.id = string_ref(_id);
+		response.is_final = is_final;
+		Alternative alternative;
+		alternative.transcript = string_ref(_transcript);
+		alternative.items.data = _items.data();
+		alternative.items.count = _items.size();
+		response.alternatives.push_back(alternative);
+	}
+
+	Response response;
+
+private:
+	std::string _type;
+	std::string _id;
+	std::vector<std::string> _words;
+	std::string _kind;
+	std::string _speaker;
+	std::string _transcript;
+	std::vector<Item> _items;
+};
+
+void add(TranscriptAssembler& assembler, const std::string& id, const std::vector<std::string>& words,
+	double start, bool is_final, const std::string& type = "transcript")
+{
+	Message message(type, id, words, start, is_final);
+	assembler.add(message.response);
+}
+
+} // anonymous namespace
+
+void TranscriptAssemblerTest::test_ctor_invalid()
+{
+	CPPUNIT_ASSERT_THROW_MESSAGE("both types", TranscriptAssembler(ResponseType::Transcript | ResponseType::Captions),
+		std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("no type", TranscriptAssembler(0), std::runtime_error);
+}
+
+void TranscriptAssemblerTest::test_partials_and_finals()
+{
+	TranscriptAssembler assembler;
+	add(assembler, "u1", {"hello"}, 0.0, false);
+	add(assembler, "u1", {"hello", "there"}, 0.0, false);
+
+	TranscriptSnapshot snapshot = assembler.snapshot();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("no finals yet", (size_t)0, snapshot.size());
+	CPPUNIT_ASSERT_MESSAGE("open", snapshot.open() != nullptr);
+	CPPUNIT_ASSERT_MESSAGE("open transcript", snapshot.open()->transcript == "hello there");
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("open items", (size_t)2, snapshot.open()->items.size());
+	CPPUNIT_ASSERT_MESSAGE("open text", snapshot.text() == "hello there");
+
+	add(assembler, "u1", {"hello", "there", "."}, 0.0, true);
+	add(assembler, "u2", {"general"}, 1.0, false);
+	snapshot = assembler.snapshot();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("one final", (size_t)1, snapshot.size());
+	CPPUNIT_ASSERT_MESSAGE("final id", snapshot[0].id == "u1");
+	CPPUNIT_ASSERT_MESSAGE("final transcript", snapshot[0].transcript == "hello there .");
+	CPPUNIT_ASSERT_MESSAGE("final start", snapshot[0].start == 0.0);
+	CPPUNIT_ASSERT_MESSAGE("final end", (snapshot[0].end > 0.24) && (snapshot[0].end < 0.26));
+	CPPUNIT_ASSERT_MESSAGE("final item", snapshot[0].items[1].value == "there");
+	CPPUNIT_ASSERT_MESSAGE("final item kind", snapshot[0].items[1].kind == "text");
+	CPPUNIT_ASSERT_MESSAGE("final item speaker", snapshot[0].items[1].speaker_id == "1");
+	CPPUNIT_ASSERT_MESSAGE("second open", snapshot.open()->id == "u2");
+	CPPUNIT_ASSERT_MESSAGE("text", snapshot.text() == "hello there . general");
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("item count", (size_t)3, assembler.item_count());
+
+	// end-of-stream closes the open utterance, like a final
+	Message eos("transcript", "u2", {"general", "kenobi"}, 1.0, false);
+	eos.response.is_end_of_stream = true;
+	assembler.add(eos.response);
+	snapshot = assembler.snapshot();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("eos final", (size_t)2, snapshot.size());
+	CPPUNIT_ASSERT_MESSAGE("eos no open", snapshot.open() == nullptr);
+	CPPUNIT_ASSERT_MESSAGE("eos text", snapshot.text() == "hello there . general kenobi");
+}
+
+void TranscriptAssemblerTest::test_other_types()
+{
+	TranscriptAssembler assembler {ResponseType::Captions};
+	add(assembler, "t1", {"transcript"}, 0.0, true, "transcript");
+	add(assembler, "c1", {"caption"}, 0.0, true, "captions");
+	Response none;
+	assembler.add(none);
+	TranscriptSnapshot snapshot = assembler.snapshot();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("captions only", (size_t)1, snapshot.size());
+	CPPUNIT_ASSERT_MESSAGE("captions id", snapshot[0].id == "c1");
+}
+
+void TranscriptAssemblerTest::test_snapshot_unchanged()
+{
+	TranscriptAssembler assembler;
+	add(assembler, "u1", {"one"}, 0.0, true);
+	add(assembler, "u2", {"two"}, 1.0, false);
+	TranscriptSnapshot before = assembler.snapshot();
+
+	// later responses (including partials rebuilding the open utterance) leave it as it was
+	add(assembler, "u2", {"two", "too"}, 1.0, false);
+	add(assembler, "u2", {"two", "too", "to"}, 1.0, false);
+	add(assembler, "u2", {"two", "too", "to", "."}, 1.0, true);
+	for (int i = 0; i < 1000; i++) {
+		add(assembler, "u" + std::to_string(i + 3), {"more"}, 2.0 + i, true);
+	}
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("before size", (size_t)1, before.size());
+	CPPUNIT_ASSERT_MESSAGE("before final", before[0].transcript == "one");
+	CPPUNIT_ASSERT_MESSAGE("before open", before.open()->transcript == "two");
+	CPPUNIT_ASSERT_MESSAGE("before text", before.text() == "one two");
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("after size", (size_t)1002, assembler.size());
+	CPPUNIT_ASSERT_MESSAGE("after final", assembler.snapshot()[1].transcript == "two too to .");
+}
+
+void TranscriptAssemblerTest::test_time_range()
+{
+	TranscriptAssembler assembler;
+	// utterances at 0s, 10s, 20s ... 90s, of words at +0.0, +0.1, +0.2 (each 0.05s long)
+	for (int i = 0; i < 10; i++) {
+		add(assembler, "u" + std::to_string(i), {"w" + std::to_string(i) + "a", "w" + std::to_string(i) + "b",
+			"w" + std::to_string(i) + "c"}, 10.0 * i, true);
+	}
+	add(assembler, "open", {"o1", "o2"}, 100.0, false);
+	TranscriptSnapshot snapshot = assembler.snapshot();
+
+	std::pair<size_t, size_t> range = snapshot.find(15.0, 35.0);
+	CPPUNIT_ASSERT_MESSAGE("find", (range.first == 2) && (range.second == 4));
+	range = snapshot.find(20.22, 20.23);
+	CPPUNIT_ASSERT_MESSAGE("find inside", (range.first == 2) && (range.second == 3));
+	range = snapshot.find(25.0, 26.0);
+	CPPUNIT_ASSERT_MESSAGE("find gap", range.first == range.second);
+	range = snapshot.find(-10.0, 1000.0);
+	CPPUNIT_ASSERT_MESSAGE("find all", (range.first == 0) && (range.second == 10));
+
+	std::vector<Item> items = snapshot.items(20.12, 30.01);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("items count", (size_t)3, items.size());
+	CPPUNIT_ASSERT_MESSAGE("items first", items[0].value == "w2b");
+	CPPUNIT_ASSERT_MESSAGE("items last", items[2].value == "w3a");
+
+	items = snapshot.items(95.0, 101.0);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("open items", (size_t)2, items.size());
+	CPPUNIT_ASSERT_MESSAGE("open item", items[1].value == "o2");
+}
+
+void TranscriptAssemblerTest::test_many_utterances()
+{
+	// enough utterances and text for several blocks of each kind
+	TranscriptAssembler assembler;
+	std::string word(100, 'x');
+	for (int i = 0; i < 5000; i++) {
+		add(assembler, "u" + std::to_string(i), {word, std::to_string(i)}, i, false);
+		add(assembler, "u" + std::to_string(i), {word, std::to_string(i), "."}, i, true);
+	}
+	TranscriptSnapshot snapshot = assembler.snapshot();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("count", (size_t)5000, snapshot.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("items", (size_t)15000, assembler.item_count());
+	for (int i = 0; i < 5000; i += 499) {
+		CPPUNIT_ASSERT_MESSAGE("utterance item", snapshot[i].items[1].value == std::to_string(i).c_str());
+		CPPUNIT_ASSERT_MESSAGE("utterance start", snapshot[i].start == i);
+	}
+	std::vector<Item> items = snapshot.items(4321.0, 4321.3);
+	CPPUNIT_ASSERT_MESSAGE("range", (items.size() == 3) && (items[1].value == "4321"));
+}
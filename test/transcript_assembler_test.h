@@ -0,0 +1,27 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/transcript_assembler.h>
+
+/**
+ * Unit tests for `TranscriptAssembler` class.
+ */
+class TranscriptAssemblerTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TranscriptAssemblerTest);
+
+	CPPUNIT_TEST(test_ctor_invalid);
+	CPPUNIT_TEST(test_partials_and_finals);
+	CPPUNIT_TEST(test_other_types);
+	CPPUNIT_TEST(test_snapshot_unchanged);
+	CPPUNIT_TEST(test_time_range);
+	CPPUNIT_TEST(test_many_utterances);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_ctor_invalid();
+	void test_partials_and_finals();
+	void test_other_types();
+	void test_snapshot_unchanged();
+	void test_time_range();
+	void test_many_utterances();
+};
@@ -0,0 +1,268 @@
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "voice_gate_test.h"
+
+using namespace verbit::streaming;
+
+CPPUNIT_TEST_SUITE_REGISTRATION(VoiceGateTest);
+
+namespace {
+
+const int RATE = 16000;
+
+// S16LE media builders, appending `seconds` of a signal to `media`
+
+void silence(std::string& media, double seconds)
+{
+	media.append((size_t)(RATE * seconds) * 2, '\0');
+}
+
+void append_sample(std::string& media, int value)
+{
+	int16_t sample = (int16_t)value;
+	media.append(reinterpret_cast<const char*>(&sample), 2);
+}
+
+void tone(std::string& media, double seconds, double frequency, double amplitude)
+{
+	for (size_t i = 0; i < (size_t)(RATE * seconds); i++) {
+		append_sample(media, (int)lrint(amplitude * std::sin(2 * M_PI * frequency * i / RATE)));
+	}
+}
+
+// uniform white noise in `[-amplitude, amplitude]`
+void hiss(std::string& media, double seconds, int amplitude)
+{
+	uint32_t state = 12345;
+	for (size_t i = 0; i < (size_t)(RATE * seconds); i++) {
+		state = state * 1664525 + 1013904223;
+		append_sample(media, (int)((state >> 16) % (2 * amplitude + 1)) - amplitude);
+	}
+}
+
+// gate media in chunks of `chunk` bytes, and return what is passed on
+std::string gate_media(VoiceGate& gate, const std::string& media, size_t chunk)
+{
+	std::string out;
+	for (size_t pos = 0; pos < media.size(); pos += chunk) {
+		std::string payload = media.substr(pos, chunk);
+		gate.process(payload);
+		out += payload;
+	}
+	return out;
+}
+
+VoiceGateConfig drop_config()
+{
+	VoiceGateConfig config;
+	config.mode = VoiceGateConfig::gate_drop;
+	return config;
+}
+
+} // anonymous namespace
+
+void VoiceGateTest::test_analyse()
+{
+	const SampleConverter::Isa isas[] = { SampleConverter::isa_scalar, SampleConverter::isa_sse2, SampleConverter::isa_avx2 };
+	std::vector<int16_t> samples(20007);
+	uint32_t state = 1;
+	for (size_t i = 0; i < samples.size(); i++) {
+		state = state * 1664525 + 1013904223;
+		samples[i] = (int16_t)(state >> 16);
+	}
+	samples[100] = -32768;
+	samples[101] = -32768;
+	samples[102] = 32767;
+	for (size_t stride : {1, 2, 6}) {
+		std::vector<int16_t> prev(samples.end() - stride, samples.end());
+		for (size_t n : {0, 1, 5, 17, 40, 103, 20007}) {
+			uint64_t energy = 0;
+			uint64_t crossings = 0;
+			for (size_t i = 0; i < n; i++) {
+				int16_t p = (i < stride) ? prev[i] : samples[i - stride];
+				energy += (uint64_t)((int64_t)samples[i] * samples[i]);
+				crossings += ((samples[i] < 0) != (p < 0)) ? 1 : 0;
+			}
+			for (SampleConverter::Isa isa : isas) {
+				if (!SampleConverter::supported(isa)) {
+					continue;
+				}
+				std::string message = std::string(SampleConverter::isa_name(isa)) + ", stride " + std::to_string(stride)
+					+ ", " + std::to_string(n) + " samples";
+				uint64_t got_energy = 7;
+				uint64_t got_crossings = 3;
+				// (from an odd address too)
+				std::string bytes = " " + std::string(reinterpret_cast<const char*>(samples.data()), 2 * n);
+				VoiceGate::analyse(bytes.data() + 1, n, stride, prev.data(), got_energy, got_crossings, isa);
+				CPPUNIT_ASSERT_EQUAL_MESSAGE(message + " energy", energy + 7, got_energy);
+				CPPUNIT_ASSERT_EQUAL_MESSAGE(message + " crossings", crossings + 3, got_crossings);
+			}
+		}
+	}
+}
+
+void VoiceGateTest::test_silence()
+{
+	VoiceGate gate {drop_config(), RATE};
+	CPPUNIT_ASSERT_MESSAGE("closed", !gate.is_open());
+	std::string media;
+	silence(media, 5.0);
+	for (size_t pos = 0; pos < media.size(); pos += 640) {
+		std::string payload = media.substr(pos, 640);
+		gate.process(payload);
+		CPPUNIT_ASSERT_MESSAGE("nothing sent", payload.empty());
+	}
+	GateStats stats = gate.stats();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("bytes_in", (uint64_t)160000, stats.bytes_in);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("bytes_sent", (uint64_t)0, stats.bytes_sent);
+	// (the last 200ms are held back as pre-roll)
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("bytes_gated", (uint64_t)153600, stats.bytes_gated);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("time_gated", (int64_t)4800, (int64_t)stats.time_gated.count());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("speech_segments", (uint64_t)0, stats.speech_segments);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("level", -120.0, gate.level_db());
+}
+
+void VoiceGateTest::test_speech()
+{
+	std::string media;
+	silence(media, 1.0);
+	tone(media, 1.0, 1000, 16384);
+	silence(media, 2.0);
+	VoiceGate gate {drop_config(), RATE};
+	std::string sent = gate_media(gate, media, 640);
+
+	// from the pre-roll before the first window of the tone, until the hangover after it
+	const size_t begin = 25920;  // 0.81s
+	const size_t end = 73920;    // 2.31s
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("sent", end - begin, sent.size());
+	CPPUNIT_ASSERT_MESSAGE("sent media", sent == media.substr(begin, end - begin));
+	CPPUNIT_ASSERT_MESSAGE("closed after", !gate.is_open());
+	GateStats stats = gate.stats();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("speech_segments", (uint64_t)1, stats.speech_segments);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("bytes_sent", (uint64_t)sent.size(), stats.bytes_sent);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("bytes_gated", (uint64_t)(media.size() - sent.size() - 6400), stats.bytes_gated);
+
+	// offsets in the media sent map back to the media
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("first offset", (uint64_t)begin, gate.media_offset(0));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("tone offset", (uint64_t)32000, gate.media_offset(32000 - begin));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("last offset", (uint64_t)end, gate.media_offset(end - begin));
+}
+
+void VoiceGateTest::test_zero_crossings()
+{
+	// a quiet hiss (about -55dBFS) crosses zero often enough to be speech
+	std::string media;
+	hiss(media, 1.0, 101);
+	VoiceGate hissing {drop_config(), RATE};
+	std::string sent = gate_media(hissing, media, 640);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("hiss sent", media.size(), sent.size());
+	CPPUNIT_ASSERT_MESSAGE("hiss level", std::abs(hissing.level_db() + 55.0) < 1.0);
+
+	// a hum as loud does not
+	media.clear();
+	tone(media, 1.0, 100, 82);
+	VoiceGate humming {drop_config(), RATE};
+	sent = gate_media(humming, media, 640);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("hum sent", (size_t)0, sent.size());
+	CPPUNIT_ASSERT_MESSAGE("hum level", std::abs(humming.level_db() + 55.0) < 1.0);
+}
+
+void VoiceGateTest::test_noise_floor()
+{
+	// a steady hum above the threshold (-40dBFS) is sent at first, until the noise floor rises to it
+	std::string media;
+	tone(media, 30.0, 200, 463.4);
+	VoiceGate gate {drop_config(), RATE};
+	std::string sent = gate_media(gate, media, 640);
+	CPPUNIT_ASSERT_MESSAGE("hum sent at first", sent.size() > 10 * 32000);
+	CPPUNIT_ASSERT_MESSAGE("hum gated later", sent.size() < 15 * 32000);
+	CPPUNIT_ASSERT_MESSAGE("closed", !gate.is_open());
+	CPPUNIT_ASSERT_MESSAGE("noise floor", std::abs(gate.noise_floor_db() + 40.0) < 0.5);
+
+	// louder speech over it opens the gate again
+	media.clear();
+	tone(media, 0.5, 1000, 3277);
+	sent = gate_media(gate, media, 640);
+	CPPUNIT_ASSERT_MESSAGE("open", gate.is_open());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("speech_segments", (uint64_t)2, gate.stats().speech_segments);
+}
+
+void VoiceGateTest::test_keepalive()
+{
+	VoiceGateConfig config;
+	config.mode = VoiceGateConfig::gate_keepalive;
+	config.keepalive_interval = std::chrono::seconds(1);
+	config.keepalive_frame = std::chrono::milliseconds(10);
+	std::string media;
+	silence(media, 5.5);
+	tone(media, 0.5, 1000, 16384);
+	VoiceGate gate {config, RATE};
+	std::string sent = gate_media(gate, media, 640);
+
+	// a frame of digital silence for each second of silence withheld, then the speech with its pre-roll
+	GateStats stats = gate.stats();
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("keepalive_frames", (uint64_t)5, stats.keepalive_frames);
+	CPPUNIT_ASSERT_MESSAGE("keep-alive frames", sent.substr(0, 1600) == std::string(1600, '\0'));
+	CPPUNIT_ASSERT_MESSAGE("speech", sent.substr(1600) == media.substr(169920));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("bytes_gated", (uint64_t)169920, stats.bytes_gated);
+
+	// each keep-alive frame stands for the end of the silence withheld before it
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("first frame", (uint64_t)31680, gate.media_offset(0));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("second frame", (uint64_t)63680, gate.media_offset(320));
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("speech start", (uint64_t)169920, gate.media_offset(1600));
+}
+
+void VoiceGateTest::test_chunks()
+{
+	// stereo, with speech on one channel, split at arbitrary bytes: the same with every ISA
+	std::string left;
+	std::string right;
+	silence(left, 0.5);
+	tone(left, 0.5, 440, 8000);
+	silence(left, 1.0);
+	hiss(left, 0.3, 3000);
+	silence(left, 0.7);
+	silence(right, 3.0);
+	std::string media;
+	for (size_t i = 0; i < left.size(); i += 2) {
+		media.append(left, i, 2);
+		media.append(right, i, 2);
+	}
+
+	const SampleConverter::Isa isas[] = { SampleConverter::isa_scalar, SampleConverter::isa_sse2, SampleConverter::isa_avx2 };
+	VoiceGate whole_gate {drop_config(), RATE, 2, SampleConverter::isa_scalar};
+	std::string whole = gate_media(whole_gate, media, media.size());
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("speech_segments", (uint64_t)2, whole_gate.stats().speech_segments);
+	for (SampleConverter::Isa isa : isas) {
+		if (!SampleConverter::supported(isa)) {
+			continue;
+		}
+		for (size_t chunk : {1, 3, 640, 1001, 6400}) {
+			VoiceGate gate {drop_config(), RATE, 2, isa};
+			CPPUNIT_ASSERT_MESSAGE(std::string(SampleConverter::isa_name(isa)) + " chunks of " + std::to_string(chunk),
+				gate_media(gate, media, chunk) == whole);
+		}
+	}
+}
+
+void VoiceGateTest::test_invalid()
+{
+	VoiceGateConfig config;
+	CPPUNIT_ASSERT_THROW_MESSAGE("no rate", VoiceGate(config, 0), std::runtime_error);
+	CPPUNIT_ASSERT_THROW_MESSAGE("no channels", VoiceGate(config, RATE, 0), std::runtime_error);
+	config.window = std::chrono::milliseconds(0);
+	CPPUNIT_ASSERT_THROW_MESSAGE("no window", VoiceGate(config, RATE), std::runtime_error);
+	config = VoiceGateConfig();
+	config.hangover = std::chrono::milliseconds(-1);
+	CPPUNIT_ASSERT_THROW_MESSAGE("negative hangover", VoiceGate(config, RATE), std::runtime_error);
+	config = VoiceGateConfig();
+	config.keepalive_frame = std::chrono::seconds(10);
+	CPPUNIT_ASSERT_THROW_MESSAGE("keep-alive frame too long", VoiceGate(config, RATE), std::runtime_error);
+	config.mode = VoiceGateConfig::gate_drop;
+	VoiceGate gate {config, RATE};
+	CPPUNIT_ASSERT_MESSAGE("keep-alive frame unused", gate.config().mode == VoiceGateConfig::gate_drop);
+}
@@ -0,0 +1,31 @@
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <verbit/streaming/voice_gate.h>
+
+/**
+ * Unit tests for `VoiceGate` class.
+ */
+class VoiceGateTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(VoiceGateTest);
+
+	CPPUNIT_TEST(test_analyse);
+	CPPUNIT_TEST(test_silence);
+	CPPUNIT_TEST(test_speech);
+	CPPUNIT_TEST(test_zero_crossings);
+	CPPUNIT_TEST(test_noise_floor);
+	CPPUNIT_TEST(test_keepalive);
+	CPPUNIT_TEST(test_chunks);
+	CPPUNIT_TEST(test_invalid);
+
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void test_analyse();
+	void test_silence();
+	void test_speech();
+	void test_zero_crossings();
+	void test_noise_floor();
+	void test_keepalive();
+	void test_chunks();
+	void test_invalid();
+};
@@ -75,3 +75,22 @@ void WebSocketStreamingClientTest::test_set_verify_ssl_cert()
 	client.verify_ssl_cert(false);
 	CPPUNIT_ASSERT_MESSAGE("get verify_ssl_cert", client.verify_ssl_cert() == false);
 }
+
+void WebSocketStreamingClientTest::test_set_send_watermarks_invalid()
+{
+	std::string access_token = "frobozz";
+	WebSocketStreamingClient client {access_token};
+	CPPUNIT_ASSERT_THROW_MESSAGE("low above high", client.send_watermarks(32000, 64000), std::runtime_error);
+	CPPUNIT_ASSERT_EQUAL_MESSAGE("high_watermark unchanged", (size_t)WSSC_DEFAULT_HIGH_WATERMARK, client.high_watermark());
+}
+
+void WebSocketStreamingClientTest::test_resilient_encoded_media()
+{
+	std::string access_token = "xyzzy";
+	WebSocketStreamingClient client {access_token};
+	client.resilient(true);
+	EmptyMediaGenerator media_gen;
+	MediaConfig config;
+	config.format = "FLAC";
+	CPPUNIT_ASSERT_THROW_MESSAGE("FLAC can't be replayed", client.run_stream(media_gen, config, ResponseType()), std::runtime_error);
+}
@@ -16,6 +16,8 @@ class WebSocketStreamingClientTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(test_ws_full_url_with_params);
 	CPPUNIT_TEST(test_set_max_connection_retry);
 	CPPUNIT_TEST(test_set_verify_ssl_cert);
+	CPPUNIT_TEST(test_set_send_watermarks_invalid);
+	CPPUNIT_TEST(test_resilient_encoded_media);
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -28,4 +30,6 @@ public:
 	void test_ws_full_url_with_params();
 	void test_set_max_connection_retry();
 	void test_set_verify_ssl_cert();
+	void test_set_send_watermarks_invalid();
+	void test_resilient_encoded_media();
 };
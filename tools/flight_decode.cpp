@@ -0,0 +1,170 @@
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <sysexits.h>
+
+#include <verbit/streaming/flight_recorder.h>
+
+using namespace verbit::streaming;
+
+// as ServiceState numbers them
+const char* state_name(uint32_t state)
+{
+	static const char* names[] = {"initial", "opening", "open", "closing", "done", "fail"};
+	return (state < sizeof(names) / sizeof(names[0])) ? names[state] : "unknown";
+}
+
+// as WebSocketStreamingClient names them
+std::string error_name(int error_code)
+{
+	switch (error_code) {
+	case 0: return "none";
+	case 1006: return "1006 (WS_1006)";
+	case 3500: return "3500 (AUDIO_SOURCE_EOF)";
+	case 3510: return "3510 (KEEPALIVE_TIMEOUT)";
+	default: return std::to_string(error_code);
+	}
+}
+
+std::string details(const FlightEvent& event)
+{
+	switch (event.kind) {
+	case FlightEvent::state:
+		return std::string(state_name(event.value)) + " -> " + state_name(event.arg);
+	case FlightEvent::connect:
+		return "attempt " + std::to_string(event.value);
+	case FlightEvent::send:
+	case FlightEvent::buffered:
+		return std::to_string(event.value) + " bytes";
+	case FlightEvent::send_error:
+		return "error " + std::to_string(event.value);
+	case FlightEvent::response:
+		return std::to_string(event.value) + " bytes"
+			+ ((event.arg & FlightEvent::response_final) ? " final" : "")
+			+ ((event.arg & FlightEvent::response_eos) ? " end-of-stream" : "");
+	case FlightEvent::close:
+		return "local code " + std::to_string(event.value) + " remote code " + std::to_string(event.arg);
+	case FlightEvent::fail:
+		return "local code " + std::to_string(event.value);
+	case FlightEvent::reconnect:
+		return "reconnect " + std::to_string(event.value);
+	case FlightEvent::finish:
+		return "error " + error_name((int)event.value);
+	default:
+		return "";
+	}
+}
+
+// wall clock time of a monotonic time, from when the dump was written
+std::string wall_time(uint64_t time_ns, uint64_t dump_wall_us, uint64_t dump_time_ns)
+{
+	int64_t us = (int64_t)dump_wall_us - ((int64_t)dump_time_ns - (int64_t)time_ns) / 1000;
+	time_t seconds = us / 1000000;
+	struct tm tm;
+	localtime_r(&seconds, &tm);
+	char text[64];
+	size_t len = strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &tm);
+	snprintf(text + len, sizeof(text) - len, ".%06d", (int)(us % 1000000));
+	return text;
+}
+
+void print_text(const std::vector<FlightEvent>& events, int error_code, uint64_t wall_us, uint64_t time_ns)
+{
+	std::cout << events.size() << " events, session error " << error_name(error_code)
+		<< ", dumped " << wall_time(time_ns, wall_us, time_ns) << std::endl;
+	uint64_t first = events.empty() ? 0 : events[0].time_ns;
+	for (const FlightEvent& event : events) {
+		char line[128];
+		snprintf(line, sizeof(line), "%s %+12.3fms  %-18s ", wall_time(event.time_ns, wall_us, time_ns).c_str(),
+			((int64_t)event.time_ns - (int64_t)first) / 1e6, FlightEvent::kind_name(event.kind));
+		std::cout << line << details(event) << std::endl;
+	}
+}
+
+// Chrome trace (chrome://tracing, Perfetto) JSON: states as spans, the send queue and media
+// sent as counters, and every other event as an instant
+void print_trace(const std::vector<FlightEvent>& events, int error_code)
+{
+	uint64_t first = events.empty() ? 0 : events[0].time_ns;
+	auto ts = [first](uint64_t time_ns) { return ((int64_t)time_ns - (int64_t)first) / 1000.0; };
+	std::cout << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"error_code\":" << error_code << "},\"traceEvents\":[";
+	const char* sep = "\n";
+	char line[256];
+	uint64_t sent = 0;
+	for (size_t i = 0; i < events.size(); i++) {
+		const FlightEvent& event = events[i];
+		if (event.kind == FlightEvent::state) {
+			uint64_t end = events.back().time_ns;
+			for (size_t j = i + 1; j < events.size(); j++) {
+				if (events[j].kind == FlightEvent::state) {
+					end = events[j].time_ns;
+					break;
+				}
+			}
+			snprintf(line, sizeof(line), "{\"name\":\"%s\",\"cat\":\"state\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+				state_name(event.arg), ts(event.time_ns), (end - event.time_ns) / 1000.0);
+		} else if (event.kind == FlightEvent::buffered) {
+			snprintf(line, sizeof(line), "{\"name\":\"buffered\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"bytes\":%" PRIu32 "}}",
+				ts(event.time_ns), event.value);
+		} else if (event.kind == FlightEvent::send) {
+			sent += event.value;
+			snprintf(line, sizeof(line), "{\"name\":\"sent\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"bytes\":%" PRIu64 "}}",
+				ts(event.time_ns), sent);
+		} else {
+			int tid = (event.kind == FlightEvent::response) ? 3 : 2;
+			snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"details\":\"%s\"}}",
+				FlightEvent::kind_name(event.kind), ts(event.time_ns), tid, details(event).c_str());
+		}
+		std::cout << sep << line;
+		sep = ",\n";
+	}
+	std::cout << "\n]}" << std::endl;
+}
+
+void usage()
+{
+	std::cerr << "Usage: flight_decode [ -j ] dump" << std::endl;
+	std::cerr << "  prints the events of a flight recorder dump as text, or with -j as Chrome trace JSON" << std::endl;
+	std::cerr << "  (for chrome://tracing or https://ui.perfetto.dev)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	bool trace = false;
+	int c;
+	while ((c = getopt(argc, argv, "?hj")) != -1) {
+		switch (c) {
+		case 'j':
+			trace = true;
+			break;
+		default:
+			usage();
+			return EX_USAGE;
+		}
+	}
+	if (optind != argc - 1) {
+		usage();
+		return EX_USAGE;
+	}
+
+	std::vector<FlightEvent> events;
+	int error_code;
+	uint64_t wall_us;
+	uint64_t time_ns;
+	try {
+		FlightRecorder::load(argv[optind], events, error_code, wall_us, time_ns);
+	} catch (std::exception& e) {
+		std::cerr << "flight_decode: " << e.what() << std::endl;
+		return EX_DATAERR;
+	}
+	if (trace) {
+		print_trace(events, error_code);
+	} else {
+		print_text(events, error_code, wall_us, time_ns);
+	}
+	return EX_OK;
+}